@@ -88,6 +88,8 @@ static const pa_daemon_conf default_conf = {
     .remixing_produce_lfe = false,
     .remixing_consume_lfe = false,
     .lfe_crossover_freq = 0,
+    .render_workers = 0,
+    .rtpoll_backend = PA_RTPOLL_BACKEND_PPOLL,
     .config_file = NULL,
     .use_pid_file = true,
     .system_instance = false,
@@ -99,6 +101,8 @@ static const pa_daemon_conf default_conf = {
     .disable_memfd = false,
     .lock_memory = false,
     .deferred_volume = true,
+    .float_mixing = false,
+    .float_mixing_dither = true,
     .default_n_fragments = 4,
     .default_fragment_size_msec = 25,
     .deferred_volume_safety_margin_usec = 8000,
@@ -106,7 +110,13 @@ static const pa_daemon_conf default_conf = {
     .default_sample_spec = { .format = PA_SAMPLE_S16NE, .rate = 44100, .channels = 2 },
     .alternate_sample_rate = 48000,
     .default_channel_map = { .channels = 2, .map = { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } },
-    .shm_size = 0
+    .shm_size = 0,
+    .mempool_slot_sizes = { 2048, 8192, 65536 },
+    .n_mempool_slot_sizes = 3,
+    .mempool_huge_pages = false,
+    .mempool_prefault = false,
+    .mempool_numa_node = PA_SHM_NUMA_NODE_ANY,
+    .max_simd_tier = PA_CPU_X86_TIER_MAX
 #ifdef HAVE_SYS_RESOURCE_H
    ,.rlimit_fsize = { .value = 0, .is_set = false },
     .rlimit_data = { .value = 0, .is_set = false },
@@ -304,6 +314,93 @@ static int parse_resample_method(pa_config_parser_state *state) {
     return 0;
 }
 
+static int parse_rtpoll_backend(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    int b;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if ((b = pa_rtpoll_backend_from_string(state->rvalue)) < 0) {
+        pa_log(_("[%s:%u] Invalid poll backend '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    c->rtpoll_backend = (pa_rtpoll_backend_t) b;
+    return 0;
+}
+
+static int parse_simd_tier(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    int t;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if ((t = pa_cpu_x86_parse_tier(state->rvalue)) < 0) {
+        pa_log(_("[%s:%u] Invalid SIMD tier '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    c->max_simd_tier = (pa_cpu_x86_tier_t) t;
+    return 0;
+}
+
+static int parse_mempool_slot_sizes(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    const char *state_split = NULL;
+    char *k;
+    size_t sizes[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    unsigned n = 0;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    while ((k = pa_split_spaces(state->rvalue, &state_split))) {
+        uint32_t u;
+
+        if (n >= PA_MEMPOOL_SLOT_CLASSES_MAX || pa_atou(k, &u) < 0 || u < 256) {
+            pa_log(_("[%s:%u] Invalid memory pool slot sizes '%s'."), state->filename, state->lineno, state->rvalue);
+            pa_xfree(k);
+            return -1;
+        }
+
+        sizes[n++] = (size_t) u;
+        pa_xfree(k);
+    }
+
+    if (n == 0) {
+        pa_log(_("[%s:%u] Invalid memory pool slot sizes '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    memcpy(c->mempool_slot_sizes, sizes, n * sizeof(size_t));
+    c->n_mempool_slot_sizes = n;
+    return 0;
+}
+
+static int parse_mempool_numa_node(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    int32_t n;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if (pa_streq(state->rvalue, "auto"))
+        n = PA_SHM_NUMA_NODE_LOCAL;
+    else if (pa_atoi(state->rvalue, &n) < 0 || n < PA_SHM_NUMA_NODE_ANY) {
+        pa_log(_("[%s:%u] Invalid NUMA node '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    c->mempool_numa_node = n;
+    return 0;
+}
+
 #ifdef HAVE_SYS_RESOURCE_H
 static int parse_rlimit(pa_config_parser_state *state) {
     struct pa_rlimit *r;
@@ -587,6 +684,8 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "exit-idle-time",             pa_config_parse_int,      &c->exit_idle_time, NULL },
         { "scache-idle-time",           pa_config_parse_int,      &c->scache_idle_time, NULL },
         { "realtime-priority",          parse_rtprio,             c, NULL },
+        { "render-workers",             pa_config_parse_unsigned, &c->render_workers, NULL },
+        { "rtpoll-backend",             parse_rtpoll_backend,     c, NULL },
         { "dl-search-path",             pa_config_parse_string,   &c->dl_search_path, NULL },
         { "default-script-file",        pa_config_parse_string,   &c->default_script_file, NULL },
         { "log-target",                 parse_log_target,         c, NULL },
@@ -615,8 +714,15 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "remixing-produce-lfe",       pa_config_parse_bool,     &c->remixing_produce_lfe, NULL },
         { "remixing-consume-lfe",       pa_config_parse_bool,     &c->remixing_consume_lfe, NULL },
         { "lfe-crossover-freq",         pa_config_parse_unsigned, &c->lfe_crossover_freq, NULL },
+        { "float-mixing",               pa_config_parse_bool,     &c->float_mixing, NULL },
+        { "float-mixing-dither",        pa_config_parse_bool,     &c->float_mixing_dither, NULL },
         { "load-default-script-file",   pa_config_parse_bool,     &c->load_default_script_file, NULL },
         { "shm-size-bytes",             pa_config_parse_size,     &c->shm_size, NULL },
+        { "mempool-slot-sizes",         parse_mempool_slot_sizes, c, NULL },
+        { "mempool-huge-pages",         pa_config_parse_bool,     &c->mempool_huge_pages, NULL },
+        { "mempool-prefault",           pa_config_parse_bool,     &c->mempool_prefault, NULL },
+        { "mempool-numa-node",          parse_mempool_numa_node,  c, NULL },
+        { "max-simd-tier",              parse_simd_tier,          c, NULL },
         { "log-meta",                   pa_config_parse_bool,     &c->log_meta, NULL },
         { "log-time",                   pa_config_parse_bool,     &c->log_time, NULL },
         { "log-backtrace",              pa_config_parse_unsigned, &c->log_backtrace, NULL },
@@ -767,6 +873,7 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf *s;
     char cm[PA_CHANNEL_MAP_SNPRINT_MAX];
     char *log_target = NULL;
+    unsigned i;
 
     pa_assert(c);
 
@@ -786,6 +893,8 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "nice-level = %i\n", c->nice_level);
     pa_strbuf_printf(s, "realtime-scheduling = %s\n", pa_yes_no(c->realtime_scheduling));
     pa_strbuf_printf(s, "realtime-priority = %i\n", c->realtime_priority);
+    pa_strbuf_printf(s, "render-workers = %u\n", c->render_workers);
+    pa_strbuf_printf(s, "rtpoll-backend = %s\n", pa_rtpoll_backend_to_string(c->rtpoll_backend));
     pa_strbuf_printf(s, "allow-module-loading = %s\n", pa_yes_no(!c->disallow_module_loading));
     pa_strbuf_printf(s, "allow-exit = %s\n", pa_yes_no(!c->disallow_exit));
     pa_strbuf_printf(s, "use-pid-file = %s\n", pa_yes_no(c->use_pid_file));
@@ -812,6 +921,8 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "remixing-produce-lfe = %s\n", pa_yes_no(c->remixing_produce_lfe));
     pa_strbuf_printf(s, "remixing-consume-lfe = %s\n", pa_yes_no(c->remixing_consume_lfe));
     pa_strbuf_printf(s, "lfe-crossover-freq = %u\n", c->lfe_crossover_freq);
+    pa_strbuf_printf(s, "float-mixing = %s\n", pa_yes_no(c->float_mixing));
+    pa_strbuf_printf(s, "float-mixing-dither = %s\n", pa_yes_no(c->float_mixing_dither));
     pa_strbuf_printf(s, "default-sample-format = %s\n", pa_sample_format_to_string(c->default_sample_spec.format));
     pa_strbuf_printf(s, "default-sample-rate = %u\n", c->default_sample_spec.rate);
     pa_strbuf_printf(s, "alternate-sample-rate = %u\n", c->alternate_sample_rate);
@@ -823,6 +934,17 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "deferred-volume-safety-margin-usec = %u\n", c->deferred_volume_safety_margin_usec);
     pa_strbuf_printf(s, "deferred-volume-extra-delay-usec = %d\n", c->deferred_volume_extra_delay_usec);
     pa_strbuf_printf(s, "shm-size-bytes = %lu\n", (unsigned long) c->shm_size);
+    pa_strbuf_puts(s, "mempool-slot-sizes =");
+    for (i = 0; i < c->n_mempool_slot_sizes; i++)
+        pa_strbuf_printf(s, " %lu", (unsigned long) c->mempool_slot_sizes[i]);
+    pa_strbuf_puts(s, "\n");
+    pa_strbuf_printf(s, "mempool-huge-pages = %s\n", pa_yes_no(c->mempool_huge_pages));
+    pa_strbuf_printf(s, "mempool-prefault = %s\n", pa_yes_no(c->mempool_prefault));
+    if (c->mempool_numa_node == PA_SHM_NUMA_NODE_LOCAL)
+        pa_strbuf_puts(s, "mempool-numa-node = auto\n");
+    else
+        pa_strbuf_printf(s, "mempool-numa-node = %i\n", c->mempool_numa_node);
+    pa_strbuf_printf(s, "max-simd-tier = %s\n", pa_cpu_x86_tier_to_string(c->max_simd_tier));
     pa_strbuf_printf(s, "log-meta = %s\n", pa_yes_no(c->log_meta));
     pa_strbuf_printf(s, "log-time = %s\n", pa_yes_no(c->log_time));
     pa_strbuf_printf(s, "log-backtrace = %u\n", c->log_backtrace);
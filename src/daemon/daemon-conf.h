@@ -28,6 +28,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/core.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/rtpoll.h>
 
 #ifdef HAVE_SYS_RESOURCE_H
 #include <sys/resource.h>
@@ -79,7 +80,9 @@ typedef struct pa_daemon_conf {
         flat_volumes,
         rescue_streams,
         lock_memory,
-        deferred_volume;
+        deferred_volume,
+        float_mixing,
+        float_mixing_dither;
     pa_server_type_t local_server_type;
     int exit_idle_time,
         scache_idle_time,
@@ -133,10 +136,17 @@ typedef struct pa_daemon_conf {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
+    unsigned render_workers;
+    pa_rtpoll_backend_t rtpoll_backend;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
     size_t shm_size;
+    size_t mempool_slot_sizes[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    unsigned n_mempool_slot_sizes;
+    bool mempool_huge_pages, mempool_prefault;
+    int mempool_numa_node;
+    pa_cpu_x86_tier_t max_simd_tier;
 } pa_daemon_conf;
 
 /* Allocate a new structure and fill it with sane defaults */
@@ -85,6 +85,7 @@
 #include <pulsecore/shm.h>
 #include <pulsecore/memtrap.h>
 #include <pulsecore/strlist.h>
+#include <pulsecore/rtpoll.h>
 #ifdef HAVE_DBUS
 #include <pulsecore/dbus-shared.h>
 #endif
@@ -1037,11 +1038,16 @@ int main(int argc, char *argv[]) {
 
     pa_memtrap_install();
 
+    pa_rtpoll_set_default_backend(conf->rtpoll_backend);
+
     pa_assert_se(mainloop = pa_mainloop_new());
 
     if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm,
                           !conf->disable_shm && !conf->disable_memfd && pa_memfd_is_locally_supported(),
-                          conf->shm_size))) {
+                          conf->shm_size, conf->mempool_slot_sizes, conf->n_mempool_slot_sizes,
+                          (conf->mempool_huge_pages ? PA_SHM_HUGE_PAGES : 0) |
+                          (conf->mempool_prefault ? PA_SHM_PREFAULT : 0),
+                          conf->mempool_numa_node))) {
         pa_log(_("pa_core_new() failed."));
         goto finish;
     }
@@ -1054,6 +1060,7 @@ int main(int argc, char *argv[]) {
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
     c->lfe_crossover_freq = conf->lfe_crossover_freq;
+    c->render_workers = conf->render_workers;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
     c->resample_method = conf->resample_method;
@@ -1065,6 +1072,8 @@ int main(int argc, char *argv[]) {
     c->remixing_produce_lfe = conf->remixing_produce_lfe;
     c->remixing_consume_lfe = conf->remixing_consume_lfe;
     c->deferred_volume = conf->deferred_volume;
+    c->float_mixing = conf->float_mixing;
+    c->float_mixing_dither = conf->float_mixing_dither;
     c->running_as_daemon = conf->daemonize;
     c->disallow_exit = conf->disallow_exit;
     c->flat_volumes = conf->flat_volumes;
@@ -1077,6 +1086,7 @@ int main(int argc, char *argv[]) {
 
     c->state = PA_CORE_RUNNING;
 
+    c->cpu_info.x86_max_tier = conf->max_simd_tier;
     pa_cpu_init(&c->cpu_info);
 
     pa_assert_se(pa_signal_init(pa_mainloop_get_api(mainloop)) == 0);
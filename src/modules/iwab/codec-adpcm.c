@@ -0,0 +1,257 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+
+#include "codec-api.h"
+
+/* IMA ADPCM, 4 bits per sample.
+ *
+ * Each frame is a self-contained block: for every channel a 4 byte header
+ * holding the first sample (s16le), the step index and a flags byte,
+ * followed by one nibble per channel for each of the remaining samples,
+ * channels interleaved, low nibble first. The first channel flags tell
+ * whether the last nibble is padding. The encoder carries the step index over
+ * from one block to the next so that quality doesn't suffer from the
+ * restart, but the decoder only needs the block itself. */
+
+#define BLOCK_HEADER_SIZE 4
+#define BLOCK_FLAG_PADDED 1
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+struct adpcm_channel {
+    int32_t predictor;
+    int32_t index;
+};
+
+struct adpcm_info {
+    unsigned channels;
+    struct adpcm_channel state[PA_CHANNELS_MAX];
+};
+
+static void *init(bool for_encoding, const pa_sample_spec *sample_spec) {
+    struct adpcm_info *adpcm_info;
+
+    if (sample_spec->format != PA_SAMPLE_S16NE) {
+        pa_log_error("ADPCM only supports %s samples", pa_sample_format_to_string(PA_SAMPLE_S16NE));
+        return NULL;
+    }
+
+    adpcm_info = pa_xnew0(struct adpcm_info, 1);
+    adpcm_info->channels = sample_spec->channels;
+
+    return adpcm_info;
+}
+
+static void deinit(void *codec_info) {
+    pa_xfree(codec_info);
+}
+
+static int reset(void *codec_info) {
+    struct adpcm_info *adpcm_info = (struct adpcm_info *) codec_info;
+    unsigned c;
+
+    for (c = 0; c < adpcm_info->channels; c++) {
+        adpcm_info->state[c].predictor = 0;
+        adpcm_info->state[c].index = 0;
+    }
+
+    return 0;
+}
+
+/* Number of frames fitting in a block of link_mtu bytes */
+static size_t block_frames(struct adpcm_info *adpcm_info, size_t link_mtu) {
+    size_t header = BLOCK_HEADER_SIZE * adpcm_info->channels;
+
+    if (link_mtu <= header)
+        return 0;
+
+    return (link_mtu - header) * 2 / adpcm_info->channels + 1;
+}
+
+static size_t get_block_size(void *codec_info, size_t link_mtu) {
+    struct adpcm_info *adpcm_info = (struct adpcm_info *) codec_info;
+
+    return block_frames(adpcm_info, link_mtu) * adpcm_info->channels * sizeof(int16_t);
+}
+
+/* Apply a nibble to the channel state, returns the decoded sample */
+static inline int16_t step(struct adpcm_channel *s, uint8_t nibble) {
+    int32_t st = step_table[s->index];
+    int32_t diff = st >> 3;
+
+    if (nibble & 4)
+        diff += st;
+    if (nibble & 2)
+        diff += st >> 1;
+    if (nibble & 1)
+        diff += st >> 2;
+
+    s->predictor += (nibble & 8) ? -diff : diff;
+    s->predictor = PA_CLAMP_UNLIKELY(s->predictor, -32768, 32767);
+    s->index = PA_CLAMP_UNLIKELY(s->index + index_table[nibble], 0, 88);
+
+    return (int16_t) s->predictor;
+}
+
+static inline uint8_t encode_sample(struct adpcm_channel *s, int16_t sample) {
+    int32_t st = step_table[s->index];
+    int32_t diff = sample - s->predictor;
+    uint8_t nibble = 0;
+
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+
+    if (diff >= st) {
+        nibble |= 4;
+        diff -= st;
+    }
+    st >>= 1;
+    if (diff >= st) {
+        nibble |= 2;
+        diff -= st;
+    }
+    st >>= 1;
+    if (diff >= st)
+        nibble |= 1;
+
+    /* track exactly what the decoder will reconstruct */
+    step(s, nibble);
+    return nibble;
+}
+
+static size_t encode_buffer(void *codec_info, uint32_t timestamp, const uint8_t *input_buffer, size_t input_size, uint8_t *output_buffer, size_t output_size, size_t *processed) {
+    struct adpcm_info *adpcm_info = (struct adpcm_info *) codec_info;
+    const int16_t *in = (const int16_t *) input_buffer;
+    unsigned c, channels = adpcm_info->channels;
+    size_t frames, f, n = 0;
+    uint8_t *d = output_buffer;
+
+    frames = PA_MIN(input_size / (channels * sizeof(int16_t)), block_frames(adpcm_info, output_size));
+
+    if (frames == 0) {
+        *processed = 0;
+        return 0;
+    }
+
+    for (c = 0; c < channels; c++) {
+        struct adpcm_channel *s = &adpcm_info->state[c];
+
+        s->predictor = in[c];
+        d[0] = (uint8_t) (s->predictor & 0xff);
+        d[1] = (uint8_t) ((s->predictor >> 8) & 0xff);
+        d[2] = (uint8_t) s->index;
+        d[3] = 0;
+        d += BLOCK_HEADER_SIZE;
+    }
+
+    for (f = 1; f < frames; f++) {
+        for (c = 0; c < channels; c++, n++) {
+            uint8_t nibble = encode_sample(&adpcm_info->state[c], in[f * channels + c]);
+
+            if (n & 1)
+                *(d++) |= nibble << 4;
+            else
+                *d = nibble;
+        }
+    }
+
+    if (n & 1) {
+        output_buffer[3] = BLOCK_FLAG_PADDED;
+        d++;
+    }
+
+    *processed = frames * channels * sizeof(int16_t);
+    return d - output_buffer;
+}
+
+static size_t decode_buffer(void *codec_info, const uint8_t *input_buffer, size_t input_size, uint8_t *output_buffer, size_t output_size, size_t *processed) {
+    struct adpcm_info *adpcm_info = (struct adpcm_info *) codec_info;
+    struct adpcm_channel state[PA_CHANNELS_MAX];
+    int16_t *out = (int16_t *) output_buffer;
+    unsigned c, channels = adpcm_info->channels;
+    size_t frames, f, n = 0;
+    const uint8_t *p = input_buffer;
+
+    if (input_size <= BLOCK_HEADER_SIZE * channels) {
+        *processed = 0;
+        return 0;
+    }
+
+    frames = ((input_size - BLOCK_HEADER_SIZE * channels) * 2 - (p[3] & BLOCK_FLAG_PADDED)) / channels + 1;
+    frames = PA_MIN(frames, output_size / (channels * sizeof(int16_t)));
+    if (frames == 0) {
+        *processed = 0;
+        return 0;
+    }
+
+    for (c = 0; c < channels; c++) {
+        state[c].predictor = (int16_t) (p[0] | (p[1] << 8));
+        state[c].index = PA_MIN(p[2], 88);
+        out[c] = (int16_t) state[c].predictor;
+        p += BLOCK_HEADER_SIZE;
+    }
+
+    for (f = 1; f < frames; f++) {
+        for (c = 0; c < channels; c++, n++) {
+            uint8_t nibble = (n & 1) ? (*(p++) >> 4) : (*p & 0x0f);
+
+            out[f * channels + c] = step(&state[c], nibble);
+        }
+    }
+
+    if (n & 1)
+        p++;
+
+    *processed = p - input_buffer;
+    return frames * channels * sizeof(int16_t);
+}
+
+const iwab_codec iwab_codec_adpcm = {
+    .name = "adpcm",
+    .description = "IMA ADPCM",
+    .id = IWAB_CODEC_ADPCM,
+    .init = init,
+    .deinit = deinit,
+    .reset = reset,
+    .get_read_block_size = get_block_size,
+    .get_write_block_size = get_block_size,
+    .encode_buffer = encode_buffer,
+    .decode_buffer = decode_buffer,
+};
@@ -0,0 +1,70 @@
+#ifndef fooiwabcodecapihfoo
+#define fooiwabcodecapihfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/sample.h>
+#include <pulsecore/macro.h>
+
+/* Payload codec ids, carried in the codec field of struct iwab_head */
+enum iwab_codec_id {
+    IWAB_CODEC_PCM = 0,
+    IWAB_CODEC_ADPCM = 1,
+};
+
+/* Same shape as pa_a2dp_codec, minus the A2DP capability negotiation: the
+ * sender picks the codec and tags every frame with its id. Every frame must
+ * decode on its own, a lost frame can't desynchronise the decoder. */
+typedef struct iwab_codec {
+    /* Unique name of the codec, lowercase and without whitespaces, used as
+     * the codec= module argument */
+    const char *name;
+    /* Human readable codec description */
+    const char *description;
+
+    /* iwab codec id */
+    uint8_t id;
+
+    /* Initialize codec, returns codec info data or NULL if sample_spec is
+     * not supported, for_encoding is true when codec_info is used for
+     * encoding */
+    void *(*init)(bool for_encoding, const pa_sample_spec *sample_spec);
+    /* Deinitialize and release codec info data in codec_info */
+    void (*deinit)(void *codec_info);
+    /* Reset internal state of codec info data in codec_info, returns
+     * a negative value on failure */
+    int (*reset)(void *codec_info);
+
+    /* Get read block size for codec, it is minimal size of buffer
+     * needed to decode read_link_mtu bytes of encoded data */
+    size_t (*get_read_block_size)(void *codec_info, size_t read_link_mtu);
+    /* Get write block size for codec, it is maximal size of buffer
+     * which can produce at most write_link_mtu bytes of encoded data */
+    size_t (*get_write_block_size)(void *codec_info, size_t write_link_mtu);
+
+    /* Encode input_buffer of input_size to output_buffer of output_size,
+     * returns size of filled ouput_buffer and set processed to size of
+     * processed input_buffer */
+    size_t (*encode_buffer)(void *codec_info, uint32_t timestamp, const uint8_t *input_buffer, size_t input_size, uint8_t *output_buffer, size_t output_size, size_t *processed);
+    /* Decode input_buffer of input_size to output_buffer of output_size,
+     * returns size of filled ouput_buffer and set processed to size of
+     * processed input_buffer */
+    size_t (*decode_buffer)(void *codec_info, const uint8_t *input_buffer, size_t input_size, uint8_t *output_buffer, size_t output_size, size_t *processed);
+} iwab_codec;
+
+#endif
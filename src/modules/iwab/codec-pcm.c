@@ -0,0 +1,87 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include "codec-api.h"
+
+/* Raw PCM, the historical iwab payload */
+
+struct pcm_info {
+    size_t frame_size;
+};
+
+static void *init(bool for_encoding, const pa_sample_spec *sample_spec) {
+    struct pcm_info *pcm_info;
+
+    pcm_info = pa_xnew0(struct pcm_info, 1);
+    pcm_info->frame_size = pa_frame_size(sample_spec);
+
+    return pcm_info;
+}
+
+static void deinit(void *codec_info) {
+    pa_xfree(codec_info);
+}
+
+static int reset(void *codec_info) {
+    return 0;
+}
+
+static size_t get_block_size(void *codec_info, size_t link_mtu) {
+    struct pcm_info *pcm_info = (struct pcm_info *) codec_info;
+
+    return link_mtu - link_mtu % pcm_info->frame_size;
+}
+
+static size_t copy_buffer(void *codec_info, const uint8_t *input_buffer, size_t input_size, uint8_t *output_buffer, size_t output_size, size_t *processed) {
+    struct pcm_info *pcm_info = (struct pcm_info *) codec_info;
+    size_t size = PA_MIN(input_size, output_size);
+
+    size -= size % pcm_info->frame_size;
+    memcpy(output_buffer, input_buffer, size);
+
+    *processed = size;
+    return size;
+}
+
+static size_t encode_buffer(void *codec_info, uint32_t timestamp, const uint8_t *input_buffer, size_t input_size, uint8_t *output_buffer, size_t output_size, size_t *processed) {
+    return copy_buffer(codec_info, input_buffer, input_size, output_buffer, output_size, processed);
+}
+
+static size_t decode_buffer(void *codec_info, const uint8_t *input_buffer, size_t input_size, uint8_t *output_buffer, size_t output_size, size_t *processed) {
+    return copy_buffer(codec_info, input_buffer, input_size, output_buffer, output_size, processed);
+}
+
+const iwab_codec iwab_codec_pcm = {
+    .name = "pcm",
+    .description = "Uncompressed PCM",
+    .id = IWAB_CODEC_PCM,
+    .init = init,
+    .deinit = deinit,
+    .reset = reset,
+    .get_read_block_size = get_block_size,
+    .get_write_block_size = get_block_size,
+    .encode_buffer = encode_buffer,
+    .decode_buffer = decode_buffer,
+};
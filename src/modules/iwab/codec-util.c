@@ -0,0 +1,71 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/core-util.h>
+
+#include "codec-util.h"
+
+extern const iwab_codec iwab_codec_pcm;
+extern const iwab_codec iwab_codec_adpcm;
+
+const iwab_codec *iwab_codecs[] = {
+    &iwab_codec_pcm,
+    &iwab_codec_adpcm,
+};
+
+unsigned int iwab_codec_count(void) {
+    return PA_ELEMENTSOF(iwab_codecs);
+}
+
+const iwab_codec *iwab_codec_iter(unsigned int i) {
+    pa_assert(i < iwab_codec_count());
+    return iwab_codecs[i];
+}
+
+const iwab_codec *iwab_get_codec(const char *name) {
+    unsigned int i;
+    unsigned int count = iwab_codec_count();
+
+    for (i = 0; i < count; i++) {
+        if (pa_streq(iwab_codecs[i]->name, name))
+            return iwab_codecs[i];
+    }
+
+    return NULL;
+}
+
+const iwab_codec *iwab_get_codec_by_id(uint8_t id) {
+    unsigned int i;
+    unsigned int count = iwab_codec_count();
+
+    for (i = 0; i < count; i++) {
+        if (iwab_codecs[i]->id == id)
+            return iwab_codecs[i];
+    }
+
+    return NULL;
+}
+
+size_t iwab_codec_get_decoded_size(const iwab_codec *codec, void *codec_info, const pa_sample_spec *ss, size_t length) {
+    size_t size = codec->get_read_block_size(codec_info, length);
+
+    return size < pa_frame_size(ss) ? 0 : size;
+}
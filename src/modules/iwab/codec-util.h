@@ -0,0 +1,39 @@
+#ifndef fooiwabcodecutilhfoo
+#define fooiwabcodecutilhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "codec-api.h"
+
+/* Get number of supported iwab codecs */
+unsigned int iwab_codec_count(void);
+
+/* Get i-th codec */
+const iwab_codec *iwab_codec_iter(unsigned int i);
+
+/* Get codec by name */
+const iwab_codec *iwab_get_codec(const char *name);
+
+/* Get codec by the id found in frame headers */
+const iwab_codec *iwab_get_codec_by_id(uint8_t id);
+
+/* Get the size of the buffer a payload of length bytes decodes into, 0 if
+ * the payload can't hold a single frame */
+size_t iwab_codec_get_decoded_size(const iwab_codec *codec, void *codec_info, const pa_sample_spec *ss, size_t length);
+
+#endif
@@ -0,0 +1,253 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "fec.h"
+
+int iwab_fec_params_valid(unsigned k, unsigned m) {
+    return k > 0 && k <= IWAB_FEC_MAX_K && m > 0 && m <= IWAB_FEC_MAX_M && m <= k;
+}
+
+static void xor_into(uint8_t *dst, const uint8_t *src, size_t length) {
+    size_t n = 0;
+
+    for (; n + sizeof(uint64_t) <= length; n += sizeof(uint64_t)) {
+        uint64_t a, b;
+
+        memcpy(&a, dst + n, sizeof(a));
+        memcpy(&b, src + n, sizeof(b));
+        a ^= b;
+        memcpy(dst + n, &a, sizeof(a));
+    }
+
+    for (; n < length; n++)
+        dst[n] ^= src[n];
+}
+
+/* XOR a frame into a parity frame, growing the parity to the frame length */
+static void parity_add(struct iwab_fec_frame *p, const uint8_t *data, size_t length, uint64_t timestamp) {
+    if (length > p->length) {
+        memset(p->data + p->length, 0, length - p->length);
+        p->length = length;
+    }
+
+    xor_into(p->data, data, length);
+    p->length_xor ^= length;
+    p->timestamp ^= timestamp;
+}
+
+void iwab_fec_encoder_init(struct iwab_fec_encoder *e, unsigned k, unsigned m) {
+    memset(e, 0, sizeof(*e));
+    e->k = k;
+    e->m = m;
+}
+
+unsigned iwab_fec_encoder_add(struct iwab_fec_encoder *e, const uint8_t *data, size_t length, uint64_t timestamp) {
+    unsigned index, j;
+
+    /* The previous group is done, start a new one */
+    if (e->index == e->k)
+        e->index = 0;
+
+    if (e->index == 0) {
+        for (j = 0; j < e->m; j++) {
+            e->parity[j].length = 0;
+            e->parity[j].length_xor = 0;
+            e->parity[j].timestamp = 0;
+        }
+    }
+
+    index = e->index++;
+    parity_add(&e->parity[index % e->m], data, length, timestamp);
+
+    return index;
+}
+
+void iwab_fec_decoder_init(struct iwab_fec_decoder *d) {
+    d->k = 0;
+    d->m = 0;
+    d->active = 0;
+    d->closed = 0;
+    d->next = 0;
+    d->recovered = 0;
+    d->lost = 0;
+}
+
+static void decoder_start(struct iwab_fec_decoder *d, unsigned k, unsigned m, uint32_t group_seq) {
+    unsigned n;
+
+    d->k = k;
+    d->m = m;
+    d->group_seq = group_seq;
+    d->active = 1;
+    d->closed = 0;
+    d->next = 0;
+
+    for (n = 0; n < k + m; n++) {
+        d->frames[n].present = 0;
+        d->frames[n].recovered = 0;
+    }
+}
+
+/* Rebuild the missing data frame of parity class j, if it is the only one */
+static void decoder_repair(struct iwab_fec_decoder *d, unsigned j) {
+    struct iwab_fec_frame *parity = &d->frames[d->k + j];
+    struct iwab_fec_frame *missing = NULL;
+    struct iwab_fec_frame *f;
+    size_t length;
+    uint64_t timestamp;
+    unsigned i;
+
+    if (!parity->present)
+        return;
+
+    for (i = j; i < d->k; i += d->m) {
+        if (!d->frames[i].present) {
+            /* More than one loss in this class */
+            if (missing)
+                return;
+
+            missing = &d->frames[i];
+        }
+    }
+
+    if (!missing)
+        return;
+
+    length = parity->length_xor;
+    timestamp = parity->timestamp;
+    for (i = j; i < d->k; i += d->m) {
+        f = &d->frames[i];
+        if (f != missing) {
+            length ^= f->length;
+            timestamp ^= f->timestamp;
+        }
+    }
+
+    /* Corrupted parity */
+    if (length == 0 || length > parity->length)
+        return;
+
+    memcpy(missing->data, parity->data, length);
+    for (i = j; i < d->k; i += d->m) {
+        f = &d->frames[i];
+        if (f != missing)
+            xor_into(missing->data, f->data, f->length < length ? f->length : length);
+    }
+
+    missing->length = length;
+    missing->timestamp = timestamp;
+    missing->seq = d->group_seq + (missing - d->frames);
+    missing->present = 1;
+    missing->recovered = 1;
+    d->recovered += 1;
+}
+
+static void decoder_update_closed(struct iwab_fec_decoder *d) {
+    unsigned n, data = 0, parity = 0;
+
+    for (n = 0; n < d->k; n++)
+        data += d->frames[n].present;
+
+    for (n = d->k; n < d->k + d->m; n++)
+        parity += d->frames[n].present;
+
+    d->closed = data == d->k || parity == d->m;
+}
+
+int iwab_fec_decoder_put(struct iwab_fec_decoder *d, const struct iwab_head *h, const uint8_t *data, size_t length) {
+    struct iwab_fec_frame *f;
+    uint32_t group_seq;
+    unsigned k = h->fec_k, m = h->fec_m, index = h->fec_index;
+
+    if (!iwab_fec_params_valid(k, m) || index >= k + m || length > IWAB_FEC_MAX_PAYLOAD)
+        return -1;
+
+    group_seq = index < k ? h->seq - index : h->seq;
+
+    if (d->active && (k != d->k || m != d->m || (int32_t) (group_seq - d->group_seq) > 0)) {
+        /* A newer group started, the current one won't get any more frames */
+        if (d->next < d->k) {
+            iwab_fec_decoder_flush(d);
+            return 1;
+        }
+
+        d->active = 0;
+    }
+
+    /* Late frame of an old group */
+    if (d->active && (int32_t) (group_seq - d->group_seq) < 0)
+        return 0;
+
+    if (!d->active)
+        decoder_start(d, k, m, group_seq);
+
+    f = &d->frames[index];
+
+    /* Repeat */
+    if (f->present)
+        return 0;
+
+    memcpy(f->data, data, length);
+    f->length = length;
+    f->length_xor = h->length;
+    f->timestamp = h->timestamp;
+    f->seq = h->seq;
+    f->present = 1;
+    f->recovered = 0;
+
+    decoder_repair(d, index < k ? index % m : index - k);
+    decoder_update_closed(d);
+
+    return 0;
+}
+
+const struct iwab_fec_frame *iwab_fec_decoder_pop(struct iwab_fec_decoder *d) {
+    if (!d->active)
+        return NULL;
+
+    while (d->next < d->k) {
+        struct iwab_fec_frame *f = &d->frames[d->next];
+
+        if (f->present) {
+            d->next += 1;
+            return f;
+        }
+
+        /* Wait for the parity */
+        if (!d->closed)
+            return NULL;
+
+        d->lost += 1;
+        d->next += 1;
+    }
+
+    return NULL;
+}
+
+void iwab_fec_decoder_flush(struct iwab_fec_decoder *d) {
+    d->closed = 1;
+}
+
+void iwab_fec_decoder_reset(struct iwab_fec_decoder *d) {
+    d->active = 0;
+}
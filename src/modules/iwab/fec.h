@@ -0,0 +1,95 @@
+#ifndef fooiwabfechfoo
+#define fooiwabfechfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "net.h"
+
+/* Interleaved XOR parity: a group is made of k data frames followed by m
+ * parity frames, parity frame j covers the data frames i with i % m == j.
+ * Any loss pattern leaving at most one missing frame per parity class can
+ * be repaired, which includes every burst of up to m consecutive frames.
+ *
+ * Parity frames don't consume a sequence number: their seq is the one of
+ * the first data frame of the group. Their timestamp and length fields
+ * hold the XOR of the timestamps and lengths of the frames they cover, and
+ * their payload the XOR of those payloads, zero padded to the longest one. */
+
+#define IWAB_FEC_MAX_K 32
+#define IWAB_FEC_MAX_M 8
+#define IWAB_FEC_MAX_PAYLOAD 1600
+
+struct iwab_fec_frame {
+    uint8_t data[IWAB_FEC_MAX_PAYLOAD];
+    size_t length; // payload length
+    uint16_t length_xor; // parity frames only
+    uint64_t timestamp;
+    uint32_t seq;
+    int present;
+    int recovered;
+};
+
+struct iwab_fec_encoder {
+    unsigned k, m;
+    unsigned index; // index of the next data frame in the group
+    struct iwab_fec_frame parity[IWAB_FEC_MAX_M];
+};
+
+struct iwab_fec_decoder {
+    unsigned k, m;
+    int active;
+    int closed; // no more frames of this group are expected
+    uint32_t group_seq; // seq of the first data frame of the group
+    unsigned next; // index of the next data frame to hand out
+    struct iwab_fec_frame frames[IWAB_FEC_MAX_K + IWAB_FEC_MAX_M];
+    uint64_t recovered;
+    uint64_t lost; // data frames missing from a closed group
+};
+
+int iwab_fec_params_valid(unsigned k, unsigned m);
+
+void iwab_fec_encoder_init(struct iwab_fec_encoder *e, unsigned k, unsigned m);
+
+/* Account a data frame, returns its index in the group. When the index is
+ * k - 1 the group is complete and its parity frames are ready. */
+unsigned iwab_fec_encoder_add(struct iwab_fec_encoder *e, const uint8_t *data, size_t length, uint64_t timestamp);
+
+void iwab_fec_decoder_init(struct iwab_fec_decoder *d);
+
+/* Feed a received frame, data or parity, to the decoder. Returns 1 if the
+ * frame starts a new group while frames of the current one are still
+ * pending: they must be drained with iwab_fec_decoder_pop() and the frame
+ * put again. Returns -1 for invalid fec parameters. */
+int iwab_fec_decoder_put(struct iwab_fec_decoder *d, const struct iwab_head *h, const uint8_t *data, size_t length);
+
+/* Return the next data frame in sequence order, received or repaired, or
+ * NULL if it is missing and may still be repaired. The frame is valid until
+ * the next call to iwab_fec_decoder_put(). */
+const struct iwab_fec_frame *iwab_fec_decoder_pop(struct iwab_fec_decoder *d);
+
+/* Give up on the missing frames of the current group */
+void iwab_fec_decoder_flush(struct iwab_fec_decoder *d);
+
+/* Drop the current group without handing out its frames, the counters are
+ * kept */
+void iwab_fec_decoder_reset(struct iwab_fec_decoder *d);
+
+#endif
@@ -24,122 +24,982 @@
 
 #include <errno.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/core-error.h>
 #include <pulsecore/sink-input.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-util.h>
-#include <pulsecore/memblockq.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/llist.h>
 #include <pulsecore/modargs.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/poll.h>
+#include <pulsecore/ringq.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
 
+#include "codec-util.h"
+#include "fec.h"
 #include "net.h"
+#include "plc.h"
+#include "rx.h"
 
 PA_MODULE_AUTHOR("");
-PA_MODULE_DESCRIPTION("input sound from a wireless source");
+PA_MODULE_DESCRIPTION("input sound from wireless sources");
 PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(false);
 PA_MODULE_USAGE(
         "sink=<name of the sink> "
         "iface=<wireless interface> "
+        "rx_ring=<use a mmap'ed receive ring?> "
+        "filter=<drop non iwab frames in the kernel?> "
+        "rcvbuf=<socket receive buffer size in bytes> "
+        "latency_msec=<minimum jitter buffer latency in ms> "
+        "max_latency_msec=<maximum jitter buffer latency in ms> "
+        "plc=<loss concealment, fade or wsola> "
+        "plc_max_msec=<maximum concealment per gap in ms> "
 );
 
-#define DEFAULT_SOURCE_NAME "iwabsrc"
 #define DEFAULT_IFACE "mon0"
 #define MAX_FRAME_SIZE 1600
+#define N_CHANNEL_IDS 256 // values of iwab_head.channel
 
-#define MEMBLOCKQ_MAXLENGTH (1024*1024*40)
+#define MAX_SESSIONS 16
 #define DEATH_TIMEOUT 20
 #define RATE_UPDATE_INTERVAL (5*PA_USEC_PER_SEC)
+#define STATS_INTERVAL (5*PA_USEC_PER_SEC)
+#define DEFAULT_LATENCY_MSEC 20
+#define DEFAULT_MAX_LATENCY_MSEC 200
+#define DEFAULT_PLC_MAX_MSEC 60
+#define UNDERRUN_LATENCY_STEP (5*PA_USEC_PER_MSEC)
 
 static const char* const valid_modargs[] = {
     "sink",
     "iface",
+    "rx_ring",
+    "filter",
+    "rcvbuf",
+    "latency_msec",
+    "max_latency_msec",
+    "plc",
+    "plc_max_msec",
     NULL
 };
 
+enum {
+    SINK_INPUT_MESSAGE_POST = PA_SINK_INPUT_MESSAGE_MAX,
+    SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT,
+    SINK_INPUT_MESSAGE_SET_BUFFER_TARGET,
+};
+
+enum {
+    IWAB_INPUT_MESSAGE_FORMAT,
+    IWAB_INPUT_MESSAGE_UPDATE_STATS,
+    IWAB_INPUT_MESSAGE_ADD_SESSION,
+    IWAB_INPUT_MESSAGE_REMOVE_SESSION,
+    IWAB_INPUT_MESSAGE_LATENCY_SNAPSHOT,
+};
+
+typedef struct iwab_input_msg iwab_input_msg;
+
+struct iwab_input_msg {
+    pa_msgobject parent;
+    struct userdata *userdata;
+};
+
+PA_DEFINE_PRIVATE_CLASS(iwab_input_msg, pa_msgobject);
+#define IWAB_INPUT_MSG(o) (iwab_input_msg_cast(o))
+
+struct stream_format {
+    uint8_t channel;
+    pa_sample_spec ss;
+    pa_channel_map map;
+};
+
+struct rx_stats {
+    uint8_t channel;
+    struct iwab_rx_stats net;
+    unsigned ring_used;
+    uint64_t fec_recovered;
+    uint64_t fec_lost;
+    pa_usec_t concealed;
+    pa_usec_t lost;
+    const char *codec;
+};
+
+struct latency_snapshot {
+    /* filled in the sink thread */
+    pa_usec_t buffer; // audio in the jitter buffer
+    pa_usec_t sink_latency;
+    unsigned underruns;
+    /* filled in the rx thread */
+    pa_usec_t jitter;
+    pa_usec_t local; // local time of the snapshot
+    pa_usec_t remote; // sender clock estimate at that time
+    unsigned timeline; // bumped each time the sender restarts its stream
+};
+
+/* One stream received from a sender, played by its own sink input */
+struct session {
+    struct userdata *userdata;
+    PA_LLIST_FIELDS(struct session);
+
+    uint8_t channel; // iwab stream id
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_atomic_t timestamp; // second the last frame was accepted
+
+    pa_sink_input *sink_input;
+    pa_ringq *queue; // jitter buffer, copied into one ring
+    pa_asyncmsgq *asyncmsgq; // decoded audio, from the rx thread to the sink thread
+    pa_rtpoll_item *rtpoll_item;
+
+    /* Main thread: jitter buffer target and rate control */
+    pa_usec_t latency_floor; // raised when underruns happen
+    pa_usec_t buffer_target;
+    struct latency_snapshot snapshot;
+    struct latency_snapshot last_snapshot;
+    double drift; // sender clock rate relative to ours
+
+    /* Sink I/O thread */
+    unsigned underruns;
+    bool playing;
+
+    /* RX thread: reordering, repair, decoding and arrival statistics */
+    struct iwab_fec_decoder *fec;
+    struct iwab_plc plc;
+    bool plc_enabled; // the concealment works on native endian s16 only
+    const iwab_codec *codec; // decoder of the received frames
+    void *codec_info;
+    struct iwab_rx rx; // sequencing and arrival timing
+};
+
 struct userdata {
     pa_core *core;
     pa_module *module;
-    pa_sink_input *sink_input;
+    char *sink_name;
     const char *iface;
-    pa_memblockq *queue;
-    bool first_packet;
-    pa_rtpoll_item *rtpoll_item;
-    uint32_t seqnb;
-    pa_usec_t last_pb_ts;
     struct iwab istream;
-    int retries;
-    pa_sample_spec ss;
-	pa_usec_t lost_pb;
+
+    /* One thread receives every stream of the interface */
+    pa_thread *thread;
+    pa_thread_mq thread_mq;
+    pa_rtpoll *rtpoll;
+    pa_rtpoll_item *rtpoll_item;
+    iwab_input_msg *msg;
+
+    PA_LLIST_HEAD(struct session, sessions);
+    pa_hashmap *by_channel;
+    int n_sessions;
+
+    pa_time_event *time_event;
+    pa_time_event *check_death_event;
+
+    /* Settings of new sessions */
+    pa_usec_t min_latency;
+    pa_usec_t max_latency;
+    enum iwab_plc_mode plc_mode;
+    uint32_t plc_max_msec;
+
+    struct {
+        struct session *sessions[N_CHANNEL_IDS];
+        pa_usec_t stats_abs; // time for the next stats update
+    } thread_info;
 };
 
-/* Called from I/O thread context */
+static void session_free(struct session *s);
+
+/* Called from sink I/O thread context */
 static int sink_input_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
-    struct userdata *u = PA_SINK_INPUT(o)->userdata;
+    struct session *s = PA_SINK_INPUT(o)->userdata;
+    struct userdata *u = s->userdata;
 
     switch (code) {
         case PA_SINK_INPUT_MESSAGE_GET_LATENCY:
-            *((pa_usec_t*) data) = pa_bytes_to_usec(pa_memblockq_get_length(u->queue),
-                    &u->sink_input->sample_spec);
+            *((pa_usec_t*) data) = pa_bytes_to_usec(pa_ringq_get_length(s->queue),
+                    &s->sink_input->sample_spec);
 
             /* Fall through, the default handler will add in the extra
              * latency added by the resampler */
             break;
+
+        case SINK_INPUT_MESSAGE_POST:
+            if (pa_ringq_push(s->queue, chunk) < 0) {
+                pa_log("Buffer overrun, new packet received but audio queue is full (%zu bytes)",
+                        pa_ringq_get_length(s->queue));
+            }
+
+            if (pa_ringq_get_length(s->queue) > pa_usec_to_bytes(u->max_latency, &s->ss)) {
+                size_t excess = pa_ringq_get_length(s->queue) - pa_ringq_get_tlength(s->queue);
+
+                pa_log_debug("Jitter buffer above %0.2f ms, dropping %0.2f ms",
+                        (double) u->max_latency / PA_USEC_PER_MSEC,
+                        (double) pa_bytes_to_usec(excess, &s->ss) / PA_USEC_PER_MSEC);
+                pa_ringq_drop(s->queue, excess);
+            }
+
+            return 0;
+
+        case SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT: {
+            struct latency_snapshot *snapshot = &s->snapshot;
+
+            snapshot->buffer = pa_bytes_to_usec(pa_ringq_get_length(s->queue), &s->ss);
+            snapshot->sink_latency = pa_sink_get_latency_within_thread(s->sink_input->sink, false);
+            snapshot->underruns = s->underruns;
+            return 0;
+        }
+
+        case SINK_INPUT_MESSAGE_SET_BUFFER_TARGET: {
+            size_t target = pa_usec_to_bytes((pa_usec_t) offset, &s->ss);
+
+            pa_ringq_set_tlength(s->queue, target);
+            pa_ringq_set_prebuf(s->queue, target);
+            return 0;
+        }
     }
 
     return pa_sink_input_process_msg(o, code, data, offset, chunk);
 }
 
-/* Called from I/O thread context */
+/* Called from sink I/O thread context */
 static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
-    struct userdata* u;
+    struct session *s;
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(s = i->userdata);
+
+    pa_ringq_rewind(s->queue, nbytes);
+}
+
+/* Called from sink I/O thread context */
+static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    struct session *s;
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(s = i->userdata);
 
-    pa_memblockq_rewind(u->queue, nbytes);
+    /* The sink input keeps the chunks we pass it for rewinding, the
+     * ring must not reuse their memory before that */
+    pa_ringq_set_maxrewind(s->queue, nbytes);
 }
 
 // according to sink-input.h it is better to ignore the `length` argument if we already
 // have the data
 static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk) {
-    struct userdata* u;
+    struct session *s;
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(s = i->userdata);
+
+    /* Take what the rx thread decoded so far */
+    while (pa_asyncmsgq_process_one(s->asyncmsgq) > 0)
+        ;
+
+    if (pa_ringq_peek(s->queue, chunk) < 0) {
+        if (s->playing) {
+            pa_log("Warning, buffer underrun on stream %u : %zd bytes requested but queue empty",
+                    s->channel, length);
+            s->underruns++;
+            s->playing = false;
+        }
 
-    if (pa_memblockq_peek(u->queue, chunk) < 0) {
-        pa_log("Warning, buffer underrun : %zd bytes requested but queue empty",
-                length);
         return -1;
     }
 
-    pa_memblockq_drop(u->queue, chunk->length);
+    /* The chunk points into the ring, which only keeps maxrewind bytes
+     * behind the read index unchanged: hand out no more than asked for */
+    chunk->length = PA_MIN(chunk->length, length);
+
+    s->playing = true;
+    pa_ringq_drop(s->queue, chunk->length);
     return 0;
 }
 
+/* Called from main context */
 static void sink_input_kill_cb(pa_sink_input *i) {
-    struct userdata *u;
+    struct session *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(s = i->userdata);
+
+    pa_hashmap_remove_and_free(s->userdata->by_channel, PA_UINT32_TO_PTR(s->channel));
+}
+
+/* Called from sink I/O thread context */
+static void sink_input_attach(pa_sink_input *i) {
+    struct session *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(s = i->userdata);
+    pa_assert(!s->rtpoll_item);
+
+    s->rtpoll_item = pa_rtpoll_item_new_asyncmsgq_read(i->sink->thread_info.rtpoll, PA_RTPOLL_LATE, s->asyncmsgq);
+}
+
+/* Called from sink I/O thread context */
+static void sink_input_detach(pa_sink_input *i) {
+    struct session *s;
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(s = i->userdata);
+    pa_assert(s->rtpoll_item);
+
+    pa_rtpoll_item_free(s->rtpoll_item);
+    s->rtpoll_item = NULL;
+}
+
+/* Called from sink I/O thread context. The queued chunks hold references to
+ * the sink input, see module-loopback. The rx thread doesn't post anymore by
+ * then, session_free() removed the session from it first. */
+static void sink_input_state_change_cb(pa_sink_input *i, pa_sink_input_state_t state) {
+    struct session *s;
 
     pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
+    pa_assert_se(s = i->userdata);
+
+    if (state == PA_SINK_INPUT_UNLINKED)
+        pa_asyncmsgq_flush(s->asyncmsgq, false);
+}
+
+/* rate controller, called from main context. Same as module-loopback's:
+ * correct the latency offset over several cycles, never deviating more than
+ * 1% from base_rate. */
+static uint32_t rate_controller(
+                uint32_t base_rate,
+                pa_usec_t adjust_time,
+                int32_t latency_difference_usec) {
+
+    double min_cycles;
+
+    min_cycles = (double)abs(latency_difference_usec) / adjust_time / 0.01 + 1;
+    return base_rate * (1.0 + (double)latency_difference_usec / min_cycles / adjust_time);
+}
+
+/* Called from main context. Update the drift estimate from the sender clock
+ * progress since the previous snapshot. */
+static void update_drift(struct session *s) {
+    struct latency_snapshot *cur = &s->snapshot, *last = &s->last_snapshot;
+    double ratio;
+
+    if (cur->timeline != last->timeline || cur->remote <= last->remote
+            || cur->local < last->local + RATE_UPDATE_INTERVAL / 2)
+        return;
+
+    ratio = (double) (cur->remote - last->remote) / (double) (cur->local - last->local);
+    if (ratio < 0.99 || ratio > 1.01) {
+        pa_log_debug("Ignoring implausible clock ratio %f", ratio);
+        return;
+    }
+
+    s->drift += 0.2 * (ratio - s->drift);
+}
+
+/* Called from main context */
+static void adjust_rates(struct session *s) {
+    struct userdata *u = s->userdata;
+    struct latency_snapshot *cur = &s->snapshot;
+    pa_usec_t target;
+    uint32_t base_rate, new_rate;
+    int32_t latency_difference;
+    pa_proplist *pl;
+
+    pa_assert_ctl_context();
+
+    update_drift(s);
+
+    /* Each underrun raises the floor of the jitter buffer */
+    if (cur->underruns != s->last_snapshot.underruns && s->latency_floor < u->max_latency) {
+        s->latency_floor = PA_MIN(s->latency_floor + UNDERRUN_LATENCY_STEP, u->max_latency);
+        pa_log_warn("Underruns on stream %u, raising the jitter buffer latency to at least %0.2f ms",
+                s->channel, (double) s->latency_floor / PA_USEC_PER_MSEC);
+    }
+
+    target = PA_CLAMP(s->latency_floor + 4 * cur->jitter, u->min_latency, u->max_latency);
+    if (target > s->buffer_target + PA_USEC_PER_MSEC || target + PA_USEC_PER_MSEC < s->buffer_target) {
+        s->buffer_target = target;
+        pa_asyncmsgq_post(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input),
+                SINK_INPUT_MESSAGE_SET_BUFFER_TARGET, NULL, (int64_t) target, NULL, NULL);
+    }
+
+    /* Run at the sender rate, corrected to bring the jitter buffer back to
+     * its target */
+    base_rate = (uint32_t) (s->ss.rate * s->drift + 0.5);
+    latency_difference = (int32_t) ((int64_t) cur->buffer - (int64_t) s->buffer_target);
+    new_rate = rate_controller(base_rate, RATE_UPDATE_INTERVAL, latency_difference);
+
+    pa_log_debug("Stream %u: jitter buffer %0.2f ms, target %0.2f ms, jitter %0.2f ms, drift %+0.1f ppm",
+            s->channel,
+            (double) cur->buffer / PA_USEC_PER_MSEC,
+            (double) s->buffer_target / PA_USEC_PER_MSEC,
+            (double) cur->jitter / PA_USEC_PER_MSEC,
+            (s->drift - 1.0) * 1e6);
+
+    pa_sink_input_set_rate(s->sink_input, new_rate);
+
+    pl = pa_proplist_new();
+    pa_proplist_setf(pl, "iwab.latency.target", "%0.2f ms",
+            (double) (s->buffer_target + cur->sink_latency) / PA_USEC_PER_MSEC);
+    pa_proplist_setf(pl, "iwab.latency.observed", "%0.2f ms",
+            (double) (cur->buffer + cur->sink_latency) / PA_USEC_PER_MSEC);
+    pa_proplist_setf(pl, "iwab.drift", "%+0.1f ppm", (s->drift - 1.0) * 1e6);
+    pa_sink_input_update_proplist(s->sink_input, PA_UPDATE_REPLACE, pl);
+    pa_proplist_free(pl);
+
+    s->last_snapshot = *cur;
+}
+
+/* Called from main context */
+static void time_callback(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
+    struct userdata *u = userdata;
+    struct session *s;
+
+    pa_assert(u);
+    pa_assert(u->time_event == e);
+
+    pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + RATE_UPDATE_INTERVAL);
+
+    PA_LLIST_FOREACH(s, u->sessions) {
+        if (!s->sink_input->sink || !PA_SINK_IS_OPENED(s->sink_input->sink->state))
+            continue;
+
+        pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input),
+                SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT, NULL, 0, NULL);
+        pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->msg),
+                IWAB_INPUT_MESSAGE_LATENCY_SNAPSHOT, s, 0, NULL);
+
+        adjust_rates(s);
+    }
+}
+
+/* Called from main context */
+static void check_death_event_cb(pa_mainloop_api *m, pa_time_event *t, const struct timeval *tv, void *userdata) {
+    struct session *s, *n;
+    struct userdata *u = userdata;
+    int now;
+
+    pa_assert(m);
+    pa_assert(t);
+    pa_assert(u);
+
+    now = (int) (pa_rtclock_now() / PA_USEC_PER_SEC);
+
+    for (s = u->sessions; s; s = n) {
+        n = s->next;
+
+        if (pa_atomic_load(&s->timestamp) + DEATH_TIMEOUT < now) {
+            pa_log_info("Stream %u timed out", s->channel);
+            pa_hashmap_remove_and_free(u->by_channel, PA_UINT32_TO_PTR(s->channel));
+        }
+    }
+
+    /* Restart timer */
+    pa_core_rttime_restart(u->core, t, pa_rtclock_now() + DEATH_TIMEOUT * PA_USEC_PER_SEC);
+}
+
+/* Called from main context */
+static struct session *session_new(struct userdata *u, const struct stream_format *f) {
+    struct session *s;
+    pa_sink *sink;
+    pa_sink_input_new_data data;
+    pa_memchunk silence;
+
+    pa_assert(u);
+    pa_assert(f);
+
+    if (u->n_sessions >= MAX_SESSIONS) {
+        pa_log("Session limit reached, ignoring stream %u.", f->channel);
+        return NULL;
+    }
+
+    if (!(sink = pa_namereg_get(u->core, u->sink_name, PA_NAMEREG_SINK))) {
+        pa_log("Sink does not exist.");
+        return NULL;
+    }
+
+    s = pa_xnew0(struct session, 1);
+    s->userdata = u;
+    s->channel = f->channel;
+    s->ss = f->ss;
+    s->map = f->map;
+    pa_atomic_store(&s->timestamp, (int) (pa_rtclock_now() / PA_USEC_PER_SEC));
+    s->latency_floor = u->min_latency;
+    s->buffer_target = u->min_latency;
+    s->drift = 1.0;
+
+    if (s->ss.format == PA_SAMPLE_S16NE) {
+        if (iwab_plc_init(&s->plc, u->plc_mode, s->ss.rate, s->ss.channels, u->plc_max_msec) < 0) {
+            pa_log("Failed to setup the loss concealment : %s", pa_cstrerror(errno));
+            goto fail;
+        }
+
+        s->plc_enabled = true;
+    } else
+        pa_log_warn("Loss concealment is not supported for %s, gaps are left empty",
+                pa_sample_format_to_string(s->ss.format));
+
+    pa_sink_input_new_data_init(&data);
+    pa_sink_input_new_data_set_sink(&data, sink, false, true);
+    data.driver = __FILE__;
+    pa_proplist_sets(data.proplist, PA_PROP_MEDIA_ROLE, "stream");
+    pa_proplist_setf(data.proplist, PA_PROP_MEDIA_NAME, "wiscast stream %u from %s",
+            s->channel, u->iface);
+    pa_proplist_setf(data.proplist, "iwab.stream_id", "%u", s->channel);
+    pa_proplist_setf(data.proplist, "iwab.lost", "%lums lost", 0UL);
+    pa_proplist_sets(data.proplist, "iwab.concealed", "0ms concealed");
+    data.module = u->module;
+    data.flags = PA_SINK_INPUT_VARIABLE_RATE;
+    pa_sink_input_new_data_set_sample_spec(&data, &s->ss);
+    pa_sink_input_new_data_set_channel_map(&data, &s->map);
+    pa_sink_input_new(&s->sink_input, u->core, &data);
+    pa_sink_input_new_data_done(&data);
+
+    if (!s->sink_input) {
+        pa_log("Failed to create sink input.");
+        goto fail;
+    }
+
+    s->sink_input->userdata = s;
+    s->sink_input->parent.process_msg = sink_input_process_msg;
+    s->sink_input->pop = sink_input_pop_cb;
+    s->sink_input->attach = sink_input_attach;
+    s->sink_input->detach = sink_input_detach;
+    s->sink_input->kill = sink_input_kill_cb;
+    s->sink_input->state_change = sink_input_state_change_cb;
+    s->sink_input->process_rewind = sink_input_process_rewind_cb;
+    s->sink_input->update_max_rewind = sink_input_update_max_rewind_cb;
+
+    // setup audio buffer
+    pa_sink_input_get_silence(s->sink_input, &silence);
+    s->queue = pa_ringq_new(
+            "module-iwab-input ringq",
+            u->core->mempool,
+            0,
+            2 * pa_usec_to_bytes(u->max_latency, &s->ss), // trimmed back to the target above max_latency
+            pa_usec_to_bytes(s->buffer_target, &s->ss),
+            &s->ss,
+            pa_usec_to_bytes(s->buffer_target, &s->ss),
+            0,
+            0,
+            &silence);
+    pa_memblock_unref(silence.memblock);
+
+    s->asyncmsgq = pa_asyncmsgq_new(0);
+    iwab_rx_init(&s->rx, pa_rtclock_now());
+
+    pa_hashmap_put(u->by_channel, PA_UINT32_TO_PTR(s->channel), s);
+    u->n_sessions++;
+    PA_LLIST_PREPEND(struct session, u->sessions, s);
+
+    pa_sink_input_put(s->sink_input);
+
+    /* The rx thread can hand the stream frames out from now on */
+    pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->msg), IWAB_INPUT_MESSAGE_ADD_SESSION, s, 0, NULL);
+
+    pa_log_info("New stream %u: %s %uch %uHz", s->channel,
+            pa_sample_format_to_string(s->ss.format), s->ss.channels, s->ss.rate);
+
+    return s;
+
+fail:
+    if (s->sink_input)
+        pa_sink_input_unref(s->sink_input);
+
+    iwab_plc_done(&s->plc);
+    pa_xfree(s);
+
+    return NULL;
+}
+
+/* Called from main context */
+static void session_free(struct session *s) {
+    struct userdata *u;
+
+    pa_assert(s);
+    pa_assert_se(u = s->userdata);
+
+    pa_log_info("Freeing stream %u", s->channel);
+
+    /* Nothing is posted to the session once this returns */
+    pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->msg), IWAB_INPUT_MESSAGE_REMOVE_SESSION, s, 0, NULL);
+
+    pa_sink_input_unlink(s->sink_input);
+    pa_sink_input_unref(s->sink_input);
+
+    PA_LLIST_REMOVE(struct session, u->sessions, s);
+    pa_assert(u->n_sessions >= 1);
+    u->n_sessions--;
+
+    pa_ringq_free(s->queue);
+    pa_asyncmsgq_unref(s->asyncmsgq);
+    iwab_rx_done(&s->rx);
+    pa_xfree(s->fec);
+    iwab_plc_done(&s->plc);
+
+    if (s->codec)
+        s->codec->deinit(s->codec_info);
+
+    pa_xfree(s);
+}
+
+/* Called from main context. A sender advertised the format of its stream,
+ * start playing it or restart it if the format changed. */
+static void format_changed(struct userdata *u, const struct stream_format *f) {
+    struct session *s;
+
+    if ((s = pa_hashmap_get(u->by_channel, PA_UINT32_TO_PTR(f->channel)))) {
+        if (pa_sample_spec_equal(&s->ss, &f->ss) && pa_channel_map_equal(&s->map, &f->map))
+            return;
+
+        pa_log_info("Stream %u changed its format", f->channel);
+        pa_hashmap_remove_and_free(u->by_channel, PA_UINT32_TO_PTR(f->channel));
+    }
+
+    session_new(u, f);
+}
+
+/* Called from main context */
+static void update_stats(struct userdata *u, const struct rx_stats *st) {
+    struct session *s;
+    pa_proplist *pl;
+
+    if (!(s = pa_hashmap_get(u->by_channel, PA_UINT32_TO_PTR(st->channel))))
+        return;
+
+    pl = pa_proplist_new();
+    pa_proplist_setf(pl, "iwab.rx.drops", "%llu", (unsigned long long) st->net.drops);
+    pa_proplist_setf(pl, "iwab.rx.filtered", "%llu", (unsigned long long) st->net.filtered);
+    pa_proplist_setf(pl, "iwab.rx.ring", "%u/%u blocks", st->ring_used, IWAB_RX_RING_BLOCKS);
+    pa_proplist_setf(pl, "iwab.fec", "%llu recovered, %llu lost",
+            (unsigned long long) st->fec_recovered, (unsigned long long) st->fec_lost);
+    pa_proplist_setf(pl, "iwab.lost", "%llums lost",
+            (unsigned long long) (st->lost / PA_USEC_PER_MSEC));
+    pa_proplist_setf(pl, "iwab.concealed", "%llums concealed",
+            (unsigned long long) (st->concealed / PA_USEC_PER_MSEC));
+    if (st->codec)
+        pa_proplist_sets(pl, "iwab.codec", st->codec);
+    pa_sink_input_update_proplist(s->sink_input, PA_UPDATE_REPLACE, pl);
+    pa_proplist_free(pl);
+}
+
+static int iwab_input_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    struct userdata *u;
+    struct session *s;
+
+    pa_assert(o);
+    pa_assert_se(u = IWAB_INPUT_MSG(o)->userdata);
+
+    switch (code) {
+        case IWAB_INPUT_MESSAGE_FORMAT: // Called from main context
+            format_changed(u, data);
+            return 0;
+
+        case IWAB_INPUT_MESSAGE_UPDATE_STATS: // Called from main context
+            update_stats(u, data);
+            return 0;
+
+        case IWAB_INPUT_MESSAGE_ADD_SESSION: // Called from rx thread context
+            s = data;
+            u->thread_info.sessions[s->channel] = s;
+            return 0;
+
+        case IWAB_INPUT_MESSAGE_REMOVE_SESSION: // Called from rx thread context
+            s = data;
+            if (u->thread_info.sessions[s->channel] == s)
+                u->thread_info.sessions[s->channel] = NULL;
+            return 0;
+
+        case IWAB_INPUT_MESSAGE_LATENCY_SNAPSHOT: { // Called from rx thread context
+            struct latency_snapshot *snapshot;
+
+            s = data;
+            snapshot = &s->snapshot;
+            snapshot->jitter = s->rx.jitter;
+            snapshot->local = pa_rtclock_now();
+            snapshot->remote = iwab_rx_get_remote(&s->rx, snapshot->local);
+            snapshot->timeline = s->rx.timeline;
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+/* Called from rx thread context. Hand audio over to the sink thread. */
+static void post_chunk(struct session *s, pa_memchunk *chunk) {
+    pa_asyncmsgq_post(s->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_POST, NULL, 0, chunk, NULL);
+}
+
+/* Called from rx thread context. Fill a gap in the stream with concealed
+ * audio, up to the concealment cap. Past it nothing is pushed and the jitter
+ * buffer underruns, which is the right thing for long outages. */
+static void conceal(struct session *s, pa_usec_t missing) {
+    size_t fs = pa_frame_size(&s->ss), frames = pa_usec_to_bytes(missing, &s->ss) / fs;
+    pa_memchunk filler;
+    void *p;
+
+    if (!s->plc_enabled)
+        return;
+
+    frames = PA_MIN(frames, s->plc.max_conceal);
+    if (frames == 0)
+        return;
+
+    filler.memblock = pa_memblock_new(s->userdata->core->mempool, frames * fs);
+    filler.index = 0;
+    p = pa_memblock_acquire(filler.memblock);
+    filler.length = iwab_plc_conceal(&s->plc, p, frames) * fs;
+    pa_memblock_release(filler.memblock);
+
+    if (filler.length > 0)
+        post_chunk(s, &filler);
+
+    pa_memblock_unref(filler.memblock);
+}
+
+/* Called from rx thread context. Let the concealment see the received
+ * audio, it crossfades the start of the chunk into a preceding concealment. */
+static void plc_feed(struct session *s, pa_memchunk *chunk) {
+    uint8_t *p;
+
+    if (!s->plc_enabled)
+        return;
+
+    p = pa_memblock_acquire(chunk->memblock);
+    iwab_plc_feed(&s->plc, (int16_t*) (p + chunk->index), chunk->length / pa_frame_size(&s->ss));
+    pa_memblock_release(chunk->memblock);
+}
+
+/* Called from rx thread context */
+static void push_frame(struct session *s, uint32_t seq, uint64_t timestamp, pa_memchunk *newchunk) {
+    pa_usec_t missing;
+
+    pa_assert(pa_frame_aligned(newchunk->length, &s->ss));
+
+    if ((missing = iwab_rx_push(&s->rx, seq, timestamp, pa_bytes_to_usec(newchunk->length, &s->ss))) > 0)
+        conceal(s, missing);
+
+    plc_feed(s, newchunk);
+    post_chunk(s, newchunk);
+    iwab_rx_update_timing(&s->rx, timestamp, pa_rtclock_now());
+
+    /* Only frames that are played keep the session alive */
+    pa_atomic_store(&s->timestamp, (int) (pa_rtclock_now() / PA_USEC_PER_SEC));
+}
+
+/* Called from rx thread context. Decode a payload into a new memblock and
+ * push it. */
+static void push_payload(struct session *s, uint32_t seq, uint64_t timestamp, const void *payload, size_t length) {
+    pa_memchunk newchunk;
+    size_t size, processed;
+    void *p;
+
+    if ((size = iwab_codec_get_decoded_size(s->codec, s->codec_info, &s->ss, length)) == 0) {
+        pa_log_debug("Dropping %zu bytes frame, shorter than an audio frame", length);
+        return;
+    }
+
+    newchunk.memblock = pa_memblock_new(s->userdata->core->mempool, size);
+    newchunk.index = 0;
+    p = pa_memblock_acquire(newchunk.memblock);
+    newchunk.length = s->codec->decode_buffer(s->codec_info, payload, length,
+            p, pa_memblock_get_length(newchunk.memblock), &processed);
+    pa_memblock_release(newchunk.memblock);
+
+    if (newchunk.length == 0 || !pa_frame_aligned(newchunk.length, &s->ss)) {
+        pa_log_debug("Dropping undecodable %zu bytes frame", length);
+        pa_memblock_unref(newchunk.memblock);
+        return;
+    }
+
+    push_frame(s, seq, timestamp, &newchunk);
+    pa_memblock_unref(newchunk.memblock);
+}
+
+/* Called from rx thread context. Pick the decoder for frames tagged with
+ * the given codec id, returns false if there is none. */
+static bool select_codec(struct session *s, uint8_t id) {
+    const iwab_codec *codec;
+    void *codec_info;
+
+    if (s->codec && s->codec->id == id)
+        return true;
+
+    if (!(codec = iwab_get_codec_by_id(id)) || !(codec_info = codec->init(false, &s->ss))) {
+        pa_log_debug("Dropping frame encoded with unsupported codec %u", id);
+        return false;
+    }
+
+    if (s->codec)
+        s->codec->deinit(s->codec_info);
+
+    pa_log_info("Receiving %s frames on stream %u", codec->description, s->channel);
+    s->codec = codec;
+    s->codec_info = codec_info;
+    return true;
+}
+
+/* Called from rx thread context */
+static void fec_drain(struct session *s) {
+    const struct iwab_fec_frame *f;
+
+    while ((f = iwab_fec_decoder_pop(s->fec))) {
+        if (iwab_rx_frame_is_new(&s->rx, f->seq, f->timestamp))
+            push_payload(s, f->seq, f->timestamp, f->data, f->length);
+    }
+}
+
+/* Called from rx thread context. Feed a frame to the fec decoder and push
+ * the frames it can hand out in order. */
+static void fec_receive(struct session *s, const struct iwab_head *h, const void *payload, size_t length) {
+    if (!s->fec) {
+        s->fec = pa_xnew(struct iwab_fec_decoder, 1);
+        iwab_fec_decoder_init(s->fec);
+    }
+
+    while (iwab_fec_decoder_put(s->fec, h, payload, length) > 0)
+        fec_drain(s);
+
+    fec_drain(s);
+}
+
+/* Called from rx thread context. The sender restarted its stream, frames of
+ * the previous one waiting for repair won't be needed anymore. */
+static void restart(struct session *s) {
+    if (s->fec)
+        iwab_fec_decoder_reset(s->fec);
+}
+
+/* Called from rx thread context. Ask the main thread for a session when the
+ * advertised format is new for this stream id. */
+static void format_received(struct userdata *u, uint8_t channel, const void *payload, size_t length) {
+    struct iwab_format wire;
+    struct stream_format *f;
+    struct session *s;
+    unsigned c;
+
+    if (length < sizeof(wire))
+        return;
+
+    memcpy(&wire, payload, sizeof(wire));
+    f = pa_xnew0(struct stream_format, 1);
+    f->channel = channel;
+    f->ss.format = wire.format;
+    f->ss.rate = wire.rate;
+    f->ss.channels = wire.channels;
+    f->map.channels = wire.channels;
+
+    if (pa_sample_spec_valid(&f->ss))
+        for (c = 0; c < f->map.channels; c++)
+            f->map.map[c] = wire.map[c];
+
+    if (!pa_sample_spec_valid(&f->ss) || !pa_channel_map_valid(&f->map)) {
+        pa_log_debug("Ignoring invalid format of stream %u", channel);
+        pa_xfree(f);
+        return;
+    }
+
+    if ((s = u->thread_info.sessions[channel])
+            && pa_sample_spec_equal(&s->ss, &f->ss) && pa_channel_map_equal(&s->map, &f->map)) {
+        pa_xfree(f);
+        return;
+    }
+
+    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->msg), IWAB_INPUT_MESSAGE_FORMAT, f, 0, NULL, pa_xfree);
+}
+
+/* Called from rx thread context. Dispatch a frame read from the istream to
+ * its session. chunk holds the payload when it was read in a memblock, raw
+ * PCM is then pushed without a copy. */
+static bool receive(struct userdata *u, const uint8_t *payload, size_t length, pa_memchunk *chunk) {
+    const struct iwab_head *h = u->istream.iw_in;
+    struct session *s;
+
+    if (h->type == IWAB_FRAME_FORMAT) {
+        format_received(u, h->channel, payload, length);
+        return true;
+    }
+
+    // frames of streams whose format is not known yet are dropped
+    if (h->type != IWAB_FRAME_AUDIO || !(s = u->thread_info.sessions[h->channel]))
+        return false;
+
+    if (!select_codec(s, h->codec))
+        return false;
+
+    // parity frames carry no timestamp of their own
+    if ((!h->fec_k || h->fec_index < h->fec_k) && iwab_rx_check_restart(&s->rx, h->seq, h->timestamp))
+        restart(s);
+
+    if (h->fec_k)
+        fec_receive(s, h, payload, length);
+    else if (!iwab_rx_frame_is_new(&s->rx, h->seq, h->timestamp))
+        return false;
+    else if (chunk && s->codec->id == IWAB_CODEC_PCM && pa_frame_aligned(chunk->length, &s->ss))
+        push_frame(s, h->seq, h->timestamp, chunk);
+    else
+        push_payload(s, h->seq, h->timestamp, payload, length);
+
+    return true;
+}
+
+/* Called from rx thread context */
+static void post_stats(struct userdata *u) {
+    pa_usec_t now = pa_rtclock_now();
+    unsigned ring_used, c;
+
+    if (now < u->thread_info.stats_abs)
+        return;
+
+    u->thread_info.stats_abs = now + STATS_INTERVAL;
+    iwab_rx_update_stats(&u->istream);
+    ring_used = iwab_rx_ring_occupancy(&u->istream);
+
+    for (c = 0; c < N_CHANNEL_IDS; c++) {
+        struct session *s = u->thread_info.sessions[c];
+        struct rx_stats *st;
+
+        if (!s)
+            continue;
+
+        st = pa_xnew(struct rx_stats, 1);
+        st->channel = s->channel;
+        st->net = u->istream.rx_stats;
+        st->ring_used = ring_used;
+        st->fec_recovered = s->fec ? s->fec->recovered : 0;
+        st->fec_lost = s->fec ? s->fec->lost : 0;
+        st->concealed = s->plc.total * PA_USEC_PER_SEC / s->ss.rate;
+        st->lost = s->rx.lost;
+        st->codec = s->codec ? s->codec->name : NULL;
+        pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->msg), IWAB_INPUT_MESSAGE_UPDATE_STATS, st, 0, NULL, pa_xfree);
+    }
+}
+
+/* Called from rx thread context. Drain every frame pending in the rx ring,
+ * only accepted payloads are copied out of the ring. */
+static int read_ring(struct userdata *u) {
+    const char *payload;
+    ssize_t l;
+    int n = 0;
 
-    pa_sink_input_unlink(u->sink_input);
-    pa_sink_input_unref(u->sink_input);
-    u->sink_input = NULL;
+    while ((l = iwab_ring_read(&u->istream, &payload)) >= 0) {
+        if (receive(u, (const uint8_t*) payload, l, NULL))
+            n++;
+    }
 
-    pa_module_unload_request(u->module, true);
+    post_stats(u);
+    return n > 0 ? 1 : 0;
 }
 
 static int rtpoll_work_cb(pa_rtpoll_item *i) {
     struct userdata *u;
     struct pollfd *pollfd;
     ssize_t l;
-    void *p;
+    uint8_t *p;
     pa_memchunk newchunk;
+    bool received;
 
     pa_assert_se(u = pa_rtpoll_item_get_work_userdata(i));
-    pa_memchunk_reset(&newchunk);
 
     pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
 
@@ -154,8 +1014,8 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
     pollfd->revents = 0;
 
-    if (!PA_SINK_IS_OPENED(u->sink_input->sink->thread_info.state)) {
-        return 0;
+    if (u->istream.rx_ring) {
+        return read_ring(u);
     }
 
     newchunk.memblock = pa_memblock_new(u->core->mempool, MAX_FRAME_SIZE);
@@ -166,136 +1026,73 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
         pa_memblock_release(newchunk.memblock);
 
         if (l < 0) {
-            /*
-            if (l == -4) {
-                pa_log("invalid dot11, type %u, subtype %u, rt offset : %zu",
-                        u->istream.dot11_in->type,
-                        u->istream.dot11_in->subtype,
-                        newchunk.index);
-            }
-            */
-
             if (errno == EINTR) {
                 // retry;
                 continue;
             }
 
-            if (errno == EAGAIN) {
-                // no data yet available, or invalid packet
-                goto ignore;
+            if (errno != EAGAIN) {
+                // EAGAIN: no data yet available, or invalid packet
+                pa_log("Failed to read wireless data : %s", pa_cstrerror(errno));
             }
 
-            pa_log("Failed to read wireless data : %s", pa_cstrerror(errno));
-            goto ignore; // TODO: can/should we signal an error ?
+            pa_memblock_unref(newchunk.memblock);
+            return 0; // TODO: can/should we signal an error ?
         }
 
         newchunk.length = l;
         break;
     }
 
-    if (u->istream.iw_in->seq == u->seqnb) {
-        // this is a repeat packet
-        goto ignore;
-    }
-
-	pa_assert(pa_frame_aligned(newchunk.length, &u->ss));
-	if (u->seqnb != 0 && u->istream.iw_in->seq < u->seqnb) {
-		pa_log("Packet disordered. Previous seq : %u, last seq : %u, rewind : %u",
-			u->seqnb, u->istream.iw_in->seq, u->seqnb - u->istream.iw_in->seq);
-		goto ignore;
-	}
-
-	if (u->last_pb_ts != 0 && u->istream.iw_in->timestamp < u->last_pb_ts) {
-		pa_log("Timestamps disordered. Previous ts : %lu, last ts : %lu, rewind : %lu",
-			u->last_pb_ts, u->istream.iw_in->timestamp,
-			u->last_pb_ts - u->istream.iw_in->timestamp);
-        goto ignore;
-	}
-
-    if (u->seqnb != 0 && u->istream.iw_in->seq != (u->seqnb + 1)) {
-		u->lost_pb += u->istream.iw_in->timestamp - u->last_pb_ts;
-		pa_proplist_setf(u->sink_input->proplist, "iwab.lost", "%lums lost", u->lost_pb / 1000);
-		pa_assert(u->istream.iw_in->timestamp > u->last_pb_ts);
-		pa_usec_t missing = pa_usec_to_bytes(u->istream.iw_in->timestamp - u->last_pb_ts, &u->ss);
-		pa_memchunk filler = newchunk;
-		while (missing > 0) {
-			if (newchunk.length > missing) {
-				filler.length = missing;
-			} else {
-				filler.length = newchunk.length;
-			}
-
-			/*
-			pa_log("Packet lost or disordered. Previous seq : %u, last seq : %u. \
-					Missing %luus of playback, duplicating this chunk of length %luus",
-                u->seqnb, u->istream.iw_in->seq,
-				pa_bytes_to_usec(missing, &u->ss),
-                pa_bytes_to_usec(filler.length, &u->ss));
-			*/
-			pa_memblockq_push(u->queue, &filler);
-			missing -= filler.length;
-		}
-    }
-
-    if (pa_memblockq_push(u->queue, &newchunk) < 0) {
-        pa_log("Buffer overrun, new packet received but audio queue is full (%u packets)",
-                pa_memblockq_get_nblocks(u->queue));
-        //pa_memblockq_seek(u->queue, (int64_t) newchunk.length, PA_SEEK_RELATIVE, true); // TODO: why ?
-    } else {
-        //pa_log("new packet received queue size : %u packets", pa_memblockq_get_nblocks(u->queue));
-    }
-
-    u->seqnb = u->istream.iw_in->seq;
-    u->last_pb_ts = u->istream.iw_in->timestamp + pa_bytes_to_usec(newchunk.length, &u->ss);
+    p = pa_memblock_acquire(newchunk.memblock);
+    received = receive(u, p + newchunk.index, newchunk.length, &newchunk);
+    pa_memblock_release(newchunk.memblock);
     pa_memblock_unref(newchunk.memblock);
 
-    return 1;
-
-ignore:
-    if (newchunk.memblock) {
-        pa_memblock_unref(newchunk.memblock);
-    }
+    if (!received)
+        return 0;
 
-    return 0;
+    post_stats(u);
+    return 1;
 }
 
+static void thread_func(void *userdata) {
+    struct userdata *u = userdata;
 
-/* Called from I/O thread context */
-static void sink_input_attach(pa_sink_input *i) {
-    struct userdata *u;
-    struct pollfd *p;
+    pa_assert(u);
+    pa_log_debug("Thread starting up");
 
-    pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
-    pa_assert(!u->rtpoll_item);
-    pa_assert(i->sink->thread_info.rtpoll); // This sink must have an rtpoll !
+    pa_thread_mq_install(&u->thread_mq);
 
-    u->rtpoll_item = pa_rtpoll_item_new(i->sink->thread_info.rtpoll, PA_RTPOLL_LATE, 1);
-    p = pa_rtpoll_item_get_pollfd(u->rtpoll_item, NULL);
-    p->fd = u->istream.fd;
-    p->events = POLLIN;
-    p->revents = 0;
+    for (;;) {
+        int ret;
 
-    pa_rtpoll_item_set_work_callback(u->rtpoll_item, rtpoll_work_cb, u);
-}
+        if ((ret = pa_rtpoll_run(u->rtpoll)) < 0) {
+            pa_log("rtpoll fail : %d", ret);
+            goto fail;
+        }
 
-/* Called from I/O thread context */
-static void sink_input_detach(pa_sink_input *i) {
-    struct userdata *u;
-    pa_sink_input_assert_ref(i);
-    pa_assert_se(u = i->userdata);
-    pa_assert(u->rtpoll_item);
+        if (ret == 0)
+            goto finish;
+    }
 
-    pa_rtpoll_item_free(u->rtpoll_item);
-    u->rtpoll_item = NULL;
+fail:
+    /* If this was no regular exit from the loop we have to continue
+     * processing messages until we received PA_MESSAGE_SHUTDOWN */
+    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
+    pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
+
+finish:
+    pa_log_debug("Thread shutting down");
 }
 
 int pa__init(pa_module*m) {
     struct userdata *u = NULL;
     pa_modargs *ma = NULL;
-    pa_sink *sink;
-    pa_sink_input_new_data data;
-    pa_memchunk silence;
+    struct pollfd *pollfd;
+    bool rx_ring, filter;
+    uint32_t rcvbuf, latency_msec, max_latency_msec;
+    const char *plc;
 
     pa_assert(m);
 
@@ -304,20 +1101,12 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    m->userdata = u = pa_xnew(struct userdata, 1);
+    m->userdata = u = pa_xnew0(struct userdata, 1);
     u->module = m;
     u->core = m->core;
-    u->seqnb = 0;
-    u->last_pb_ts = 0;
-    u->rtpoll_item = NULL;
-    // TODO: get actual sample spec from sender
-    u->ss.format = PA_SAMPLE_S16LE;
-    u->ss.rate = 44100;
-    u->ss.channels = 2;
-    if (!pa_sample_spec_valid(&u->ss)) {
-        pa_log("Invalid sample spec");
-        goto fail;
-    }
+    u->sink_name = pa_xstrdup(pa_modargs_get_value(ma, "sink", NULL));
+    PA_LLIST_HEAD_INIT(struct session, u->sessions);
+    u->by_channel = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL, (pa_free_cb_t) session_free);
 
     // open istream
     u->iface = pa_modargs_get_value(ma, "iface", DEFAULT_IFACE);
@@ -328,53 +1117,93 @@ int pa__init(pa_module*m) {
 
     pa_make_fd_nonblock(u->istream.fd);
 
-    // setup sink input
-    if (!(sink = pa_namereg_get(u->module->core,
-                    pa_modargs_get_value(ma, "sink", NULL), PA_NAMEREG_SINK))) {
+    rcvbuf = IWAB_DEFAULT_RCVBUF;
+    if (pa_modargs_get_value_u32(ma, "rcvbuf", &rcvbuf) < 0 || rcvbuf == 0 || rcvbuf > INT_MAX) {
+        pa_log("Invalid rcvbuf= argument");
+        goto fail;
+    }
+
+    if (rcvbuf != IWAB_DEFAULT_RCVBUF)
+        iwab_set_rcvbuf(&u->istream, rcvbuf);
+
+    filter = true;
+    if (pa_modargs_get_value_boolean(ma, "filter", &filter) < 0) {
+        pa_log("filter= expects a boolean argument");
+        goto fail;
+    }
+
+    if (filter && iwab_attach_filter(&u->istream) < 0) {
+        pa_log_warn("Failed to attach the socket filter : %s", pa_cstrerror(errno));
+    }
+
+    rx_ring = false;
+    if (pa_modargs_get_value_boolean(ma, "rx_ring", &rx_ring) < 0) {
+        pa_log("rx_ring= expects a boolean argument");
+        goto fail;
+    }
+
+    if (rx_ring && iwab_rx_setup(&u->istream) < 0) {
+        pa_log_warn("Failed to setup the receive ring : %s, using plain reads", pa_cstrerror(errno));
+    }
+
+    latency_msec = DEFAULT_LATENCY_MSEC;
+    max_latency_msec = DEFAULT_MAX_LATENCY_MSEC;
+    if (pa_modargs_get_value_u32(ma, "latency_msec", &latency_msec) < 0 || latency_msec < 1
+            || pa_modargs_get_value_u32(ma, "max_latency_msec", &max_latency_msec) < 0
+            || max_latency_msec < latency_msec || max_latency_msec > 30000) {
+        pa_log("Invalid latency specification");
+        goto fail;
+    }
+
+    u->min_latency = (pa_usec_t) latency_msec * PA_USEC_PER_MSEC;
+    u->max_latency = (pa_usec_t) max_latency_msec * PA_USEC_PER_MSEC;
+
+    plc = pa_modargs_get_value(ma, "plc", "wsola");
+    if (pa_streq(plc, "wsola"))
+        u->plc_mode = IWAB_PLC_WSOLA;
+    else if (pa_streq(plc, "fade"))
+        u->plc_mode = IWAB_PLC_FADE;
+    else {
+        pa_log("Invalid plc= argument, expected fade or wsola");
+        goto fail;
+    }
+
+    u->plc_max_msec = DEFAULT_PLC_MAX_MSEC;
+    if (pa_modargs_get_value_u32(ma, "plc_max_msec", &u->plc_max_msec) < 0 || u->plc_max_msec < 1 || u->plc_max_msec > 1000) {
+        pa_log("Invalid plc_max_msec= argument");
+        goto fail;
+    }
+
+    if (!pa_namereg_get(u->core, u->sink_name, PA_NAMEREG_SINK)) {
         pa_log("Sink does not exist.");
         goto fail;
     }
 
-    pa_sink_input_new_data_init(&data);
-    pa_sink_input_new_data_set_sink(&data, sink, false, true);
-    data.driver = __FILE__;
-    pa_proplist_sets(data.proplist, PA_PROP_MEDIA_ROLE, "stream");
-    pa_proplist_setf(data.proplist, PA_PROP_MEDIA_NAME, "wiscast streaming from %s",
-            u->iface);
-	pa_proplist_setf(data.proplist, "iwab.lost", "%lums lost", 0UL);
-    data.module = u->module;
-    pa_sink_input_new_data_set_sample_spec(&data, &u->ss);
-    pa_sink_input_new(&u->sink_input, u->module->core, &data);
-    pa_sink_input_new_data_done(&data);
+    // setup the rx thread, sessions are created as senders advertise their streams
+    u->msg = pa_msgobject_new(iwab_input_msg);
+    u->msg->parent.process_msg = iwab_input_process_msg_cb;
+    u->msg->userdata = u;
 
-    if (!u->sink_input) {
-        pa_log("Failed to create sink input.");
+    u->rtpoll = pa_rtpoll_new();
+    if (pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll) < 0) {
+        pa_log("pa_thread_mq_init() failed.");
         goto fail;
     }
 
-    u->sink_input->userdata = u;
-    u->sink_input->parent.process_msg = sink_input_process_msg;
-    u->sink_input->pop = sink_input_pop_cb;
-    u->sink_input->attach = sink_input_attach;
-    u->sink_input->detach = sink_input_detach;
-    u->sink_input->kill = sink_input_kill_cb;
-    u->sink_input->process_rewind = sink_input_process_rewind_cb;
+    u->rtpoll_item = pa_rtpoll_item_new(u->rtpoll, PA_RTPOLL_NORMAL, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(u->rtpoll_item, NULL);
+    pollfd->fd = u->istream.fd;
+    pollfd->events = POLLIN;
+    pollfd->revents = 0;
+    pa_rtpoll_item_set_work_callback(u->rtpoll_item, rtpoll_work_cb, u);
 
-    // setup audio buffer
-    pa_sink_input_get_silence(u->sink_input, &silence);
-    u->queue = pa_memblockq_new(
-            "module-iwab-input memblockq",
-            0,
-            10*MAX_FRAME_SIZE,
-            5*MAX_FRAME_SIZE,
-            &u->ss,
-            5*MAX_FRAME_SIZE,
-            0,
-            0,
-            &silence);
-    pa_memblock_unref(silence.memblock);
+    if (!(u->thread = pa_thread_new("iwab-input", thread_func, u))) {
+        pa_log("Failed to create thread.");
+        goto fail;
+    }
 
-    pa_sink_input_put(u->sink_input);
+    u->time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + RATE_UPDATE_INTERVAL, time_callback, u);
+    u->check_death_event = pa_core_rttime_new(u->core, pa_rtclock_now() + DEATH_TIMEOUT * PA_USEC_PER_SEC, check_death_event_cb, u);
     pa_modargs_free(ma);
     return 0;
 
@@ -383,13 +1212,7 @@ fail:
         pa_modargs_free(ma);
     }
 
-    if (u->istream.fd) {
-        pa_assert_se(iwab_close(&u->istream) == 0);
-    }
-
-    if (u) {
-        pa_xfree(u);
-    }
+    pa__done(m);
 
     return -1;
 }
@@ -402,13 +1225,36 @@ void pa__done(pa_module*m) {
     if (!(u = m->userdata))
         return;
 
-    if (u->queue) {
-        pa_memblockq_free(u->queue);
+    if (u->time_event)
+        u->core->mainloop->time_free(u->time_event);
+
+    if (u->check_death_event)
+        u->core->mainloop->time_free(u->check_death_event);
+
+    /* Sessions are removed from the rx thread, it must still run */
+    if (u->by_channel)
+        pa_hashmap_free(u->by_channel);
+
+    if (u->thread) {
+        pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+        pa_thread_free(u->thread);
     }
 
+    if (u->rtpoll_item)
+        pa_rtpoll_item_free(u->rtpoll_item);
+
+    if (u->rtpoll) {
+        pa_thread_mq_done(&u->thread_mq);
+        pa_rtpoll_free(u->rtpoll);
+    }
+
+    if (u->msg)
+        pa_msgobject_unref(PA_MSGOBJECT(u->msg));
+
     if (u->istream.fd) {
         pa_assert_se(iwab_close(&u->istream) == 0);
     }
 
+    pa_xfree(u->sink_name);
     pa_xfree(u);
 }
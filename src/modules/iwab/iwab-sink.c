@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 
@@ -42,7 +43,11 @@
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/strbuf.h>
+#include <pulsecore/time-smoother.h>
 
+#include "codec-util.h"
+#include "fec.h"
 #include "net.h"
 
 PA_MODULE_AUTHOR("rca");
@@ -55,12 +60,42 @@ PA_MODULE_USAGE(
         "rate=<sample rate> "
         "channels=<number of channels> "
         "channel_map=<channel map>"
-        "iface=<wireless interface>"
+        "iface=<wireless interface> "
+        "tx_mode=<direct|mmsg|ring> "
+        "fec_k=<data frames per fec group, 0 to resend frames instead> "
+        "fec_m=<parity frames per fec group> "
+        "codec=<payload codec, pcm or adpcm> "
+        "stream_id=<iwab stream id, 0 to 255> "
+        "lead_usec=<time a frame is rendered and sent ahead of its timestamp>"
         );
 
 #define DEFAULT_SINK_NAME "iwabsink"
 #define DEFAULT_IFACE "mon0"
 #define MAX_FRAME_SIZE 1400
+#define STATS_INTERVAL (5*PA_USEC_PER_SEC)
+#define FORMAT_INTERVAL PA_USEC_PER_SEC
+#define DEFAULT_LEAD_USEC (2*PA_USEC_PER_MSEC)
+#define MIN_FRAME_USEC PA_USEC_PER_MSEC
+#define MAX_LATENCY_USEC (10*PA_USEC_PER_SEC) // the most pa_sink_set_latency_range() takes
+#define SMOOTHER_WINDOW_USEC (10*PA_USEC_PER_SEC)
+#define SMOOTHER_ADJUST_USEC PA_USEC_PER_SEC
+
+/* Upper bounds of the wakeup lateness histogram buckets, the last bucket
+ * holds everything above */
+static const pa_usec_t lateness_bounds[] = { 50, 100, 250, 500, 1000, 2000, 5000 };
+#define N_LATENESS (PA_ELEMENTSOF(lateness_bounds) + 1)
+
+enum {
+    SINK_MESSAGE_UPDATE_STATS = PA_SINK_MESSAGE_MAX,
+};
+
+struct tx_stats {
+    struct iwab_tx_stats net;
+    pa_usec_t send_usec;
+    uint64_t lateness[N_LATENESS];
+    pa_usec_t max_lateness;
+    uint64_t late_frames;
+};
 
 struct userdata {
     pa_core *core;
@@ -71,13 +106,36 @@ struct userdata {
     pa_thread_mq thread_mq;
     pa_rtpoll *rtpoll;
 
-    pa_usec_t block_usec;
-    pa_usec_t stream_ts_abs; // time for the next packet render
+    pa_usec_t block_usec; // playback time covered by a frame
+    pa_usec_t lead_usec;
+    pa_usec_t stream_ts_abs; // timestamp of the next frame, it is rendered lead_usec earlier
     pa_usec_t stream_resend_abs;
     const char *iface;
     int retries;
     struct iwab istream;
     pa_memchunk chunk;
+
+    // in batched tx modes the previous chunk is resent along with the next one
+    pa_memchunk resend_chunk;
+    pa_usec_t resend_ts;
+    bool fec; // frames are protected by parity frames instead of resends
+
+    const iwab_codec *codec;
+    void *codec_info;
+    size_t block_size; // PCM bytes encoded in a frame
+
+    struct iwab_format format; // advertised to receivers
+    pa_usec_t format_abs; // time for the next format frame
+
+    // x is the local time a frame left, y the stream time it starts at
+    pa_smoother *smoother;
+    pa_usec_t written; // stream time rendered since the sink was opened
+
+    pa_usec_t send_usec; // time spent in the send path
+    uint64_t lateness[N_LATENESS]; // wakeups past the render deadline
+    pa_usec_t max_lateness;
+    uint64_t late_frames; // frames that left after their timestamp
+    pa_usec_t stats_abs; // time for the next stats update
 };
 
 static const char* const valid_modargs[] = {
@@ -87,6 +145,12 @@ static const char* const valid_modargs[] = {
     "channels",
     "channel_map",
     "iface",
+    "tx_mode",
+    "fec_k",
+    "fec_m",
+    "codec",
+    "stream_id",
+    "lead_usec",
     NULL
 };
 
@@ -100,11 +164,51 @@ static int sink_process_msg(
     struct userdata *u = PA_SINK(o)->userdata;
 
     switch (code) {
-        case PA_SINK_MESSAGE_GET_LATENCY: { // We can do this lock free, we should override get_latency() instead
-            pa_usec_t now = pa_rtclock_now();
-            pa_usec_t latency = u->stream_ts_abs - now;
-            *((int64_t*) data) = (int64_t) latency;
-            pa_log("Get latency : %ldus", latency);
+        case PA_SINK_MESSAGE_GET_LATENCY: {
+            /* Answered in the IO thread, which owns the smoother. Its
+             * estimate of the stream time on air is free of the jitter of
+             * our wakeups, the audio handed out lead_usec ahead of it is
+             * still to be played. */
+            int64_t latency = 0;
+
+            if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
+                latency = (int64_t) u->written + (int64_t) u->lead_usec -
+                    (int64_t) pa_smoother_get(u->smoother, pa_rtclock_now());
+
+            *((int64_t*) data) = latency;
+            return 0;
+        }
+
+        case SINK_MESSAGE_UPDATE_STATS: { // Called from main context
+            struct tx_stats *st = data;
+            pa_proplist *pl = pa_proplist_new();
+            pa_strbuf *buf = pa_strbuf_new();
+            char *lateness;
+            unsigned i;
+
+            pa_proplist_setf(pl, "iwab.tx.frames", "%llu", (unsigned long long) st->net.frames);
+            pa_proplist_setf(pl, "iwab.tx.dropped", "%llu", (unsigned long long) st->net.dropped);
+            pa_proplist_setf(pl, "iwab.tx.frames_per_syscall", "%.2f",
+                    st->net.syscalls ? (double) st->net.frames / st->net.syscalls : 0.0);
+            pa_proplist_setf(pl, "iwab.tx.send_time", "%lluus",
+                    (unsigned long long) st->send_usec);
+
+            for (i = 0; i < N_LATENESS; i++) {
+                if (i < N_LATENESS - 1)
+                    pa_strbuf_printf(buf, "%s<%lluus:%llu", i ? " " : "",
+                            (unsigned long long) lateness_bounds[i], (unsigned long long) st->lateness[i]);
+                else
+                    pa_strbuf_printf(buf, " >=%lluus:%llu",
+                            (unsigned long long) lateness_bounds[i - 1], (unsigned long long) st->lateness[i]);
+            }
+
+            lateness = pa_strbuf_to_string_free(buf);
+            pa_proplist_sets(pl, "iwab.tx.lateness", lateness);
+            pa_xfree(lateness);
+            pa_proplist_setf(pl, "iwab.tx.max_lateness", "%lluus", (unsigned long long) st->max_lateness);
+            pa_proplist_setf(pl, "iwab.tx.late_frames", "%llu", (unsigned long long) st->late_frames);
+            pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
+            pa_proplist_free(pl);
             return 0;
         }
     }
@@ -120,12 +224,24 @@ static int sink_set_state_in_io_thread_cb(pa_sink *s, pa_sink_state_t new_state,
     pa_assert_se(u = s->userdata);
 
     if (s->thread_info.state == PA_SINK_SUSPENDED || s->thread_info.state == PA_SINK_INIT) {
-        if (PA_SINK_IS_OPENED(new_state))
-            pa_log("Sink is opened");
-            u->stream_ts_abs = pa_rtclock_now();
+        if (PA_SINK_IS_OPENED(new_state)) {
+            pa_usec_t now = pa_rtclock_now();
+
+            pa_log_debug("Sink is opened");
+            // the first frame is due right away
+            u->stream_ts_abs = now + u->lead_usec;
+            u->format_abs = 0; // receivers need it before any audio
+            u->written = 0;
+            pa_smoother_reset(u->smoother, now, false);
+        }
     } else if (PA_SINK_IS_OPENED(s->thread_info.state)) {
         if (new_state == PA_SINK_SUSPENDED) {
-            pa_log("Sink is suspended");
+            pa_log_debug("Sink is suspended");
+            pa_smoother_pause(u->smoother, pa_rtclock_now());
+            if (u->resend_chunk.memblock) {
+                pa_memblock_unref(u->resend_chunk.memblock);
+                pa_memchunk_reset(&u->resend_chunk);
+            }
         }
     }
 
@@ -134,27 +250,142 @@ static int sink_set_state_in_io_thread_cb(pa_sink *s, pa_sink_state_t new_state,
 
 static void sink_update_requested_latency_cb(pa_sink *s) {
     struct userdata *u;
+    pa_usec_t latency;
     size_t nbytes;
 
     pa_sink_assert_ref(s);
     pa_assert_se(u = s->userdata);
 
-    u->block_usec = pa_sink_get_requested_latency_within_thread(s);
-    pa_log("Update requested latency to %ld", u->block_usec); // TODO: this is wrong, block_usec is used to determine the frame size
-
-    if (u->block_usec == -1) {
-        nbytes = pa_frame_align(MAX_FRAME_SIZE, &u->sink->sample_spec);
-        u->block_usec = pa_bytes_to_usec(nbytes, &u->sink->sample_spec);
-        pa_log("Requested latency is invalid, using %lu instead", u->block_usec);
-    } else {
-        nbytes = pa_usec_to_bytes(u->block_usec, &u->sink->sample_spec);
+    latency = pa_sink_get_requested_latency_within_thread(s);
+
+    if (latency == (pa_usec_t) -1)
+        nbytes = u->block_size;
+    else {
+        /* A frame is handed out lead_usec before it is due and then covers
+         * its own duration, what is left of the requested latency once the
+         * lead is taken out is the frame duration. */
+        latency = latency > u->lead_usec + MIN_FRAME_USEC ? latency - u->lead_usec : MIN_FRAME_USEC;
+        nbytes = PA_MIN(pa_usec_to_bytes(latency, &s->sample_spec), u->block_size);
+        nbytes = PA_MAX(nbytes, pa_frame_size(&s->sample_spec));
     }
 
-    pa_log("Corresponding buffer size : %lu", nbytes);
+    u->block_usec = pa_bytes_to_usec(nbytes, &s->sample_spec);
+    pa_log_debug("Sending %zu byte frames of %lluus", nbytes, (unsigned long long) u->block_usec);
     pa_sink_set_max_rewind_within_thread(s, 0);
     pa_sink_set_max_request_within_thread(s, nbytes);
 }
 
+/* Called from the IO thread. */
+static void post_stats(struct userdata *u) {
+    struct tx_stats *st = pa_xnew(struct tx_stats, 1);
+
+    st->net = u->istream.tx_stats;
+    st->send_usec = u->send_usec;
+    memcpy(st->lateness, u->lateness, sizeof(st->lateness));
+    st->max_lateness = u->max_lateness;
+    st->late_frames = u->late_frames;
+    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_UPDATE_STATS, st, 0, NULL, pa_xfree);
+}
+
+/* Called from the IO thread. Account how late we woke up to render a frame. */
+static void account_lateness(struct userdata *u, pa_usec_t lateness) {
+    unsigned i;
+
+    for (i = 0; i < N_LATENESS - 1; i++)
+        if (lateness < lateness_bounds[i])
+            break;
+
+    u->lateness[i]++;
+    u->max_lateness = PA_MAX(u->max_lateness, lateness);
+}
+
+/* Called from the IO thread. Repeat the stream format every FORMAT_INTERVAL
+ * so that receivers started late, or which missed it, can play the stream. */
+static int send_format(struct userdata *u, pa_usec_t now) {
+    if (now < u->format_abs)
+        return 0;
+
+    u->format_abs = now + FORMAT_INTERVAL;
+    return iwab_send_format(&u->istream, &u->format);
+}
+
+/* Called from the IO thread. Render the next chunk and, unless sending raw
+ * PCM, replace it with its encoded version. Returns the playback time it
+ * covers. */
+static pa_usec_t render_chunk(struct userdata *u) {
+    pa_memchunk encoded;
+    pa_usec_t chunk_time;
+    size_t processed;
+    uint8_t *src, *dst;
+
+    pa_sink_render(u->sink, u->sink->thread_info.max_request, &u->chunk);
+    pa_assert(u->chunk.length > 0);
+    chunk_time = pa_bytes_to_usec(u->chunk.length, &u->sink->sample_spec);
+
+    if (u->codec->id == IWAB_CODEC_PCM)
+        return chunk_time;
+
+    encoded.memblock = pa_memblock_new(u->core->mempool, MAX_FRAME_SIZE);
+    encoded.index = 0;
+    src = pa_memblock_acquire_chunk(&u->chunk);
+    dst = pa_memblock_acquire(encoded.memblock);
+    encoded.length = u->codec->encode_buffer(u->codec_info, (uint32_t) u->stream_ts_abs,
+            src, u->chunk.length, dst, MAX_FRAME_SIZE, &processed);
+    pa_memblock_release(encoded.memblock);
+    pa_memblock_release(u->chunk.memblock);
+
+    /* max_request never exceeds what fits in a frame */
+    pa_assert(processed == u->chunk.length);
+    pa_assert(encoded.length > 0);
+
+    pa_memblock_unref(u->chunk.memblock);
+    u->chunk = encoded;
+
+    return chunk_time;
+}
+
+/* Called from the IO thread. Queue the resend of the previous chunk and the
+ * newly rendered one, and push both out with a single syscall. The resend
+ * then trails the original by one chunk instead of half a chunk. */
+static int send_batched(struct userdata *u) {
+    char *p = NULL, *prev = NULL;
+    int ret = 0;
+
+    if (u->resend_chunk.memblock) {
+        prev = pa_memblock_acquire_chunk(&u->resend_chunk);
+        ret = iwab_queue(&u->istream, prev, u->resend_chunk.length, u->resend_ts, 1);
+    }
+
+    if (ret >= 0 || errno == EAGAIN) {
+        p = pa_memblock_acquire_chunk(&u->chunk);
+        ret = iwab_queue(&u->istream, p, u->chunk.length, u->stream_ts_abs, 0);
+    }
+
+    if (ret >= 0 || errno == EAGAIN)
+        ret = iwab_flush(&u->istream);
+
+    if (p)
+        pa_memblock_release(u->chunk.memblock);
+
+    if (prev) {
+        pa_memblock_release(u->resend_chunk.memblock);
+        pa_memblock_unref(u->resend_chunk.memblock);
+    }
+
+    if (u->fec) {
+        // the parity frames replace the resend
+        pa_memblock_unref(u->chunk.memblock);
+        pa_memchunk_reset(&u->resend_chunk);
+    } else {
+        u->resend_chunk = u->chunk;
+        u->resend_ts = u->stream_ts_abs;
+    }
+
+    pa_memchunk_reset(&u->chunk);
+
+    return ret;
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
 
@@ -162,11 +393,13 @@ static void thread_func(void *userdata) {
     pa_log_debug("Thread starting up");
 
     pa_thread_mq_install(&u->thread_mq);
-    u->stream_ts_abs = pa_rtclock_now();
-    u->retries = 0;
+    u->stream_ts_abs = pa_rtclock_now() + u->lead_usec;
+    u->stats_abs = u->stream_ts_abs + STATS_INTERVAL;
+    u->retries = 2; // nothing to resend yet
 
     for (;;) {
         pa_usec_t now = 0;
+        pa_usec_t send_start;
         int ret;
         char * p;
 
@@ -177,34 +410,65 @@ static void thread_func(void *userdata) {
             pa_sink_process_rewind(u->sink, 0);
 
         if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
-            if (now >= u->stream_ts_abs) { // is it time to render the next chunk already ?
-                pa_usec_t chunk_time = 0;
-                pa_sink_render(u->sink, u->sink->thread_info.max_request, &u->chunk);
-                u->retries = 0;
-                pa_assert(u->chunk.length > 0);
-                /*
-                pa_log("stream_ts: %lu, now : %lu, retries : %d, rendering & sending.",
-                        u->stream_ts_abs, now, u->retries);
-                */
+            // frames are rendered and sent lead_usec before their timestamp
+            pa_usec_t deadline = u->stream_ts_abs - PA_MIN(u->lead_usec, u->stream_ts_abs);
+            pa_usec_t wakeup;
 
-                p = pa_memblock_acquire(u->chunk.memblock);
-                ret = iwab_send(&u->istream, (char*) p + u->chunk.index, u->chunk.length, u->stream_ts_abs, u->retries);
-                if (ret < 0) {
-                    pa_log("Error %d sending %zu byte buffer : %s", ret, u->chunk.length, pa_cstrerror(errno));
+            if (now >= deadline) {
+                pa_usec_t chunk_time;
+
+                account_lateness(u, now - deadline);
+
+                if (u->chunk.memblock) {
+                    // its resend was overtaken by the next frame
+                    pa_memblock_unref(u->chunk.memblock);
+                    pa_memchunk_reset(&u->chunk);
+                }
+
+                if (send_format(u, now) < 0 && errno != EAGAIN) {
+                    pa_log("Error sending the stream format : %s", pa_cstrerror(errno));
                     goto fail;
                 }
 
-                pa_memblock_release(u->chunk.memblock);
-                u->retries += 1;
-                chunk_time = pa_bytes_to_usec(u->chunk.length, &u->sink->sample_spec);
-                u->stream_resend_abs = u->stream_ts_abs + chunk_time / 2;
+                chunk_time = render_chunk(u);
+                send_start = pa_rtclock_now();
+
+                if (u->istream.tx_mode != IWAB_TX_DIRECT) {
+                    if ((ret = send_batched(u)) < 0 && errno != EAGAIN) {
+                        pa_log("Error %d sending batch : %s", ret, pa_cstrerror(errno));
+                        goto fail;
+                    }
+                } else {
+                    u->retries = 0;
+                    p = pa_memblock_acquire(u->chunk.memblock);
+                    ret = iwab_send(&u->istream, (char*) p + u->chunk.index, u->chunk.length, u->stream_ts_abs, u->retries);
+                    if (ret < 0) {
+                        pa_log("Error %d sending %zu byte buffer : %s", ret, u->chunk.length, pa_cstrerror(errno));
+                        goto fail;
+                    }
+
+                    pa_memblock_release(u->chunk.memblock);
+                    u->retries += 1;
+                    u->stream_resend_abs = deadline + chunk_time / 2;
+
+                    if (u->fec) {
+                        // the parity frames replace the resend
+                        pa_memblock_unref(u->chunk.memblock);
+                        pa_memchunk_reset(&u->chunk);
+                        u->retries = 2;
+                    }
+                }
+
+                now = pa_rtclock_now();
+                u->send_usec += now - send_start;
+                if (now > u->stream_ts_abs)
+                    u->late_frames++;
+
+                pa_smoother_put(u->smoother, now, u->written);
+                u->written += chunk_time;
                 u->stream_ts_abs += chunk_time;
-                pa_rtpoll_set_timer_absolute(u->rtpoll, u->stream_resend_abs);
-            } else if (now >= u->stream_resend_abs && u->retries <= 1) {
-                /*
-                pa_log("stream_resend_ts: %lu, now : %lu, retries : %d, rendering & sending.",
-                        u->stream_resend_abs, now, u->retries);
-                */
+            } else if (u->istream.tx_mode == IWAB_TX_DIRECT && now >= u->stream_resend_abs && u->retries <= 1) {
+                send_start = pa_rtclock_now();
                 p = pa_memblock_acquire(u->chunk.memblock);
                 ret = iwab_send(&u->istream, (char*) p + u->chunk.index, u->chunk.length, u->istream.wi_h.iw_h.timestamp, u->retries);
                 if (ret < 0) {
@@ -214,15 +478,23 @@ static void thread_func(void *userdata) {
 
                 pa_memblock_release(u->chunk.memblock);
                 pa_memblock_unref(u->chunk.memblock);
+                pa_memchunk_reset(&u->chunk);
+                u->send_usec += pa_rtclock_now() - send_start;
                 u->retries += 1;
-                pa_rtpoll_set_timer_absolute(u->rtpoll, u->stream_ts_abs);
-            } else {
-                pa_rtpoll_set_timer_absolute(u->rtpoll, u->stream_ts_abs);
             }
-        } else {
+
+            wakeup = u->stream_ts_abs - PA_MIN(u->lead_usec, u->stream_ts_abs);
+            if (u->istream.tx_mode == IWAB_TX_DIRECT && u->retries <= 1)
+                wakeup = PA_MIN(wakeup, u->stream_resend_abs);
+
+            pa_rtpoll_set_timer_absolute(u->rtpoll, wakeup);
+
+            if (now >= u->stats_abs) {
+                post_stats(u);
+                u->stats_abs = now + STATS_INTERVAL;
+            }
+        } else
             pa_rtpoll_set_timer_disabled(u->rtpoll);
-            pa_log("rtpoll set timer disabled ok");
-        }
 
         /* Hmm, nothing to do. Let's sleep */
         if ((ret = pa_rtpoll_run(u->rtpoll)) < 0) {
@@ -239,12 +511,22 @@ static void thread_func(void *userdata) {
     }
 
 fail:
+    if (u->resend_chunk.memblock) {
+        pa_memblock_unref(u->resend_chunk.memblock);
+        pa_memchunk_reset(&u->resend_chunk);
+    }
+
     /* If this was no regular exit from the loop we have to continue
      * processing messages until we received PA_MESSAGE_SHUTDOWN */
     pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
     pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
 
 finish:
+    if (u->resend_chunk.memblock) {
+        pa_memblock_unref(u->resend_chunk.memblock);
+        pa_memchunk_reset(&u->resend_chunk);
+    }
+
     pa_log_debug("Thread shutting down");
 }
 
@@ -255,6 +537,10 @@ int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     pa_sink_new_data data;
     size_t buffer_size = 0;
+    const char *tx_mode, *codec;
+    enum iwab_tx_mode mode;
+    uint32_t fec_k = 0, fec_m = 1, stream_id = 0, lead_usec = DEFAULT_LEAD_USEC;
+    unsigned c;
 
     pa_assert(m);
 
@@ -302,6 +588,73 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    tx_mode = pa_modargs_get_value(ma, "tx_mode", "direct");
+    if (pa_streq(tx_mode, "direct"))
+        mode = IWAB_TX_DIRECT;
+    else if (pa_streq(tx_mode, "mmsg"))
+        mode = IWAB_TX_MMSG;
+    else if (pa_streq(tx_mode, "ring"))
+        mode = IWAB_TX_RING;
+    else {
+        pa_log("Invalid tx_mode %s", tx_mode);
+        pa_sink_new_data_done(&data);
+        goto fail;
+    }
+
+    mode = iwab_tx_setup(&u->istream, mode);
+    pa_log_debug("Using tx mode %d", mode);
+
+    if (pa_modargs_get_value_u32(ma, "fec_k", &fec_k) < 0 ||
+        pa_modargs_get_value_u32(ma, "fec_m", &fec_m) < 0 ||
+        iwab_set_fec(&u->istream, fec_k, fec_m) < 0) {
+        pa_log("Invalid fec parameters, expected 1 <= fec_m <= fec_k <= %u and fec_m <= %u",
+                IWAB_FEC_MAX_K, IWAB_FEC_MAX_M);
+        pa_sink_new_data_done(&data);
+        goto fail;
+    }
+
+    u->fec = fec_k > 0;
+
+    codec = pa_modargs_get_value(ma, "codec", "pcm");
+    if (!(u->codec = iwab_get_codec(codec))) {
+        pa_log("Invalid codec %s", codec);
+        pa_sink_new_data_done(&data);
+        goto fail;
+    }
+
+    if (!(u->codec_info = u->codec->init(true, &ss))) {
+        pa_log("Failed to initialize %s codec", u->codec->name);
+        pa_sink_new_data_done(&data);
+        goto fail;
+    }
+
+    iwab_set_codec(&u->istream, u->codec->id);
+    pa_proplist_sets(data.proplist, "iwab.codec", u->codec->name);
+
+    if (pa_modargs_get_value_u32(ma, "stream_id", &stream_id) < 0 || stream_id > 255) {
+        pa_log("Invalid stream_id, expected 0 to 255");
+        pa_sink_new_data_done(&data);
+        goto fail;
+    }
+
+    iwab_set_channel(&u->istream, stream_id);
+    pa_proplist_setf(data.proplist, "iwab.stream_id", "%u", stream_id);
+
+    if (pa_modargs_get_value_u32(ma, "lead_usec", &lead_usec) < 0) {
+        pa_log("Invalid lead_usec");
+        pa_sink_new_data_done(&data);
+        goto fail;
+    }
+
+    u->lead_usec = lead_usec;
+    u->smoother = pa_smoother_new(SMOOTHER_ADJUST_USEC, SMOOTHER_WINDOW_USEC, true, true, 5, pa_rtclock_now(), true);
+
+    u->format.format = ss.format;
+    u->format.channels = ss.channels;
+    u->format.rate = ss.rate;
+    for (c = 0; c < map.channels; c++)
+        u->format.map[c] = map.map[c];
+
     u->sink = pa_sink_new(m->core, &data, PA_SINK_LATENCY | PA_SINK_DYNAMIC_LATENCY);
     pa_sink_new_data_done(&data);
 
@@ -310,15 +663,23 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    // We can send 1400 bytes frames max
-    buffer_size = pa_frame_align(MAX_FRAME_SIZE, &u->sink->sample_spec);
+    // We can send 1400 bytes frames max, once encoded
+    buffer_size = pa_frame_align(u->codec->get_write_block_size(u->codec_info, MAX_FRAME_SIZE), &u->sink->sample_spec);
+    u->block_size = buffer_size;
     u->block_usec = pa_bytes_to_usec(buffer_size, &u->sink->sample_spec);
     pa_log("Buffer size : %zd, corresponding timing : %luus at %s %uch %dHz",
             buffer_size, u->block_usec,
             pa_sample_format_to_string(u->sink->sample_spec.format),
             u->sink->sample_spec.channels,
             u->sink->sample_spec.rate);
-    pa_sink_set_latency_range(u->sink, 0, u->block_usec);
+
+    if (u->lead_usec + u->block_usec > MAX_LATENCY_USEC) {
+        pa_log("lead_usec too large, at most %llu with %lluus frames",
+                (unsigned long long) (MAX_LATENCY_USEC - u->block_usec), (unsigned long long) u->block_usec);
+        goto fail;
+    }
+
+    pa_sink_set_latency_range(u->sink, u->lead_usec + PA_MIN(MIN_FRAME_USEC, u->block_usec), u->lead_usec + u->block_usec);
     pa_sink_set_max_rewind(u->sink, 0); // disable rewind on this sink
     pa_sink_set_max_request(u->sink, buffer_size);
 
@@ -386,5 +747,11 @@ void pa__done(pa_module*m) {
 
     pa_assert_se(iwab_close(&u->istream) == 0);
 
+    if (u->codec_info)
+        u->codec->deinit(u->codec_info);
+
+    if (u->smoother)
+        pa_smoother_free(u->smoother);
+
     pa_xfree(u);
 }
@@ -3,9 +3,12 @@
 #include <linux/if_ether.h>
 #include <linux/if_packet.h>
 #include <net/if.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <unistd.h>
@@ -16,24 +19,16 @@
 
 #include <pulsecore/log.h>
 
+#include "fec.h"
 #include "net.h"
 
-ssize_t iwab_read(struct iwab* iw, char* buffer, ssize_t max_length, size_t* data_offset) {
-  ssize_t read_size;
+// Check that the frame is an iwab frame and locate its headers
+static ssize_t iwab_parse(struct iwab* iw, char* buffer, ssize_t read_size, size_t* data_offset) {
   struct radiotap_head* rt_in = NULL;
   struct ieee80211_head* dot11_in = NULL;
   struct l2_head* l2_in = NULL;
   struct iwab_head* iw_in = NULL;
   *data_offset = 0;
-  if (!buffer) {
-    errno = EINVAL;
-    return -1;
-  }
-
-  read_size = recv(iw->fd, buffer, max_length, 0);
-  if (read_size < 0) {
-    return read_size;
-  }
 
   if (read_size <= sizeof(struct radiotap)) {
     errno = EAGAIN; // this is too small to be a valid packet
@@ -64,7 +59,7 @@ ssize_t iwab_read(struct iwab* iw, char* buffer, ssize_t max_length, size_t* dat
   // TODO: why do we even have this layer ?
   l2_in = (struct l2_head*) (buffer + *data_offset);
   *data_offset += sizeof(struct l2_head);
-  if (read_size - *data_offset <= sizeof(struct iwab_head)) {
+  if (read_size - *data_offset <= sizeof(struct iwab_head) || l2_in->ethertype != IWAB_ETHERTYPE) {
     errno = EAGAIN;
     return -6;
   }
@@ -83,24 +78,468 @@ ssize_t iwab_read(struct iwab* iw, char* buffer, ssize_t max_length, size_t* dat
   return read_size - (*data_offset + 4); // 4 is for the FCS
 }
 
-int iwab_send(struct iwab* iw, char* buffer, ssize_t length, uint64_t timestamp, uint8_t retried) {
+ssize_t iwab_read(struct iwab* iw, char* buffer, ssize_t max_length, size_t* data_offset) {
+  ssize_t read_size;
+  *data_offset = 0;
   if (!buffer) {
     errno = EINVAL;
     return -1;
   }
 
+  read_size = recv(iw->fd, buffer, max_length, 0);
+  if (read_size < 0) {
+    return read_size;
+  }
+
+  return iwab_parse(iw, buffer, read_size, data_offset);
+}
+
+static size_t iwab_rx_ring_size(void) {
+  return IWAB_RX_RING_BLOCK_SIZE * IWAB_RX_RING_BLOCKS;
+}
+
+int iwab_rx_setup(struct iwab* iw) {
+  struct tpacket_req3 req;
+  int version = TPACKET_V3;
+  void* ring;
+
+  if (!iw) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (setsockopt(iw->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+    return -2;
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = IWAB_RX_RING_BLOCK_SIZE;
+  req.tp_block_nr = IWAB_RX_RING_BLOCKS;
+  req.tp_frame_size = TPACKET_ALIGNMENT << 7; // only used for sanity checks with V3
+  req.tp_frame_nr = (req.tp_block_size / req.tp_frame_size) * req.tp_block_nr;
+  req.tp_retire_blk_tov = IWAB_RX_RING_TIMEOUT_MS;
+  if (setsockopt(iw->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+    return -3;
+  }
+
+  ring = mmap(NULL, iwab_rx_ring_size(), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, iw->fd, 0);
+  if (ring == MAP_FAILED) {
+    ring = mmap(NULL, iwab_rx_ring_size(), PROT_READ | PROT_WRITE, MAP_SHARED, iw->fd, 0);
+  }
+
+  if (ring == MAP_FAILED) {
+    memset(&req, 0, sizeof(req));
+    setsockopt(iw->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+    return -4;
+  }
+
+  iw->rx_ring = ring;
+  iw->rx_block = 0;
+  iw->rx_in_block = 0;
+  iw->rx_frame = NULL;
+  iw->rx_frames_left = 0;
+  return 0;
+}
+
+static struct tpacket_block_desc* iwab_rx_block(struct iwab* iw, unsigned n) {
+  return (struct tpacket_block_desc*) (iw->rx_ring + n * IWAB_RX_RING_BLOCK_SIZE);
+}
+
+ssize_t iwab_ring_read(struct iwab* iw, const char** payload) {
+  struct tpacket_block_desc* bd;
+  struct tpacket3_hdr* hdr;
+  size_t data_offset;
+  ssize_t ret;
+
+  if (!iw->rx_ring || !payload) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (;;) {
+    bd = iwab_rx_block(iw, iw->rx_block);
+
+    if (iw->rx_in_block && iw->rx_frames_left == 0) {
+      // give the drained block back to the kernel
+      __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+      iw->rx_in_block = 0;
+      iw->rx_block = (iw->rx_block + 1) % IWAB_RX_RING_BLOCKS;
+      continue;
+    }
+
+    if (!iw->rx_in_block) {
+      if ((__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
+        errno = EAGAIN;
+        return -1;
+      }
+
+      iw->rx_in_block = 1;
+      iw->rx_frames_left = bd->hdr.bh1.num_pkts;
+      iw->rx_frame = (uint8_t*) bd + bd->hdr.bh1.offset_to_first_pkt;
+      continue;
+    }
+
+    hdr = (struct tpacket3_hdr*) iw->rx_frame;
+    iw->rx_frames_left -= 1;
+    iw->rx_frame += hdr->tp_next_offset;
+    iw->rx_stats.frames += 1;
+
+    ret = iwab_parse(iw, (char*) hdr + hdr->tp_mac, hdr->tp_snaplen, &data_offset);
+    if (ret < 0) {
+      iw->rx_stats.filtered += 1;
+      continue;
+    }
+
+    *payload = (char*) hdr + hdr->tp_mac + data_offset;
+    return ret;
+  }
+}
+
+unsigned iwab_rx_ring_occupancy(struct iwab* iw) {
+  unsigned n, used = 0;
+
+  if (!iw->rx_ring) {
+    return 0;
+  }
+
+  for (n = 0; n < IWAB_RX_RING_BLOCKS; n++) {
+    if (__atomic_load_n(&iwab_rx_block(iw, n)->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) {
+      used += 1;
+    }
+  }
+
+  return used;
+}
+
+int iwab_rx_update_stats(struct iwab* iw) {
+  struct tpacket_stats_v3 st;
+  socklen_t len = sizeof(st);
+
+  // the kernel resets its counters on each read
+  if (getsockopt(iw->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) < 0) {
+    return -1;
+  }
+
+  iw->rx_stats.drops += st.tp_drops;
+  return 0;
+}
+
+static void iwab_update_head(struct iwab* iw, ssize_t length, uint64_t timestamp, uint8_t retried) {
   iw->wi_h.iw_h.length = length;
   if (retried == 0) {
       iw->wi_h.iw_h.seq += 1;
   }
   iw->wi_h.iw_h.timestamp = timestamp;
   iw->wi_h.iw_h.retry = retried;
+}
+
+// Write a frame with the current headers right away
+static int iwab_write(struct iwab* iw, char* buffer, ssize_t length) {
   iw->iov[2].iov_base = buffer;
   iw->iov[2].iov_len = length;
   int iovcnt = sizeof(iw->iov) / sizeof(struct iovec);
+  iw->tx_stats.frames += 1;
+  iw->tx_stats.syscalls += 1;
   return writev(iw->fd, iw->iov, iovcnt);
 }
 
+static int iwab_emit(struct iwab* iw, char* buffer, ssize_t length, int direct);
+
+// Send the parity frames of the fec group that was just completed
+static int iwab_emit_parity(struct iwab* iw, int direct) {
+  struct iwab_head data_head = iw->wi_h.iw_h;
+  unsigned j;
+  int ret = 0;
+
+  for (j = 0; j < iw->fec->m && ret >= 0; j++) {
+    struct iwab_fec_frame* p = &iw->fec->parity[j];
+
+    iw->wi_h.iw_h.seq = data_head.seq - (iw->fec->k - 1);
+    iw->wi_h.iw_h.fec_index = iw->fec->k + j;
+    iw->wi_h.iw_h.length = p->length_xor;
+    iw->wi_h.iw_h.timestamp = p->timestamp;
+    iw->wi_h.iw_h.retry = 0;
+    ret = iwab_emit(iw, (char*) p->data, p->length, direct);
+  }
+
+  iw->wi_h.iw_h = data_head;
+  return ret;
+}
+
+static int iwab_frame(struct iwab* iw, char* buffer, ssize_t length, uint64_t timestamp, uint8_t retried, int direct) {
+  unsigned index = 0;
+  int ret;
+
+  if (!buffer) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  iwab_update_head(iw, length, timestamp, retried);
+  if (iw->fec && retried == 0) {
+    if (iw->tx_mode == IWAB_TX_MMSG && !direct && iw->fec->index == iw->fec->k && iw->tx_pending > 0 && (ret = iwab_flush(iw)) < 0) {
+      return ret; // the parity buffers of the previous group are still referenced
+    }
+
+    index = iwab_fec_encoder_add(iw->fec, (const uint8_t*) buffer, length, timestamp);
+    iw->wi_h.iw_h.fec_index = index;
+  }
+
+  if ((ret = iwab_emit(iw, buffer, length, direct)) < 0) {
+    return ret;
+  }
+
+  if (iw->fec && retried == 0 && index == iw->fec->k - 1) {
+    int r;
+    if ((r = iwab_emit_parity(iw, direct)) < 0) {
+      return r;
+    }
+  }
+
+  return ret;
+}
+
+int iwab_send(struct iwab* iw, char* buffer, ssize_t length, uint64_t timestamp, uint8_t retried) {
+  return iwab_frame(iw, buffer, length, timestamp, retried, 1);
+}
+
+int iwab_set_fec(struct iwab* iw, unsigned k, unsigned m) {
+  if (iw->tx_pending > 0 || (k > 0 && !iwab_fec_params_valid(k, m))) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  free(iw->fec);
+  iw->fec = NULL;
+  iw->wi_h.iw_h.fec_k = 0;
+  iw->wi_h.iw_h.fec_m = 0;
+  iw->wi_h.iw_h.fec_index = 0;
+
+  if (k == 0) {
+    return 0;
+  }
+
+  if (!(iw->fec = malloc(sizeof(*iw->fec)))) {
+    return -1;
+  }
+
+  iwab_fec_encoder_init(iw->fec, k, m);
+  iw->wi_h.iw_h.fec_k = k;
+  iw->wi_h.iw_h.fec_m = m;
+  return 0;
+}
+
+void iwab_set_codec(struct iwab* iw, uint8_t codec) {
+  iw->wi_h.iw_h.codec = codec;
+}
+
+void iwab_set_channel(struct iwab* iw, uint8_t channel) {
+  iw->wi_h.iw_h.channel = channel;
+}
+
+int iwab_send_format(struct iwab* iw, const struct iwab_format* format) {
+  struct iwab_head data_head = iw->wi_h.iw_h;
+  int direct = iw->tx_mode == IWAB_TX_DIRECT;
+  int ret;
+
+  if (!format) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // keep the seq of the audio frames, and don't let receivers feed the
+  // format to their fec decoder
+  iw->wi_h.iw_h.type = IWAB_FRAME_FORMAT;
+  iw->wi_h.iw_h.length = sizeof(*format);
+  iw->wi_h.iw_h.retry = 0;
+  iw->wi_h.iw_h.fec_k = 0;
+  iw->wi_h.iw_h.fec_m = 0;
+  iw->wi_h.iw_h.fec_index = 0;
+  ret = iwab_emit(iw, (char*) format, sizeof(*format), direct);
+  iw->wi_h.iw_h = data_head;
+
+  if (ret >= 0 && !direct) {
+    // the format is referenced, not copied, in IWAB_TX_MMSG mode
+    ret = iwab_flush(iw);
+  }
+
+  return ret;
+}
+
+static size_t iwab_tx_ring_size(void) {
+  return IWAB_TX_RING_FRAME_SIZE * IWAB_TX_RING_FRAMES;
+}
+
+static int iwab_tx_ring_setup(struct iwab* iw) {
+  struct tpacket_req req;
+  int version = TPACKET_V2;
+  void* ring;
+
+  if (setsockopt(iw->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+    return -1;
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = getpagesize();
+  req.tp_frame_size = IWAB_TX_RING_FRAME_SIZE;
+  req.tp_frame_nr = IWAB_TX_RING_FRAMES;
+  req.tp_block_nr = iwab_tx_ring_size() / req.tp_block_size;
+  if (req.tp_block_nr == 0 || req.tp_block_size % req.tp_frame_size != 0) {
+    errno = EINVAL;
+    return -2;
+  }
+
+  if (setsockopt(iw->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+    return -3;
+  }
+
+  ring = mmap(NULL, iwab_tx_ring_size(), PROT_READ | PROT_WRITE, MAP_SHARED, iw->fd, 0);
+  if (ring == MAP_FAILED) {
+    memset(&req, 0, sizeof(req));
+    setsockopt(iw->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+    return -4;
+  }
+
+  iw->tx_ring = ring;
+  iw->tx_ring_head = 0;
+  return 0;
+}
+
+int iwab_tx_setup(struct iwab* iw, enum iwab_tx_mode mode) {
+  if (!iw || iw->tx_pending > 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (mode == IWAB_TX_RING && !iw->tx_ring && iwab_tx_ring_setup(iw) < 0) {
+    pa_log_warn("Error setting up PACKET_TX_RING : %s, falling back to sendmmsg", strerror(errno));
+    mode = IWAB_TX_MMSG;
+  }
+
+  iw->tx_mode = mode;
+  return mode;
+}
+
+// The data of a tx ring frame starts right after the tpacket header, the
+// kernel doesn't expect the sockaddr_ll part on transmit.
+static uint8_t* iwab_tx_ring_data(struct tpacket2_hdr* hdr) {
+  return (uint8_t*) hdr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+}
+
+static int iwab_queue_ring(struct iwab* iw, char* buffer, ssize_t length) {
+  struct tpacket2_hdr* hdr;
+  uint8_t* data;
+  size_t rt_len = iw->iov[0].iov_len;
+  size_t wi_len = iw->iov[1].iov_len;
+
+  if (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll) + rt_len + wi_len + length > IWAB_TX_RING_FRAME_SIZE) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  hdr = (struct tpacket2_hdr*) (iw->tx_ring + iw->tx_ring_head * IWAB_TX_RING_FRAME_SIZE);
+  if (hdr->tp_status & TP_STATUS_WRONG_FORMAT) {
+    pa_log_warn("Kernel rejected a tx ring frame");
+    hdr->tp_status = TP_STATUS_AVAILABLE;
+  }
+
+  if (hdr->tp_status != TP_STATUS_AVAILABLE) {
+    // the kernel didn't catch up with the ring yet
+    iw->tx_stats.dropped += 1;
+    errno = EAGAIN;
+    return -2;
+  }
+
+  // build the frame in place
+  data = iwab_tx_ring_data(hdr);
+  memcpy(data, iw->rt_h_buff, rt_len);
+  memcpy(data + rt_len, iw->wi_h_buff, wi_len);
+  memcpy(data + rt_len + wi_len, buffer, length);
+  hdr->tp_len = rt_len + wi_len + length;
+  __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+  iw->tx_ring_head = (iw->tx_ring_head + 1) % IWAB_TX_RING_FRAMES;
+  return 0;
+}
+
+static void iwab_queue_mmsg(struct iwab* iw, char* buffer, ssize_t length) {
+  unsigned n = iw->tx_pending;
+
+  iw->tx_hdrs[n] = iw->wi_h;
+  iw->tx_iov[n][0] = iw->iov[0];
+  iw->tx_iov[n][1].iov_base = &iw->tx_hdrs[n];
+  iw->tx_iov[n][1].iov_len = iw->iov[1].iov_len;
+  iw->tx_iov[n][2].iov_base = buffer;
+  iw->tx_iov[n][2].iov_len = length;
+  memset(&iw->tx_msgs[n], 0, sizeof(iw->tx_msgs[n]));
+  iw->tx_msgs[n].msg_hdr.msg_iov = iw->tx_iov[n];
+  iw->tx_msgs[n].msg_hdr.msg_iovlen = 3;
+}
+
+static int iwab_emit(struct iwab* iw, char* buffer, ssize_t length, int direct) {
+  int ret;
+
+  if (direct) {
+    return iwab_write(iw, buffer, length);
+  }
+
+  if (iw->tx_pending >= IWAB_TX_BATCH && (ret = iwab_flush(iw)) < 0) {
+    return ret;
+  }
+
+  if (iw->tx_mode == IWAB_TX_RING) {
+    if ((ret = iwab_queue_ring(iw, buffer, length)) < 0) {
+      return ret;
+    }
+  } else {
+    iwab_queue_mmsg(iw, buffer, length);
+  }
+
+  iw->tx_pending += 1;
+  return length;
+}
+
+int iwab_queue(struct iwab* iw, char* buffer, ssize_t length, uint64_t timestamp, uint8_t retried) {
+  return iwab_frame(iw, buffer, length, timestamp, retried, iw->tx_mode == IWAB_TX_DIRECT);
+}
+
+int iwab_flush(struct iwab* iw) {
+  unsigned sent = 0;
+  int ret;
+
+  if (iw->tx_pending == 0) {
+    return 0;
+  }
+
+  if (iw->tx_mode == IWAB_TX_RING) {
+    iw->tx_stats.syscalls += 1;
+    ret = send(iw->fd, NULL, 0, MSG_DONTWAIT);
+    if (ret < 0 && errno != EAGAIN) {
+      return ret;
+    }
+
+    sent = iw->tx_pending;
+  } else {
+    while (sent < iw->tx_pending) {
+      iw->tx_stats.syscalls += 1;
+      ret = sendmmsg(iw->fd, iw->tx_msgs + sent, iw->tx_pending - sent, 0);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        iw->tx_pending = 0;
+        return ret;
+      }
+
+      sent += ret;
+    }
+  }
+
+  iw->tx_stats.frames += sent;
+  iw->tx_pending = 0;
+  return sent;
+}
+
 static void iwab_setup(struct iwab* iw) {
   memset(iw, 0, sizeof(struct iwab));
   iw->rt_h.head.version = 0;
@@ -127,7 +566,7 @@ static void iwab_setup(struct iwab* iw) {
   iw->wi_h.dot11qos= 0;
   memset(iw->wi_h.l2.src_mac, 0, sizeof(iw->wi_h.l2.src_mac));
   memset(iw->wi_h.l2.dst_mac, 0, sizeof(iw->wi_h.l2.dst_mac));
-  iw->wi_h.l2.ethertype = 0x8454;
+  iw->wi_h.l2.ethertype = IWAB_ETHERTYPE;
 
   // Swag header
   iw->wi_h.iw_h.version = 0;
@@ -136,6 +575,8 @@ static void iwab_setup(struct iwab* iw) {
   iw->wi_h.iw_h.seq = 0; // increment by one for each new packet
   iw->wi_h.iw_h.timestamp = 0;
   iw->wi_h.iw_h.retry = 0; // set if it's a retry
+  iw->wi_h.iw_h.codec = 0; // raw pcm, see iwab_set_codec()
+  iw->wi_h.iw_h.type = IWAB_FRAME_AUDIO;
 
   // Setup iovec
   iw->iov[0].iov_base = iw->rt_h_buff;
@@ -148,9 +589,106 @@ static void iwab_setup(struct iwab* iw) {
 }
 
 int iwab_close(struct iwab* iw) {
+  free(iw->fec);
+  iw->fec = NULL;
+
+  if (iw->tx_ring) {
+    munmap(iw->tx_ring, iwab_tx_ring_size());
+    iw->tx_ring = NULL;
+  }
+
+  if (iw->rx_ring) {
+    munmap(iw->rx_ring, iwab_rx_ring_size());
+    iw->rx_ring = NULL;
+  }
+
   return close(iw->fd);
 }
 
+// Load a 32 or 16 bit word in network order as BPF_LD does
+static uint32_t iwab_filter_word(const uint8_t* b, size_t size) {
+  uint32_t w = 0;
+  size_t n;
+
+  for (n = 0; n < size; n++) {
+    w = (w << 8) | b[n];
+  }
+
+  return w;
+}
+
+void iwab_filter_build(struct iwab* iw, struct sock_filter* prog) {
+  const uint16_t ethertype = IWAB_ETHERTYPE;
+  const size_t addr_off[3] = {
+    offsetof(struct ieee80211_head, addr1),
+    offsetof(struct ieee80211_head, addr2),
+    offsetof(struct ieee80211_head, addr3),
+  };
+  // the ieee80211 fields are relative to the end of the radiotap header,
+  // whose length is kept in X
+  const uint32_t ethertype_off = offsetof(struct headers, l2) + offsetof(struct l2_head, ethertype);
+  const uint32_t min_len = sizeof(struct headers) + 4; // + FCS, and at least one payload byte
+  unsigned n = 0, i;
+
+#define REJECT (IWAB_FILTER_LEN - 1 - (n + 1))
+  // X = radiotap length, which is little endian
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_B | BPF_ABS, offsetof(struct radiotap_head, length) + 1);
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8);
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_B | BPF_ABS, offsetof(struct radiotap_head, length));
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0);
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);
+  // an out of bound load ends the program and drops the frame, use that
+  // to check the frame length
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_B | BPF_IND, min_len);
+  // qos data frame, whatever the version bits
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0);
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xfc);
+  prog[n] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (8 << 4) | (2 << 2), 0, REJECT); n++;
+  for (i = 0; i < 3; i++) {
+    prog[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_IND, addr_off[i]);
+    prog[n] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, iwab_filter_word(iw->addr_filter, 4), 0, REJECT); n++;
+    prog[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_IND, addr_off[i] + 4);
+    prog[n] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, iwab_filter_word(iw->addr_filter + 4, 2), 0, REJECT); n++;
+  }
+
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_IND, ethertype_off);
+  prog[n] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, iwab_filter_word((const uint8_t*) &ethertype, 2), 0, REJECT); n++;
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+  prog[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+#undef REJECT
+}
+
+int iwab_attach_filter(struct iwab* iw) {
+  struct sock_filter prog[IWAB_FILTER_LEN];
+  struct sock_fprog fprog;
+
+  iwab_filter_build(iw, prog);
+  fprog.len = IWAB_FILTER_LEN;
+  fprog.filter = prog;
+  return setsockopt(iw->fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+}
+
+int iwab_set_rcvbuf(struct iwab* iw, int size) {
+  if (setsockopt(iw->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(int)) < 0) {
+    printf("Error setting receive buffer size : %s\n", strerror(errno));
+    return -1;
+  }
+
+  return 0;
+}
+
+int iwab_open_fd(struct iwab* iw, int fd) {
+  if (!iw || fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  iwab_setup(iw);
+  iw->fd = fd;
+  return 0;
+}
+
 int iwab_open(struct iwab* iw, const char* iface) {
   struct sockaddr_ll sll;
   struct ifreq ifr;
@@ -183,12 +721,7 @@ int iwab_open(struct iwab* iw, const char* iface) {
     return -4;
   }
 
-  int max_rcv_size = 1600;
-  if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &max_rcv_size, sizeof(int)) < 0) {
-    printf("Error setting receive buffer size : %s\n", strerror(errno));
-  }
-
-  iwab_setup(iw);
-  iw->fd = fd;
+  iwab_open_fd(iw, fd);
+  iwab_set_rcvbuf(iw, IWAB_DEFAULT_RCVBUF);
   return 0;
 }
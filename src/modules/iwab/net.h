@@ -2,8 +2,21 @@
 #define _NET_H_
 
 #include <stdint.h>
+#include <linux/filter.h>
+#include <sys/socket.h>
 #include <sys/uio.h>
 
+#define IWAB_TX_BATCH 8 // max number of frames queued between two iwab_flush()
+#define IWAB_TX_RING_FRAME_SIZE 2048
+#define IWAB_TX_RING_FRAMES 16
+#define IWAB_RX_RING_BLOCK_SIZE (1 << 15)
+#define IWAB_RX_RING_BLOCKS 16
+#define IWAB_RX_RING_TIMEOUT_MS 1 // a partially filled block is handed to userspace after this
+#define IWAB_DEFAULT_RCVBUF 1600
+#define IWAB_ETHERTYPE 0x8454
+#define IWAB_FILTER_LEN 26 // number of instructions of the socket filter
+#define IWAB_MAX_CHANNELS 32 // audio channels of a stream, PA_CHANNELS_MAX
+
 enum radiotap_flags {
 	RADIOTAP_TSFT = 1 << 0,
 	RADIOTAP_FLAGS = 1 << 1,
@@ -66,14 +79,35 @@ struct l2_head {
   uint16_t ethertype;
 }__attribute__((packed));
 
+enum iwab_frame_type {
+  IWAB_FRAME_AUDIO = 0,
+  IWAB_FRAME_FORMAT, // the payload is a struct iwab_format
+};
+
 struct iwab_head {
   uint8_t version;
-  uint8_t channel;
+  uint8_t channel; // stream id, receivers demultiplex streams on it
   uint16_t length;
   uint32_t seq;
   uint64_t timestamp;
   uint8_t retry;
-  uint8_t pad[7]; // align on 64bit boundary
+  uint8_t fec_k; // data frames per fec group, 0 when fec is disabled
+  uint8_t fec_m; // parity frames per fec group
+  uint8_t fec_index; // index in the fec group, parity frames come after the k data frames
+  uint8_t codec; // payload codec, see codec-api.h
+  uint8_t type; // enum iwab_frame_type
+  uint8_t pad[2]; // align on 64bit boundary
+}__attribute__((packed));
+
+// Format of a stream, advertised in band by the sender. Format frames don't
+// consume a sequence number and aren't fec protected, they are repeated
+// instead.
+struct iwab_format {
+  uint8_t format; // pa_sample_format_t
+  uint8_t channels;
+  uint8_t pad[2];
+  uint32_t rate;
+  uint8_t map[IWAB_MAX_CHANNELS]; // pa_channel_position_t of each channel
 }__attribute__((packed));
 
 struct headers {
@@ -83,6 +117,26 @@ struct headers {
   struct iwab_head iw_h;
 }__attribute__((packed));
 
+enum iwab_tx_mode {
+  IWAB_TX_DIRECT = 0, // one writev() per frame
+  IWAB_TX_MMSG, // frames are batched and sent with a single sendmmsg()
+  IWAB_TX_RING, // frames are built in a mmap'ed PACKET_TX_RING and sent with a single kick
+};
+
+struct iwab_tx_stats {
+  uint64_t frames;
+  uint64_t syscalls;
+  uint64_t dropped; // frames that didn't fit in the tx ring
+};
+
+struct iwab_rx_stats {
+  uint64_t frames; // frames found in the rx ring
+  uint64_t filtered; // non iwab frames skipped in the ring
+  uint64_t drops; // frames dropped by the kernel, updated by iwab_rx_update_stats()
+};
+
+struct iwab_fec_encoder;
+
 struct iwab {
   int fd;
   // the following pointers are used when receiving,
@@ -102,11 +156,67 @@ struct iwab {
   };
   struct iovec iov[3]; //Fixed headers, body
   uint8_t addr_filter[6];
+  // batched transmit state, see iwab_tx_setup()
+  enum iwab_tx_mode tx_mode;
+  unsigned tx_pending;
+  struct iwab_tx_stats tx_stats;
+  uint8_t* tx_ring;
+  unsigned tx_ring_head;
+  struct mmsghdr tx_msgs[IWAB_TX_BATCH];
+  struct iovec tx_iov[IWAB_TX_BATCH][3];
+  struct headers tx_hdrs[IWAB_TX_BATCH];
+  // mmap'ed receive state, see iwab_rx_setup()
+  uint8_t* rx_ring;
+  unsigned rx_block;
+  int rx_in_block;
+  uint8_t* rx_frame;
+  unsigned rx_frames_left;
+  struct iwab_rx_stats rx_stats;
+  // forward error correction of sent frames, see iwab_set_fec()
+  struct iwab_fec_encoder* fec;
 };
 
 int iwab_open(struct iwab* iw, const char *iface);
+// Setup iw on an already opened socket, this is mostly useful for tests.
+int iwab_open_fd(struct iwab* iw, int fd);
+int iwab_set_rcvbuf(struct iwab* iw, int size);
+// Build the classic BPF program equivalent to the checks of iwab_read() in
+// prog, which must hold IWAB_FILTER_LEN instructions.
+void iwab_filter_build(struct iwab* iw, struct sock_filter* prog);
+// Attach that program to the socket so that the kernel drops non iwab
+// frames before they wake us up.
+int iwab_attach_filter(struct iwab* iw);
 int iwab_close(struct iwab* iw);
 int iwab_send(struct iwab* iw, char* buffer, ssize_t length, uint64_t timestamp, uint8_t retried);
+// Select how frames queued with iwab_queue() are sent. Returns the mode
+// actually in use: IWAB_TX_RING falls back to IWAB_TX_MMSG if the kernel
+// refuses to setup the ring.
+int iwab_tx_setup(struct iwab* iw, enum iwab_tx_mode mode);
+// Queue a frame for the next iwab_flush(). In IWAB_TX_MMSG mode buffer is
+// referenced, not copied, and must stay valid until the flush. In
+// IWAB_TX_DIRECT mode the frame is sent right away.
+int iwab_queue(struct iwab* iw, char* buffer, ssize_t length, uint64_t timestamp, uint8_t retried);
+int iwab_flush(struct iwab* iw);
+// Protect sent frames with k data + m parity frames fec groups instead of
+// relying on resends, k = 0 disables fec.
+int iwab_set_fec(struct iwab* iw, unsigned k, unsigned m);
+// Tag sent frames with the id of the codec their payload is encoded with.
+void iwab_set_codec(struct iwab* iw, uint8_t codec);
+// Tag sent frames with the id of their stream.
+void iwab_set_channel(struct iwab* iw, uint8_t channel);
+// Send a format frame describing the stream, queued frames are sent first.
+int iwab_send_format(struct iwab* iw, const struct iwab_format* format);
 ssize_t iwab_read(struct iwab* iw, char* buffer, ssize_t max_length, size_t* data_offset);
+// Map a TPACKET_V3 receive ring on the socket, iwab_ring_read() must then
+// be used instead of iwab_read().
+int iwab_rx_setup(struct iwab* iw);
+// Return the length of the next iwab payload pending in the ring and point
+// payload to it, skipping non iwab frames. The payload and the iw->*_in
+// headers stay valid until the next call. Returns -1 with errno set to
+// EAGAIN once the ring is drained.
+ssize_t iwab_ring_read(struct iwab* iw, const char** payload);
+// Number of ring blocks currently handed to userspace.
+unsigned iwab_rx_ring_occupancy(struct iwab* iw);
+int iwab_rx_update_stats(struct iwab* iw);
 
 #endif
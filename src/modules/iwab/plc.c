@@ -0,0 +1,227 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plc.h"
+
+int iwab_plc_init(struct iwab_plc *plc, enum iwab_plc_mode mode, unsigned rate, unsigned channels, unsigned max_msec) {
+    size_t size;
+
+    memset(plc, 0, sizeof(*plc));
+    if (rate < 8000 || channels == 0 || max_msec == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    plc->mode = mode;
+    plc->channels = channels;
+    plc->min_lag = rate / 400; // 2.5ms, 400Hz
+    plc->max_lag = rate / 50; // 20ms, 50Hz
+    plc->window = rate / 125; // 8ms
+    plc->overlap = rate / 500; // 2ms
+    plc->hold = rate / 100;
+    plc->fade = rate / 50;
+    plc->crossfade = rate / 200;
+    plc->max_conceal = (size_t) rate * max_msec / 1000;
+    plc->history = plc->max_lag * 2 + plc->window;
+
+    /* A whole period may be synthesised past the gap and its crossfade */
+    size = plc->history + plc->max_conceal + plc->crossfade + plc->max_lag;
+    plc->buffer = calloc(size * channels, sizeof(int16_t));
+    plc->tail = calloc(plc->crossfade * channels, sizeof(int16_t));
+    if (!plc->buffer || !plc->tail) {
+        iwab_plc_done(plc);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+void iwab_plc_done(struct iwab_plc *plc) {
+    free(plc->buffer);
+    free(plc->tail);
+    plc->buffer = NULL;
+    plc->tail = NULL;
+}
+
+static void history_append(struct iwab_plc *plc, const int16_t *data, size_t frames) {
+    size_t c = plc->channels;
+
+    if (frames >= plc->history)
+        memcpy(plc->buffer, data + (frames - plc->history) * c, plc->history * c * sizeof(int16_t));
+    else {
+        memmove(plc->buffer, plc->buffer + frames * c, (plc->history - frames) * c * sizeof(int16_t));
+        memcpy(plc->buffer + (plc->history - frames) * c, data, frames * c * sizeof(int16_t));
+    }
+
+    plc->filled += frames;
+    if (plc->filled > plc->history)
+        plc->filled = plc->history;
+}
+
+void iwab_plc_feed(struct iwab_plc *plc, int16_t *data, size_t frames) {
+    size_t c = plc->channels, n = plc->tail_frames < frames ? plc->tail_frames : frames;
+    size_t f, ch;
+
+    for (f = 0; f < n; f++) {
+        float w = (float) (f + 1) / (float) (n + 1);
+
+        for (ch = 0; ch < c; ch++) {
+            float v = plc->tail[f * c + ch] * (1.0f - w) + data[f * c + ch] * w;
+            data[f * c + ch] = (int16_t) lrintf(v);
+        }
+    }
+
+    plc->tail_frames = 0;
+    plc->concealed = 0;
+    history_append(plc, data, frames);
+}
+
+/* Sum of the channels of frame f */
+static float mono(const struct iwab_plc *plc, size_t f) {
+    const int16_t *p = plc->buffer + f * plc->channels;
+    float v = 0;
+    unsigned ch;
+
+    for (ch = 0; ch < plc->channels; ch++)
+        v += p[ch];
+
+    return v;
+}
+
+/* Find the period lag for which the audio preceding pos - lag best matches
+ * the audio preceding pos, its continuation then extends the signal */
+static size_t find_lag(const struct iwab_plc *plc, size_t pos) {
+    size_t lag, best = plc->max_lag, i;
+    float best_score = 0;
+
+    for (lag = plc->min_lag; lag <= plc->max_lag; lag++) {
+        float dot = 0, energy = 0, score;
+
+        for (i = pos - plc->window; i < pos; i++) {
+            float a = mono(plc, i), b = mono(plc, i - lag);
+
+            dot += a * b;
+            energy += b * b;
+        }
+
+        if (dot <= 0 || energy <= 0)
+            continue;
+
+        /* Squared normalised correlation, negative correlations were
+         * skipped */
+        score = dot * dot / energy;
+        if (score > best_score) {
+            best_score = score;
+            best = lag;
+        }
+    }
+
+    return best;
+}
+
+/* Extend the history past pos by one period, returns its length */
+static size_t extend(struct iwab_plc *plc, size_t pos) {
+    size_t c = plc->channels, lag, j, ch;
+    int16_t *buf = plc->buffer;
+
+    lag = plc->mode == IWAB_PLC_WSOLA ? find_lag(plc, pos) : plc->max_lag;
+
+    /* Blend the end of the previous synthesised period into the audio
+     * preceding the new one, received audio is left untouched */
+    if (pos > plc->history) {
+        for (j = 0; j < plc->overlap; j++) {
+            float w = (float) (j + 1) / (float) (plc->overlap + 1);
+            size_t d = pos - plc->overlap + j, s = d - lag;
+
+            for (ch = 0; ch < c; ch++)
+                buf[d * c + ch] = (int16_t) lrintf(buf[d * c + ch] * (1.0f - w) + buf[s * c + ch] * w);
+        }
+    }
+
+    memcpy(buf + pos * c, buf + (pos - lag) * c, lag * c * sizeof(int16_t));
+
+    return lag;
+}
+
+static float gain(const struct iwab_plc *plc, size_t f) {
+    size_t end;
+
+    if (plc->mode == IWAB_PLC_FADE) {
+        end = plc->fade < plc->max_conceal ? plc->fade : plc->max_conceal;
+        return f < end ? 1.0f - (float) f / (float) end : 0.0f;
+    }
+
+    if (f < plc->hold)
+        return 1.0f;
+
+    if (f >= plc->max_conceal || plc->max_conceal <= plc->hold)
+        return 0.0f;
+
+    return 1.0f - (float) (f - plc->hold) / (float) (plc->max_conceal - plc->hold);
+}
+
+size_t iwab_plc_conceal(struct iwab_plc *plc, int16_t *out, size_t frames) {
+    size_t c = plc->channels, pos, f, ch;
+
+    if (frames > plc->max_conceal - plc->concealed)
+        frames = plc->max_conceal - plc->concealed;
+
+    if (frames == 0)
+        return 0;
+
+    /* Not enough audio received yet to extend it */
+    if (plc->filled < plc->history) {
+        memset(out, 0, frames * c * sizeof(int16_t));
+        memset(plc->tail, 0, plc->crossfade * c * sizeof(int16_t));
+        plc->tail_frames = plc->crossfade;
+        plc->concealed += frames;
+        plc->total += frames;
+        return frames;
+    }
+
+    for (pos = plc->history; pos < plc->history + frames + plc->crossfade;)
+        pos += extend(plc, pos);
+
+    for (f = 0; f < frames + plc->crossfade; f++) {
+        float g = gain(plc, plc->concealed + f);
+        const int16_t *s = plc->buffer + (plc->history + f) * c;
+        int16_t *d = f < frames ? out + f * c : plc->tail + (f - frames) * c;
+
+        for (ch = 0; ch < c; ch++)
+            d[ch] = (int16_t) lrintf(s[ch] * g);
+    }
+
+    plc->tail_frames = plc->crossfade;
+    plc->concealed += frames;
+    plc->total += frames;
+
+    /* A following gap, without received audio in between, goes on from
+     * here */
+    history_append(plc, out, frames);
+
+    return frames;
+}
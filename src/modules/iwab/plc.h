@@ -0,0 +1,68 @@
+#ifndef fooiwabplchfoo
+#define fooiwabplchfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Packet loss concealment on interleaved native endian s16 audio.
+ *
+ * The last received audio is kept as history. A gap is filled by extending
+ * that history: IWAB_PLC_FADE replays its last 20ms while fading to silence,
+ * IWAB_PLC_WSOLA repeats pitch periods chosen by waveform similarity and
+ * overlap-adds them, then fades out towards the concealment cap. The audio
+ * synthesised past the gap is crossfaded into the next received data. */
+
+enum iwab_plc_mode {
+    IWAB_PLC_FADE,
+    IWAB_PLC_WSOLA,
+};
+
+/* All lengths are in frames */
+struct iwab_plc {
+    enum iwab_plc_mode mode;
+    unsigned channels;
+    size_t min_lag, max_lag; // pitch period search range
+    size_t window; // length of the similarity window
+    size_t overlap; // overlap-add length between two periods
+    size_t hold; // full level concealment, wsola only
+    size_t fade; // fade to silence length, fade only
+    size_t crossfade;
+    size_t max_conceal; // cap per gap, the concealed audio has faded out by then
+    size_t history;
+    size_t filled; // received frames in the history, up to history
+    int16_t *buffer; // history, followed by room for synthesis
+    int16_t *tail; // continuation of the concealed audio
+    size_t tail_frames;
+    size_t concealed; // frames concealed in the current gap
+    uint64_t total; // frames concealed overall
+};
+
+int iwab_plc_init(struct iwab_plc *plc, enum iwab_plc_mode mode, unsigned rate, unsigned channels, unsigned max_msec);
+void iwab_plc_done(struct iwab_plc *plc);
+
+/* Account received audio, crossfading its start in place with the end of a
+ * preceding concealment */
+void iwab_plc_feed(struct iwab_plc *plc, int16_t *data, size_t frames);
+
+/* Fill a gap of frames, returns the number of frames written to out which
+ * is smaller when the cap for this gap is reached */
+size_t iwab_plc_conceal(struct iwab_plc *plc, int16_t *out, size_t frames);
+
+#endif
@@ -0,0 +1,148 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "rx.h"
+
+void iwab_rx_init(struct iwab_rx *rx, pa_usec_t now) {
+    pa_assert(rx);
+
+    memset(rx, 0, sizeof(*rx));
+    rx->smoother = pa_smoother_new(PA_USEC_PER_SEC, 6*PA_USEC_PER_SEC, true, true, 10, now, true);
+}
+
+void iwab_rx_done(struct iwab_rx *rx) {
+    pa_assert(rx);
+
+    if (rx->smoother)
+        pa_smoother_free(rx->smoother);
+
+    rx->smoother = NULL;
+}
+
+bool iwab_rx_check_restart(struct iwab_rx *rx, uint32_t seq, uint64_t timestamp) {
+    pa_assert(rx);
+
+    if (!rx->started)
+        return false;
+
+    /* Late frames are behind in both sequence and time. Frames going back
+     * in sequence but not in time, or going back a lot in time, belong to a
+     * new stream. */
+    if (((int32_t) (seq - rx->seqnb) <= 0 && timestamp >= rx->last_pb_ts)
+            || timestamp + IWAB_RX_TIMELINE_JUMP < rx->last_pb_ts) {
+        pa_log_info("Sender restarted its stream, seq %u after %u", seq, rx->seqnb);
+        rx->started = false;
+        return true;
+    }
+
+    return false;
+}
+
+bool iwab_rx_frame_is_new(struct iwab_rx *rx, uint32_t seq, uint64_t timestamp) {
+    pa_assert(rx);
+
+    if (!rx->started)
+        return true;
+
+    if (seq == rx->seqnb) {
+        // this is a repeat packet
+        return false;
+    }
+
+    if ((int32_t) (seq - rx->seqnb) < 0) {
+        pa_log("Packet disordered. Previous seq : %u, last seq : %u, rewind : %u",
+                rx->seqnb, seq, rx->seqnb - seq);
+        return false;
+    }
+
+    if (timestamp < rx->last_pb_ts) {
+        pa_log("Timestamps disordered. Previous ts : %" PRIu64 ", last ts : %" PRIu64 ", rewind : %" PRIu64,
+                rx->last_pb_ts, timestamp, rx->last_pb_ts - timestamp);
+        return false;
+    }
+
+    return true;
+}
+
+pa_usec_t iwab_rx_push(struct iwab_rx *rx, uint32_t seq, uint64_t timestamp, pa_usec_t duration) {
+    pa_usec_t missing = 0;
+
+    pa_assert(rx);
+
+    /* Frames skipped in sequence without a gap in time leave nothing to
+     * fill */
+    if (rx->started && seq != rx->seqnb + 1 && timestamp > rx->last_pb_ts)
+        missing = timestamp - rx->last_pb_ts;
+
+    rx->lost += missing;
+    rx->started = true;
+    rx->seqnb = seq;
+    rx->last_pb_ts = timestamp + duration;
+
+    return missing;
+}
+
+void iwab_rx_update_timing(struct iwab_rx *rx, uint64_t timestamp, pa_usec_t now) {
+    int64_t transit = (int64_t) (now - timestamp);
+    int64_t d;
+
+    pa_assert(rx);
+
+    d = transit - rx->last_transit;
+    if (rx->ts_base == 0 || d > (int64_t) IWAB_RX_TIMELINE_JUMP || d < -(int64_t) IWAB_RX_TIMELINE_JUMP) {
+        pa_smoother_reset(rx->smoother, now, false);
+        rx->ts_base = timestamp;
+        rx->slot_end = now + IWAB_RX_SMOOTHER_SLOT;
+        rx->slot_used = false;
+        rx->timeline++;
+        d = 0;
+    }
+
+    rx->last_transit = transit;
+
+    /* J += (|D| - J) / 16, the difference is negative whenever the transit
+     * time varies less than it used to */
+    rx->jitter = (pa_usec_t) ((int64_t) rx->jitter + ((d < 0 ? -d : d) - (int64_t) rx->jitter) / 16);
+
+    if (!rx->slot_used || transit < rx->slot_transit) {
+        rx->slot_x = now;
+        rx->slot_y = timestamp - rx->ts_base;
+        rx->slot_transit = transit;
+        rx->slot_used = true;
+    }
+
+    if (now >= rx->slot_end) {
+        pa_smoother_put(rx->smoother, rx->slot_x, rx->slot_y);
+        rx->slot_end = now + IWAB_RX_SMOOTHER_SLOT;
+        rx->slot_used = false;
+    }
+}
+
+pa_usec_t iwab_rx_get_remote(struct iwab_rx *rx, pa_usec_t now) {
+    pa_assert(rx);
+
+    return rx->ts_base ? pa_smoother_get(rx->smoother, now) : 0;
+}
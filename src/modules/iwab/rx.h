@@ -0,0 +1,82 @@
+#ifndef fooiwabrxhfoo
+#define fooiwabrxhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/time-smoother.h>
+
+/* Receive side of one iwab stream, kept by the rx thread of
+ * module-iwab-input.
+ *
+ * Frames are handed out in sequence order, repeated and disordered ones are
+ * dropped and the sender time missing between two frames is reported for
+ * concealment. A sender that restarts its stream starts over from a lower
+ * sequence number, which is told apart from late frames by its timestamp.
+ *
+ * The arrival time of each frame is tracked against its sender timestamp:
+ * the interarrival jitter sizes the jitter buffer, and the least delayed
+ * arrival of every slot feeds the drift estimator. */
+
+#define IWAB_RX_SMOOTHER_SLOT (100*PA_USEC_PER_MSEC) // one drift sample per slot
+#define IWAB_RX_TIMELINE_JUMP PA_USEC_PER_SEC // the sender restarted its stream
+
+struct iwab_rx {
+    bool started;
+    uint32_t seqnb; // last frame handed out
+    uint64_t last_pb_ts; // sender time at the end of that frame
+    pa_usec_t lost; // sender time missing from the stream
+
+    pa_smoother *smoother; // sender timestamps against local time
+    uint64_t ts_base; // sender timestamp at the smoother origin
+    int64_t last_transit;
+    pa_usec_t jitter; // interarrival jitter, as in RFC 3550
+    pa_usec_t slot_end;
+    pa_usec_t slot_x, slot_y;
+    int64_t slot_transit;
+    bool slot_used;
+    unsigned timeline; // bumped each time the sender timeline jumps
+};
+
+void iwab_rx_init(struct iwab_rx *rx, pa_usec_t now);
+void iwab_rx_done(struct iwab_rx *rx);
+
+/* Check the header of a data frame before it is reordered or repaired.
+ * Returns true if the sender restarted its stream, the sequence starts over
+ * then and the caller has to reset the state that depends on it. */
+bool iwab_rx_check_restart(struct iwab_rx *rx, uint32_t seq, uint64_t timestamp);
+
+/* Returns false for repeated or disordered frames */
+bool iwab_rx_frame_is_new(struct iwab_rx *rx, uint32_t seq, uint64_t timestamp);
+
+/* Hand out a new frame lasting duration, returns the sender time missing
+ * before it */
+pa_usec_t iwab_rx_push(struct iwab_rx *rx, uint32_t seq, uint64_t timestamp, pa_usec_t duration);
+
+/* Account the arrival at local time now of a frame with the given sender
+ * timestamp */
+void iwab_rx_update_timing(struct iwab_rx *rx, uint64_t timestamp, pa_usec_t now);
+
+/* Sender clock estimate at local time now, 0 before the first frame */
+pa_usec_t iwab_rx_get_remote(struct iwab_rx *rx, pa_usec_t now);
+
+#endif
@@ -401,6 +401,15 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
                          (unsigned) pa_atomic_load(&mstat->n_allocated_by_type[k]),
                          (unsigned) pa_atomic_load(&mstat->n_accumulated_by_type[k]));
 
+    for (k = 0; k < mstat->n_slot_classes; k++)
+        pa_strbuf_printf(buf,
+                         "Memory pool slots of size %s: %u/%u in use, %u accumulated, %u times full.\n",
+                         pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) mstat->slot_class_size[k]),
+                         (unsigned) pa_atomic_load(&mstat->n_allocated_by_class[k]),
+                         mstat->slot_class_n_slots[k],
+                         (unsigned) pa_atomic_load(&mstat->n_accumulated_by_class[k]),
+                         (unsigned) pa_atomic_load(&mstat->n_full_by_class[k]));
+
     return 0;
 }
 
@@ -588,6 +588,8 @@ char *pa_sink_input_list_to_string(pa_core *c) {
 
         pa_xfree(volume_str);
 
+        if (i->sink->thread_info.render_pool)
+            pa_strbuf_printf(s, "\trender time: %0.3f ms\n", (double) pa_sink_input_get_render_time(i) / PA_USEC_PER_MSEC);
         if (i->module)
             pa_strbuf_printf(s, "\tmodule: %u\n", i->module->index);
         if (i->client)
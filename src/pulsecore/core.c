@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <signal.h>
 
 #include <pulse/rtclock.h>
@@ -38,6 +39,7 @@
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
@@ -104,17 +106,21 @@ static int core_message_handler(const char *object_path, const char *message, ch
     return -PA_ERR_NOTIMPLEMENTED;
 }
 
-pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size) {
+pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size,
+                     const size_t *mempool_slot_sizes, unsigned n_mempool_slot_sizes,
+                     pa_shm_flags_t mempool_shm_flags, int mempool_numa_node) {
     pa_core* c;
     pa_mempool *pool;
     pa_mem_type_t type;
     int j;
 
     pa_assert(m);
+    pa_assert(n_mempool_slot_sizes <= PA_MEMPOOL_SLOT_CLASSES_MAX);
 
     if (shared) {
         type = (enable_memfd) ? PA_MEM_TYPE_SHARED_MEMFD : PA_MEM_TYPE_SHARED_POSIX;
-        if (!(pool = pa_mempool_new(type, shm_size, false))) {
+        if (!(pool = pa_mempool_new_full(type, shm_size, false, mempool_slot_sizes, n_mempool_slot_sizes,
+                                         mempool_shm_flags, mempool_numa_node))) {
             pa_log_warn("Failed to allocate %s memory pool. Falling back to a normal memory pool.",
                         pa_mem_type_to_string(type));
             shared = false;
@@ -122,7 +128,8 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     }
 
     if (!shared) {
-        if (!(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, shm_size, false))) {
+        if (!(pool = pa_mempool_new_full(PA_MEM_TYPE_PRIVATE, shm_size, false, mempool_slot_sizes, n_mempool_slot_sizes,
+                                         mempool_shm_flags, mempool_numa_node))) {
             pa_log("pa_mempool_new() failed.");
             return NULL;
         }
@@ -173,6 +180,9 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
 
     c->mempool = pool;
     c->shm_size = shm_size;
+    c->n_mempool_slot_sizes = n_mempool_slot_sizes;
+    if (n_mempool_slot_sizes > 0)
+        memcpy(c->mempool_slot_sizes, mempool_slot_sizes, n_mempool_slot_sizes * sizeof(size_t));
     pa_silence_cache_init(&c->silence_cache);
 
     c->exit_event = NULL;
@@ -192,8 +202,12 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->remixing_produce_lfe = false;
     c->remixing_consume_lfe = false;
     c->lfe_crossover_freq = 0;
+    c->render_workers = 0;
     c->deferred_volume = true;
+    c->float_mixing = false;
+    c->float_mixing_dither = true;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
+    c->cpu_info.x86_max_tier = PA_CPU_X86_TIER_MAX;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
         pa_hook_init(&c->hooks[j], c);
@@ -266,6 +280,7 @@ static void core_free(pa_object *o) {
     pa_xfree(c->configured_default_sink);
 
     pa_silence_cache_done(&c->silence_cache);
+    pa_resampler_flush_cache();
     pa_mempool_unref(c->mempool);
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
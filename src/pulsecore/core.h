@@ -189,6 +189,7 @@ struct pa_core {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
+    unsigned render_workers;
 
     pa_defer_event *module_defer_unload_event;
     pa_hashmap *modules_pending_unload; /* pa_module -> pa_module (hashmap-as-a-set) */
@@ -205,6 +206,10 @@ struct pa_core {
      * or PA daemon defaults (~ 64 MiB). */
     size_t shm_size;
 
+    /* Slot size classes of the memory pools, none for the default */
+    size_t mempool_slot_sizes[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    unsigned n_mempool_slot_sizes;
+
     pa_silence_cache silence_cache;
 
     pa_time_event *exit_event;
@@ -224,6 +229,8 @@ struct pa_core {
     bool remixing_produce_lfe:1;
     bool remixing_consume_lfe:1;
     bool deferred_volume:1;
+    bool float_mixing:1;
+    bool float_mixing_dither:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
@@ -243,7 +250,9 @@ enum {
     PA_CORE_MESSAGE_MAX
 };
 
-pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size);
+pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size,
+                     const size_t *mempool_slot_sizes, unsigned n_mempool_slot_sizes,
+                     pa_shm_flags_t mempool_shm_flags, int mempool_numa_node);
 
 void pa_core_set_configured_default_sink(pa_core *core, const char *sink);
 void pa_core_set_configured_default_source(pa_core *core, const char *source);
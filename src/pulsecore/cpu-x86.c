@@ -28,14 +28,31 @@
 #include <cpuid.h>
 #endif
 
+#include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
 
 #include "cpu-x86.h"
 
+#if (defined(__i386__) || defined(__amd64__)) && defined(HAVE_CPUID_H)
+/* XCR0 state components: SSE, AVX, and opmask/ZMM for AVX-512 */
+#define XCR0_AVX 0x06
+#define XCR0_AVX512 0xe6
+
+/* Read XCR0, only valid if CPUID reports OSXSAVE */
+static uint64_t xgetbv(void) {
+    uint32_t eax, edx;
+
+    __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+
+    return ((uint64_t) edx << 32) | eax;
+}
+#endif
+
 void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
 #if (defined(__i386__) || defined(__amd64__)) && defined(HAVE_CPUID_H)
     uint32_t eax, ebx, ecx, edx;
     uint32_t level;
+    uint64_t xcr0 = 0;
 
     *flags = 0;
 
@@ -70,6 +87,35 @@ void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
 
         if (ecx & (1<<20))
           *flags |= PA_CPU_X86_SSE4_2;
+
+        /* The VEX encoded extensions also need the OS to save the YMM
+         * registers, and AVX-512 the opmask and ZMM registers */
+        if (ecx & (1<<27))
+            xcr0 = xgetbv();
+
+        if ((ecx & (1<<28)) && (xcr0 & XCR0_AVX) == XCR0_AVX) {
+            *flags |= PA_CPU_X86_AVX;
+
+            if (ecx & (1<<12))
+              *flags |= PA_CPU_X86_FMA;
+
+            if (ecx & (1<<29))
+              *flags |= PA_CPU_X86_F16C;
+        }
+    }
+
+    if (level >= 7 && (*flags & PA_CPU_X86_AVX)) {
+        __cpuid_count(0x00000007, 0, eax, ebx, ecx, edx);
+
+        if (ebx & (1<<5))
+          *flags |= PA_CPU_X86_AVX2;
+
+        if ((ebx & (1<<16)) && (xcr0 & XCR0_AVX512) == XCR0_AVX512) {
+            *flags |= PA_CPU_X86_AVX512F;
+
+            if (ebx & (1<<30))
+              *flags |= PA_CPU_X86_AVX512BW;
+        }
     }
 
     /* get extended level */
@@ -94,7 +140,7 @@ void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
     }
 
 finish:
-    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s",
+    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s",
     (*flags & PA_CPU_X86_CMOV) ? "CMOV " : "",
     (*flags & PA_CPU_X86_MMX) ? "MMX " : "",
     (*flags & PA_CPU_X86_SSE) ? "SSE " : "",
@@ -103,27 +149,127 @@ finish:
     (*flags & PA_CPU_X86_SSSE3) ? "SSSE3 " : "",
     (*flags & PA_CPU_X86_SSE4_1) ? "SSE4_1 " : "",
     (*flags & PA_CPU_X86_SSE4_2) ? "SSE4_2 " : "",
+    (*flags & PA_CPU_X86_AVX) ? "AVX " : "",
+    (*flags & PA_CPU_X86_AVX2) ? "AVX2 " : "",
+    (*flags & PA_CPU_X86_FMA) ? "FMA " : "",
+    (*flags & PA_CPU_X86_F16C) ? "F16C " : "",
+    (*flags & PA_CPU_X86_AVX512F) ? "AVX512F " : "",
+    (*flags & PA_CPU_X86_AVX512BW) ? "AVX512BW " : "",
     (*flags & PA_CPU_X86_MMXEXT) ? "MMXEXT " : "",
     (*flags & PA_CPU_X86_3DNOW) ? "3DNOW " : "",
     (*flags & PA_CPU_X86_3DNOWEXT) ? "3DNOWEXT " : "");
 #endif /* (defined(__i386__) || defined(__amd64__)) && defined(HAVE_CPUID_H) */
 }
 
-bool pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
+/* What a CPU needs on top of the tier below to be of a tier. The AVX2
+ * functions don't use FMA, which is only passed on at that tier. No
+ * function is set up for the AVX-512 tier yet, capping the tier there or
+ * at avx2 makes no difference for now. */
+static const pa_cpu_x86_flag_t tier_flags[PA_CPU_X86_TIER_MAX + 1] = {
+    [PA_CPU_X86_TIER_NONE]   = 0,
+    [PA_CPU_X86_TIER_SSE]    = PA_CPU_X86_MMX,
+    [PA_CPU_X86_TIER_AVX]    = PA_CPU_X86_AVX,
+    [PA_CPU_X86_TIER_AVX2]   = PA_CPU_X86_AVX2,
+    [PA_CPU_X86_TIER_AVX512] = PA_CPU_X86_AVX512F | PA_CPU_X86_AVX512BW
+};
+
+/* The extensions a tier adds */
+static const pa_cpu_x86_flag_t tier_mask[PA_CPU_X86_TIER_MAX + 1] = {
+    [PA_CPU_X86_TIER_NONE]   = 0,
+    [PA_CPU_X86_TIER_SSE]    = PA_CPU_X86_CMOV | PA_CPU_X86_MMX | PA_CPU_X86_MMXEXT | PA_CPU_X86_3DNOW |
+                               PA_CPU_X86_3DNOWEXT | PA_CPU_X86_SSE | PA_CPU_X86_SSE2 | PA_CPU_X86_SSE3 |
+                               PA_CPU_X86_SSSE3 | PA_CPU_X86_SSE4_1 | PA_CPU_X86_SSE4_2,
+    [PA_CPU_X86_TIER_AVX]    = PA_CPU_X86_AVX | PA_CPU_X86_F16C,
+    [PA_CPU_X86_TIER_AVX2]   = PA_CPU_X86_AVX2 | PA_CPU_X86_FMA,
+    [PA_CPU_X86_TIER_AVX512] = PA_CPU_X86_AVX512F | PA_CPU_X86_AVX512BW
+};
+
+static const char * const tier_names[PA_CPU_X86_TIER_MAX + 1] = {
+    [PA_CPU_X86_TIER_NONE]   = "none",
+    [PA_CPU_X86_TIER_SSE]    = "sse",
+    [PA_CPU_X86_TIER_AVX]    = "avx",
+    [PA_CPU_X86_TIER_AVX2]   = "avx2",
+    [PA_CPU_X86_TIER_AVX512] = "avx512"
+};
+
+#if defined (__i386__) || defined (__amd64__)
+typedef struct x86_func_init {
+    pa_cpu_x86_tier_t tier;
+    pa_cpu_x86_flag_t flags;
+    void (*init)(pa_cpu_x86_flag_t flags);
+} x86_func_init;
+
+/* Ordered by tier so that wider functions are set up last and replace the
+ * narrower ones. Each init is called if any of its flags is available. */
+static const x86_func_init func_inits[] = {
+    { PA_CPU_X86_TIER_SSE, PA_CPU_X86_MMX, pa_volume_func_init_mmx },
+    { PA_CPU_X86_TIER_SSE, PA_CPU_X86_MMX, pa_remap_func_init_mmx },
+    { PA_CPU_X86_TIER_SSE, PA_CPU_X86_SSE | PA_CPU_X86_SSE2, pa_volume_func_init_sse },
+    { PA_CPU_X86_TIER_SSE, PA_CPU_X86_SSE | PA_CPU_X86_SSE2, pa_remap_func_init_sse },
+    { PA_CPU_X86_TIER_SSE, PA_CPU_X86_SSE | PA_CPU_X86_SSE2, pa_convert_func_init_sse },
+#ifdef HAVE_SSE2
+    { PA_CPU_X86_TIER_SSE, PA_CPU_X86_SSE2, pa_mix_func_init_sse },
+#endif
+#ifdef HAVE_AVX2
+    { PA_CPU_X86_TIER_AVX2, PA_CPU_X86_AVX2, pa_mix_func_init_avx },
+    { PA_CPU_X86_TIER_AVX2, PA_CPU_X86_AVX2, pa_remap_func_init_avx },
+    { PA_CPU_X86_TIER_AVX2, PA_CPU_X86_AVX2, pa_polyphase_func_init_avx },
+    { PA_CPU_X86_TIER_AVX2, PA_CPU_X86_AVX2, pa_convert_func_init_avx },
+#endif
+};
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+pa_cpu_x86_tier_t pa_cpu_x86_get_tier(pa_cpu_x86_flag_t flags) {
+    pa_cpu_x86_tier_t tier = PA_CPU_X86_TIER_NONE;
+
+    while (tier < PA_CPU_X86_TIER_MAX && (flags & tier_flags[tier + 1]) == tier_flags[tier + 1])
+        tier++;
+
+    return tier;
+}
+
+const char *pa_cpu_x86_tier_to_string(pa_cpu_x86_tier_t tier) {
+    pa_assert(tier <= PA_CPU_X86_TIER_MAX);
+
+    return tier_names[tier];
+}
+
+int pa_cpu_x86_parse_tier(const char *s) {
+    unsigned i;
+
+    pa_assert(s);
+
+    for (i = 0; i <= PA_CPU_X86_TIER_MAX; i++)
+        if (pa_streq(s, tier_names[i]))
+            return (int) i;
+
+    return -1;
+}
+
+bool pa_cpu_init_x86(pa_cpu_x86_flag_t *flags, pa_cpu_x86_tier_t max_tier) {
 #if defined (__i386__) || defined (__amd64__)
+    pa_cpu_x86_tier_t tier;
+    pa_cpu_x86_flag_t mask = 0;
+    unsigned i;
+
     pa_cpu_get_x86_flags(flags);
 
-    /* activate various optimisations */
-    if (*flags & PA_CPU_X86_MMX) {
-        pa_volume_func_init_mmx(*flags);
-        pa_remap_func_init_mmx(*flags);
-    }
+    /* Hide the extensions above the maximum tier from the optimized
+     * functions, which also check the flags themselves */
+    tier = PA_MIN(pa_cpu_x86_get_tier(*flags), max_tier);
+    for (i = 0; i <= tier; i++)
+        mask |= tier_mask[i];
+    *flags &= mask;
 
-    if (*flags & (PA_CPU_X86_SSE | PA_CPU_X86_SSE2)) {
-        pa_volume_func_init_sse(*flags);
-        pa_remap_func_init_sse(*flags);
-        pa_convert_func_init_sse(*flags);
-    }
+    if (max_tier < PA_CPU_X86_TIER_MAX)
+        pa_log_info("Using x86 SIMD tier %s, limited to %s.", tier_names[tier], tier_names[max_tier]);
+    else
+        pa_log_info("Using x86 SIMD tier %s.", tier_names[tier]);
+
+    /* activate various optimisations */
+    for (i = 0; i < PA_ELEMENTSOF(func_inits); i++)
+        if (func_inits[i].tier <= tier && (*flags & func_inits[i].flags))
+            func_inits[i].init(*flags);
 
     return true;
 #else /* defined (__i386__) || defined (__amd64__) */
@@ -35,11 +35,33 @@ typedef enum pa_cpu_x86_flag {
     PA_CPU_X86_SSE4_2    = (1 << 7),
     PA_CPU_X86_3DNOW     = (1 << 8),
     PA_CPU_X86_3DNOWEXT  = (1 << 9),
-    PA_CPU_X86_CMOV      = (1 << 10)
+    PA_CPU_X86_CMOV      = (1 << 10),
+    PA_CPU_X86_AVX       = (1 << 11),
+    PA_CPU_X86_AVX2      = (1 << 12),
+    PA_CPU_X86_FMA       = (1 << 13),
+    PA_CPU_X86_F16C      = (1 << 14),
+    PA_CPU_X86_AVX512F   = (1 << 15),
+    PA_CPU_X86_AVX512BW  = (1 << 16)
 } pa_cpu_x86_flag_t;
 
+/* Generations of vector extensions, the optimized functions of a tier
+ * replace those of the tiers below it */
+typedef enum pa_cpu_x86_tier {
+    PA_CPU_X86_TIER_NONE,       /* C functions only */
+    PA_CPU_X86_TIER_SSE,        /* MMX, 3DNow!, SSE to SSE4.2 */
+    PA_CPU_X86_TIER_AVX,        /* AVX, F16C */
+    PA_CPU_X86_TIER_AVX2,       /* AVX2, FMA */
+    PA_CPU_X86_TIER_AVX512,     /* AVX-512F, AVX-512BW */
+    PA_CPU_X86_TIER_MAX = PA_CPU_X86_TIER_AVX512
+} pa_cpu_x86_tier_t;
+
 void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags);
-bool pa_cpu_init_x86 (pa_cpu_x86_flag_t *flags);
+bool pa_cpu_init_x86 (pa_cpu_x86_flag_t *flags, pa_cpu_x86_tier_t max_tier);
+
+/* The highest tier whose extensions are all in flags */
+pa_cpu_x86_tier_t pa_cpu_x86_get_tier(pa_cpu_x86_flag_t flags);
+const char *pa_cpu_x86_tier_to_string(pa_cpu_x86_tier_t tier);
+int pa_cpu_x86_parse_tier(const char *s);
 
 #if defined (__i386__)
 typedef int32_t pa_reg_x86;
@@ -53,7 +75,14 @@ void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags);
 
 void pa_remap_func_init_mmx(pa_cpu_x86_flag_t flags);
 void pa_remap_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_remap_func_init_avx(pa_cpu_x86_flag_t flags);
 
 void pa_convert_func_init_sse (pa_cpu_x86_flag_t flags);
+void pa_convert_func_init_avx(pa_cpu_x86_flag_t flags);
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_mix_func_init_avx(pa_cpu_x86_flag_t flags);
+
+void pa_polyphase_func_init_avx(pa_cpu_x86_flag_t flags);
 
 #endif /* foocpux86hfoo */
@@ -25,14 +25,16 @@ void pa_cpu_init(pa_cpu_info *cpu_info) {
     cpu_info->cpu_type = PA_CPU_UNDEFINED;
     /* don't force generic code, used for testing only */
     cpu_info->force_generic_code = false;
+
+    /* Set up the C functions first, the optimized ones replace them */
+    pa_remap_func_init(cpu_info);
+    pa_mix_func_init(cpu_info);
+
     if (!getenv("PULSE_NO_SIMD")) {
-        if (pa_cpu_init_x86(&cpu_info->flags.x86))
+        if (pa_cpu_init_x86(&cpu_info->flags.x86, cpu_info->x86_max_tier))
             cpu_info->cpu_type = PA_CPU_X86;
         else if (pa_cpu_init_arm(&cpu_info->flags.arm))
             cpu_info->cpu_type = PA_CPU_ARM;
         pa_cpu_init_orc(*cpu_info);
     }
-
-    pa_remap_func_init(cpu_info);
-    pa_mix_func_init(cpu_info);
 }
@@ -39,6 +39,9 @@ struct pa_cpu_info {
         pa_cpu_arm_flag_t arm;
     } flags;
     bool force_generic_code;
+
+    /* Highest x86 SIMD tier to use, set before pa_cpu_init() */
+    pa_cpu_x86_tier_t x86_max_tier;
 };
 
 void pa_cpu_init(pa_cpu_info *cpu_info);
@@ -57,6 +57,10 @@
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
+/* Slots of size classes smaller than a page are kept at a multiple of
+ * this, so that no two slots share a cache line */
+#define PA_MEMPOOL_SLOT_ALIGN 64
+
 #define PA_MEMEXPORT_SLOTS_MAX 128
 
 #define PA_MEMIMPORT_SLOTS_MAX 160
@@ -188,18 +192,27 @@ struct pa_mempool {
 
     bool global;
 
-    size_t block_size;
-    unsigned n_blocks;
-    bool is_remote_writable;
+    pa_shm_flags_t shm_flags;
+
+    /* The slots of each size class are stored in one contiguous range
+     * of the memory, the classes are sorted by increasing block size */
+    struct mempool_class {
+        size_t block_size;
+        unsigned n_blocks;
+        size_t offset;
+
+        pa_atomic_t n_init;
 
-    pa_atomic_t n_init;
+        /* A list of free slots that may be reused */
+        pa_flist *free_slots;
+    } classes[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    unsigned n_classes;
+
+    bool is_remote_writable;
 
     PA_LLIST_HEAD(pa_memimport, imports);
     PA_LLIST_HEAD(pa_memexport, exports);
 
-    /* A list of free slots that may be reused */
-    pa_flist *free_slots;
-
     pa_mempool_stat stat;
 };
 
@@ -292,60 +305,104 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
+static struct mempool_slot* mempool_class_allocate_slot(pa_mempool *p, unsigned c) {
+    struct mempool_class *k;
     struct mempool_slot *slot;
+
     pa_assert(p);
+    pa_assert(c < p->n_classes);
+
+    k = &p->classes[c];
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
+    if (!(slot = pa_flist_pop(k->free_slots))) {
         int idx;
 
         /* The free list was empty, we have to allocate a new entry */
 
-        if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
-            pa_atomic_dec(&p->n_init);
+        if ((unsigned) (idx = pa_atomic_inc(&k->n_init)) >= k->n_blocks)
+            pa_atomic_dec(&k->n_init);
         else
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
+            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + k->offset + (k->block_size * (size_t) idx));
 
         if (!slot) {
-            if (pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Pool full");
-            pa_atomic_inc(&p->stat.n_pool_full);
+            pa_atomic_inc(&p->stat.n_full_by_class[c]);
             return NULL;
         }
     }
 
+    pa_atomic_inc(&p->stat.n_allocated_by_class[c]);
+    pa_atomic_inc(&p->stat.n_accumulated_by_class[c]);
+
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*     if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
+/*         VALGRIND_MALLOCLIKE_BLOCK(slot, k->block_size, 0, 0); */
 /*     } */
 /* #endif */
 
     return slot;
 }
 
+/* Allocate a slot of at least length bytes, taken from the smallest
+ * size class that fits. If that class is exhausted we spill over into
+ * the larger ones. No lock necessary. */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, size_t length) {
+    struct mempool_slot *slot;
+    unsigned c;
+
+    pa_assert(p);
+
+    for (c = 0; c < p->n_classes; c++) {
+        if (p->classes[c].block_size < length)
+            continue;
+
+        if ((slot = mempool_class_allocate_slot(p, c)))
+            return slot;
+    }
+
+    if (pa_log_ratelimit(PA_LOG_DEBUG))
+        pa_log_debug("Pool full");
+    pa_atomic_inc(&p->stat.n_pool_full);
+    return NULL;
+}
+
 /* No lock necessary, totally redundant anyway */
 static inline void* mempool_slot_data(struct mempool_slot *slot) {
     return slot;
 }
 
 /* No lock necessary */
-static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
+static unsigned mempool_slot_class(pa_mempool *p, void *ptr) {
+    size_t offset;
+    unsigned c;
+
     pa_assert(p);
 
     pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
     pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
 
-    return (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) / p->block_size);
+    offset = (size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr);
+
+    for (c = 0; c < p->n_classes; c++)
+        if (offset >= p->classes[c].offset &&
+            offset < p->classes[c].offset + p->classes[c].block_size * p->classes[c].n_blocks)
+            return c;
+
+    pa_assert_not_reached();
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
-    unsigned idx;
+static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr, unsigned *c) {
+    struct mempool_class *k;
+    size_t idx;
 
-    if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
-        return NULL;
+    pa_assert(c);
+
+    *c = mempool_slot_class(p, ptr);
+    k = &p->classes[*c];
+
+    idx = ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) - k->offset) / k->block_size;
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + k->offset + (idx * k->block_size));
 }
 
 /* No lock necessary */
@@ -382,18 +439,18 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    if (pa_mempool_block_size_max(p) >= length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, PA_ALIGN(sizeof(pa_memblock)) + length)))
             return NULL;
 
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
-    } else if (p->block_size >= length) {
+    } else if (p->classes[p->n_classes-1].block_size >= length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, length)))
             return NULL;
 
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
@@ -403,7 +460,7 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
         pa_atomic_ptr_store(&b->data, mempool_slot_data(slot));
 
     } else {
-        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->block_size);
+        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->classes[p->n_classes-1].block_size);
         pa_atomic_inc(&p->stat.n_too_large_for_pool);
         return NULL;
     }
@@ -643,22 +700,25 @@ static void memblock_free(pa_memblock *b) {
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
             struct mempool_slot *slot;
+            unsigned c;
             bool call_free;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
+            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data), &c));
 
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*             if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->block_size); */
+/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->classes[c].block_size); */
 /*             } */
 /* #endif */
 
+            pa_atomic_dec(&b->pool->stat.n_allocated_by_class[c]);
+
             /* The free list dimensions should easily allow all slots
              * to fit in, hence try harder if pushing this slot into
              * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
+            while (pa_flist_push(b->pool->classes[c].free_slots, slot) < 0)
                 ;
 
             if (call_free)
@@ -711,10 +771,10 @@ static void memblock_make_local(pa_memblock *b) {
 
     pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
 
-    if (b->length <= b->pool->block_size) {
+    if (b->length <= b->pool->classes[b->pool->n_classes-1].block_size) {
         struct mempool_slot *slot;
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, b->length))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -826,41 +886,107 @@ static void memblock_replace_import(pa_memblock *b) {
  * TODO-1: Transform the global core mempool to a per-client one
  * TODO-2: Remove global mempools support */
 pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
+    return pa_mempool_new_full(type, size, per_client, NULL, 0, 0, PA_SHM_NUMA_NODE_ANY);
+}
+
+/* Like pa_mempool_new(), but with one size class for each entry of
+ * slot_sizes, or the default single class if there are none. Sizes of
+ * at least a page are rounded up to whole pages, smaller ones to
+ * PA_MEMPOOL_SLOT_ALIGN. The largest class gets half of the pool size,
+ * the rest is split evenly between the smaller classes. Since slots
+ * are only touched when they are used for the first time, small
+ * classes let small blocks share pages instead of each committing a
+ * full 64 KiB slot.
+ *
+ * shm_flags and numa_node are passed on to pa_shm_create_rw_full() to
+ * choose how the pool memory is backed. */
+pa_mempool *pa_mempool_new_full(pa_mem_type_t type, size_t size, bool per_client,
+                                const size_t *slot_sizes, unsigned n_slot_sizes,
+                                pa_shm_flags_t shm_flags, int numa_node) {
+    static const size_t default_slot_size = PA_MEMPOOL_SLOT_SIZE;
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
     const size_t page_size = pa_page_size();
+    size_t offset;
+    unsigned i, c;
+
+    pa_assert(n_slot_sizes <= PA_MEMPOOL_SLOT_CLASSES_MAX);
+
+    if (n_slot_sizes == 0) {
+        slot_sizes = &default_slot_size;
+        n_slot_sizes = 1;
+    }
+
+    pa_assert(slot_sizes);
 
     p = pa_xnew0(pa_mempool, 1);
     PA_REFCNT_INIT(p);
 
-    p->block_size = PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE);
-    if (p->block_size < page_size)
-        p->block_size = page_size;
+    /* Sort the classes by block size, dropping duplicates */
+    for (i = 0; i < n_slot_sizes; i++) {
+        size_t block_size;
+
+        pa_assert(slot_sizes[i] > PA_ALIGN(sizeof(pa_memblock)));
+
+        if (slot_sizes[i] >= page_size)
+            block_size = PA_PAGE_ALIGN(slot_sizes[i]);
+        else
+            block_size = ((slot_sizes[i] + PA_MEMPOOL_SLOT_ALIGN - 1) / PA_MEMPOOL_SLOT_ALIGN) * PA_MEMPOOL_SLOT_ALIGN;
+
+        for (c = 0; c < p->n_classes; c++)
+            if (p->classes[c].block_size >= block_size)
+                break;
+
+        if (c < p->n_classes && p->classes[c].block_size == block_size)
+            continue;
+
+        memmove(&p->classes[c+1], &p->classes[c], (p->n_classes - c) * sizeof(struct mempool_class));
+        p->classes[c].block_size = block_size;
+        p->n_classes++;
+    }
 
     if (size <= 0)
-        p->n_blocks = PA_MEMPOOL_SLOTS_MAX;
-    else {
-        p->n_blocks = (unsigned) (size / p->block_size);
+        size = PA_MEMPOOL_SLOTS_MAX * p->classes[p->n_classes-1].block_size;
+
+    for (c = 0; c < p->n_classes; c++) {
+        struct mempool_class *k = &p->classes[c];
+        size_t class_size;
+
+        if (c == p->n_classes - 1)
+            class_size = p->n_classes > 1 ? size / 2 : size;
+        else
+            class_size = size / 2 / (p->n_classes - 1);
+
+        k->n_blocks = (unsigned) (class_size / k->block_size);
 
-        if (p->n_blocks < 2)
-            p->n_blocks = 2;
+        if (k->n_blocks < 2)
+            k->n_blocks = 2;
     }
 
-    if (pa_shm_create_rw(&p->memory, type, p->n_blocks * p->block_size, 0700) < 0) {
+    /* Lay out the classes from the largest to the smallest, so that the
+     * page sized ones start on page boundaries and can be punched */
+    offset = 0;
+    for (c = p->n_classes; c > 0; c--) {
+        p->classes[c-1].offset = offset;
+        offset += p->classes[c-1].block_size * p->classes[c-1].n_blocks;
+    }
+
+    if (pa_shm_create_rw_full(&p->memory, type, offset, 0700, shm_flags, numa_node) < 0) {
         pa_xfree(p);
         return NULL;
     }
 
-    pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
-                 pa_mem_type_to_string(type),
-                 p->n_blocks,
-                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
-                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
-                 (unsigned long) pa_mempool_block_size_max(p));
+    p->shm_flags = shm_flags;
 
-    p->global = !per_client;
+    for (c = 0; c < p->n_classes; c++)
+        pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
+                     pa_mem_type_to_string(type),
+                     p->classes[c].n_blocks,
+                     pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->classes[c].block_size),
+                     pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->classes[c].n_blocks * p->classes[c].block_size)),
+                     (unsigned long) (p->classes[c].block_size - PA_ALIGN(sizeof(pa_memblock))));
 
-    pa_atomic_store(&p->n_init, 0);
+    p->global = !per_client;
 
     PA_LLIST_HEAD_INIT(pa_memimport, p->imports);
     PA_LLIST_HEAD_INIT(pa_memexport, p->exports);
@@ -868,12 +994,22 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
     p->mutex = pa_mutex_new(true, true);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
+    p->stat.n_slot_classes = p->n_classes;
+
+    for (c = 0; c < p->n_classes; c++) {
+        pa_atomic_store(&p->classes[c].n_init, 0);
+        p->classes[c].free_slots = pa_flist_new(p->classes[c].n_blocks);
+
+        p->stat.slot_class_size[c] = p->classes[c].block_size;
+        p->stat.slot_class_n_slots[c] = p->classes[c].n_blocks;
+    }
 
     return p;
 }
 
 static void mempool_free(pa_mempool *p) {
+    unsigned c;
+
     pa_assert(p);
 
     pa_mutex_lock(p->mutex);
@@ -886,8 +1022,6 @@ static void mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
-
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
@@ -898,32 +1032,36 @@ static void mempool_free(pa_mempool *p) {
 
         /* Let's try to find at least one of those leaked memory blocks */
 
-        list = pa_flist_new(p->n_blocks);
+        for (c = 0; c < p->n_classes; c++) {
+            struct mempool_class *cl = &p->classes[c];
 
-        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_init); i++) {
-            struct mempool_slot *slot;
-            pa_memblock *b, *k;
+            list = pa_flist_new(cl->n_blocks);
 
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
-            b = mempool_slot_data(slot);
+            for (i = 0; i < (unsigned) pa_atomic_load(&cl->n_init); i++) {
+                struct mempool_slot *slot;
+                pa_memblock *b, *k;
 
-            while ((k = pa_flist_pop(p->free_slots))) {
-                while (pa_flist_push(list, k) < 0)
-                    ;
+                slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + cl->offset + (cl->block_size * (size_t) i));
+                b = mempool_slot_data(slot);
 
-                if (b == k)
-                    break;
-            }
+                while ((k = pa_flist_pop(cl->free_slots))) {
+                    while (pa_flist_push(list, k) < 0)
+                        ;
 
-            if (!k)
-                pa_log("REF: Leaked memory block %p", b);
+                    if (b == k)
+                        break;
+                }
 
-            while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
-                    ;
-        }
+                if (!k)
+                    pa_log("REF: Leaked memory block %p", b);
 
-        pa_flist_free(list, NULL);
+                while ((k = pa_flist_pop(list)))
+                    while (pa_flist_push(cl->free_slots, k) < 0)
+                        ;
+            }
+
+            pa_flist_free(list, NULL);
+        }
 
 #endif
 
@@ -932,6 +1070,9 @@ static void mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
+    for (c = 0; c < p->n_classes; c++)
+        pa_flist_free(p->classes[c].free_slots, NULL);
+
     pa_shm_free(&p->memory);
 
     pa_mutex_free(p->mutex);
@@ -951,30 +1092,45 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
 
-    return p->block_size - PA_ALIGN(sizeof(pa_memblock));
+    return p->classes[p->n_classes-1].block_size - PA_ALIGN(sizeof(pa_memblock));
 }
 
 /* No lock necessary */
 void pa_mempool_vacuum(pa_mempool *p) {
     struct mempool_slot *slot;
     pa_flist *list;
+    unsigned c;
 
     pa_assert(p);
 
-    list = pa_flist_new(p->n_blocks);
+    /* Memory that was asked to be faulted in or to be backed by huge
+     * pages is meant to stay, punching holes would defeat that */
+    if (p->shm_flags & (PA_SHM_HUGE_PAGES|PA_SHM_PREFAULT))
+        return;
 
-    while ((slot = pa_flist_pop(p->free_slots)))
-        while (pa_flist_push(list, slot) < 0)
-            ;
+    for (c = 0; c < p->n_classes; c++) {
+        struct mempool_class *k = &p->classes[c];
 
-    while ((slot = pa_flist_pop(list))) {
-        pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
+        /* Slots smaller than a page share their pages with their
+         * neighbours, we cannot give them back individually */
+        if (k->block_size < pa_page_size())
+            continue;
 
-        while (pa_flist_push(p->free_slots, slot))
-            ;
-    }
+        list = pa_flist_new(k->n_blocks);
+
+        while ((slot = pa_flist_pop(k->free_slots)))
+            while (pa_flist_push(list, slot) < 0)
+                ;
 
-    pa_flist_free(list, NULL);
+        while ((slot = pa_flist_pop(list))) {
+            pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), k->block_size);
+
+            while (pa_flist_push(k->free_slots, slot))
+                ;
+        }
+
+        pa_flist_free(list, NULL);
+    }
 }
 
 /* No lock necessary */
@@ -31,6 +31,7 @@ typedef struct pa_memblock pa_memblock;
 #include <pulsecore/atomic.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/mem.h>
+#include <pulsecore/shm.h>
 
 /* A pa_memblock is a reference counted memory block. PulseAudio
  * passes references to pa_memblocks around instead of copying
@@ -48,6 +49,9 @@ typedef enum pa_memblock_type {
     PA_MEMBLOCK_TYPE_MAX
 } pa_memblock_type_t;
 
+/* The maximum number of slot size classes of a memory pool */
+#define PA_MEMPOOL_SLOT_CLASSES_MAX 8
+
 typedef struct pa_mempool pa_mempool;
 typedef struct pa_mempool_stat pa_mempool_stat;
 typedef struct pa_memimport_segment pa_memimport_segment;
@@ -76,6 +80,18 @@ struct pa_mempool_stat {
 
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
+
+    /* The slot size classes of the pool, these don't change after
+     * the pool has been created */
+    unsigned n_slot_classes;
+    size_t slot_class_size[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    unsigned slot_class_n_slots[PA_MEMPOOL_SLOT_CLASSES_MAX];
+
+    /* Slots in use, slots handed out during the whole lifetime and how
+     * often a class was found exhausted, per size class */
+    pa_atomic_t n_allocated_by_class[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    pa_atomic_t n_accumulated_by_class[PA_MEMPOOL_SLOT_CLASSES_MAX];
+    pa_atomic_t n_full_by_class[PA_MEMPOOL_SLOT_CLASSES_MAX];
 };
 
 /* Allocate a new memory block of type PA_MEMBLOCK_MEMPOOL or PA_MEMBLOCK_APPENDED, depending on the size */
@@ -125,6 +141,9 @@ pa_memblock *pa_memblock_will_need(pa_memblock *b);
 
 /* The memory block manager */
 pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client);
+pa_mempool *pa_mempool_new_full(pa_mem_type_t type, size_t size, bool per_client,
+                                const size_t *slot_sizes, unsigned n_slot_sizes,
+                                pa_shm_flags_t shm_flags, int numa_node);
 void pa_mempool_unref(pa_mempool *p);
 pa_mempool* pa_mempool_ref(pa_mempool *p);
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
@@ -628,7 +628,7 @@ size_t pa_mix(
     pa_assert(data);
     pa_assert(length);
     pa_assert(spec);
-    pa_assert(nstreams > 1);
+    pa_assert(nstreams > 0);
 
     if (!volume)
         volume = pa_cvolume_reset(&full_volume, spec->channels);
@@ -664,6 +664,174 @@ void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func) {
     do_mix_table[f] = func;
 }
 
+/* Float accumulation mixing. The accumulator holds the sum in units of
+ * one LSB of the sink format, so the inputs only need a conversion to
+ * float and the final conversion is a plain rounding. Float has a 24 bit
+ * mantissa, hence only formats of up to 24 bits are handled. */
+
+static void accumulate_s16ne(float *acc, pa_mix_info *m, unsigned channels, unsigned n) {
+    const int16_t *src = m->ptr;
+    unsigned channel = 0;
+
+    for (; n > 0; n--, acc++, src++) {
+        *acc += (float) *src * m->linear[channel].f;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void accumulate_s24ne(float *acc, pa_mix_info *m, unsigned channels, unsigned n) {
+    const uint8_t *src = m->ptr;
+    unsigned channel = 0;
+
+    for (; n > 0; n--, acc++, src += 3) {
+        *acc += (float) ((int32_t) (PA_READ24NE(src) << 8) >> 8) * m->linear[channel].f;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void accumulate_s24_32ne(float *acc, pa_mix_info *m, unsigned channels, unsigned n) {
+    const uint32_t *src = m->ptr;
+    unsigned channel = 0;
+
+    for (; n > 0; n--, acc++, src++) {
+        *acc += (float) ((int32_t) (*src << 8) >> 8) * m->linear[channel].f;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+/* Triangular (TPDF) dither of +/- 1 LSB: the sum of two uniform values
+ * from a xorshift generator, which is plenty for noise */
+static inline float dither_tpdf(uint32_t *state) {
+    uint32_t x = *state, a, b;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    a = x;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    b = x;
+
+    *state = x;
+
+    return ((float) (a >> 8) + (float) (b >> 8)) * (1.0f / (1 << 24)) - 1.0f;
+}
+
+static void finish_s16ne(void *data, const float *acc, unsigned n, uint32_t *dither) {
+    int16_t *d = data;
+
+    for (; n > 0; n--, acc++, d++) {
+        float v = *acc;
+
+        if (dither)
+            v += dither_tpdf(dither);
+
+        v = PA_CLAMP_UNLIKELY(v, -0x8000, 0x7FFF);
+        *d = (int16_t) lrintf(v);
+    }
+}
+
+static void finish_s24ne(void *data, const float *acc, unsigned n, uint32_t *dither) {
+    uint8_t *d = data;
+
+    for (; n > 0; n--, acc++, d += 3) {
+        float v = *acc;
+
+        if (dither)
+            v += dither_tpdf(dither);
+
+        v = PA_CLAMP_UNLIKELY(v, -0x800000, 0x7FFFFF);
+        PA_WRITE24NE(d, (uint32_t) (int32_t) lrintf(v));
+    }
+}
+
+static void finish_s24_32ne(void *data, const float *acc, unsigned n, uint32_t *dither) {
+    uint32_t *d = data;
+
+    for (; n > 0; n--, acc++, d++) {
+        float v = *acc;
+
+        if (dither)
+            v += dither_tpdf(dither);
+
+        v = PA_CLAMP_UNLIKELY(v, -0x800000, 0x7FFFFF);
+        *d = ((uint32_t) (int32_t) lrintf(v)) & 0xFFFFFFU;
+    }
+}
+
+typedef void (*accumulate_func_t)(float *acc, pa_mix_info *m, unsigned channels, unsigned n);
+typedef void (*finish_func_t)(void *data, const float *acc, unsigned n, uint32_t *dither);
+
+static const struct {
+    accumulate_func_t accumulate;
+    finish_func_t finish;
+} float_mix_table[PA_SAMPLE_MAX] = {
+    [PA_SAMPLE_S16NE]    = { accumulate_s16ne, finish_s16ne },
+    [PA_SAMPLE_S24NE]    = { accumulate_s24ne, finish_s24ne },
+    [PA_SAMPLE_S24_32NE] = { accumulate_s24_32ne, finish_s24_32ne },
+};
+
+bool pa_mix_float_supported(pa_sample_format_t f) {
+    pa_assert(pa_sample_format_valid(f));
+
+    return !!float_mix_table[f].accumulate;
+}
+
+size_t pa_mix_float(
+        pa_mix_info streams[],
+        unsigned nstreams,
+        void *data,
+        size_t length,
+        const pa_sample_spec *spec,
+        const pa_cvolume *volume,
+        bool mute,
+        float *accum,
+        uint32_t *dither) {
+
+    pa_cvolume full_volume;
+    unsigned k, n;
+
+    pa_assert(streams);
+    pa_assert(data);
+    pa_assert(length);
+    pa_assert(spec);
+    pa_assert(accum);
+    pa_assert(nstreams > 0);
+    pa_assert(pa_mix_float_supported(spec->format));
+
+    if (!volume)
+        volume = pa_cvolume_reset(&full_volume, spec->channels);
+
+    if (mute || pa_cvolume_is_muted(volume)) {
+        pa_silence_memory(data, length, spec);
+        return length;
+    }
+
+    n = (unsigned) (length / pa_sample_size(spec));
+    memset(accum, 0, n * sizeof(float));
+
+    calc_linear_float_stream_volumes(streams, nstreams, volume, spec);
+
+    for (k = 0; k < nstreams; k++) {
+        pa_assert(length <= streams[k].chunk.length);
+        streams[k].ptr = pa_memblock_acquire_chunk(&streams[k].chunk);
+        float_mix_table[spec->format].accumulate(accum, &streams[k], spec->channels, n);
+        pa_memblock_release(streams[k].chunk.memblock);
+    }
+
+    float_mix_table[spec->format].finish(data, accum, n, dither);
+
+    return length;
+}
+
 typedef union {
   float f;
   uint32_t i;
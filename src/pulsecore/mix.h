@@ -49,6 +49,26 @@ size_t pa_mix(
     const pa_cvolume *volume,
     bool mute);
 
+/* Like pa_mix(), but sums the inputs with their volumes applied in a
+ * float accumulator and converts to the sample format only once at the
+ * end. accum needs room for length / pa_sample_size(spec) floats. If
+ * dither is not NULL, TPDF dither is added before the final rounding
+ * and *dither is used as the state of the noise generator, it must not
+ * be zero. Only formats for which pa_mix_float_supported() is true may
+ * be passed. */
+size_t pa_mix_float(
+    pa_mix_info channels[],
+    unsigned nchannels,
+    void *data,
+    size_t length,
+    const pa_sample_spec *spec,
+    const pa_cvolume *volume,
+    bool mute,
+    float *accum,
+    uint32_t *dither);
+
+bool pa_mix_float_supported(pa_sample_format_t f);
+
 typedef void (*pa_do_mix_func_t) (pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length);
 
 pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f);
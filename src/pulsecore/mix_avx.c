@@ -0,0 +1,318 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <immintrin.h>
+
+/* Same scheme as the SSE2 mixers, with twice the lanes. The fallbacks are
+ * the SSE2 mixers, which take the tails of up to 15 samples. */
+#define MAX_STREAMS 32
+#define TILE_SAMPLES 512
+
+static pa_do_mix_func_t fallback_s16ne, fallback_s32ne, fallback_s24_32ne, fallback_float32ne;
+
+static void mix_tail(pa_do_mix_func_t fallback, pa_mix_info streams[], unsigned nstreams, unsigned channels,
+        void *data, unsigned length, unsigned done) {
+    unsigned i;
+
+    if (done == length)
+        return;
+
+    for (i = 0; i < nstreams; i++)
+        streams[i].ptr = (uint8_t*) streams[i].ptr + done;
+
+    fallback(streams, nstreams, channels, (uint8_t*) data + done, length - done);
+}
+
+/* See mix_sse.c. Unpacking and packing work within 128 bit lanes, which
+ * keeps the samples in order. */
+typedef struct s16_volume {
+    __m256i lo, fix, hi0, hi1;
+} s16_volume;
+
+static void s16_volumes(s16_volume vol[], const pa_mix_info streams[], unsigned nstreams, unsigned channels) {
+    const __m256i one = _mm256_set1_epi16(1);
+    unsigned i, j;
+
+    for (i = 0; i < nstreams; i++) {
+        PA_DECLARE_ALIGNED(32, int16_t, lo[16]);
+        PA_DECLARE_ALIGNED(32, int16_t, hi[16]);
+        __m256i h;
+
+        for (j = 0; j < 16; j++) {
+            int32_t cv = streams[i].linear[j % channels].i;
+
+            lo[j] = (int16_t) (cv & 0xFFFF);
+            hi[j] = (int16_t) (cv >> 16);
+        }
+
+        vol[i].lo = _mm256_load_si256((const __m256i*) lo);
+        vol[i].fix = _mm256_srai_epi16(vol[i].lo, 15);
+        h = _mm256_load_si256((const __m256i*) hi);
+        vol[i].hi0 = _mm256_unpacklo_epi16(h, one);
+        vol[i].hi1 = _mm256_unpackhi_epi16(h, one);
+    }
+}
+
+static void mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(32, int32_t, acc[TILE_SAMPLES]);
+    s16_volume vol[MAX_STREAMS];
+    unsigned tile, t, tn, g, gn, i, n, j;
+
+    if (16 % channels != 0) {
+        fallback_s16ne(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    n = length / sizeof(int16_t) & ~15U;
+    tile = nstreams <= MAX_STREAMS ? n : TILE_SAMPLES;
+
+    if (nstreams <= MAX_STREAMS)
+        s16_volumes(vol, streams, nstreams, channels);
+
+    for (t = 0; t < n; t += tn) {
+        tn = PA_MIN(tile, n - t);
+
+        for (g = 0; g < nstreams; g += gn) {
+            gn = PA_MIN(MAX_STREAMS, nstreams - g);
+
+            if (nstreams > MAX_STREAMS)
+                s16_volumes(vol, streams + g, gn, channels);
+
+            for (j = 0; j < tn; j += 16) {
+                __m256i sum0, sum1;
+
+                if (g == 0)
+                    sum0 = sum1 = _mm256_setzero_si256();
+                else {
+                    sum0 = _mm256_load_si256((const __m256i*) (acc + j));
+                    sum1 = _mm256_load_si256((const __m256i*) (acc + j + 8));
+                }
+
+                for (i = 0; i < gn; i++) {
+                    __m256i v = _mm256_loadu_si256((const __m256i*) ((const int16_t*) streams[g + i].ptr + t + j));
+                    __m256i lt = _mm256_add_epi16(_mm256_mulhi_epi16(v, vol[i].lo), _mm256_and_si256(v, vol[i].fix));
+
+                    sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_unpacklo_epi16(v, lt), vol[i].hi0));
+                    sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_unpackhi_epi16(v, lt), vol[i].hi1));
+                }
+
+                if (g + gn < nstreams) {
+                    _mm256_store_si256((__m256i*) (acc + j), sum0);
+                    _mm256_store_si256((__m256i*) (acc + j + 8), sum1);
+                } else
+                    _mm256_storeu_si256((__m256i*) (data + t + j), _mm256_packs_epi32(sum0, sum1));
+            }
+        }
+    }
+
+    mix_tail(fallback_s16ne, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+typedef struct s32_volume {
+    __m256i even, odd;
+} s32_volume;
+
+static void s32_volumes(s32_volume vol[], const pa_mix_info streams[], unsigned nstreams, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++) {
+        const pa_mix_info *m = streams + i;
+
+        vol[i].even = _mm256_set_epi32(0, m->linear[6 % channels].i, 0, m->linear[4 % channels].i,
+                0, m->linear[2 % channels].i, 0, m->linear[0].i);
+        vol[i].odd = _mm256_set_epi32(0, m->linear[7 % channels].i, 0, m->linear[5 % channels].i,
+                0, m->linear[3 % channels].i, 0, m->linear[1 % channels].i);
+    }
+}
+
+/* (v * cv) >> 16 of the signed dwords in the low half of each qword. AVX2
+ * has no arithmetic 64 bit shift, the sign is shifted in separately. */
+static inline __m256i mul_volume_s32(__m256i v, __m256i cv) {
+    __m256i p = _mm256_mul_epi32(v, cv);
+
+    return _mm256_or_si256(_mm256_srli_epi64(p, 16),
+            _mm256_slli_epi64(_mm256_cmpgt_epi64(_mm256_setzero_si256(), p), 48));
+}
+
+static inline __m256i clamp_s32(__m256i x) {
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x80000000LL);
+
+    x = _mm256_blendv_epi8(x, max, _mm256_cmpgt_epi64(x, max));
+    return _mm256_blendv_epi8(x, min, _mm256_cmpgt_epi64(min, x));
+}
+
+static inline void mix_s32_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length,
+        bool s24, pa_do_mix_func_t fallback) {
+    PA_DECLARE_ALIGNED(32, int64_t, acc[TILE_SAMPLES]);
+    s32_volume vol[MAX_STREAMS];
+    unsigned tile, t, tn, g, gn, i, n, j;
+
+    if (8 % channels != 0) {
+        fallback(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    n = length / sizeof(int32_t) & ~7U;
+    tile = nstreams <= MAX_STREAMS ? n : TILE_SAMPLES;
+
+    if (nstreams <= MAX_STREAMS)
+        s32_volumes(vol, streams, nstreams, channels);
+
+    for (t = 0; t < n; t += tn) {
+        tn = PA_MIN(tile, n - t);
+
+        for (g = 0; g < nstreams; g += gn) {
+            gn = PA_MIN(MAX_STREAMS, nstreams - g);
+
+            if (nstreams > MAX_STREAMS)
+                s32_volumes(vol, streams + g, gn, channels);
+
+            for (j = 0; j < tn; j += 8) {
+                __m256i even, odd, r;
+
+                if (g == 0)
+                    even = odd = _mm256_setzero_si256();
+                else {
+                    even = _mm256_load_si256((const __m256i*) (acc + j));
+                    odd = _mm256_load_si256((const __m256i*) (acc + j + 4));
+                }
+
+                for (i = 0; i < gn; i++) {
+                    __m256i v = _mm256_loadu_si256((const __m256i*) ((const int32_t*) streams[g + i].ptr + t + j));
+
+                    if (s24)
+                        v = _mm256_slli_epi32(v, 8);
+
+                    even = _mm256_add_epi64(even, mul_volume_s32(v, vol[i].even));
+                    odd = _mm256_add_epi64(odd, mul_volume_s32(_mm256_srli_epi64(v, 32), vol[i].odd));
+                }
+
+                if (g + gn < nstreams) {
+                    _mm256_store_si256((__m256i*) (acc + j), even);
+                    _mm256_store_si256((__m256i*) (acc + j + 4), odd);
+                    continue;
+                }
+
+                r = _mm256_blend_epi32(clamp_s32(even), _mm256_slli_epi64(clamp_s32(odd), 32), 0xAA);
+
+                if (s24)
+                    r = _mm256_srli_epi32(r, 8);
+
+                _mm256_storeu_si256((__m256i*) (data + t + j), r);
+            }
+        }
+    }
+
+    mix_tail(fallback, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static void mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    mix_s32_avx2(streams, nstreams, channels, data, length, false, fallback_s32ne);
+}
+
+static void mix_s24_32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    mix_s32_avx2(streams, nstreams, channels, data, length, true, fallback_s24_32ne);
+}
+
+static void float_volumes(__m256 vol[], const pa_mix_info streams[], unsigned nstreams, unsigned channels) {
+    unsigned i, j;
+
+    for (i = 0; i < nstreams; i++) {
+        PA_DECLARE_ALIGNED(32, float, f[8]);
+
+        for (j = 0; j < 8; j++)
+            f[j] = streams[i].linear[j % channels].f;
+
+        vol[i] = _mm256_load_ps(f);
+    }
+}
+
+static void mix_float32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    PA_DECLARE_ALIGNED(32, float, acc[TILE_SAMPLES]);
+    __m256 vol[MAX_STREAMS];
+    unsigned tile, t, tn, g, gn, i, n, j;
+
+    if (8 % channels != 0) {
+        fallback_float32ne(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    n = length / sizeof(float) & ~7U;
+    tile = nstreams <= MAX_STREAMS ? n : TILE_SAMPLES;
+
+    if (nstreams <= MAX_STREAMS)
+        float_volumes(vol, streams, nstreams, channels);
+
+    for (t = 0; t < n; t += tn) {
+        tn = PA_MIN(tile, n - t);
+
+        for (g = 0; g < nstreams; g += gn) {
+            gn = PA_MIN(MAX_STREAMS, nstreams - g);
+
+            if (nstreams > MAX_STREAMS)
+                float_volumes(vol, streams + g, gn, channels);
+
+            for (j = 0; j < tn; j += 8) {
+                __m256 sum = g == 0 ? _mm256_setzero_ps() : _mm256_load_ps(acc + j);
+
+                for (i = 0; i < gn; i++)
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps((const float*) streams[g + i].ptr + t + j), vol[i]));
+
+                if (g + gn < nstreams)
+                    _mm256_store_ps(acc + j, sum);
+                else
+                    _mm256_storeu_ps(data + t + j, sum);
+            }
+        }
+    }
+
+    mix_tail(fallback_float32ne, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_mix_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+
+        fallback_s16ne = pa_get_mix_func(PA_SAMPLE_S16NE);
+        fallback_s32ne = pa_get_mix_func(PA_SAMPLE_S32NE);
+        fallback_s24_32ne = pa_get_mix_func(PA_SAMPLE_S24_32NE);
+        fallback_float32ne = pa_get_mix_func(PA_SAMPLE_FLOAT32NE);
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) mix_s16ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) mix_s32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S24_32NE, (pa_do_mix_func_t) mix_s24_32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) mix_float32ne_avx2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -0,0 +1,334 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <emmintrin.h>
+
+/* The stream volumes are expanded into vectors, for up to MAX_STREAMS
+ * streams at a time. Their lanes follow the channel layout, which repeats
+ * from one vector to the next only if the number of channels divides the
+ * number of lanes: other layouts go to the fallback. More streams are mixed
+ * in groups, a tile of samples at a time: the sums of the groups so far are
+ * kept in an accumulator which stays in the L1 cache. The results are bit
+ * exact with the C mixers, for any number of streams. */
+#define MAX_STREAMS 32
+#define TILE_SAMPLES 512
+
+static pa_do_mix_func_t fallback_s16ne, fallback_s32ne, fallback_s24_32ne, fallback_float32ne;
+
+/* Mix what the vector loop left with the fallback */
+static void mix_tail(pa_do_mix_func_t fallback, pa_mix_info streams[], unsigned nstreams, unsigned channels,
+        void *data, unsigned length, unsigned done) {
+    unsigned i;
+
+    if (done == length)
+        return;
+
+    for (i = 0; i < nstreams; i++)
+        streams[i].ptr = (uint8_t*) streams[i].ptr + done;
+
+    fallback(streams, nstreams, channels, (uint8_t*) data + done, length - done);
+}
+
+/* With cv = hi << 16 | lo, (v * cv) >> 16 is v * hi + ((v * lo) >> 16). The
+ * latter is a signed high multiply, off by v when lo doesn't fit in an
+ * int16_t, and the sum is done by pmaddwd on (v, t) and (hi, 1) pairs. */
+typedef struct s16_volume {
+    __m128i lo, fix, hi0, hi1;
+} s16_volume;
+
+static void s16_volumes(s16_volume vol[], const pa_mix_info streams[], unsigned nstreams, unsigned channels) {
+    const __m128i one = _mm_set1_epi16(1);
+    unsigned i, j;
+
+    for (i = 0; i < nstreams; i++) {
+        PA_DECLARE_ALIGNED(16, int16_t, lo[8]);
+        PA_DECLARE_ALIGNED(16, int16_t, hi[8]);
+        __m128i h;
+
+        for (j = 0; j < 8; j++) {
+            int32_t cv = streams[i].linear[j % channels].i;
+
+            lo[j] = (int16_t) (cv & 0xFFFF);
+            hi[j] = (int16_t) (cv >> 16);
+        }
+
+        vol[i].lo = _mm_load_si128((const __m128i*) lo);
+        vol[i].fix = _mm_srai_epi16(vol[i].lo, 15);
+        h = _mm_load_si128((const __m128i*) hi);
+        vol[i].hi0 = _mm_unpacklo_epi16(h, one);
+        vol[i].hi1 = _mm_unpackhi_epi16(h, one);
+    }
+}
+
+static void mix_s16ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(16, int32_t, acc[TILE_SAMPLES]);
+    s16_volume vol[MAX_STREAMS];
+    unsigned tile, t, tn, g, gn, i, n, j;
+
+    if (8 % channels != 0) {
+        fallback_s16ne(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    n = length / sizeof(int16_t) & ~7U;
+    tile = nstreams <= MAX_STREAMS ? n : TILE_SAMPLES;
+
+    if (nstreams <= MAX_STREAMS)
+        s16_volumes(vol, streams, nstreams, channels);
+
+    for (t = 0; t < n; t += tn) {
+        tn = PA_MIN(tile, n - t);
+
+        for (g = 0; g < nstreams; g += gn) {
+            gn = PA_MIN(MAX_STREAMS, nstreams - g);
+
+            if (nstreams > MAX_STREAMS)
+                s16_volumes(vol, streams + g, gn, channels);
+
+            for (j = 0; j < tn; j += 8) {
+                __m128i sum0, sum1;
+
+                if (g == 0)
+                    sum0 = sum1 = _mm_setzero_si128();
+                else {
+                    sum0 = _mm_load_si128((const __m128i*) (acc + j));
+                    sum1 = _mm_load_si128((const __m128i*) (acc + j + 4));
+                }
+
+                for (i = 0; i < gn; i++) {
+                    __m128i v = _mm_loadu_si128((const __m128i*) ((const int16_t*) streams[g + i].ptr + t + j));
+                    __m128i lt = _mm_add_epi16(_mm_mulhi_epi16(v, vol[i].lo), _mm_and_si128(v, vol[i].fix));
+
+                    sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi16(v, lt), vol[i].hi0));
+                    sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi16(v, lt), vol[i].hi1));
+                }
+
+                if (g + gn < nstreams) {
+                    _mm_store_si128((__m128i*) (acc + j), sum0);
+                    _mm_store_si128((__m128i*) (acc + j + 4), sum1);
+                } else
+                    _mm_storeu_si128((__m128i*) (data + t + j), _mm_packs_epi32(sum0, sum1));
+            }
+        }
+    }
+
+    mix_tail(fallback_s16ne, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+/* The volumes of the even and odd lanes, in the low dword of each qword */
+typedef struct s32_volume {
+    __m128i even, odd;
+} s32_volume;
+
+static void s32_volumes(s32_volume vol[], const pa_mix_info streams[], unsigned nstreams, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++) {
+        const pa_mix_info *m = streams + i;
+
+        vol[i].even = _mm_set_epi32(0, m->linear[2 % channels].i, 0, m->linear[0].i);
+        vol[i].odd = _mm_set_epi32(0, m->linear[3 % channels].i, 0, m->linear[1 % channels].i);
+    }
+}
+
+/* SSE2 only multiplies unsigned dwords into qwords: |v| is multiplied, and
+ * the shift is turned into a floor division of the signed product. */
+static inline __m128i mul_volume_s32(__m128i a, __m128i s, __m128i cv) {
+    const __m128i round = _mm_set_epi32(0, 0xFFFF, 0, 0xFFFF);
+    __m128i p = _mm_mul_epu32(a, cv);
+
+    p = _mm_srli_epi64(_mm_add_epi64(p, _mm_and_si128(s, round)), 16);
+    return _mm_sub_epi64(_mm_xor_si128(p, s), s);
+}
+
+/* Saturate each qword to an int32_t, left in its low dword */
+static inline __m128i clamp_s32(__m128i x) {
+    __m128i hi = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 1, 1));
+    __m128i lo = _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i in_range = _mm_cmpeq_epi32(hi, _mm_srai_epi32(lo, 31));
+    __m128i sat = _mm_xor_si128(_mm_srai_epi32(hi, 31), _mm_set1_epi32(0x7FFFFFFF));
+
+    return _mm_or_si128(_mm_and_si128(in_range, lo), _mm_andnot_si128(in_range, sat));
+}
+
+/* s24_32 is s32 with the samples shifted in and out of the top 24 bits. The
+ * accumulator holds the even and odd qword sums of each vector in turn. */
+static inline void mix_s32_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length,
+        bool s24, pa_do_mix_func_t fallback) {
+    PA_DECLARE_ALIGNED(16, int64_t, acc[TILE_SAMPLES]);
+    s32_volume vol[MAX_STREAMS];
+    const __m128i low = _mm_set_epi32(0, -1, 0, -1);
+    unsigned tile, t, tn, g, gn, i, n, j;
+
+    if (4 % channels != 0) {
+        fallback(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    n = length / sizeof(int32_t) & ~3U;
+    tile = nstreams <= MAX_STREAMS ? n : TILE_SAMPLES;
+
+    if (nstreams <= MAX_STREAMS)
+        s32_volumes(vol, streams, nstreams, channels);
+
+    for (t = 0; t < n; t += tn) {
+        tn = PA_MIN(tile, n - t);
+
+        for (g = 0; g < nstreams; g += gn) {
+            gn = PA_MIN(MAX_STREAMS, nstreams - g);
+
+            if (nstreams > MAX_STREAMS)
+                s32_volumes(vol, streams + g, gn, channels);
+
+            for (j = 0; j < tn; j += 4) {
+                __m128i even, odd, r;
+
+                if (g == 0)
+                    even = odd = _mm_setzero_si128();
+                else {
+                    even = _mm_load_si128((const __m128i*) (acc + j));
+                    odd = _mm_load_si128((const __m128i*) (acc + j + 2));
+                }
+
+                for (i = 0; i < gn; i++) {
+                    __m128i v = _mm_loadu_si128((const __m128i*) ((const int32_t*) streams[g + i].ptr + t + j));
+                    __m128i s, a;
+
+                    if (s24)
+                        v = _mm_slli_epi32(v, 8);
+
+                    s = _mm_srai_epi32(v, 31);
+                    a = _mm_sub_epi32(_mm_xor_si128(v, s), s);
+
+                    even = _mm_add_epi64(even, mul_volume_s32(a, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 2, 0, 0)), vol[i].even));
+                    odd = _mm_add_epi64(odd, mul_volume_s32(_mm_srli_epi64(a, 32),
+                                _mm_shuffle_epi32(s, _MM_SHUFFLE(3, 3, 1, 1)), vol[i].odd));
+                }
+
+                if (g + gn < nstreams) {
+                    _mm_store_si128((__m128i*) (acc + j), even);
+                    _mm_store_si128((__m128i*) (acc + j + 2), odd);
+                    continue;
+                }
+
+                r = _mm_or_si128(_mm_and_si128(clamp_s32(even), low), _mm_slli_epi64(clamp_s32(odd), 32));
+
+                if (s24)
+                    r = _mm_srli_epi32(r, 8);
+
+                _mm_storeu_si128((__m128i*) (data + t + j), r);
+            }
+        }
+    }
+
+    mix_tail(fallback, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static void mix_s32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    mix_s32_sse2(streams, nstreams, channels, data, length, false, fallback_s32ne);
+}
+
+static void mix_s24_32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    mix_s32_sse2(streams, nstreams, channels, data, length, true, fallback_s24_32ne);
+}
+
+static void float_volumes(__m128 vol[], const pa_mix_info streams[], unsigned nstreams, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++) {
+        const pa_mix_info *m = streams + i;
+
+        vol[i] = _mm_set_ps(m->linear[3 % channels].f, m->linear[2 % channels].f,
+                m->linear[1 % channels].f, m->linear[0].f);
+    }
+}
+
+/* The streams are added in the same order as by the C mixer */
+static void mix_float32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    PA_DECLARE_ALIGNED(16, float, acc[TILE_SAMPLES]);
+    __m128 vol[MAX_STREAMS];
+    unsigned tile, t, tn, g, gn, i, n, j;
+
+    if (4 % channels != 0) {
+        fallback_float32ne(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    n = length / sizeof(float) & ~3U;
+    tile = nstreams <= MAX_STREAMS ? n : TILE_SAMPLES;
+
+    if (nstreams <= MAX_STREAMS)
+        float_volumes(vol, streams, nstreams, channels);
+
+    for (t = 0; t < n; t += tn) {
+        tn = PA_MIN(tile, n - t);
+
+        for (g = 0; g < nstreams; g += gn) {
+            gn = PA_MIN(MAX_STREAMS, nstreams - g);
+
+            if (nstreams > MAX_STREAMS)
+                float_volumes(vol, streams + g, gn, channels);
+
+            for (j = 0; j < tn; j += 4) {
+                __m128 sum = g == 0 ? _mm_setzero_ps() : _mm_load_ps(acc + j);
+
+                for (i = 0; i < gn; i++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps((const float*) streams[g + i].ptr + t + j), vol[i]));
+
+                if (g + gn < nstreams)
+                    _mm_store_ps(acc + j, sum);
+                else
+                    _mm_storeu_ps(data + t + j, sum);
+            }
+        }
+    }
+
+    mix_tail(fallback_float32ne, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized mixing functions.");
+
+        fallback_s16ne = pa_get_mix_func(PA_SAMPLE_S16NE);
+        fallback_s32ne = pa_get_mix_func(PA_SAMPLE_S32NE);
+        fallback_s24_32ne = pa_get_mix_func(PA_SAMPLE_S24_32NE);
+        fallback_float32ne = pa_get_mix_func(PA_SAMPLE_FLOAT32NE);
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) mix_s16ne_sse2);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) mix_s32ne_sse2);
+        pa_set_mix_func(PA_SAMPLE_S24_32NE, (pa_do_mix_func_t) mix_s24_32ne_sse2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) mix_float32ne_sse2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
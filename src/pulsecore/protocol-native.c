@@ -2496,7 +2496,12 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
         return;
     }
 
-    if (!(c->rw_mempool = pa_mempool_new(shm_type, c->protocol->core->shm_size, true))) {
+    /* Only the core pool gets the huge page and NUMA backing, one such
+     * pool per client would pin far too much memory */
+    if (!(c->rw_mempool = pa_mempool_new_full(shm_type, c->protocol->core->shm_size, true,
+                                              c->protocol->core->mempool_slot_sizes,
+                                              c->protocol->core->n_mempool_slot_sizes,
+                                              0, PA_SHM_NUMA_NODE_ANY))) {
         pa_log_warn("Disabling srbchannel, reason: Failed to allocate shared "
                     "writable memory pool.");
         return;
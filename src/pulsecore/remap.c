@@ -348,6 +348,111 @@ static void remap_channels_matrix_float32ne_c(pa_remap_t *m, float *dst, const f
     }
 }
 
+/* Sparse matrix remapping for common layouts: for each output channel,
+ * only the input channels with a non-zero coefficient are read. Up to
+ * four of them are summed up in one pass, any further ones are added in
+ * another pass, like the generic code does. The sums are done in the
+ * same order, so the result is the same. */
+#define SPARSE_MAX_CHANNELS 8
+
+struct remap_sparse {
+    unsigned n_terms[SPARSE_MAX_CHANNELS];
+    unsigned ic[SPARSE_MAX_CHANNELS][SPARSE_MAX_CHANNELS];
+    int32_t vol_i[SPARSE_MAX_CHANNELS][SPARSE_MAX_CHANNELS];
+    float vol_f[SPARSE_MAX_CHANNELS][SPARSE_MAX_CHANNELS];
+};
+
+static struct remap_sparse *remap_sparse_new(const pa_remap_t *m) {
+    struct remap_sparse *sp;
+    unsigned oc, ic;
+
+    pa_assert(m->i_ss.channels <= SPARSE_MAX_CHANNELS);
+    pa_assert(m->o_ss.channels <= SPARSE_MAX_CHANNELS);
+
+    sp = pa_xnew0(struct remap_sparse, 1);
+
+    for (oc = 0; oc < m->o_ss.channels; oc++)
+        for (ic = 0; ic < m->i_ss.channels; ic++) {
+            unsigned t = sp->n_terms[oc];
+
+            if (m->map_table_i[oc][ic] <= 0 && m->map_table_f[oc][ic] <= 0.0f)
+                continue;
+
+            sp->ic[oc][t] = ic;
+            sp->vol_i[oc][t] = PA_CLAMP(m->map_table_i[oc][ic], 0, 0x10000);
+            sp->vol_f[oc][t] = PA_CLAMP(m->map_table_f[oc][ic], 0.0f, 1.0f);
+            sp->n_terms[oc]++;
+        }
+
+    return sp;
+}
+
+#define REMAP_SPARSE(type, sum_type, vol_type, vol, term, n_ic, n_oc)                               \
+    const struct remap_sparse *sp = m->state;                                                       \
+    unsigned oc, t, i;                                                                              \
+                                                                                                    \
+    for (oc = 0; oc < n_oc; oc++) {                                                                 \
+        const unsigned *ic = sp->ic[oc];                                                            \
+        const type *s0 = src + ic[0], *s1 = src + ic[1], *s2 = src + ic[2], *s3 = src + ic[3];      \
+        const vol_type *v = sp->vol[oc];                                                            \
+        type *d = dst + oc;                                                                         \
+                                                                                                    \
+        switch (sp->n_terms[oc]) {                                                                  \
+            case 0:                                                                                 \
+                for (i = 0; i < n; i++)                                                             \
+                    d[i * n_oc] = 0;                                                                \
+                break;                                                                              \
+            case 1:                                                                                 \
+                for (i = 0; i < n; i++)                                                             \
+                    d[i * n_oc] = (type) term(s0[i * n_ic], v[0]);                                  \
+                break;                                                                              \
+            case 2:                                                                                 \
+                for (i = 0; i < n; i++)                                                             \
+                    d[i * n_oc] = (type) ((sum_type) term(s0[i * n_ic], v[0]) +                     \
+                                          term(s1[i * n_ic], v[1]));                                \
+                break;                                                                              \
+            case 3:                                                                                 \
+                for (i = 0; i < n; i++)                                                             \
+                    d[i * n_oc] = (type) ((sum_type) term(s0[i * n_ic], v[0]) +                     \
+                                          term(s1[i * n_ic], v[1]) + term(s2[i * n_ic], v[2]));     \
+                break;                                                                              \
+            default:                                                                                \
+                for (i = 0; i < n; i++)                                                             \
+                    d[i * n_oc] = (type) ((sum_type) term(s0[i * n_ic], v[0]) +                     \
+                                          term(s1[i * n_ic], v[1]) + term(s2[i * n_ic], v[2]) +     \
+                                          term(s3[i * n_ic], v[3]));                                \
+                                                                                                    \
+                for (t = 4; t < sp->n_terms[oc]; t++) {                                             \
+                    const type *st = src + ic[t];                                                   \
+                                                                                                    \
+                    for (i = 0; i < n; i++)                                                         \
+                        d[i * n_oc] = (type) ((sum_type) d[i * n_oc] + term(st[i * n_ic], v[t]));   \
+                }                                                                                   \
+                break;                                                                              \
+        }                                                                                           \
+    }
+
+#define TERM_S16(s, vol) (((int32_t) (s) * (vol)) >> 16)
+#define TERM_S32(s, vol) (((int64_t) (s) * (vol)) >> 16)
+#define TERM_FLOAT(s, vol) ((s) * (vol))
+
+#define DEFINE_REMAP_SPARSE(name, n_ic, n_oc)                                                       \
+static void remap_sparse_##name##_s16ne_c(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) { \
+    REMAP_SPARSE(int16_t, int32_t, int32_t, vol_i, TERM_S16, n_ic, n_oc)                            \
+}                                                                                                   \
+                                                                                                    \
+static void remap_sparse_##name##_s32ne_c(pa_remap_t *m, int32_t *dst, const int32_t *src, unsigned n) { \
+    REMAP_SPARSE(int32_t, int64_t, int32_t, vol_i, TERM_S32, n_ic, n_oc)                            \
+}                                                                                                   \
+                                                                                                    \
+static void remap_sparse_##name##_float32ne_c(pa_remap_t *m, float *dst, const float *src, unsigned n) { \
+    REMAP_SPARSE(float, float, float, vol_f, TERM_FLOAT, n_ic, n_oc)                                \
+}
+
+DEFINE_REMAP_SPARSE(stereo_to_ch6, 2, 6)
+DEFINE_REMAP_SPARSE(ch6_to_stereo, 6, 2)
+DEFINE_REMAP_SPARSE(ch8_to_stereo, 8, 2)
+
 /* Produce an array containing input channel indices to map to output channels.
  * If the output channel is empty, the array element is -1. */
 bool pa_setup_remap_arrange(const pa_remap_t *m, int8_t arrange[PA_CHANNELS_MAX]) {
@@ -495,6 +600,77 @@ static void remap_arrange_ch4_float32ne_c(pa_remap_t *m, float *dst, const float
     }
 }
 
+bool pa_remap_needs_matrix(const pa_remap_t *m) {
+    unsigned n_oc, n_ic;
+    int8_t arrange[PA_CHANNELS_MAX];
+
+    pa_assert(m);
+
+    n_oc = m->o_ss.channels;
+    n_ic = m->i_ss.channels;
+
+    /* Keep in sync with init_remap_c() */
+    if (n_ic == 1 && n_oc == 2 &&
+            m->map_table_i[0][0] == 0x10000 && m->map_table_i[1][0] == 0x10000)
+        return false;
+
+    if (n_ic == 2 && n_oc == 1 &&
+            m->map_table_i[0][0] == 0x8000 && m->map_table_i[0][1] == 0x8000)
+        return false;
+
+    if (n_ic == 1 && n_oc == 4 &&
+            m->map_table_i[0][0] == 0x10000 && m->map_table_i[1][0] == 0x10000 &&
+            m->map_table_i[2][0] == 0x10000 && m->map_table_i[3][0] == 0x10000)
+        return false;
+
+    if (n_ic == 4 && n_oc == 1 &&
+            m->map_table_i[0][0] == 0x4000 && m->map_table_i[0][1] == 0x4000 &&
+            m->map_table_i[0][2] == 0x4000 && m->map_table_i[0][3] == 0x4000)
+        return false;
+
+    if (pa_setup_remap_arrange(m, arrange) && (n_oc == 1 || n_oc == 2 || n_oc == 4))
+        return false;
+
+    /* The sparse remappers skip the zero coefficients of these layouts */
+    if ((n_ic == 2 && n_oc == 6) || (n_ic == 6 && n_oc == 2) || (n_ic == 8 && n_oc == 2))
+        return false;
+
+    return true;
+}
+
+pa_remap_matrix *pa_remap_matrix_new(const pa_remap_t *m) {
+    pa_remap_matrix *x;
+    unsigned oc, ic;
+
+    pa_assert(m);
+    pa_assert(m->o_ss.channels <= PA_REMAP_MATRIX_MAX_OUT);
+
+    x = pa_xnew0(pa_remap_matrix, 1);
+
+    for (ic = 0; ic < m->i_ss.channels; ic++) {
+        unsigned c = x->n_cols;
+        bool used = false;
+
+        for (oc = 0; oc < m->o_ss.channels; oc++) {
+            int32_t vol = PA_CLAMP(m->map_table_i[oc][ic], 0, 0x10000);
+
+            x->f[c][oc] = PA_CLAMP(m->map_table_f[oc][ic], 0.0f, 1.0f);
+            x->i[c][oc] = vol;
+            x->i16[c][oc] = (int16_t) (vol & 0xffff);
+            x->i16_mask[c][oc] = vol >= 0x8000 ? -1 : 0;
+
+            if (vol > 0 || x->f[c][oc] > 0.0f)
+                used = true;
+        }
+
+        /* Skip input channels that aren't used at all */
+        if (used)
+            x->col_ic[x->n_cols++] = ic;
+    }
+
+    return x;
+}
+
 void pa_set_remap_func(pa_remap_t *m, pa_do_remap_func_t func_s16,
     pa_do_remap_func_t func_s32, pa_do_remap_func_t func_float) {
 
@@ -587,6 +763,33 @@ static void init_remap_c(pa_remap_t *m) {
 
         /* setup state */
         m->state = pa_xnewdup(int8_t, arrange, PA_CHANNELS_MAX);
+    } else if (n_ic == 2 && n_oc == 6) {
+
+        pa_log_info("Using sparse stereo to 6-channel remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_sparse_stereo_to_ch6_s16ne_c,
+            (pa_do_remap_func_t) remap_sparse_stereo_to_ch6_s32ne_c,
+            (pa_do_remap_func_t) remap_sparse_stereo_to_ch6_float32ne_c);
+
+        /* setup state */
+        m->state = remap_sparse_new(m);
+    } else if (n_ic == 6 && n_oc == 2) {
+
+        pa_log_info("Using sparse 6-channel to stereo remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_sparse_ch6_to_stereo_s16ne_c,
+            (pa_do_remap_func_t) remap_sparse_ch6_to_stereo_s32ne_c,
+            (pa_do_remap_func_t) remap_sparse_ch6_to_stereo_float32ne_c);
+
+        /* setup state */
+        m->state = remap_sparse_new(m);
+    } else if (n_ic == 8 && n_oc == 2) {
+
+        pa_log_info("Using sparse 8-channel to stereo remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_sparse_ch8_to_stereo_s16ne_c,
+            (pa_do_remap_func_t) remap_sparse_ch8_to_stereo_s32ne_c,
+            (pa_do_remap_func_t) remap_sparse_ch8_to_stereo_float32ne_c);
+
+        /* setup state */
+        m->state = remap_sparse_new(m);
     } else {
 
         pa_log_info("Using generic matrix remapping");
@@ -57,4 +57,29 @@ bool pa_setup_remap_arrange(const pa_remap_t *m, int8_t arrange[PA_CHANNELS_MAX]
 void pa_set_remap_func(pa_remap_t *m, pa_do_remap_func_t func_s16,
     pa_do_remap_func_t func_s32, pa_do_remap_func_t func_float);
 
+/* Check if none of the special remappings (mono/stereo/4-channel up- and
+ * downmixing, rearranging) applies, so that a full matrix operation is
+ * needed */
+bool pa_remap_needs_matrix(const pa_remap_t *m);
+
+/* The matrix laid out for the SIMD matrix remappers, which handle up
+ * to 8 output channels. For each input channel that is used, its
+ * coefficients for all output channels, clamped to [0, 1] like the
+ * generic code does. For s16, (s * vol) >> 16 is the signed high
+ * multiply with the low 16 bits of vol, plus s where the mask is set,
+ * i.e. for vol >= 0x8000. */
+#define PA_REMAP_MATRIX_MAX_OUT 8
+
+typedef struct pa_remap_matrix {
+    unsigned n_cols;
+    unsigned col_ic[PA_CHANNELS_MAX];
+    float f[PA_CHANNELS_MAX][PA_REMAP_MATRIX_MAX_OUT];
+    int32_t i[PA_CHANNELS_MAX][PA_REMAP_MATRIX_MAX_OUT];
+    int16_t i16[PA_CHANNELS_MAX][PA_REMAP_MATRIX_MAX_OUT];
+    int16_t i16_mask[PA_CHANNELS_MAX][PA_REMAP_MATRIX_MAX_OUT];
+} pa_remap_matrix;
+
+/* Free with pa_xfree(), usually as m->state */
+pa_remap_matrix *pa_remap_matrix_new(const pa_remap_t *m);
+
 #endif /* fooremapfoo */
@@ -0,0 +1,218 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "remap.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <immintrin.h>
+
+/* Same scheme as the SSE2 matrix remappers, with all output channels in
+ * one vector. For s16, two frames share a vector, the second one stored
+ * after the first. */
+static pa_init_remap_func_t fallback_init;
+
+static inline void mac_s16_avx2(__m256i *acc, const int16_t *s, unsigned n_ic, __m256i vol, __m256i mask) {
+    __m256i v = _mm256_set_m128i(_mm_set1_epi16(s[n_ic]), _mm_set1_epi16(s[0]));
+
+    *acc = _mm256_add_epi16(*acc, _mm256_add_epi16(_mm256_mulhi_epi16(v, vol), _mm256_and_si256(v, mask)));
+}
+
+static inline void store_s16_avx2(int16_t *d, unsigned n_oc, __m256i acc) {
+    _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(acc));
+    _mm_storeu_si128((__m128i *) (d + n_oc), _mm256_extracti128_si256(acc, 1));
+}
+
+static void remap_matrix_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    int16_t tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + 8; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        __m256i a0 = _mm256_setzero_si256(), a1 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const int16_t *s = src + x->col_ic[c];
+            __m256i vol = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) x->i16[c]));
+            __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) x->i16_mask[c]));
+
+            mac_s16_avx2(&a0, s, n_ic, vol, mask);
+            mac_s16_avx2(&a1, s + 2 * n_ic, n_ic, vol, mask);
+        }
+
+        store_s16_avx2(dst, n_oc, a0);
+        store_s16_avx2(dst + 2 * n_oc, n_oc, a1);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        __m128i acc = _mm_setzero_si128();
+        int16_t *d = n * n_oc >= 8 ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++) {
+            __m128i v = _mm_set1_epi16(src[x->col_ic[c]]);
+            __m128i t = _mm_mulhi_epi16(v, _mm_loadu_si128((const __m128i *) x->i16[c]));
+
+            t = _mm_add_epi16(t, _mm_and_si128(v, _mm_loadu_si128((const __m128i *) x->i16_mask[c])));
+            acc = _mm_add_epi16(acc, t);
+        }
+
+        _mm_storeu_si128((__m128i *) d, acc);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(int16_t));
+    }
+}
+
+/* (s * vol) >> 16 from the full 64-bit products of the even and odd lanes */
+static inline __m256i term_s32_avx2(int32_t s, __m256i vol_even, __m256i vol_odd) {
+    __m256i v = _mm256_set1_epi32(s);
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(v, vol_even), 16);
+    __m256i odd = _mm256_slli_epi64(_mm256_mul_epi32(v, vol_odd), 16);
+
+    return _mm256_blend_epi32(even, odd, 0xaa);
+}
+
+static void remap_matrix_s32ne_avx2(pa_remap_t *m, int32_t *dst, const int32_t *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    int32_t tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + 8; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const int32_t *s = src + x->col_ic[c];
+            __m256i vol = _mm256_loadu_si256((const __m256i *) x->i[c]);
+            __m256i vol_odd = _mm256_srli_epi64(vol, 32);
+
+            a0 = _mm256_add_epi32(a0, term_s32_avx2(s[0], vol, vol_odd));
+            a1 = _mm256_add_epi32(a1, term_s32_avx2(s[n_ic], vol, vol_odd));
+            a2 = _mm256_add_epi32(a2, term_s32_avx2(s[2 * n_ic], vol, vol_odd));
+            a3 = _mm256_add_epi32(a3, term_s32_avx2(s[3 * n_ic], vol, vol_odd));
+        }
+
+        _mm256_storeu_si256((__m256i *) dst, a0);
+        _mm256_storeu_si256((__m256i *) (dst + n_oc), a1);
+        _mm256_storeu_si256((__m256i *) (dst + 2 * n_oc), a2);
+        _mm256_storeu_si256((__m256i *) (dst + 3 * n_oc), a3);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        __m256i acc = _mm256_setzero_si256();
+        int32_t *d = n * n_oc >= 8 ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++) {
+            __m256i vol = _mm256_loadu_si256((const __m256i *) x->i[c]);
+
+            acc = _mm256_add_epi32(acc, term_s32_avx2(src[x->col_ic[c]], vol, _mm256_srli_epi64(vol, 32)));
+        }
+
+        _mm256_storeu_si256((__m256i *) d, acc);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(int32_t));
+    }
+}
+
+static inline __m256 mac_float_avx2(__m256 acc, float s, __m256 vol) {
+    return _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(s), vol));
+}
+
+static void remap_matrix_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    float tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + 8; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const float *s = src + x->col_ic[c];
+            __m256 vol = _mm256_loadu_ps(x->f[c]);
+
+            a0 = mac_float_avx2(a0, s[0], vol);
+            a1 = mac_float_avx2(a1, s[n_ic], vol);
+            a2 = mac_float_avx2(a2, s[2 * n_ic], vol);
+            a3 = mac_float_avx2(a3, s[3 * n_ic], vol);
+        }
+
+        _mm256_storeu_ps(dst, a0);
+        _mm256_storeu_ps(dst + n_oc, a1);
+        _mm256_storeu_ps(dst + 2 * n_oc, a2);
+        _mm256_storeu_ps(dst + 3 * n_oc, a3);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        __m256 acc = _mm256_setzero_ps();
+        float *d = n * n_oc >= 8 ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++)
+            acc = mac_float_avx2(acc, src[x->col_ic[c]], _mm256_loadu_ps(x->f[c]));
+
+        _mm256_storeu_ps(d, acc);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(float));
+    }
+}
+
+static void init_remap_avx2(pa_remap_t *m) {
+    unsigned n_oc = m->o_ss.channels;
+
+    /* Up to 4 output channels are left to the SSE2 remappers. These don't
+     * do S32NE, for which the C code is faster only when downmixing to
+     * mono or stereo. */
+    if ((n_oc > 4 || (m->format == PA_SAMPLE_S32NE && n_oc > 2)) &&
+            n_oc <= PA_REMAP_MATRIX_MAX_OUT && pa_remap_needs_matrix(m)) {
+
+        pa_log_info("Using AVX2 matrix remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_s16ne_avx2,
+            (pa_do_remap_func_t) remap_matrix_s32ne_avx2,
+            (pa_do_remap_func_t) remap_matrix_float32ne_avx2);
+
+        /* setup state */
+        m->state = pa_remap_matrix_new(m);
+    } else
+        fallback_init(m);
+}
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_remap_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized remappers.");
+
+        fallback_init = pa_get_init_remap_func();
+        pa_set_init_remap_func((pa_init_remap_func_t) init_remap_avx2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
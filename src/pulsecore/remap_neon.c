@@ -18,6 +18,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/sample.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
@@ -380,6 +382,171 @@ static void remap_arrange_ch4_float32ne_neon(pa_remap_t *m, float *dst, const fl
     }
 }
 
+/* Matrix remapping, four frames at a time, see remap_sse.c. The products
+ * are computed in 32 (s16) or 64 bits (s32) and shifted down, like the
+ * generic code does. */
+static inline void mac_s16_neon(int32x4_t *a, int32x4_t *b, int16_t s, const int32_t *vol) {
+    *a = vaddq_s32(*a, vshrq_n_s32(vmulq_n_s32(vld1q_s32(vol), s), 16));
+    *b = vaddq_s32(*b, vshrq_n_s32(vmulq_n_s32(vld1q_s32(vol + 4), s), 16));
+}
+
+static inline void store_s16_neon(int16_t *d, int32x4_t a, int32x4_t b) {
+    vst1q_s16(d, vcombine_s16(vmovn_s32(a), vmovn_s32(b)));
+}
+
+static void remap_matrix_s16ne_neon(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    int16_t tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + 8; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        int32x4_t a0 = vdupq_n_s32(0), a1 = a0, a2 = a0, a3 = a0;
+        int32x4_t b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const int16_t *s = src + x->col_ic[c];
+
+            mac_s16_neon(&a0, &b0, s[0], x->i[c]);
+            mac_s16_neon(&a1, &b1, s[n_ic], x->i[c]);
+            mac_s16_neon(&a2, &b2, s[2 * n_ic], x->i[c]);
+            mac_s16_neon(&a3, &b3, s[3 * n_ic], x->i[c]);
+        }
+
+        store_s16_neon(dst, a0, b0);
+        store_s16_neon(dst + n_oc, a1, b1);
+        store_s16_neon(dst + 2 * n_oc, a2, b2);
+        store_s16_neon(dst + 3 * n_oc, a3, b3);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        int32x4_t a0 = vdupq_n_s32(0), b0 = a0;
+        int16_t *d = n * n_oc >= 8 ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++)
+            mac_s16_neon(&a0, &b0, src[x->col_ic[c]], x->i[c]);
+
+        store_s16_neon(d, a0, b0);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(int16_t));
+    }
+}
+
+static inline int32x4_t term_s32_neon(int32_t s, const int32_t *vol) {
+    int64x2_t lo = vmull_n_s32(vld1_s32(vol), s);
+    int64x2_t hi = vmull_n_s32(vld1_s32(vol + 2), s);
+
+    return vcombine_s32(vshrn_n_s64(lo, 16), vshrn_n_s64(hi, 16));
+}
+
+static inline void mac_s32_neon(int32x4_t *a, int32x4_t *b, int32_t s, const int32_t *vol, bool wide) {
+    *a = vaddq_s32(*a, term_s32_neon(s, vol));
+    if (wide)
+        *b = vaddq_s32(*b, term_s32_neon(s, vol + 4));
+}
+
+static inline void store_s32_neon(int32_t *d, int32x4_t a, int32x4_t b, bool wide) {
+    vst1q_s32(d, a);
+    if (wide)
+        vst1q_s32(d + 4, b);
+}
+
+static void remap_matrix_s32ne_neon(pa_remap_t *m, int32_t *dst, const int32_t *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    bool wide = n_oc > 4;
+    unsigned w = wide ? 8 : 4;
+    int32_t tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + w; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        int32x4_t a0 = vdupq_n_s32(0), a1 = a0, a2 = a0, a3 = a0;
+        int32x4_t b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const int32_t *s = src + x->col_ic[c];
+
+            mac_s32_neon(&a0, &b0, s[0], x->i[c], wide);
+            mac_s32_neon(&a1, &b1, s[n_ic], x->i[c], wide);
+            mac_s32_neon(&a2, &b2, s[2 * n_ic], x->i[c], wide);
+            mac_s32_neon(&a3, &b3, s[3 * n_ic], x->i[c], wide);
+        }
+
+        store_s32_neon(dst, a0, b0, wide);
+        store_s32_neon(dst + n_oc, a1, b1, wide);
+        store_s32_neon(dst + 2 * n_oc, a2, b2, wide);
+        store_s32_neon(dst + 3 * n_oc, a3, b3, wide);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        int32x4_t a0 = vdupq_n_s32(0), b0 = a0;
+        int32_t *d = n * n_oc >= w ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++)
+            mac_s32_neon(&a0, &b0, src[x->col_ic[c]], x->i[c], wide);
+
+        store_s32_neon(d, a0, b0, wide);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(int32_t));
+    }
+}
+
+/* No multiply-accumulate, which may be fused and round differently */
+static inline void mac_float_neon(float32x4_t *a, float32x4_t *b, float s, const float *vol, bool wide) {
+    *a = vaddq_f32(*a, vmulq_n_f32(vld1q_f32(vol), s));
+    if (wide)
+        *b = vaddq_f32(*b, vmulq_n_f32(vld1q_f32(vol + 4), s));
+}
+
+static inline void store_float_neon(float *d, float32x4_t a, float32x4_t b, bool wide) {
+    vst1q_f32(d, a);
+    if (wide)
+        vst1q_f32(d + 4, b);
+}
+
+static void remap_matrix_float32ne_neon(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    bool wide = n_oc > 4;
+    unsigned w = wide ? 8 : 4;
+    float tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + w; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        float32x4_t a0 = vdupq_n_f32(0.0f), a1 = a0, a2 = a0, a3 = a0;
+        float32x4_t b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const float *s = src + x->col_ic[c];
+
+            mac_float_neon(&a0, &b0, s[0], x->f[c], wide);
+            mac_float_neon(&a1, &b1, s[n_ic], x->f[c], wide);
+            mac_float_neon(&a2, &b2, s[2 * n_ic], x->f[c], wide);
+            mac_float_neon(&a3, &b3, s[3 * n_ic], x->f[c], wide);
+        }
+
+        store_float_neon(dst, a0, b0, wide);
+        store_float_neon(dst + n_oc, a1, b1, wide);
+        store_float_neon(dst + 2 * n_oc, a2, b2, wide);
+        store_float_neon(dst + 3 * n_oc, a3, b3, wide);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        float32x4_t a0 = vdupq_n_f32(0.0f), b0 = a0;
+        float *d = n * n_oc >= w ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++)
+            mac_float_neon(&a0, &b0, src[x->col_ic[c]], x->f[c], wide);
+
+        store_float_neon(d, a0, b0, wide);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(float));
+    }
+}
+
 static pa_cpu_arm_flag_t arm_flags;
 
 static void init_remap_neon(pa_remap_t *m) {
@@ -535,6 +702,15 @@ static void init_remap_neon(pa_remap_t *m) {
         default:
             pa_assert_not_reached();
         }
+    } else if (n_oc <= PA_REMAP_MATRIX_MAX_OUT && pa_remap_needs_matrix(m)) {
+
+        pa_log_info("Using NEON matrix remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_s16ne_neon,
+            (pa_do_remap_func_t) remap_matrix_s32ne_neon,
+            (pa_do_remap_func_t) remap_matrix_float32ne_neon);
+
+        /* setup state */
+        m->state = pa_remap_matrix_new(m);
     }
 }
 
@@ -22,6 +22,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/sample.h>
 #include <pulse/volume.h>
 #include <pulsecore/log.h>
@@ -122,6 +124,206 @@ static void remap_mono_to_stereo_any32ne_sse2(pa_remap_t *m, float *dst, const f
     );
 }
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* Matrix remapping: each used input channel is broadcast, multiplied with
+ * its column of coefficients for all output channels and accumulated, in
+ * the same order as the generic code. Four frames are done at once, which
+ * keeps their sums independent. The full vectors are stored, spilling into
+ * the next frame, which is written afterwards. Only where this would write
+ * past the end, the frame is stored to a temporary buffer and copied. */
+
+static inline void mac_s16_sse2(__m128i *acc, int16_t s, const pa_remap_matrix *x, unsigned c) {
+    __m128i v = _mm_set1_epi16(s);
+    __m128i t = _mm_mulhi_epi16(v, _mm_loadu_si128((const __m128i *) x->i16[c]));
+
+    t = _mm_add_epi16(t, _mm_and_si128(v, _mm_loadu_si128((const __m128i *) x->i16_mask[c])));
+    *acc = _mm_add_epi16(*acc, t);
+}
+
+static void remap_matrix_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    int16_t tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + 8; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        __m128i a0 = _mm_setzero_si128(), a1 = a0, a2 = a0, a3 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const int16_t *s = src + x->col_ic[c];
+
+            mac_s16_sse2(&a0, s[0], x, c);
+            mac_s16_sse2(&a1, s[n_ic], x, c);
+            mac_s16_sse2(&a2, s[2 * n_ic], x, c);
+            mac_s16_sse2(&a3, s[3 * n_ic], x, c);
+        }
+
+        _mm_storeu_si128((__m128i *) dst, a0);
+        _mm_storeu_si128((__m128i *) (dst + n_oc), a1);
+        _mm_storeu_si128((__m128i *) (dst + 2 * n_oc), a2);
+        _mm_storeu_si128((__m128i *) (dst + 3 * n_oc), a3);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        __m128i a0 = _mm_setzero_si128();
+        int16_t *d = n * n_oc >= 8 ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++)
+            mac_s16_sse2(&a0, src[x->col_ic[c]], x, c);
+
+        _mm_storeu_si128((__m128i *) d, a0);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(int16_t));
+    }
+}
+
+/* For one or two output channels, the samples of several frames are
+ * gathered into one vector, so that there are no unused lanes */
+static inline __m128i pair_s16_sse2(const int16_t *s, unsigned stride) {
+    return _mm_cvtsi32_si128((uint16_t) s[0] | ((uint32_t) (uint16_t) s[stride] << 16));
+}
+
+static void remap_matrix_narrow_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned frames = 8 / n_oc;
+    unsigned c;
+
+    pa_assert(n_oc <= 2);
+
+    for (; n >= frames; n -= frames, src += frames * n_ic, dst += 8) {
+        __m128i acc = _mm_setzero_si128();
+
+        for (c = 0; c < x->n_cols; c++) {
+            const int16_t *s = src + x->col_ic[c];
+            __m128i v, vol, mask;
+
+            v = _mm_unpacklo_epi32(pair_s16_sse2(s, n_ic), pair_s16_sse2(s + 2 * n_ic, n_ic));
+            if (n_oc == 1) {
+                __m128i v2 = _mm_unpacklo_epi32(pair_s16_sse2(s + 4 * n_ic, n_ic), pair_s16_sse2(s + 6 * n_ic, n_ic));
+
+                v = _mm_unpacklo_epi64(v, v2);
+                vol = _mm_set1_epi16(x->i16[c][0]);
+                mask = _mm_set1_epi16(x->i16_mask[c][0]);
+            } else {
+                v = _mm_unpacklo_epi16(v, v);
+                vol = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) x->i16[c]), 0);
+                mask = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) x->i16_mask[c]), 0);
+            }
+
+            acc = _mm_add_epi16(acc, _mm_add_epi16(_mm_mulhi_epi16(v, vol), _mm_and_si128(v, mask)));
+        }
+
+        _mm_storeu_si128((__m128i *) dst, acc);
+    }
+
+    if (n > 0)
+        remap_matrix_s16ne_sse2(m, dst, src, n);
+}
+
+static inline void mac_float_sse2(__m128 *a, __m128 *b, float s, __m128 lo, __m128 hi, bool wide) {
+    __m128 v = _mm_set1_ps(s);
+
+    *a = _mm_add_ps(*a, _mm_mul_ps(v, lo));
+    if (wide)
+        *b = _mm_add_ps(*b, _mm_mul_ps(v, hi));
+}
+
+static inline void store_float_sse2(float *d, __m128 a, __m128 b, bool wide) {
+    _mm_storeu_ps(d, a);
+    if (wide)
+        _mm_storeu_ps(d + 4, b);
+}
+
+static void remap_matrix_float32ne_sse2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    bool wide = n_oc > 4;
+    unsigned w = wide ? 8 : 4;
+    float tmp[8];
+    unsigned c;
+
+    for (; n >= 4 && n * n_oc >= 3 * n_oc + w; n -= 4, src += 4 * n_ic, dst += 4 * n_oc) {
+        __m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+        __m128 b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const float *s = src + x->col_ic[c];
+            __m128 lo = _mm_loadu_ps(x->f[c]), hi = _mm_loadu_ps(x->f[c] + 4);
+
+            mac_float_sse2(&a0, &b0, s[0], lo, hi, wide);
+            mac_float_sse2(&a1, &b1, s[n_ic], lo, hi, wide);
+            mac_float_sse2(&a2, &b2, s[2 * n_ic], lo, hi, wide);
+            mac_float_sse2(&a3, &b3, s[3 * n_ic], lo, hi, wide);
+        }
+
+        store_float_sse2(dst, a0, b0, wide);
+        store_float_sse2(dst + n_oc, a1, b1, wide);
+        store_float_sse2(dst + 2 * n_oc, a2, b2, wide);
+        store_float_sse2(dst + 3 * n_oc, a3, b3, wide);
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        __m128 a0 = _mm_setzero_ps(), b0 = a0;
+        float *d = n * n_oc >= w ? dst : tmp;
+
+        for (c = 0; c < x->n_cols; c++)
+            mac_float_sse2(&a0, &b0, src[x->col_ic[c]], _mm_loadu_ps(x->f[c]), _mm_loadu_ps(x->f[c] + 4), wide);
+
+        store_float_sse2(d, a0, b0, wide);
+
+        if (d == tmp)
+            memcpy(dst, tmp, n_oc * sizeof(float));
+    }
+}
+static inline __m128 pair_float_sse2(const float *s, unsigned stride) {
+    return _mm_unpacklo_ps(_mm_load_ss(s), _mm_load_ss(s + stride));
+}
+
+static void remap_matrix_narrow_float32ne_sse2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix *x = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned frames = 8 / n_oc;
+    unsigned c;
+
+    pa_assert(n_oc <= 2);
+
+    /* Two vectors at a time */
+    for (; n >= frames; n -= frames, src += frames * n_ic, dst += 8) {
+        __m128 a0 = _mm_setzero_ps(), a1 = a0;
+
+        for (c = 0; c < x->n_cols; c++) {
+            const float *s = src + x->col_ic[c];
+            __m128 v0, v1, vol;
+
+            if (n_oc == 1) {
+                v0 = _mm_movelh_ps(pair_float_sse2(s, n_ic), pair_float_sse2(s + 2 * n_ic, n_ic));
+                v1 = _mm_movelh_ps(pair_float_sse2(s + 4 * n_ic, n_ic), pair_float_sse2(s + 6 * n_ic, n_ic));
+                vol = _mm_set1_ps(x->f[c][0]);
+            } else {
+                v0 = pair_float_sse2(s, n_ic);
+                v0 = _mm_unpacklo_ps(v0, v0);
+                v1 = pair_float_sse2(s + 2 * n_ic, n_ic);
+                v1 = _mm_unpacklo_ps(v1, v1);
+                vol = _mm_castpd_ps(_mm_load1_pd((const double *) x->f[c]));
+            }
+
+            a0 = _mm_add_ps(a0, _mm_mul_ps(v0, vol));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(v1, vol));
+        }
+
+        _mm_storeu_ps(dst, a0);
+        _mm_storeu_ps(dst + 4, a1);
+    }
+
+    if (n > 0)
+        remap_matrix_float32ne_sse2(m, dst, src, n);
+}
+#endif /* __SSE2__ */
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
     unsigned n_oc, n_ic;
@@ -138,6 +340,23 @@ static void init_remap_sse2(pa_remap_t *m) {
             (pa_do_remap_func_t) remap_mono_to_stereo_any32ne_sse2,
             (pa_do_remap_func_t) remap_mono_to_stereo_any32ne_sse2);
     }
+#ifdef __SSE2__
+    /* Without a 32-bit multiply, S32NE is left to the C code, which is
+     * faster */
+    else if (m->format != PA_SAMPLE_S32NE && n_oc <= PA_REMAP_MATRIX_MAX_OUT && pa_remap_needs_matrix(m)) {
+
+        pa_log_info("Using SSE2 matrix remapping");
+        if (n_oc <= 2)
+            pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_narrow_s16ne_sse2,
+                NULL, (pa_do_remap_func_t) remap_matrix_narrow_float32ne_sse2);
+        else
+            pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_s16ne_sse2,
+                NULL, (pa_do_remap_func_t) remap_matrix_float32ne_sse2);
+
+        /* setup state */
+        m->state = pa_remap_matrix_new(m);
+    }
+#endif
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
 
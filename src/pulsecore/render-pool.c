@@ -0,0 +1,205 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#include "render-pool.h"
+
+/* The pool whose jobs the current thread is running, if any */
+PA_STATIC_TLS_DECLARE_NO_FREE(render_pool);
+
+struct worker {
+    pa_render_pool *pool;
+    unsigned index;
+    pa_thread *thread;
+    pa_semaphore *start;
+};
+
+struct pa_render_pool {
+    unsigned n_workers;
+    struct worker *workers;
+    int rtprio;
+
+    /* Posted once by every worker that finished its share of a run */
+    pa_semaphore *done;
+
+    /* Set up by pa_render_pool_run() before the workers are woken
+     * up. The semaphores order these accesses, no locking needed. */
+    pa_thread_mq *thread_mq;
+    pa_render_pool_job_cb_t cb;
+    void *userdata;
+    unsigned n_jobs;
+    unsigned n_threads;
+    bool quit;
+};
+
+/* The jobs are statically distributed round-robin: with n_threads
+ * threads taking part, thread t runs jobs t, t + n_threads, ... Thread
+ * 0 is the caller of pa_render_pool_run(). Handing out fixed slices
+ * means no shared job counter, and a late waking worker can never pick
+ * up a job of the next run. */
+static void run_jobs(pa_render_pool *p, unsigned t) {
+    unsigned j;
+
+    for (j = t; j < p->n_jobs; j += p->n_threads)
+        p->cb(p, j, p->userdata);
+}
+
+static void thread_func(void *userdata) {
+    struct worker *w = userdata;
+    pa_render_pool *p = w->pool;
+
+    if (p->rtprio >= 0)
+        pa_thread_make_realtime(p->rtprio);
+
+    PA_STATIC_TLS_SET(render_pool, p);
+
+    for (;;) {
+        pa_semaphore_wait(w->start);
+
+        if (p->quit)
+            break;
+
+        /* Jobs expect to be called in the IO context of the thread that
+         * runs the pool. That thread (and hence its thread_mq) stays the
+         * same for the lifetime of the pool. */
+        if (p->thread_mq) {
+            if (!pa_thread_mq_get())
+                pa_thread_mq_install(p->thread_mq);
+            else
+                pa_assert(pa_thread_mq_get() == p->thread_mq);
+        }
+
+        run_jobs(p, w->index);
+
+        pa_semaphore_post(p->done);
+    }
+}
+
+pa_render_pool *pa_render_pool_new(unsigned n_workers, int rtprio) {
+    pa_render_pool *p;
+    unsigned i;
+
+    pa_assert(n_workers > 0);
+
+    p = pa_xnew0(pa_render_pool, 1);
+    p->rtprio = rtprio;
+    p->done = pa_semaphore_new(0);
+    p->workers = pa_xnew0(struct worker, n_workers);
+
+    for (i = 0; i < n_workers; i++) {
+        struct worker *w = &p->workers[i];
+        char name[16];
+
+        w->pool = p;
+        w->index = i + 1;
+        w->start = pa_semaphore_new(0);
+
+        pa_snprintf(name, sizeof(name), "render%u", i);
+
+        if (!(w->thread = pa_thread_new(name, thread_func, w))) {
+            pa_log("Failed to create render worker thread.");
+            pa_semaphore_free(w->start);
+            break;
+        }
+
+        p->n_workers++;
+    }
+
+    if (p->n_workers == 0) {
+        pa_render_pool_free(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+void pa_render_pool_free(pa_render_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    p->quit = true;
+
+    for (i = 0; i < p->n_workers; i++)
+        pa_semaphore_post(p->workers[i].start);
+
+    for (i = 0; i < p->n_workers; i++) {
+        pa_thread_free(p->workers[i].thread);
+        pa_semaphore_free(p->workers[i].start);
+    }
+
+    pa_semaphore_free(p->done);
+    pa_xfree(p->workers);
+    pa_xfree(p);
+}
+
+unsigned pa_render_pool_get_n_workers(pa_render_pool *p) {
+    pa_assert(p);
+
+    return p->n_workers;
+}
+
+void pa_render_pool_run(pa_render_pool *p, unsigned n_jobs, pa_render_pool_job_cb_t cb, void *userdata) {
+    pa_render_pool *prev;
+    unsigned i, n_active;
+
+    pa_assert(p);
+    pa_assert(cb);
+
+    if (n_jobs == 0)
+        return;
+
+    /* Only wake up as many workers as there are jobs to share */
+    n_active = PA_MIN(p->n_workers, n_jobs - 1);
+
+    p->thread_mq = pa_thread_mq_get();
+    p->cb = cb;
+    p->userdata = userdata;
+    p->n_jobs = n_jobs;
+    p->n_threads = n_active + 1;
+
+    for (i = 0; i < n_active; i++)
+        pa_semaphore_post(p->workers[i].start);
+
+    prev = PA_STATIC_TLS_SET(render_pool, p);
+
+    run_jobs(p, 0);
+
+    PA_STATIC_TLS_SET(render_pool, prev);
+
+    for (i = 0; i < n_active; i++)
+        pa_semaphore_wait(p->done);
+}
+
+bool pa_render_pool_in_job(pa_render_pool *p) {
+    pa_assert(p);
+
+    return PA_STATIC_TLS_GET(render_pool) == p;
+}
@@ -0,0 +1,46 @@
+#ifndef foopulserenderpoolhfoo
+#define foopulserenderpoolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdbool.h>
+
+/* A small set of worker threads an IO thread can hand independent jobs
+ * to. pa_render_pool_run() splits the jobs between the workers and the
+ * calling thread and only returns when all of them are done, so the
+ * caller never sees a partially processed batch. The jobs run with the
+ * thread_mq of the calling IO thread installed, i.e. they may use
+ * pa_thread_mq_get() and pass the IO context assertions. */
+
+typedef struct pa_render_pool pa_render_pool;
+
+typedef void (*pa_render_pool_job_cb_t)(pa_render_pool *p, unsigned job, void *userdata);
+
+/* rtprio < 0 leaves the workers at normal priority */
+pa_render_pool *pa_render_pool_new(unsigned n_workers, int rtprio);
+void pa_render_pool_free(pa_render_pool *p);
+
+unsigned pa_render_pool_get_n_workers(pa_render_pool *p);
+
+/* Called from IO context. Runs cb for every job in 0..n_jobs-1 exactly once */
+void pa_render_pool_run(pa_render_pool *p, unsigned n_jobs, pa_render_pool_job_cb_t cb, void *userdata);
+
+/* True if the calling thread is currently running a job of p */
+bool pa_render_pool_in_job(pa_render_pool *p);
+
+#endif
@@ -34,6 +34,10 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Frames per tile when format conversion and remapping are fused. The
+ * tiles of up to 8 channels fit into 16 KiB. */
+#define TILE_FRAMES 256
+
 struct ffmpeg_data { /* data specific to ffmpeg */
     struct AVResampleContext *state;
 };
@@ -42,6 +46,7 @@ static int copy_init(pa_resampler *r);
 
 static void setup_remap(const pa_resampler *r, pa_remap_t *m, bool *lfe_remixed);
 static void free_remap(pa_remap_t *m);
+static void setup_fusion(pa_resampler *r);
 
 static int (* const init_table[])(pa_resampler *r) = {
 #ifdef HAVE_LIBSAMPLERATE
@@ -118,6 +123,7 @@ static int (* const init_table[])(pa_resampler *r) = {
     [PA_RESAMPLER_SOXR_HQ]                 = NULL,
     [PA_RESAMPLER_SOXR_VHQ]                = NULL,
 #endif
+    [PA_RESAMPLER_POLYPHASE]               = pa_resampler_polyphase_init,
 };
 
 static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
@@ -125,10 +131,8 @@ static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
 
     if (pa_resample_method_supported(PA_RESAMPLER_SPEEX_FLOAT_BASE + 1))
         method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
-    else if (flags & PA_RESAMPLER_VARIABLE_RATE)
-        method = PA_RESAMPLER_TRIVIAL;
     else
-        method = PA_RESAMPLER_FFMPEG;
+        method = PA_RESAMPLER_POLYPHASE;
 
     return method;
 }
@@ -436,6 +440,8 @@ pa_resampler* pa_resampler_new(
     if (init_table[method](r) < 0)
         goto fail;
 
+    setup_fusion(r);
+
     return r;
 
 fail:
@@ -467,6 +473,7 @@ void pa_resampler_free(pa_resampler *r) {
         pa_memblock_unref(r->from_work_format_buf.memblock);
 
     free_remap(&r->remap);
+    pa_xfree(r->tile_buf);
 
     pa_xfree(r);
 }
@@ -588,20 +595,31 @@ void pa_resampler_reset(pa_resampler *r) {
     *r->have_leftover = false;
 }
 
-void pa_resampler_rewind(pa_resampler *r, size_t out_frames) {
+void pa_resampler_rewind(pa_resampler *r, size_t out_bytes, size_t in_bytes) {
     pa_assert(r);
 
-    /* For now, we don't have any rewindable resamplers, so we just
-       reset the resampler instead (and hope that nobody hears the difference). */
-    if (r->impl.reset)
-        r->impl.reset(r);
+    /* Resamplers that can't rewind are just reset instead (and we hope
+       that nobody hears the difference). */
+    if (!r->impl.rewind || r->impl.rewind(r, out_bytes / r->o_fz, in_bytes / r->i_fz) < 0)
+        if (r->impl.reset)
+            r->impl.reset(r);
 
     if (r->lfe_filter)
-        pa_lfe_filter_rewind(r->lfe_filter, out_frames);
+        pa_lfe_filter_rewind(r->lfe_filter, out_bytes);
 
     *r->have_leftover = false;
 }
 
+void pa_resampler_set_max_rewind(pa_resampler *r, size_t out_bytes) {
+    pa_assert(r);
+
+    r->max_rewind = out_bytes;
+}
+
+void pa_resampler_flush_cache(void) {
+    pa_resampler_polyphase_flush_cache();
+}
+
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r) {
     pa_assert(r);
 
@@ -667,7 +685,8 @@ static const char * const resample_methods[] = {
     "peaks",
     "soxr-mq",
     "soxr-hq",
-    "soxr-vhq"
+    "soxr-vhq",
+    "polyphase"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -1263,6 +1282,40 @@ static void free_remap(pa_remap_t *m) {
     pa_xfree(m->state);
 }
 
+/* A format conversion that is directly followed or preceded by remapping
+ * is done in the same pass, one tile at a time, instead of each stage
+ * writing a whole block to its own buffer and the next one reading it
+ * back. The work format data of a tile never leaves the cache. */
+static void setup_fusion(pa_resampler *r) {
+    bool remap_first, remap_last;
+    size_t tile_size = 0;
+
+    pa_assert(r);
+
+    if (!r->map_required)
+        return;
+
+    /* See pa_resampler_run() for the order of the stages */
+    remap_first = r->o_ss.channels <= r->i_ss.channels || !r->impl.resample;
+    remap_last = (r->o_ss.channels > r->i_ss.channels || !r->impl.resample) && !r->lfe_filter;
+
+    if (remap_first && r->to_work_format_func) {
+        r->fuse_to_work = true;
+        tile_size += TILE_FRAMES * r->i_ss.channels * r->w_sz;
+    }
+
+    if (remap_last && r->from_work_format_func) {
+        r->fuse_from_work = true;
+        tile_size += TILE_FRAMES * r->o_ss.channels * r->w_sz;
+    }
+
+    if (tile_size > 0) {
+        r->tile_buf = pa_xmalloc(tile_size);
+        pa_log_debug("  fused stages:%s%s", r->fuse_to_work ? " format conv. -> remap" : " remap",
+                     r->fuse_from_work ? " -> format conv." : "");
+    }
+}
+
 /* check if buf's memblock is large enough to hold 'len' bytes; create a
  * new memblock if necessary and optionally preserve 'copy' data bytes */
 static void fit_buf(pa_resampler *r, pa_memchunk *buf, size_t len, size_t *size, size_t copy) {
@@ -1387,6 +1440,88 @@ static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
     return &r->remap_buf;
 }
 
+/* remap_channels() with the conversion into the work format before it
+ * and/or the conversion from the work format after it fused in */
+static pa_memchunk *convert_remap(pa_resampler *r, pa_memchunk *input) {
+    unsigned in_n_frames, n, i_channels, o_channels;
+    size_t in_fz, out_fz, leftover_length = 0;
+    uint8_t *src, *dst, *tile_in, *tile_out;
+    pa_memchunk *output;
+    bool have_leftover;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(input->memblock);
+
+    i_channels = r->i_ss.channels;
+    o_channels = r->o_ss.channels;
+    in_fz = r->fuse_to_work ? r->i_fz : r->w_sz * i_channels;
+    out_fz = r->fuse_from_work ? r->o_fz : r->w_sz * o_channels;
+
+    /* Only the remap output buffer can hold leftover data, when remapping
+     * comes before resampling; there is then no conversion after it. */
+    have_leftover = r->leftover_in_remap;
+    r->leftover_in_remap = false;
+
+    if (r->fuse_from_work) {
+        pa_assert(!have_leftover);
+
+        if (input->length <= 0)
+            return input;
+
+        output = &r->from_work_format_buf;
+    } else {
+        if (input->length <= 0)
+            return have_leftover ? &r->remap_buf : input;
+
+        if (have_leftover)
+            leftover_length = r->remap_buf.length;
+
+        output = &r->remap_buf;
+    }
+
+    in_n_frames = (unsigned) (input->length / in_fz);
+
+    if (r->fuse_from_work)
+        fit_buf(r, output, in_n_frames * out_fz, &r->from_work_format_buf_size, 0);
+    else
+        fit_buf(r, output, leftover_length + in_n_frames * out_fz, &r->remap_buf_size, leftover_length);
+
+    tile_in = r->tile_buf;
+    tile_out = r->fuse_to_work ? tile_in + TILE_FRAMES * i_channels * r->w_sz : tile_in;
+
+    src = pa_memblock_acquire_chunk(input);
+    dst = (uint8_t *) pa_memblock_acquire(output->memblock) + leftover_length;
+
+    for (; in_n_frames > 0; in_n_frames -= n) {
+        const void *remap_src = src;
+        void *remap_dst = dst;
+
+        n = PA_MIN(in_n_frames, TILE_FRAMES);
+
+        if (r->fuse_to_work) {
+            r->to_work_format_func(n * i_channels, src, tile_in);
+            remap_src = tile_in;
+        }
+
+        if (r->fuse_from_work)
+            remap_dst = tile_out;
+
+        r->remap.do_remap(&r->remap, remap_dst, remap_src, n);
+
+        if (r->fuse_from_work)
+            r->from_work_format_func(n * o_channels, tile_out, dst);
+
+        src += n * in_fz;
+        dst += n * out_fz;
+    }
+
+    pa_memblock_release(input->memblock);
+    pa_memblock_release(output->memblock);
+
+    return output;
+}
+
 static void save_leftover(pa_resampler *r, void *buf, size_t len) {
     void *dst;
 
@@ -1469,23 +1604,25 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
     pa_assert(in->length % r->i_fz == 0);
 
     buf = (pa_memchunk*) in;
-    buf = convert_to_work_format(r, buf);
+    if (!r->fuse_to_work)
+        buf = convert_to_work_format(r, buf);
 
     /* Try to save resampling effort: if we have more output channels than
      * input channels, do resampling first, then remapping. */
     if (r->o_ss.channels <= r->i_ss.channels) {
-        buf = remap_channels(r, buf);
+        buf = r->tile_buf ? convert_remap(r, buf) : remap_channels(r, buf);
         buf = resample(r, buf);
     } else {
         buf = resample(r, buf);
-        buf = remap_channels(r, buf);
+        buf = r->tile_buf ? convert_remap(r, buf) : remap_channels(r, buf);
     }
 
     if (r->lfe_filter)
         buf = pa_lfe_filter_process(r->lfe_filter, buf);
 
     if (buf->length) {
-        buf = convert_from_work_format(r, buf);
+        if (!r->fuse_from_work)
+            buf = convert_from_work_format(r, buf);
         *out = *buf;
 
         if (buf == in)
@@ -39,6 +39,13 @@ struct pa_resampler_impl {
     unsigned (*resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_n_frames, pa_memchunk *out, unsigned *out_n_frames);
 
     void (*reset)(pa_resampler *r);
+
+    /* Optional, rewinds the state by the given number of output frames,
+     * the caller then feeds the last in_frames input frames again.
+     * Returns a negative value if that's not possible, in which case the
+     * resampler is reset instead. */
+    int (*rewind)(pa_resampler *r, size_t out_frames, size_t in_frames);
+
     void *data;
 };
 
@@ -61,6 +68,7 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_SOXR_MQ,
     PA_RESAMPLER_SOXR_HQ,
     PA_RESAMPLER_SOXR_VHQ,
+    PA_RESAMPLER_POLYPHASE,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -109,8 +117,16 @@ struct pa_resampler {
     pa_remap_t remap;
     bool map_required;
 
+    /* Format conversions done in the same pass as remapping, on tiles of
+     * TILE_FRAMES frames that stay in the cache, see setup_fusion() */
+    bool fuse_to_work, fuse_from_work;
+    void *tile_buf;
+
     pa_lfe_filter_t *lfe_filter;
 
+    /* In output bytes, see pa_resampler_set_max_rewind() */
+    size_t max_rewind;
+
     pa_resampler_impl impl;
 };
 
@@ -147,8 +163,15 @@ void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate);
 /* Reinitialize state of the resampler, possibly due to seeking or other discontinuities */
 void pa_resampler_reset(pa_resampler *r);
 
-/* Rewind resampler */
-void pa_resampler_rewind(pa_resampler *r, size_t out_frames);
+/* Rewind resampler by out_bytes of output, in_bytes is how much input
+ * the caller rewound and will feed again. The two don't need to be the
+ * same time, e.g. pa_resampler_result() of in_bytes. */
+void pa_resampler_rewind(pa_resampler *r, size_t out_bytes, size_t in_bytes);
+
+/* Set how far pa_resampler_rewind() may be asked to go back, in output
+ * bytes. Resamplers that can rewind exactly keep that much history, the
+ * others reset on rewinding. */
+void pa_resampler_set_max_rewind(pa_resampler *r, size_t out_bytes);
 
 /* Return the resampling method of the resampler object */
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r);
@@ -162,6 +185,11 @@ const char *pa_resample_method_to_string(pa_resample_method_t m);
 /* Return 1 when the specified resampling method is supported */
 int pa_resample_method_supported(pa_resample_method_t m);
 
+/* Free the filter tables that resamplers share and no resampler uses
+ * anymore. They are otherwise kept for the next resampler with the
+ * same rates. */
+void pa_resampler_flush_cache(void);
+
 const pa_channel_map* pa_resampler_input_channel_map(pa_resampler *r);
 const pa_sample_spec* pa_resampler_input_sample_spec(pa_resampler *r);
 const pa_channel_map* pa_resampler_output_channel_map(pa_resampler *r);
@@ -174,6 +202,19 @@ int pa_resampler_peaks_init(pa_resampler *r);
 int pa_resampler_speex_init(pa_resampler *r);
 int pa_resampler_trivial_init(pa_resampler*r);
 int pa_resampler_soxr_init(pa_resampler *r);
+int pa_resampler_polyphase_init(pa_resampler *r);
+
+void pa_resampler_polyphase_flush_cache(void);
+
+/* Number of filter banks in the cache, used or not */
+unsigned pa_resampler_polyphase_n_banks(void);
+
+/* The inner product of the polyphase resampler, replaced by the SIMD
+ * versions */
+typedef float (*pa_polyphase_dot_func_t)(const float *a, const float *b, unsigned n);
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void);
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func);
 
 /* Resampler-specific quirks */
 bool pa_speex_is_fixed_point(void);
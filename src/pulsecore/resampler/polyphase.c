@@ -0,0 +1,612 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/llist.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/refcnt.h>
+#include <pulsecore/resampler.h>
+
+/* A windowed sinc FIR evaluated at the output positions. The position
+ * of each output frame in the input is kept as an input frame index
+ * plus a fraction, which selects one of the phases of the filter bank.
+ *
+ * If the rates are fixed and their ratio reduces to out/in = L/M with
+ * L <= MAX_EXACT_PHASES, which covers all ratios between 44.1, 48 and
+ * 96 kHz, the bank has one phase per output position within a period
+ * of L output frames and no interpolation is needed. Otherwise the
+ * bank has INTERP_PHASES phases and the coefficients are interpolated
+ * linearly between the two nearest ones. The latter is used for
+ * variable rates, changing the rate then only changes the step, and
+ * the filter history is kept. Rates change in IO threads, so the bank
+ * of a variable rate resampler is picked once when it is created and
+ * kept: its cutoff leaves room for the input rate to go up by
+ * VARIABLE_RATE_HEADROOM without aliasing.
+ *
+ * The input is kept deinterleaved so that each output sample is a
+ * single contiguous inner product, done by the SIMD kernels where
+ * available.
+ *
+ * The banks are immutable once built and shared between all resamplers
+ * of the process through a small cache, so that creating many streams
+ * with the same rates costs one bank build. Banks that are no longer
+ * used are kept around for the next stream until more than
+ * MAX_IDLE_BANKS of them pile up. */
+
+#define MAX_EXACT_PHASES 1024
+#define INTERP_PHASES 256
+#define SUBPHASE_BITS 16
+
+/* Taps per phase when upsampling, more when downsampling to keep the
+ * transition band at the same relative width. Multiples of 8. */
+#define BASE_TAPS 64
+#define MAX_TAPS 1024
+
+/* About 90 dB of stopband attenuation. The center of the transition
+ * band is at CUTOFF times the lower of the two Nyquist frequencies, its
+ * upper end at the Nyquist frequency. */
+#define KAISER_BETA 8.96
+#define CUTOFF 0.91
+
+/* Covers the adjustments of module-loopback and most of those of
+ * module-rtp-recv */
+#define VARIABLE_RATE_HEADROOM 0.02
+
+#define MAX_IDLE_BANKS 8
+
+struct polyphase_bank {
+    PA_REFCNT_DECLARE;
+    PA_LLIST_FIELDS(struct polyphase_bank);
+
+    unsigned n_phases;
+    unsigned n_taps;
+    bool interpolated;
+    double cutoff;
+
+    /* n_taps coefficients per phase, n_phases + 1 phases when
+     * interpolated so that the last phase can be interpolated with the
+     * first one of the next input frame */
+    float *coeffs;
+};
+
+struct polyphase_data {
+    struct polyphase_bank *bank;
+
+    /* The fraction is in units of 1/den of an input frame */
+    uint64_t den;
+    int64_t step_int;
+    uint64_t step_frac;
+
+    /* Absolute index of the input frame at the first tap of the next
+     * output frame, and its fractional position */
+    int64_t idx;
+    uint64_t frac;
+
+    /* Output frames since the last reset or rate change, rewinding
+     * can't go back further */
+    uint64_t n_out;
+
+    /* Deinterleaved input frames base..end-1, capacity frames for each
+     * channel */
+    float *buf;
+    size_t capacity;
+    int64_t base, end;
+
+    /* Interpolated coefficients, room for MAX_TAPS of them once an
+     * interpolated bank is used */
+    float *coeffs;
+};
+
+static float dot_c(const float *a, const float *b, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    unsigned i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+
+    for (; i < n; i++)
+        s0 += a[i] * b[i];
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static pa_polyphase_dot_func_t dot_func = dot_c;
+
+/* All banks, most recently used first */
+static pa_static_mutex cache_mutex = PA_STATIC_MUTEX_INIT;
+static PA_LLIST_HEAD(struct polyphase_bank, cache);
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/* Modified Bessel function of the first kind, order 0 */
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for (k = 1; term > sum * 1e-12; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/* The cutoff relative to the input Nyquist frequency */
+static double bank_cutoff(uint32_t i_rate, uint32_t o_rate) {
+    return CUTOFF * PA_MIN(1.0, (double) o_rate / i_rate);
+}
+
+static struct polyphase_bank *bank_new(unsigned n_phases, bool interpolated, double cutoff) {
+    struct polyphase_bank *b;
+    unsigned p, t, n_rows, half;
+    double i0_beta;
+
+    b = pa_xnew0(struct polyphase_bank, 1);
+    b->n_phases = n_phases;
+    b->interpolated = interpolated;
+    b->cutoff = cutoff;
+    b->n_taps = PA_MIN(PA_ROUND_UP((unsigned) ceil(BASE_TAPS * CUTOFF / cutoff), 8), MAX_TAPS);
+
+    n_rows = interpolated ? n_phases + 1 : n_phases;
+    b->coeffs = pa_xnew(float, n_rows * b->n_taps);
+
+    half = b->n_taps / 2;
+    i0_beta = bessel_i0(KAISER_BETA);
+
+    /* Phase p is centered between the taps half - 1 and half, shifted
+     * by p / n_phases towards the latter. Each phase is normalized to
+     * unity gain at DC. */
+    for (p = 0; p < n_rows; p++) {
+        float *h = b->coeffs + p * b->n_taps;
+        double sum = 0;
+
+        for (t = 0; t < b->n_taps; t++) {
+            double x = (double) t - (half - 1) - (double) p / n_phases;
+            double w = x / half, v;
+
+            v = cutoff * x;
+            v = fabs(v) < 1e-9 ? 1.0 : sin(M_PI * v) / (M_PI * v);
+            v *= cutoff * bessel_i0(KAISER_BETA * sqrt(PA_MAX(0.0, 1.0 - w * w))) / i0_beta;
+
+            h[t] = (float) v;
+            sum += v;
+        }
+
+        for (t = 0; t < b->n_taps; t++)
+            h[t] = (float) (h[t] / sum);
+    }
+
+    return b;
+}
+
+static void bank_free(struct polyphase_bank *b) {
+    pa_xfree(b->coeffs);
+    pa_xfree(b);
+}
+
+/* Needs the cache mutex */
+static struct polyphase_bank *cache_find(unsigned n_phases, bool interpolated, double cutoff) {
+    struct polyphase_bank *b;
+
+    PA_LLIST_FOREACH(b, cache)
+        if (b->n_phases == n_phases && b->interpolated == interpolated && b->cutoff == cutoff)
+            return b;
+
+    return NULL;
+}
+
+/* Needs the cache mutex, frees the least recently used idle banks
+ * beyond max_idle */
+static void cache_trim(unsigned max_idle) {
+    struct polyphase_bank *b, *next;
+    unsigned n_idle = 0;
+
+    PA_LLIST_FOREACH_SAFE(b, next, cache) {
+        if (PA_REFCNT_VALUE(b) > 0 || ++n_idle <= max_idle)
+            continue;
+
+        PA_LLIST_REMOVE(struct polyphase_bank, cache, b);
+        bank_free(b);
+    }
+}
+
+/* Returns a reference to a cached bank, building it if needed. The bank
+ * is built without holding the mutex, a resampler of an IO thread
+ * changing its rate shouldn't wait for one of the main thread being
+ * created. */
+static struct polyphase_bank *bank_get(unsigned n_phases, bool interpolated, double cutoff) {
+    struct polyphase_bank *b, *n;
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+
+    pa_mutex_lock(m);
+    if ((b = cache_find(n_phases, interpolated, cutoff))) {
+        PA_LLIST_REMOVE(struct polyphase_bank, cache, b);
+        PA_LLIST_PREPEND(struct polyphase_bank, cache, b);
+        PA_REFCNT_INC(b);
+        pa_mutex_unlock(m);
+        return b;
+    }
+    pa_mutex_unlock(m);
+
+    n = bank_new(n_phases, interpolated, cutoff);
+
+    pa_mutex_lock(m);
+    if ((b = cache_find(n_phases, interpolated, cutoff))) {
+        /* Somebody else was faster */
+        PA_LLIST_REMOVE(struct polyphase_bank, cache, b);
+        bank_free(n);
+    } else {
+        b = n;
+        PA_REFCNT_INIT_ZERO(b);
+        PA_LLIST_INIT(struct polyphase_bank, b);
+    }
+    PA_LLIST_PREPEND(struct polyphase_bank, cache, b);
+    PA_REFCNT_INC(b);
+    pa_mutex_unlock(m);
+
+    pa_log_debug("Polyphase filter bank: %u phases%s, %u taps", b->n_phases,
+                 b->interpolated ? " (interpolated)" : "", b->n_taps);
+
+    return b;
+}
+
+static void bank_unref(struct polyphase_bank *b) {
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+
+    pa_mutex_lock(m);
+    if (PA_REFCNT_DEC(b) <= 0)
+        cache_trim(MAX_IDLE_BANKS);
+    pa_mutex_unlock(m);
+}
+
+unsigned pa_resampler_polyphase_n_banks(void) {
+    struct polyphase_bank *b;
+    unsigned n = 0;
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+
+    pa_mutex_lock(m);
+    PA_LLIST_FOREACH(b, cache)
+        n++;
+    pa_mutex_unlock(m);
+
+    return n;
+}
+
+void pa_resampler_polyphase_flush_cache(void) {
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+
+    pa_mutex_lock(m);
+    cache_trim(0);
+    pa_mutex_unlock(m);
+}
+
+/* Picks the bank for the current rates and sets up the step. The
+ * position is the caller's business. The bank of a variable rate
+ * resampler is only picked when it is created, this then runs without
+ * allocating anything. */
+static void setup_rates(pa_resampler *r, struct polyphase_data *d) {
+    uint32_t g, l, m;
+    double cutoff;
+
+    g = gcd(r->i_ss.rate, r->o_ss.rate);
+    l = r->o_ss.rate / g;
+    m = r->i_ss.rate / g;
+
+    if (!(r->flags & PA_RESAMPLER_VARIABLE_RATE) && l <= MAX_EXACT_PHASES) {
+        cutoff = bank_cutoff(r->i_ss.rate, r->o_ss.rate);
+
+        /* Only variable rates change while the resampler runs */
+        if (!d->bank || d->bank->interpolated || d->bank->n_phases != l || d->bank->cutoff != cutoff) {
+            if (d->bank)
+                bank_unref(d->bank);
+            d->bank = bank_get(l, false, cutoff);
+        }
+
+        d->den = l;
+        d->step_int = m / l;
+        d->step_frac = m % l;
+    } else {
+        bool variable = !!(r->flags & PA_RESAMPLER_VARIABLE_RATE);
+        uint64_t step;
+
+        cutoff = bank_cutoff((uint32_t) (r->i_ss.rate * (variable ? 1 + VARIABLE_RATE_HEADROOM : 1)), r->o_ss.rate);
+
+        if (!d->bank || !d->bank->interpolated || (!variable && d->bank->cutoff != cutoff)) {
+            if (d->bank)
+                bank_unref(d->bank);
+            d->bank = bank_get(INTERP_PHASES, true, cutoff);
+        }
+
+        if (!d->coeffs)
+            d->coeffs = pa_xnew(float, MAX_TAPS);
+
+        d->den = (uint64_t) INTERP_PHASES << SUBPHASE_BITS;
+        step = ((uint64_t) r->i_ss.rate * d->den + r->o_ss.rate / 2) / r->o_ss.rate;
+        d->step_int = step / d->den;
+        d->step_frac = step % d->den;
+    }
+
+    d->n_out = 0;
+}
+
+/* Makes room for n more frames, dropping what neither the next output
+ * nor rewinding needs anymore */
+static void make_room(pa_resampler *r, struct polyphase_data *d, size_t n) {
+    unsigned c, channels = r->work_channels;
+    int64_t keep_from;
+    size_t history, length;
+
+    if ((size_t) (d->end - d->base) + n <= d->capacity)
+        return;
+
+    history = (uint64_t) (r->max_rewind / r->o_fz) * r->i_ss.rate / r->o_ss.rate + d->bank->n_taps + 1;
+    keep_from = PA_MIN(d->idx, d->end - (int64_t) history);
+    keep_from = PA_CLAMP(keep_from, d->base, d->end);
+    length = d->end - keep_from;
+
+    /* Twice what's needed, so that the history is moved only once per
+     * its length of input */
+    if (length + n > d->capacity) {
+        size_t capacity = PA_MAX(d->capacity * 2, (length + n) * 2);
+        float *buf = pa_xnew(float, capacity * channels);
+
+        if (length > 0)
+            for (c = 0; c < channels; c++)
+                memcpy(buf + c * capacity, d->buf + c * d->capacity + (keep_from - d->base), length * sizeof(float));
+
+        pa_xfree(d->buf);
+        d->buf = buf;
+        d->capacity = capacity;
+    } else
+        for (c = 0; c < channels; c++)
+            memmove(d->buf + c * d->capacity, d->buf + c * d->capacity + (keep_from - d->base), length * sizeof(float));
+
+    d->base = keep_from;
+}
+
+static void append(pa_resampler *r, struct polyphase_data *d, const float *src, size_t n) {
+    unsigned c, channels = r->work_channels;
+    size_t i;
+
+    make_room(r, d, n);
+
+    for (c = 0; c < channels; c++) {
+        float *dst = d->buf + c * d->capacity + (d->end - d->base);
+
+        if (src)
+            for (i = 0; i < n; i++)
+                dst[i] = src[i * channels + c];
+        else
+            memset(dst, 0, n * sizeof(float));
+    }
+
+    d->end += n;
+}
+
+static void reset_state(pa_resampler *r, struct polyphase_data *d) {
+    d->base = d->end = 0;
+    d->idx = 0;
+    d->frac = 0;
+    d->n_out = 0;
+
+    /* Center the first output frame on the first input frame */
+    append(r, d, NULL, d->bank->n_taps / 2 - 1);
+}
+
+static unsigned polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames,
+                                   pa_memchunk *output, unsigned *out_n_frames) {
+    struct polyphase_data *d;
+    const struct polyphase_bank *b;
+    unsigned o, c, channels = r->work_channels;
+    float *src, *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    d = r->impl.data;
+    b = d->bank;
+
+    src = pa_memblock_acquire_chunk(input);
+    append(r, d, src, in_n_frames);
+    pa_memblock_release(input->memblock);
+
+    dst = pa_memblock_acquire_chunk(output);
+
+    for (o = 0; o < *out_n_frames && d->idx + b->n_taps <= d->end; o++) {
+        const float *h, *x;
+
+        if (b->interpolated) {
+            unsigned phase = (unsigned) (d->frac >> SUBPHASE_BITS), t;
+            float w = (float) (d->frac & ((1 << SUBPHASE_BITS) - 1)) / (1 << SUBPHASE_BITS);
+            const float *h0 = b->coeffs + phase * b->n_taps, *h1 = h0 + b->n_taps;
+
+            for (t = 0; t < b->n_taps; t++)
+                d->coeffs[t] = h0[t] + w * (h1[t] - h0[t]);
+
+            h = d->coeffs;
+        } else
+            h = b->coeffs + d->frac * b->n_taps;
+
+        x = d->buf + (d->idx - d->base);
+
+        for (c = 0; c < channels; c++)
+            dst[o * channels + c] = dot_func(h, x + c * d->capacity, b->n_taps);
+
+        d->frac += d->step_frac;
+        if (d->frac >= d->den) {
+            d->frac -= d->den;
+            d->idx++;
+        }
+        d->idx += d->step_int;
+    }
+
+    pa_memblock_release(output->memblock);
+
+    d->n_out += o;
+    *out_n_frames = o;
+
+    /* Everything is kept in the history */
+    return 0;
+}
+
+static int polyphase_rewind(pa_resampler *r, size_t out_frames, size_t in_frames) {
+    struct polyphase_data *d;
+    uint64_t back_frac;
+    int64_t idx;
+    uint64_t frac;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+
+    if (out_frames > d->n_out)
+        return -1;
+
+    /* Step back out_frames times */
+    back_frac = (uint64_t) out_frames * d->step_frac;
+    idx = d->idx - (int64_t) out_frames * d->step_int - (int64_t) (back_frac / d->den);
+    back_frac %= d->den;
+    frac = d->frac;
+    if (frac < back_frac) {
+        frac += d->den;
+        idx--;
+    }
+    frac -= back_frac;
+
+    /* The position is absolute in the input, so the input going back by a
+     * different time than the output, as the callers round each on their
+     * own, does not matter as long as what is fed again lines up */
+    if (idx < d->base || d->end - (int64_t) in_frames < d->base)
+        return -1;
+
+    d->idx = idx;
+    d->frac = frac;
+    d->end -= (int64_t) in_frames;
+    d->n_out -= out_frames;
+
+    return 0;
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    struct polyphase_data *d;
+    unsigned old_taps;
+    uint64_t old_den;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+    old_taps = d->bank->n_taps;
+    old_den = d->den;
+
+    setup_rates(r, d);
+
+    /* Keep the position of the next output frame, the history stays
+     * as it is so there is no discontinuity */
+    d->idx += (int64_t) (old_taps / 2) - (int64_t) (d->bank->n_taps / 2);
+    d->frac = (uint64_t) ((double) d->frac * d->den / old_den);
+    if (d->frac >= d->den)
+        d->frac = d->den - 1;
+
+    if (d->idx < d->base) {
+        d->idx = d->base;
+        d->frac = 0;
+    }
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    pa_assert(r);
+
+    reset_state(r, r->impl.data);
+}
+
+static void polyphase_free(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+
+    if (!(d = r->impl.data))
+        return;
+
+    if (d->bank)
+        bank_unref(d->bank);
+    pa_xfree(d->coeffs);
+    pa_xfree(d->buf);
+    pa_xfree(d);
+
+    r->impl.data = NULL;
+}
+
+int pa_resampler_polyphase_init(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+
+    d = pa_xnew0(struct polyphase_data, 1);
+
+    setup_rates(r, d);
+    reset_state(r, d);
+
+    r->impl.free = polyphase_free;
+    r->impl.reset = polyphase_reset;
+    r->impl.update_rates = polyphase_update_rates;
+    r->impl.resample = polyphase_resample;
+    r->impl.rewind = polyphase_rewind;
+    r->impl.data = d;
+
+    return 0;
+}
@@ -0,0 +1,762 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "ringq.h"
+
+struct pa_ringq {
+    pa_mempool *pool;
+    pa_memblock *memblock;
+    uint8_t *data; /* memblock, acquired for as long as we own it */
+    size_t capacity;
+
+    /* The ring holds the data for the indexes start to end. Everything
+     * else is a hole that reads as silence. */
+    int64_t start, end;
+
+    size_t maxlength, tlength, base, prebuf, minreq, maxrewind;
+    int64_t read_index, write_index;
+    bool in_prebuf;
+    pa_memchunk silence;
+    int64_t missing, requested;
+    char *name;
+    pa_sample_spec sample_spec;
+};
+
+static size_t ring_offset(pa_ringq *q, int64_t idx) {
+    int64_t r;
+
+    r = idx % (int64_t) q->capacity;
+    if (r < 0)
+        r += (int64_t) q->capacity;
+
+    return (size_t) r;
+}
+
+static void copy_in(pa_ringq *q, int64_t idx, const uint8_t *src, size_t length) {
+    while (length > 0) {
+        size_t o, n;
+
+        o = ring_offset(q, idx);
+        n = PA_MIN(length, q->capacity - o);
+        memcpy(q->data + o, src, n);
+
+        src += n;
+        idx += (int64_t) n;
+        length -= n;
+    }
+}
+
+static void silence_in(pa_ringq *q, int64_t idx, size_t length) {
+    while (length > 0) {
+        size_t o, n;
+
+        o = ring_offset(q, idx);
+        n = PA_MIN(length, q->capacity - o);
+        pa_silence_memory(q->data + o, n, &q->sample_spec);
+
+        idx += (int64_t) n;
+        length -= n;
+    }
+}
+
+/* Copies length bytes starting at idx to dst, filling holes with silence */
+static void copy_out(pa_ringq *q, int64_t idx, uint8_t *dst, size_t length) {
+    while (length > 0) {
+        size_t n;
+
+        if (idx >= q->start && idx < q->end) {
+            size_t o;
+
+            o = ring_offset(q, idx);
+            n = PA_MIN(length, PA_MIN((size_t) (q->end - idx), q->capacity - o));
+            memcpy(dst, q->data + o, n);
+        } else {
+            if (idx < q->start && q->start < q->end)
+                n = PA_MIN(length, (size_t) (q->start - idx));
+            else
+                n = length;
+
+            pa_silence_memory(dst, n, &q->sample_spec);
+        }
+
+        dst += n;
+        idx += (int64_t) n;
+        length -= n;
+    }
+}
+
+/* Move the queued data to a ring of at least the given size */
+static void resize(pa_ringq *q, size_t capacity) {
+    pa_memblock *old_memblock;
+    uint8_t *old_data;
+    size_t old_capacity;
+    size_t m;
+
+    pa_assert(capacity > 0);
+    pa_assert(capacity % q->base == 0);
+
+    /* Whatever fits into a pool slot doesn't cost anything extra */
+    m = pa_mempool_block_size_max(q->pool);
+    if (capacity < m)
+        capacity = (m / q->base) * q->base;
+
+    old_memblock = q->memblock;
+    old_data = q->data;
+    old_capacity = q->capacity;
+
+    q->memblock = pa_memblock_new(q->pool, capacity);
+    q->data = pa_memblock_acquire(q->memblock);
+    q->capacity = capacity;
+
+    if (!old_memblock)
+        return;
+
+    pa_assert(q->end - q->start <= (int64_t) capacity);
+
+    if (q->start < q->end) {
+        int64_t idx = q->start;
+
+        while (idx < q->end) {
+            size_t o, n;
+
+            o = (size_t) (((idx % (int64_t) old_capacity) + (int64_t) old_capacity) % (int64_t) old_capacity);
+            n = PA_MIN((size_t) (q->end - idx), old_capacity - o);
+            copy_in(q, idx, old_data + o, n);
+
+            idx += (int64_t) n;
+        }
+    }
+
+    /* Peeked chunks keep their own reference to the old ring */
+    pa_memblock_release(old_memblock);
+    pa_memblock_unref(old_memblock);
+}
+
+static void ensure_capacity(pa_ringq *q) {
+    size_t need;
+
+    need = q->maxlength + q->maxrewind;
+
+    if (need > q->capacity) {
+        pa_log_debug("[%s] growing ring to %lu bytes", q->name, (unsigned long) need);
+        resize(q, need);
+    }
+}
+
+/* Forget everything that is more than maxrewind behind the read index,
+ * the equivalent of drop_backlog() in memblockq.c */
+static void trim(pa_ringq *q) {
+    int64_t boundary;
+
+    boundary = q->read_index - (int64_t) q->maxrewind;
+
+    if (q->start < boundary)
+        q->start = boundary;
+
+    if (q->end < q->start)
+        q->end = q->start;
+}
+
+pa_ringq* pa_ringq_new(
+        const char *name,
+        pa_mempool *pool,
+        int64_t idx,
+        size_t maxlength,
+        size_t tlength,
+        const pa_sample_spec *sample_spec,
+        size_t prebuf,
+        size_t minreq,
+        size_t maxrewind,
+        pa_memchunk *silence) {
+
+    pa_ringq *q;
+
+    pa_assert(sample_spec);
+    pa_assert(name);
+    pa_assert(pool);
+
+    q = pa_xnew0(pa_ringq, 1);
+    q->name = pa_xstrdup(name);
+    q->pool = pa_mempool_ref(pool);
+
+    q->sample_spec = *sample_spec;
+    q->base = pa_frame_size(sample_spec);
+    q->read_index = q->write_index = idx;
+    q->start = q->end = idx;
+
+    q->in_prebuf = true;
+
+    pa_ringq_set_maxlength(q, maxlength);
+    pa_ringq_set_tlength(q, tlength);
+    pa_ringq_set_minreq(q, minreq);
+    pa_ringq_set_prebuf(q, prebuf);
+    pa_ringq_set_maxrewind(q, maxrewind);
+
+    resize(q, q->maxlength + q->maxrewind);
+
+    pa_log_debug("ringq: maxlength=%lu, tlength=%lu, base=%lu, prebuf=%lu, minreq=%lu maxrewind=%lu capacity=%lu",
+                 (unsigned long) q->maxlength, (unsigned long) q->tlength, (unsigned long) q->base, (unsigned long) q->prebuf,
+                 (unsigned long) q->minreq, (unsigned long) q->maxrewind, (unsigned long) q->capacity);
+
+    if (silence) {
+        q->silence = *silence;
+        pa_memblock_ref(q->silence.memblock);
+    }
+
+    return q;
+}
+
+void pa_ringq_free(pa_ringq *q) {
+    pa_assert(q);
+
+    pa_memblock_release(q->memblock);
+    pa_memblock_unref(q->memblock);
+
+    if (q->silence.memblock)
+        pa_memblock_unref(q->silence.memblock);
+
+    pa_mempool_unref(q->pool);
+
+    pa_xfree(q->name);
+    pa_xfree(q);
+}
+
+static bool can_push(pa_ringq *q, size_t l) {
+    int64_t end;
+
+    pa_assert(q);
+
+    if (q->read_index > q->write_index) {
+        int64_t d = q->read_index - q->write_index;
+
+        if ((int64_t) l > d)
+            l -= (size_t) d;
+        else
+            return true;
+    }
+
+    end = q->start < q->end ? q->end : q->write_index;
+
+    /* Make sure that the queue doesn't get too long */
+    if (q->write_index + (int64_t) l > end)
+        if (q->write_index + (int64_t) l - q->read_index > (int64_t) q->maxlength)
+            return false;
+
+    return true;
+}
+
+static void write_index_changed(pa_ringq *q, int64_t old_write_index, bool account) {
+    int64_t delta;
+
+    pa_assert(q);
+
+    delta = q->write_index - old_write_index;
+
+    if (account)
+        q->requested -= delta;
+    else
+        q->missing -= delta;
+}
+
+static void read_index_changed(pa_ringq *q, int64_t old_read_index) {
+    int64_t delta;
+
+    pa_assert(q);
+
+    delta = q->read_index - old_read_index;
+    q->missing += delta;
+}
+
+int pa_ringq_push(pa_ringq *q, const pa_memchunk *chunk) {
+    int64_t old, lo, hi;
+
+    pa_assert(q);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+    pa_assert(chunk->length > 0);
+    pa_assert(chunk->index + chunk->length <= pa_memblock_get_length(chunk->memblock));
+
+    pa_assert(chunk->length % q->base == 0);
+    pa_assert(chunk->index % q->base == 0);
+
+    if (!can_push(q, chunk->length))
+        return -1;
+
+    old = q->write_index;
+    hi = q->write_index + (int64_t) chunk->length;
+
+    trim(q);
+
+    /* Anything further back than maxrewind could never be read again */
+    lo = PA_MAX(q->write_index, q->read_index - (int64_t) q->maxrewind);
+
+    if (hi > lo) {
+        int64_t new_start, new_end;
+        const uint8_t *src;
+
+        /* An empty ring can start over wherever we write */
+        if (q->end <= q->start)
+            q->start = q->end = lo;
+
+        new_start = PA_MIN(q->start, lo);
+        new_end = PA_MAX(q->end, hi);
+        if (new_end - new_start > (int64_t) q->capacity)
+            return -1;
+
+        /* Fill the holes between the old and the new data */
+        if (lo > q->end)
+            silence_in(q, q->end, (size_t) (lo - q->end));
+        else if (hi < q->start)
+            silence_in(q, hi, (size_t) (q->start - hi));
+
+        src = pa_memblock_acquire_chunk(chunk);
+        copy_in(q, lo, src + (lo - q->write_index), (size_t) (hi - lo));
+        pa_memblock_release(chunk->memblock);
+
+        q->start = new_start;
+        q->end = new_end;
+    }
+
+    q->write_index = hi;
+
+    write_index_changed(q, old, true);
+    return 0;
+}
+
+bool pa_ringq_prebuf_active(pa_ringq *q) {
+    pa_assert(q);
+
+    if (q->in_prebuf)
+        return pa_ringq_get_length(q) < q->prebuf;
+    else
+        return q->prebuf > 0 && q->read_index >= q->write_index;
+}
+
+static bool update_prebuf(pa_ringq *q) {
+    pa_assert(q);
+
+    if (q->in_prebuf) {
+
+        if (pa_ringq_get_length(q) < q->prebuf)
+            return true;
+
+        q->in_prebuf = false;
+        return false;
+    } else {
+
+        if (q->prebuf > 0 && q->read_index >= q->write_index) {
+            q->in_prebuf = true;
+            return true;
+        }
+
+        return false;
+    }
+}
+
+int pa_ringq_peek(pa_ringq *q, pa_memchunk *chunk) {
+    size_t length;
+
+    pa_assert(q);
+    pa_assert(chunk);
+
+    /* We need to pre-buffer */
+    if (update_prebuf(q))
+        return -1;
+
+    if (q->read_index >= q->start && q->read_index < q->end) {
+        size_t o;
+
+        o = ring_offset(q, q->read_index);
+
+        chunk->memblock = pa_memblock_ref(q->memblock);
+        chunk->index = o;
+        chunk->length = PA_MIN((size_t) (q->end - q->read_index), q->capacity - o);
+        return 0;
+    }
+
+    /* How much silence shall we return? */
+    if (q->read_index < q->start && q->start < q->end)
+        length = (size_t) (q->start - q->read_index);
+    else if (q->write_index > q->read_index)
+        length = (size_t) (q->write_index - q->read_index);
+    else
+        length = 0;
+
+    /* We need to return silence, since no data is yet available */
+    if (q->silence.memblock) {
+        *chunk = q->silence;
+        pa_memblock_ref(chunk->memblock);
+
+        if (length > 0 && length < chunk->length)
+            chunk->length = length;
+
+    } else {
+
+        /* If the ringq is empty, return -1, otherwise return
+         * the time to sleep */
+        if (length <= 0)
+            return -1;
+
+        chunk->memblock = NULL;
+        chunk->length = length;
+    }
+
+    chunk->index = 0;
+    return 0;
+}
+
+int pa_ringq_peek_fixed_size(pa_ringq *q, size_t block_size, pa_memchunk *chunk) {
+    pa_memchunk tchunk;
+    void *d;
+
+    pa_assert(q);
+    pa_assert(block_size > 0);
+    pa_assert(chunk);
+
+    if (pa_ringq_peek(q, &tchunk) < 0)
+        return -1;
+
+    if (tchunk.memblock && tchunk.length >= block_size) {
+        *chunk = tchunk;
+        chunk->length = block_size;
+        return 0;
+    }
+
+    if (tchunk.memblock)
+        pa_memblock_unref(tchunk.memblock);
+
+    chunk->memblock = pa_memblock_new(q->pool, block_size);
+    chunk->index = 0;
+    chunk->length = block_size;
+
+    d = pa_memblock_acquire(chunk->memblock);
+    copy_out(q, q->read_index, d, block_size);
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+void pa_ringq_drop(pa_ringq *q, size_t length) {
+    int64_t old;
+
+    pa_assert(q);
+    pa_assert(length % q->base == 0);
+
+    old = q->read_index;
+
+    while (length > 0) {
+
+        /* Do not drop any data when we are in prebuffering mode */
+        if (update_prebuf(q))
+            break;
+
+        if (q->start < q->end && q->read_index < q->end) {
+            int64_t p, d;
+
+            /* We stop at the write index on the way, to make sure we
+             * don't drop more than allowed by prebuf */
+            p = q->read_index < q->write_index ? PA_MIN(q->write_index, q->end) : q->end;
+            d = PA_MIN(p - q->read_index, (int64_t) length);
+
+            q->read_index += d;
+            length -= (size_t) d;
+
+        } else {
+
+            /* The queue is empty, there's nothing we could drop */
+            q->read_index += (int64_t) length;
+            break;
+        }
+    }
+
+    trim(q);
+    read_index_changed(q, old);
+}
+
+void pa_ringq_rewind(pa_ringq *q, size_t length) {
+    int64_t old;
+
+    pa_assert(q);
+    pa_assert(length % q->base == 0);
+
+    old = q->read_index;
+
+    q->read_index -= (int64_t) length;
+
+    read_index_changed(q, old);
+}
+
+bool pa_ringq_is_readable(pa_ringq *q) {
+    pa_assert(q);
+
+    if (pa_ringq_prebuf_active(q))
+        return false;
+
+    if (pa_ringq_get_length(q) <= 0)
+        return false;
+
+    return true;
+}
+
+size_t pa_ringq_get_length(pa_ringq *q) {
+    pa_assert(q);
+
+    if (q->write_index <= q->read_index)
+        return 0;
+
+    return (size_t) (q->write_index - q->read_index);
+}
+
+void pa_ringq_seek(pa_ringq *q, int64_t offset, pa_seek_mode_t seek, bool account) {
+    int64_t old;
+
+    pa_assert(q);
+
+    old = q->write_index;
+
+    switch (seek) {
+        case PA_SEEK_RELATIVE:
+            q->write_index += offset;
+            break;
+        case PA_SEEK_ABSOLUTE:
+            q->write_index = offset;
+            break;
+        case PA_SEEK_RELATIVE_ON_READ:
+            q->write_index = q->read_index + offset;
+            break;
+        case PA_SEEK_RELATIVE_END:
+            q->write_index = (q->start < q->end ? q->end : q->read_index) + offset;
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+
+    trim(q);
+    write_index_changed(q, old, account);
+}
+
+void pa_ringq_flush_write(pa_ringq *q, bool account) {
+    int64_t old;
+
+    pa_assert(q);
+
+    pa_ringq_silence(q);
+
+    old = q->write_index;
+    q->write_index = q->read_index;
+
+    pa_ringq_prebuf_force(q);
+    write_index_changed(q, old, account);
+}
+
+void pa_ringq_flush_read(pa_ringq *q) {
+    int64_t old;
+
+    pa_assert(q);
+
+    pa_ringq_silence(q);
+
+    old = q->read_index;
+    q->read_index = q->write_index;
+
+    pa_ringq_prebuf_force(q);
+    read_index_changed(q, old);
+}
+
+size_t pa_ringq_get_tlength(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->tlength;
+}
+
+size_t pa_ringq_get_minreq(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->minreq;
+}
+
+size_t pa_ringq_get_maxrewind(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->maxrewind;
+}
+
+size_t pa_ringq_get_maxlength(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->maxlength;
+}
+
+size_t pa_ringq_get_prebuf(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->prebuf;
+}
+
+size_t pa_ringq_get_base(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->base;
+}
+
+size_t pa_ringq_get_capacity(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->capacity;
+}
+
+int64_t pa_ringq_get_read_index(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->read_index;
+}
+
+int64_t pa_ringq_get_write_index(pa_ringq *q) {
+    pa_assert(q);
+
+    return q->write_index;
+}
+
+void pa_ringq_prebuf_disable(pa_ringq *q) {
+    pa_assert(q);
+
+    q->in_prebuf = false;
+}
+
+void pa_ringq_prebuf_force(pa_ringq *q) {
+    pa_assert(q);
+
+    if (q->prebuf > 0)
+        q->in_prebuf = true;
+}
+
+size_t pa_ringq_pop_missing(pa_ringq *q) {
+    size_t l;
+
+    pa_assert(q);
+
+    if (q->missing <= 0)
+        return 0;
+
+    if (((size_t) q->missing < q->minreq) &&
+        !pa_ringq_prebuf_active(q))
+        return 0;
+
+    l = (size_t) q->missing;
+
+    q->requested += q->missing;
+    q->missing = 0;
+
+    return l;
+}
+
+void pa_ringq_set_maxlength(pa_ringq *q, size_t maxlength) {
+    pa_assert(q);
+
+    q->maxlength = ((maxlength+q->base-1)/q->base)*q->base;
+
+    if (q->maxlength < q->base)
+        q->maxlength = q->base;
+
+    if (q->tlength > q->maxlength)
+        pa_ringq_set_tlength(q, q->maxlength);
+
+    if (q->memblock)
+        ensure_capacity(q);
+}
+
+void pa_ringq_set_tlength(pa_ringq *q, size_t tlength) {
+    size_t old_tlength;
+    pa_assert(q);
+
+    if (tlength <= 0 || tlength == (size_t) -1)
+        tlength = q->maxlength;
+
+    old_tlength = q->tlength;
+    q->tlength = ((tlength+q->base-1)/q->base)*q->base;
+
+    if (q->tlength > q->maxlength)
+        q->tlength = q->maxlength;
+
+    if (q->minreq > q->tlength)
+        pa_ringq_set_minreq(q, q->tlength);
+
+    if (q->prebuf > q->tlength+q->base-q->minreq)
+        pa_ringq_set_prebuf(q, q->tlength+q->base-q->minreq);
+
+    q->missing += (int64_t) q->tlength - (int64_t) old_tlength;
+}
+
+void pa_ringq_set_minreq(pa_ringq *q, size_t minreq) {
+    pa_assert(q);
+
+    q->minreq = (minreq/q->base)*q->base;
+
+    if (q->minreq > q->tlength)
+        q->minreq = q->tlength;
+
+    if (q->minreq < q->base)
+        q->minreq = q->base;
+
+    if (q->prebuf > q->tlength+q->base-q->minreq)
+        pa_ringq_set_prebuf(q, q->tlength+q->base-q->minreq);
+}
+
+void pa_ringq_set_prebuf(pa_ringq *q, size_t prebuf) {
+    pa_assert(q);
+
+    if (prebuf == (size_t) -1)
+        prebuf = q->tlength+q->base-q->minreq;
+
+    q->prebuf = ((prebuf+q->base-1)/q->base)*q->base;
+
+    if (prebuf > 0 && q->prebuf < q->base)
+        q->prebuf = q->base;
+
+    if (q->prebuf > q->tlength+q->base-q->minreq)
+        q->prebuf = q->tlength+q->base-q->minreq;
+
+    if (q->prebuf <= 0 || pa_ringq_get_length(q) >= q->prebuf)
+        q->in_prebuf = false;
+}
+
+void pa_ringq_set_maxrewind(pa_ringq *q, size_t maxrewind) {
+    pa_assert(q);
+
+    q->maxrewind = (maxrewind/q->base)*q->base;
+
+    if (q->memblock)
+        ensure_capacity(q);
+}
+
+void pa_ringq_silence(pa_ringq *q) {
+    pa_assert(q);
+
+    q->end = q->start;
+}
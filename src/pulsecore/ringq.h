@@ -0,0 +1,158 @@
+#ifndef fooringqhfoo
+#define fooringqhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+#include <pulse/def.h>
+
+/* A ringq is a drop-in alternative to a memblockq for queues that
+ * are fed with many small chunks at a steady rate, like the jitter
+ * buffers of network sources. Instead of keeping a list of references
+ * to the pushed memblocks, pushing copies the data into a single ring
+ * buffer memblock. Pushing and dropping then never allocate and never
+ * touch reference counts, and the queued data is contiguous in memory.
+ *
+ * Indexes, seeking, prebuffering, rewinding, the request accounting
+ * and the silence returned for missing data work exactly like in a
+ * memblockq, with these differences:
+ *
+ *  - The ring holds maxlength + maxrewind bytes. Data pushed more than
+ *    maxrewind bytes behind the read index is discarded right away, a
+ *    memblockq would only discard it on the next drop or seek.
+ *
+ *  - Holes left by seeking forward are filled with silence when data
+ *    is pushed behind them, so peeking them returns ring data instead
+ *    of the silence memchunk.
+ *
+ *  - Chunks returned by pa_ringq_peek() point into the ring. They stay
+ *    unchanged as long as the data is within maxrewind bytes of the
+ *    read index and is not overwritten by seeking back and pushing
+ *    again. Queues whose chunks are handed to a sink input must hence
+ *    keep maxrewind at least at pa_sink_input_get_max_rewind(), since
+ *    the sink input keeps them around for rewinding.
+ *
+ * Like a memblockq, a ringq is not thread-safe. */
+
+typedef struct pa_ringq pa_ringq;
+
+/* The parameters are the same as for pa_memblockq_new(). The ring
+ * memory is allocated from pool. */
+pa_ringq* pa_ringq_new(
+        const char *name,
+        pa_mempool *pool,
+        int64_t idx,
+        size_t maxlength,
+        size_t tlength,
+        const pa_sample_spec *sample_spec,
+        size_t prebuf,
+        size_t minreq,
+        size_t maxrewind,
+        pa_memchunk *silence);
+
+void pa_ringq_free(pa_ringq *q);
+
+/* Copy a chunk into the queue at the write index. Returns -1 if the
+ * queue would grow beyond maxlength. */
+int pa_ringq_push(pa_ringq *q, const pa_memchunk *chunk);
+
+/* Return a reference to the data at the read index, or silence, see
+ * pa_memblockq_peek(). The chunk never wraps around the end of the
+ * ring. */
+int pa_ringq_peek(pa_ringq *q, pa_memchunk *chunk);
+
+/* Much like pa_ringq_peek(), but always returns exactly block_size
+ * bytes, copied into a new memblock where the data wraps around or
+ * runs out */
+int pa_ringq_peek_fixed_size(pa_ringq *q, size_t block_size, pa_memchunk *chunk);
+
+/* Drop the specified bytes from the queue */
+void pa_ringq_drop(pa_ringq *q, size_t length);
+
+/* Rewind the read index */
+void pa_ringq_rewind(pa_ringq *q, size_t length);
+
+/* Change the current write index */
+void pa_ringq_seek(pa_ringq *q, int64_t offset, pa_seek_mode_t seek, bool account);
+
+/* Forget the queued data and seek the write index to the read index */
+void pa_ringq_flush_write(pa_ringq *q, bool account);
+
+/* Forget the queued data and seek the read index to the write index */
+void pa_ringq_flush_read(pa_ringq *q);
+
+/* Test if the ringq is currently readable, that is, more data than
+ * base and not in prebuffering mode */
+bool pa_ringq_is_readable(pa_ringq *q);
+
+/* Return the length of the queue in bytes */
+size_t pa_ringq_get_length(pa_ringq *q);
+
+/* Return the number of bytes that are missing since the last call to
+ * this function, reset the internal counter to 0. */
+size_t pa_ringq_pop_missing(pa_ringq *q);
+
+/* Returns the minimal request value */
+size_t pa_ringq_get_minreq(pa_ringq *q);
+
+/* Returns the maximal length */
+size_t pa_ringq_get_maxlength(pa_ringq *q);
+
+/* Returns the target length */
+size_t pa_ringq_get_tlength(pa_ringq *q);
+
+/* Returns the prebuf length */
+size_t pa_ringq_get_prebuf(pa_ringq *q);
+
+/* Returns the maximum rewind */
+size_t pa_ringq_get_maxrewind(pa_ringq *q);
+
+/* Return the base unit in bytes */
+size_t pa_ringq_get_base(pa_ringq *q);
+
+/* Return the size of the ring in bytes */
+size_t pa_ringq_get_capacity(pa_ringq *q);
+
+/* Returns the current read index */
+int64_t pa_ringq_get_read_index(pa_ringq *q);
+
+/* Returns the current write index */
+int64_t pa_ringq_get_write_index(pa_ringq *q);
+
+/* Change metrics. Growing maxlength or maxrewind beyond the ring
+ * capacity moves the queued data to a new, larger ring. Chunks peeked
+ * before stay valid. */
+void pa_ringq_set_maxlength(pa_ringq *q, size_t maxlength); /* might modify tlength, prebuf, minreq too */
+void pa_ringq_set_tlength(pa_ringq *q, size_t tlength); /* might modify minreq, too */
+void pa_ringq_set_minreq(pa_ringq *q, size_t minreq); /* might modify prebuf, too */
+void pa_ringq_set_prebuf(pa_ringq *q, size_t prebuf);
+void pa_ringq_set_maxrewind(pa_ringq *q, size_t maxrewind); /* Set the maximum history size */
+
+/* Manipulate the prebuffering state */
+void pa_ringq_prebuf_disable(pa_ringq *q);
+void pa_ringq_prebuf_force(pa_ringq *q);
+bool pa_ringq_prebuf_active(pa_ringq *q);
+
+/* Drop all queued data, but leave the indexes alone */
+void pa_ringq_silence(pa_ringq *q);
+
+#endif
@@ -26,6 +26,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#define USE_EPOLL
+#endif
 
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
@@ -36,6 +43,8 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/ratelimit.h>
 #include <pulse/rtclock.h>
@@ -44,7 +53,21 @@
 
 /* #define DEBUG_TIMING */
 
+#ifdef USE_EPOLL
+/* What we registered with epoll for one pollfd of an item */
+struct epoll_fd {
+    pa_rtpoll_item *item;
+    unsigned idx;
+
+    int fd;
+    short events;
+    bool registered;
+};
+#endif
+
 struct pa_rtpoll {
+    pa_rtpoll_backend_t backend;
+
     struct pollfd *pollfd, *pollfd2;
     unsigned n_pollfd_alloc, n_pollfd_used;
 
@@ -56,6 +79,35 @@ struct pa_rtpoll {
     bool rebuild_needed:1;
     bool quit:1;
     bool timer_elapsed:1;
+    bool dispatch_rebuild_needed:1;
+
+    /* The items that have a work, before or after callback set, in
+     * the order of the item list, so that we don't have to walk all
+     * items three times per iteration */
+    pa_rtpoll_item **work_items, **before_items, **after_items;
+    unsigned n_work_items, n_before_items, n_after_items, n_dispatch_alloc;
+
+#ifdef USE_EPOLL
+    int epoll_fd, timer_fd;
+
+    /* The deadline the timerfd is armed for, zero if disarmed */
+    struct timeval timer_armed;
+
+    /* Items whose pollfds might have changed since we last told epoll
+     * about them, linked via sync_next */
+    pa_rtpoll_item *sync_items;
+
+    /* fd -> struct epoll_fd, the current owner of a registration */
+    pa_hashmap *epoll_owners;
+
+    struct epoll_event *events;
+    unsigned n_events_alloc;
+
+    /* The pollfds whose revents the last epoll_wait() set */
+    struct epoll_fd **ready;
+    unsigned n_ready;
+    bool reset_revents_needed:1;
+#endif
 
 #ifdef DEBUG_TIMING
     pa_usec_t timestamp;
@@ -81,12 +133,134 @@ struct pa_rtpoll_item {
     void *before_userdata;
     void *after_userdata;
 
+#ifdef USE_EPOLL
+    struct epoll_fd *epoll_fds;
+    bool sync_needed;
+    pa_rtpoll_item *sync_next;
+#endif
+
     PA_LLIST_FIELDS(pa_rtpoll_item);
 };
 
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
+static pa_rtpoll_backend_t default_backend = PA_RTPOLL_BACKEND_PPOLL;
+
+void pa_rtpoll_set_default_backend(pa_rtpoll_backend_t backend) {
+    pa_assert(backend == PA_RTPOLL_BACKEND_PPOLL || backend == PA_RTPOLL_BACKEND_EPOLL);
+
+    default_backend = backend;
+}
+
+pa_rtpoll_backend_t pa_rtpoll_get_default_backend(void) {
+    return default_backend;
+}
+
+const char *pa_rtpoll_backend_to_string(pa_rtpoll_backend_t backend) {
+    switch (backend) {
+        case PA_RTPOLL_BACKEND_PPOLL:
+            return "ppoll";
+        case PA_RTPOLL_BACKEND_EPOLL:
+            return "epoll";
+    }
+
+    pa_assert_not_reached();
+}
+
+int pa_rtpoll_backend_from_string(const char *s) {
+    pa_assert(s);
+
+    if (pa_streq(s, "ppoll"))
+        return PA_RTPOLL_BACKEND_PPOLL;
+    if (pa_streq(s, "epoll"))
+        return PA_RTPOLL_BACKEND_EPOLL;
+
+    return -1;
+}
+
+#ifdef USE_EPOLL
+static int epoll_init(pa_rtpoll *p) {
+    struct epoll_event ev;
+
+    pa_assert(p);
+
+    p->epoll_fd = p->timer_fd = -1;
+
+    if ((p->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_warn("epoll_create1() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK)) < 0) {
+        pa_log_warn("timerfd_create() failed: %s", pa_cstrerror(errno));
+        pa_close(p->epoll_fd);
+        p->epoll_fd = -1;
+        return -1;
+    }
+
+    /* The timer is told apart from the pollfds by its NULL pointer */
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+        pa_log_warn("epoll_ctl() failed: %s", pa_cstrerror(errno));
+        pa_close(p->timer_fd);
+        pa_close(p->epoll_fd);
+        p->epoll_fd = p->timer_fd = -1;
+        return -1;
+    }
+
+    p->epoll_owners = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    return 0;
+}
+
+static void epoll_done(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (p->epoll_owners)
+        pa_hashmap_free(p->epoll_owners);
+    p->epoll_owners = NULL;
+
+    if (p->timer_fd >= 0)
+        pa_close(p->timer_fd);
+    if (p->epoll_fd >= 0)
+        pa_close(p->epoll_fd);
+    p->epoll_fd = p->timer_fd = -1;
+
+    pa_xfree(p->events);
+    p->events = NULL;
+    pa_xfree(p->ready);
+    p->ready = NULL;
+    p->n_events_alloc = p->n_ready = 0;
+}
+
+/* Something epoll cannot do the way poll() does, like watching a
+ * regular file or the same fd twice. ppoll() copes with everything,
+ * so continue with that. */
+static void epoll_give_up(pa_rtpoll *p, int fd, const char *what) {
+    pa_rtpoll_item *i;
+
+    pa_assert(p);
+
+    pa_log_info("Cannot %s fd %i with epoll (%s), falling back to ppoll().", what, fd, pa_cstrerror(errno));
+
+    epoll_done(p);
+    p->backend = PA_RTPOLL_BACKEND_PPOLL;
+
+    while ((i = p->sync_items)) {
+        p->sync_items = i->sync_next;
+        i->sync_needed = false;
+    }
+}
+#endif
+
 pa_rtpoll *pa_rtpoll_new(void) {
+    return pa_rtpoll_new_with_backend(default_backend);
+}
+
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t backend) {
     pa_rtpoll *p;
 
     p = pa_xnew0(pa_rtpoll, 1);
@@ -95,6 +269,17 @@ pa_rtpoll *pa_rtpoll_new(void) {
     p->pollfd = pa_xnew(struct pollfd, p->n_pollfd_alloc);
     p->pollfd2 = pa_xnew(struct pollfd, p->n_pollfd_alloc);
 
+    p->backend = PA_RTPOLL_BACKEND_PPOLL;
+
+    if (backend == PA_RTPOLL_BACKEND_EPOLL) {
+#ifdef USE_EPOLL
+        if (epoll_init(p) >= 0)
+            p->backend = PA_RTPOLL_BACKEND_EPOLL;
+#else
+        pa_log_info("epoll is not supported on this system, using ppoll().");
+#endif
+    }
+
 #ifdef DEBUG_TIMING
     p->timestamp = pa_rtclock_now();
 #endif
@@ -102,6 +287,12 @@ pa_rtpoll *pa_rtpoll_new(void) {
     return p;
 }
 
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p) {
+    pa_assert(p);
+
+    return p->backend;
+}
+
 static void rtpoll_rebuild(pa_rtpoll *p) {
 
     struct pollfd *e, *t;
@@ -147,6 +338,190 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
 }
 
+static void rtpoll_rebuild_dispatch(pa_rtpoll *p) {
+    pa_rtpoll_item *i;
+    unsigned n = 0;
+
+    pa_assert(p);
+
+    p->dispatch_rebuild_needed = false;
+
+    for (i = p->items; i; i = i->next)
+        n++;
+
+    if (n > p->n_dispatch_alloc) {
+        p->n_dispatch_alloc = n * 2;
+        p->work_items = pa_xrenew(pa_rtpoll_item*, p->work_items, p->n_dispatch_alloc);
+        p->before_items = pa_xrenew(pa_rtpoll_item*, p->before_items, p->n_dispatch_alloc);
+        p->after_items = pa_xrenew(pa_rtpoll_item*, p->after_items, p->n_dispatch_alloc);
+    }
+
+    p->n_work_items = p->n_before_items = p->n_after_items = 0;
+
+    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
+        if (i->work_cb)
+            p->work_items[p->n_work_items++] = i;
+        if (i->before_cb)
+            p->before_items[p->n_before_items++] = i;
+        if (i->after_cb)
+            p->after_items[p->n_after_items++] = i;
+    }
+}
+
+#ifdef USE_EPOLL
+static void epoll_fd_unregister(pa_rtpoll *p, struct epoll_fd *e) {
+    pa_assert(p);
+    pa_assert(e);
+
+    if (!e->registered)
+        return;
+
+    e->registered = false;
+
+    if (pa_hashmap_get(p->epoll_owners, PA_INT_TO_PTR(e->fd + 1)) != e)
+        return;
+
+    pa_hashmap_remove(p->epoll_owners, PA_INT_TO_PTR(e->fd + 1));
+
+    /* If the fd has already been closed, the kernel dropped it from
+     * the epoll set by itself */
+    if (epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, e->fd, NULL) < 0 && errno != EBADF && errno != ENOENT)
+        pa_log_warn("epoll_ctl(EPOLL_CTL_DEL) failed: %s", pa_cstrerror(errno));
+}
+
+static int epoll_fd_register(pa_rtpoll *p, struct epoll_fd *e, int fd, short events) {
+    struct epoll_event ev;
+    struct epoll_fd *owner;
+    int op = EPOLL_CTL_ADD;
+
+    pa_assert(p);
+    pa_assert(e);
+    pa_assert(fd >= 0);
+
+    if ((owner = pa_hashmap_get(p->epoll_owners, PA_INT_TO_PTR(fd + 1)))) {
+
+        /* The same fd is watched by an item that is about to go away,
+         * it was most likely closed and the number reused since. Take
+         * its registration over. */
+        if (owner->item->dead) {
+            owner->registered = false;
+            pa_hashmap_remove(p->epoll_owners, PA_INT_TO_PTR(fd + 1));
+            op = EPOLL_CTL_MOD;
+        } else {
+            errno = EEXIST;
+            return -1;
+        }
+    }
+
+    pa_zero(ev);
+    ev.events = (uint32_t) events;
+    ev.data.ptr = e;
+
+    if (epoll_ctl(p->epoll_fd, op, fd, &ev) < 0) {
+        if (op == EPOLL_CTL_MOD && errno == ENOENT)
+            op = EPOLL_CTL_ADD;
+        else
+            return -1;
+
+        if (epoll_ctl(p->epoll_fd, op, fd, &ev) < 0)
+            return -1;
+    }
+
+    pa_assert_se(pa_hashmap_put(p->epoll_owners, PA_INT_TO_PTR(fd + 1), e) == 0);
+
+    e->fd = fd;
+    e->events = events;
+    e->registered = true;
+
+    return 0;
+}
+
+/* Bring the epoll set up to date with the pollfds of one item */
+static int epoll_sync_item(pa_rtpoll *p, pa_rtpoll_item *i) {
+    unsigned k;
+
+    pa_assert(p);
+    pa_assert(i);
+
+    for (k = 0; k < i->n_pollfd; k++) {
+        struct epoll_fd *e = &i->epoll_fds[k];
+        const struct pollfd *f = &i->pollfd[k];
+        struct epoll_event ev;
+
+        if (e->registered && e->fd == f->fd) {
+            if (e->events == f->events)
+                continue;
+
+            pa_zero(ev);
+            ev.events = (uint32_t) f->events;
+            ev.data.ptr = e;
+
+            if (epoll_ctl(p->epoll_fd, EPOLL_CTL_MOD, f->fd, &ev) < 0) {
+                epoll_give_up(p, f->fd, "modify");
+                return -1;
+            }
+
+            e->events = f->events;
+            continue;
+        }
+
+        epoll_fd_unregister(p, e);
+
+        /* Like poll() we ignore negative fds */
+        if (f->fd < 0)
+            continue;
+
+        if (epoll_fd_register(p, e, f->fd, f->events) < 0) {
+            epoll_give_up(p, f->fd, "watch");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void epoll_item_mark_sync(pa_rtpoll_item *i) {
+    pa_assert(i);
+
+    if (i->rtpoll->backend != PA_RTPOLL_BACKEND_EPOLL || i->n_pollfd <= 0 || i->sync_needed)
+        return;
+
+    i->sync_needed = true;
+    i->sync_next = i->rtpoll->sync_items;
+    i->rtpoll->sync_items = i;
+}
+
+static void epoll_item_destroy(pa_rtpoll_item *i) {
+    pa_rtpoll *p;
+    unsigned k;
+
+    pa_assert(i);
+
+    p = i->rtpoll;
+
+    if (i->sync_needed) {
+        pa_rtpoll_item **j;
+
+        for (j = &p->sync_items; *j != i; j = &(*j)->sync_next)
+            pa_assert(*j);
+
+        *j = i->sync_next;
+        i->sync_needed = false;
+    }
+
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL)
+        for (k = 0; k < i->n_pollfd; k++)
+            epoll_fd_unregister(p, &i->epoll_fds[k]);
+
+    pa_xfree(i->epoll_fds);
+    i->epoll_fds = NULL;
+
+    /* The ready list might point to this item */
+    p->n_ready = 0;
+    p->reset_revents_needed = true;
+}
+#endif
+
 static void rtpoll_item_destroy(pa_rtpoll_item *i) {
     pa_rtpoll *p;
 
@@ -154,6 +529,10 @@ static void rtpoll_item_destroy(pa_rtpoll_item *i) {
 
     p = i->rtpoll;
 
+#ifdef USE_EPOLL
+    epoll_item_destroy(i);
+#endif
+
     PA_LLIST_REMOVE(pa_rtpoll_item, p->items, i);
 
     p->n_pollfd_used -= i->n_pollfd;
@@ -162,6 +541,7 @@ static void rtpoll_item_destroy(pa_rtpoll_item *i) {
         pa_xfree(i);
 
     p->rebuild_needed = true;
+    p->dispatch_rebuild_needed = true;
 }
 
 void pa_rtpoll_free(pa_rtpoll *p) {
@@ -170,23 +550,28 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     while (p->items)
         rtpoll_item_destroy(p->items);
 
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL)
+        epoll_done(p);
+#endif
+
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
+    pa_xfree(p->work_items);
+    pa_xfree(p->before_items);
+    pa_xfree(p->after_items);
+
     pa_xfree(p);
 }
 
 static void reset_revents(pa_rtpoll_item *i) {
-    struct pollfd *f;
     unsigned n;
 
     pa_assert(i);
 
-    if (!(f = pa_rtpoll_item_get_pollfd(i, &n)))
-        return;
-
-    for (; n > 0; n--)
-        f[n-1].revents = 0;
+    for (n = 0; n < i->n_pollfd; n++)
+        i->pollfd[n].revents = 0;
 }
 
 static void reset_all_revents(pa_rtpoll *p) {
@@ -194,6 +579,9 @@ static void reset_all_revents(pa_rtpoll *p) {
 
     pa_assert(p);
 
+    if (p->rebuild_needed)
+        rtpoll_rebuild(p);
+
     for (i = p->items; i; i = i->next) {
 
         if (i->dead)
@@ -203,8 +591,153 @@ static void reset_all_revents(pa_rtpoll *p) {
     }
 }
 
+/* Sleep with ppoll() on all pollfds. Returns what ppoll() returns. */
+static int rtpoll_sleep_ppoll(pa_rtpoll *p, const struct timeval *timeout) {
+    int r;
+
+    pa_assert(p);
+    pa_assert(timeout);
+
+#ifdef HAVE_PPOLL
+    {
+        struct timespec ts;
+        ts.tv_sec = timeout->tv_sec;
+        ts.tv_nsec = timeout->tv_usec * 1000;
+        r = ppoll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? &ts : NULL, NULL);
+    }
+#else
+    r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout->tv_sec*1000) + (timeout->tv_usec / 1000)) : -1);
+#endif
+
+    p->timer_elapsed = r == 0;
+
+    return r;
+}
+
+#ifdef USE_EPOLL
+static bool timeval_isset(const struct timeval *tv) {
+    return tv->tv_sec != 0 || tv->tv_usec != 0;
+}
+
+static int epoll_arm_timer(pa_rtpoll *p, const struct timeval *deadline) {
+    struct itimerspec its;
+
+    pa_assert(p);
+
+    if (deadline) {
+        if (pa_timeval_cmp(&p->timer_armed, deadline) == 0)
+            return 0;
+    } else if (!timeval_isset(&p->timer_armed))
+        return 0;
+
+    pa_zero(its);
+
+    if (deadline) {
+        its.it_value.tv_sec = deadline->tv_sec;
+        its.it_value.tv_nsec = deadline->tv_usec * 1000;
+    }
+
+    if (timerfd_settime(p->timer_fd, deadline ? TFD_TIMER_ABSTIME : 0, &its, NULL) < 0) {
+        pa_log_error("timerfd_settime(): %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    if (deadline)
+        p->timer_armed = *deadline;
+    else
+        pa_zero(p->timer_armed);
+
+    return 0;
+}
+
+/* Sleep with epoll_wait(), with the timer on the timerfd. Only the
+ * pollfds epoll reports as ready get their revents set, the ones set
+ * by the previous call are cleared. Returns -1 on failure, the number
+ * of ready events otherwise. Might fall back to ppoll(). */
+static int rtpoll_sleep_epoll(pa_rtpoll *p, const struct timeval *timeout) {
+    pa_rtpoll_item *i;
+    unsigned k;
+    int r, n_fd_ready = 0;
+    bool timer = false;
+
+    pa_assert(p);
+    pa_assert(timeout);
+
+    /* Tell epoll about all pollfds that might have changed */
+    while ((i = p->sync_items)) {
+        p->sync_items = i->sync_next;
+        i->sync_needed = false;
+
+        if (i->dead)
+            continue;
+
+        if (epoll_sync_item(p, i) < 0)
+            return rtpoll_sleep_ppoll(p, timeout);
+    }
+
+    if (p->reset_revents_needed) {
+        p->reset_revents_needed = false;
+        reset_all_revents(p);
+    } else
+        for (k = 0; k < p->n_ready; k++)
+            p->ready[k]->item->pollfd[p->ready[k]->idx].revents = 0;
+
+    p->n_ready = 0;
+
+    /* A zero timeout means that the deadline has already passed or
+     * that we are quitting, in that case we don't need the timerfd */
+    if (!p->quit && p->timer_enabled && timeval_isset(timeout)) {
+        if (epoll_arm_timer(p, &p->next_elapse) < 0)
+            return -1;
+    } else if (!p->timer_enabled) {
+        if (epoll_arm_timer(p, NULL) < 0)
+            return -1;
+    }
+
+    if (p->n_events_alloc < p->n_pollfd_used + 1) {
+        p->n_events_alloc = (p->n_pollfd_used + 1) * 2;
+        p->events = pa_xrenew(struct epoll_event, p->events, p->n_events_alloc);
+        p->ready = pa_xrenew(struct epoll_fd*, p->ready, p->n_events_alloc);
+    }
+
+    r = epoll_wait(p->epoll_fd, p->events, (int) p->n_events_alloc,
+                   (p->quit || (p->timer_enabled && !timeval_isset(timeout))) ? 0 : -1);
+
+    if (r < 0)
+        return r;
+
+    for (k = 0; k < (unsigned) r; k++) {
+        struct epoll_fd *e = p->events[k].data.ptr;
+
+        if (!e) {
+            uint64_t expirations;
+
+            /* The timer fired and is disarmed now */
+            if (read(p->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                pa_log_error("read() from timerfd: %s", pa_cstrerror(errno));
+
+            pa_zero(p->timer_armed);
+            timer = true;
+            continue;
+        }
+
+        /* The epoll event bits are the same as the poll ones */
+        e->item->pollfd[e->idx].revents = (short) (p->events[k].events & 0xffff);
+        p->ready[p->n_ready++] = e;
+        n_fd_ready++;
+    }
+
+    /* Same as with ppoll(): the timer only counts as elapsed if
+     * nothing else woke us up */
+    p->timer_elapsed = n_fd_ready == 0 && (timer || r == 0);
+
+    return n_fd_ready;
+}
+#endif
+
 int pa_rtpoll_run(pa_rtpoll *p) {
     pa_rtpoll_item *i;
+    unsigned k;
     int r = 0;
     struct timeval timeout;
 
@@ -218,14 +751,16 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     p->running = true;
     p->timer_elapsed = false;
 
+    if (p->dispatch_rebuild_needed)
+        rtpoll_rebuild_dispatch(p);
+
     /* First, let's do some work */
-    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
-        int k;
+    for (k = 0; k < p->n_work_items; k++) {
+        int j;
 
-        if (i->dead)
-            continue;
+        i = p->work_items[k];
 
-        if (!i->work_cb)
+        if (i->dead)
             continue;
 
         if (p->quit) {
@@ -235,9 +770,9 @@ int pa_rtpoll_run(pa_rtpoll *p) {
             goto finish;
         }
 
-        if ((k = i->work_cb(i)) != 0) {
-            if (k < 0)
-                r = k;
+        if ((j = i->work_cb(i)) != 0) {
+            if (j < 0)
+                r = j;
 #ifdef DEBUG_TIMING
             pa_log("rtpoll finish");
 #endif
@@ -246,16 +781,15 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     }
 
     /* Now let's prepare for entering the sleep */
-    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
-        int k = 0;
+    for (k = 0; k < p->n_before_items; k++) {
+        int j = 0;
 
-        if (i->dead)
-            continue;
+        i = p->before_items[k];
 
-        if (!i->before_cb)
+        if (i->dead)
             continue;
 
-        if (p->quit || (k = i->before_cb(i)) != 0) {
+        if (p->quit || (j = i->before_cb(i)) != 0) {
 
             /* Hmm, this one doesn't let us enter the poll, so rewind everything */
 
@@ -270,8 +804,8 @@ int pa_rtpoll_run(pa_rtpoll *p) {
                 i->after_cb(i);
             }
 
-            if (k < 0)
-                r = k;
+            if (j < 0)
+                r = j;
 #ifdef DEBUG_TIMING
             pa_log("rtpoll finish");
 #endif
@@ -308,18 +842,12 @@ int pa_rtpoll_run(pa_rtpoll *p) {
 #endif
 
     /* OK, now let's sleep */
-#ifdef HAVE_PPOLL
-    {
-        struct timespec ts;
-        ts.tv_sec = timeout.tv_sec;
-        ts.tv_nsec = timeout.tv_usec * 1000;
-        r = ppoll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? &ts : NULL, NULL);
-    }
-#else
-    r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL)
+        r = rtpoll_sleep_epoll(p, &timeout);
+    else
 #endif
-
-    p->timer_elapsed = r == 0;
+        r = rtpoll_sleep_ppoll(p, &timeout);
 
 #ifdef DEBUG_TIMING
     {
@@ -343,14 +871,12 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     }
 
     /* Let's tell everyone that we left the sleep */
-    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
+    for (k = 0; k < p->n_after_items; k++) {
+        i = p->after_items[k];
 
         if (i->dead)
             continue;
 
-        if (!i->after_cb)
-            continue;
-
         i->after_cb(i);
     }
 
@@ -420,6 +946,24 @@ pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsi
     i->after_cb = NULL;
     i->work_cb = NULL;
 
+#ifdef USE_EPOLL
+    i->epoll_fds = NULL;
+    i->sync_needed = false;
+    i->sync_next = NULL;
+
+    if (n_fds > 0) {
+        unsigned k;
+
+        i->epoll_fds = pa_xnew0(struct epoll_fd, n_fds);
+
+        for (k = 0; k < n_fds; k++) {
+            i->epoll_fds[k].item = i;
+            i->epoll_fds[k].idx = k;
+            i->epoll_fds[k].fd = -1;
+        }
+    }
+#endif
+
     for (j = p->items; j; j = j->next) {
         if (prio <= j->priority)
             break;
@@ -434,6 +978,8 @@ pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsi
         p->n_pollfd_used += n_fds;
     }
 
+    p->dispatch_rebuild_needed = true;
+
     return i;
 }
 
@@ -456,6 +1002,11 @@ struct pollfd *pa_rtpoll_item_get_pollfd(pa_rtpoll_item *i, unsigned *n_fds) {
         if (i->rtpoll->rebuild_needed)
             rtpoll_rebuild(i->rtpoll);
 
+#ifdef USE_EPOLL
+    /* The caller might change the fds or events */
+    epoll_item_mark_sync(i);
+#endif
+
     if (n_fds)
         *n_fds = i->n_pollfd;
 
@@ -468,6 +1019,7 @@ void pa_rtpoll_item_set_before_callback(pa_rtpoll_item *i, int (*before_cb)(pa_r
 
     i->before_cb = before_cb;
     i->before_userdata = userdata;
+    i->rtpoll->dispatch_rebuild_needed = true;
 }
 
 void pa_rtpoll_item_set_after_callback(pa_rtpoll_item *i, void (*after_cb)(pa_rtpoll_item *i), void *userdata) {
@@ -476,6 +1028,7 @@ void pa_rtpoll_item_set_after_callback(pa_rtpoll_item *i, void (*after_cb)(pa_rt
 
     i->after_cb = after_cb;
     i->after_userdata = userdata;
+    i->rtpoll->dispatch_rebuild_needed = true;
 }
 
 void pa_rtpoll_item_set_work_callback(pa_rtpoll_item *i, int (*work_cb)(pa_rtpoll_item *i), void *userdata) {
@@ -484,6 +1037,7 @@ void pa_rtpoll_item_set_work_callback(pa_rtpoll_item *i, int (*work_cb)(pa_rtpol
 
     i->work_cb = work_cb;
     i->work_userdata = userdata;
+    i->rtpoll->dispatch_rebuild_needed = true;
 }
 
 void* pa_rtpoll_item_get_work_userdata(pa_rtpoll_item *i) {
@@ -39,7 +39,17 @@
  * 3) It allows arbitrary functions to be run before entering the
  * actual poll() and after it.
  *
- * Only a single interval timer is supported. */
+ * Only a single interval timer is supported.
+ *
+ * On Linux the loop can alternatively sleep in epoll_wait(), with the
+ * timer on a timerfd. The fds then stay registered with the kernel
+ * between iterations and only the pollfds that became ready have
+ * their revents touched. Whenever an fd or its events might have
+ * changed pa_rtpoll_item_get_pollfd() has to be called first, which
+ * the API requires anyway. An fd that is closed and reopened with
+ * the same number needs a new item. Anything epoll cannot handle,
+ * like the same fd in two items, makes the loop fall back to
+ * ppoll(). */
 
 typedef struct pa_rtpoll pa_rtpoll;
 typedef struct pa_rtpoll_item pa_rtpoll_item;
@@ -51,9 +61,28 @@ typedef enum pa_rtpoll_priority {
     PA_RTPOLL_NEVER  = INT_MAX,       /* For stuff that doesn't register any callbacks, but only fds to listen on */
 } pa_rtpoll_priority_t;
 
+typedef enum pa_rtpoll_backend {
+    PA_RTPOLL_BACKEND_PPOLL,
+    PA_RTPOLL_BACKEND_EPOLL,
+} pa_rtpoll_backend_t;
+
+/* The backend pa_rtpoll_new() uses. Should be set once at startup,
+ * before any IO threads are created. Defaults to ppoll. */
+void pa_rtpoll_set_default_backend(pa_rtpoll_backend_t backend);
+pa_rtpoll_backend_t pa_rtpoll_get_default_backend(void);
+
+const char *pa_rtpoll_backend_to_string(pa_rtpoll_backend_t backend);
+int pa_rtpoll_backend_from_string(const char *s);
+
 pa_rtpoll *pa_rtpoll_new(void);
+
+/* If the backend is not available, ppoll is used instead */
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t backend);
 void pa_rtpoll_free(pa_rtpoll *p);
 
+/* Returns the backend actually in use */
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p);
+
 /* Sleep on the rtpoll until the time event, or any of the fd events
  * is triggered. Returns negative on error, positive if the loop
  * should continue to run, 0 when the loop should be terminated
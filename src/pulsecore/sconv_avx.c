@@ -0,0 +1,354 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "sconv.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <immintrin.h>
+
+/* Samples are loaded into 32-bit lanes, scaled to the full range like
+ * S32NE, and stored from there. Byte order and packing are handled by
+ * the byte shuffles of the loads and stores, so every format pair is a
+ * load and a store. Eight samples are converted at a time, the last
+ * ones through a bounce buffer. */
+#define DEFINE_CONVERT_AVX2(name, in_size, out_size, load, conv, store) \
+    static void name(unsigned n, const void *a, void *b) {              \
+        const uint8_t *s = a;                                           \
+        uint8_t *d = b;                                                 \
+                                                                        \
+        for (; n >= 8; n -= 8, s += 8 * (in_size), d += 8 * (out_size)) \
+            store(d, conv(load(s)));                                    \
+                                                                        \
+        if (n > 0) {                                                    \
+            uint8_t ts[8 * 4] = { 0 }, td[8 * 4];                       \
+                                                                        \
+            memcpy(ts, s, n * (in_size));                               \
+            store(td, conv(load(ts)));                                  \
+            memcpy(d, td, n * (out_size));                              \
+        }                                                               \
+    }
+
+#define LANE_MASK(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+#define SWAP16_MASK LANE_MASK(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+#define SWAP32_MASK LANE_MASK(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+
+/* S24_32 is shifted up by a byte on load and down on store */
+#define S24_32LE_LOAD_MASK LANE_MASK(-1, 0, 1, 2, -1, 4, 5, 6, -1, 8, 9, 10, -1, 12, 13, 14)
+#define S24_32LE_STORE_MASK LANE_MASK(1, 2, 3, -1, 5, 6, 7, -1, 9, 10, 11, -1, 13, 14, 15, -1)
+#define S24_32BE_MASK LANE_MASK(-1, 3, 2, 1, -1, 7, 6, 5, -1, 11, 10, 9, -1, 15, 14, 13)
+
+/* Four packed S24 samples in the low 12 bytes of each lane */
+#define S24LE_LOAD_MASK LANE_MASK(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11)
+#define S24BE_LOAD_MASK LANE_MASK(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9)
+#define S24LE_STORE_MASK LANE_MASK(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1)
+#define S24BE_STORE_MASK LANE_MASK(3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1)
+
+static inline __m256i same_avx2(__m256i x) {
+    return x;
+}
+
+/* s16 */
+
+static inline __m256i load_s16ne_avx2(const uint8_t *s) {
+    return _mm256_slli_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) s)), 16);
+}
+
+static inline __m256i load_s16re_avx2(const uint8_t *s) {
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) s), _mm256_castsi256_si128(SWAP16_MASK));
+
+    return _mm256_slli_epi32(_mm256_cvtepi16_epi32(x), 16);
+}
+
+static inline __m128i pack_s16_avx2(__m256i x) {
+    x = _mm256_srai_epi32(x, 16);
+
+    return _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+}
+
+static inline void store_s16ne_avx2(uint8_t *d, __m256i x) {
+    _mm_storeu_si128((__m128i *) d, pack_s16_avx2(x));
+}
+
+static inline void store_s16re_avx2(uint8_t *d, __m256i x) {
+    _mm_storeu_si128((__m128i *) d, _mm_shuffle_epi8(pack_s16_avx2(x), _mm256_castsi256_si128(SWAP16_MASK)));
+}
+
+/* s32, s24_32 */
+
+static inline __m256i load_s32ne_avx2(const uint8_t *s) {
+    return _mm256_loadu_si256((const __m256i *) s);
+}
+
+static inline __m256i load_s32re_avx2(const uint8_t *s) {
+    return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) s), SWAP32_MASK);
+}
+
+static inline __m256i load_s24_32le_avx2(const uint8_t *s) {
+    return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) s), S24_32LE_LOAD_MASK);
+}
+
+static inline __m256i load_s24_32be_avx2(const uint8_t *s) {
+    return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) s), S24_32BE_MASK);
+}
+
+static inline void store_s32ne_avx2(uint8_t *d, __m256i x) {
+    _mm256_storeu_si256((__m256i *) d, x);
+}
+
+static inline void store_s32re_avx2(uint8_t *d, __m256i x) {
+    _mm256_storeu_si256((__m256i *) d, _mm256_shuffle_epi8(x, SWAP32_MASK));
+}
+
+static inline void store_s24_32le_avx2(uint8_t *d, __m256i x) {
+    _mm256_storeu_si256((__m256i *) d, _mm256_shuffle_epi8(x, S24_32LE_STORE_MASK));
+}
+
+static inline void store_s24_32be_avx2(uint8_t *d, __m256i x) {
+    _mm256_storeu_si256((__m256i *) d, _mm256_shuffle_epi8(x, S24_32BE_MASK));
+}
+
+/* s24, spread over the lanes as 12 + 12 bytes without touching memory
+ * past the 24 bytes of the samples */
+
+static inline __m256i load_s24_avx2(const uint8_t *s, __m256i mask) {
+    __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) s)),
+                                        _mm_loadl_epi64((const __m128i *) (s + 16)), 1);
+
+    x = _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6));
+    return _mm256_shuffle_epi8(x, mask);
+}
+
+static inline __m256i load_s24le_avx2(const uint8_t *s) {
+    return load_s24_avx2(s, S24LE_LOAD_MASK);
+}
+
+static inline __m256i load_s24be_avx2(const uint8_t *s) {
+    return load_s24_avx2(s, S24BE_LOAD_MASK);
+}
+
+static inline void store_s24_avx2(uint8_t *d, __m256i x, __m256i mask) {
+    x = _mm256_shuffle_epi8(x, mask);
+    x = _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+    _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(x));
+    _mm_storel_epi64((__m128i *) (d + 16), _mm256_extracti128_si256(x, 1));
+}
+
+static inline void store_s24le_avx2(uint8_t *d, __m256i x) {
+    store_s24_avx2(d, x, S24LE_STORE_MASK);
+}
+
+static inline void store_s24be_avx2(uint8_t *d, __m256i x) {
+    store_s24_avx2(d, x, S24BE_STORE_MASK);
+}
+
+/* alaw, ulaw: the decoders of g711.c, with a variable shift for the
+ * segment. Encoding is left to the C code. */
+
+static inline __m256i load_u8_avx2(const uint8_t *s) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) s));
+}
+
+static inline __m256i load_alaw_avx2(const uint8_t *s) {
+    __m256i a = _mm256_xor_si256(load_u8_avx2(s), _mm256_set1_epi32(0x55));
+    __m256i seg = _mm256_srli_epi32(_mm256_and_si256(a, _mm256_set1_epi32(0x70)), 4);
+    __m256i t = _mm256_slli_epi32(_mm256_and_si256(a, _mm256_set1_epi32(0x0f)), 4);
+    __m256i neg = _mm256_cmpeq_epi32(_mm256_and_si256(a, _mm256_set1_epi32(0x80)), _mm256_setzero_si256());
+
+    /* 8 for the first segment, 0x108 for the others */
+    t = _mm256_add_epi32(t, _mm256_sub_epi32(_mm256_set1_epi32(0x108),
+            _mm256_and_si256(_mm256_cmpeq_epi32(seg, _mm256_setzero_si256()), _mm256_set1_epi32(0x100))));
+    t = _mm256_sllv_epi32(t, _mm256_max_epi32(_mm256_sub_epi32(seg, _mm256_set1_epi32(1)), _mm256_setzero_si256()));
+    t = _mm256_sub_epi32(_mm256_xor_si256(t, neg), neg);
+
+    return _mm256_slli_epi32(t, 16);
+}
+
+static inline __m256i load_ulaw_avx2(const uint8_t *s) {
+    __m256i u = _mm256_xor_si256(load_u8_avx2(s), _mm256_set1_epi32(0xff));
+    __m256i t = _mm256_slli_epi32(_mm256_and_si256(u, _mm256_set1_epi32(0x0f)), 3);
+    __m256i neg = _mm256_srai_epi32(_mm256_slli_epi32(u, 24), 31);
+
+    t = _mm256_add_epi32(t, _mm256_set1_epi32(0x84));
+    t = _mm256_sllv_epi32(t, _mm256_srli_epi32(_mm256_and_si256(u, _mm256_set1_epi32(0x70)), 4));
+    t = _mm256_sub_epi32(t, _mm256_set1_epi32(0x84));
+    t = _mm256_sub_epi32(_mm256_xor_si256(t, neg), neg);
+
+    return _mm256_slli_epi32(t, 16);
+}
+
+/* float32 */
+
+static inline __m256 load_float32ne_avx2(const uint8_t *s) {
+    return _mm256_loadu_ps((const float *) s);
+}
+
+static inline __m256 load_float32re_avx2(const uint8_t *s) {
+    return _mm256_castsi256_ps(load_s32re_avx2(s));
+}
+
+static inline void store_float32ne_avx2(uint8_t *d, __m256 f) {
+    _mm256_storeu_ps((float *) d, f);
+}
+
+static inline void store_float32re_avx2(uint8_t *d, __m256 f) {
+    store_s32re_avx2(d, _mm256_castps_si256(f));
+}
+
+/* Exact for all formats, as the integers are scaled by powers of two */
+static inline __m256 to_float_avx2(__m256i x) {
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / (1U << 31)));
+}
+
+/* Rounds to nearest like lrintf(). The conversion returns INT32_MIN on
+ * overflow, which is flipped to INT32_MAX for positive values. */
+static inline __m256i round_avx2(__m256 v) {
+    __m256i over = _mm256_castps_si256(_mm256_cmp_ps(v, _mm256_set1_ps(2147483648.0f), _CMP_GE_OQ));
+
+    return _mm256_xor_si256(_mm256_cvtps_epi32(v), over);
+}
+
+static inline __m256i from_float_avx2(__m256 f) {
+    return round_avx2(_mm256_mul_ps(f, _mm256_set1_ps(1U << 31)));
+}
+
+/* S16 rounds at its own precision and is saturated by the packing of
+ * the stores below */
+static inline __m256i from_float_s16_avx2(__m256 f) {
+    return round_avx2(_mm256_mul_ps(f, _mm256_set1_ps(1 << 15)));
+}
+
+static inline __m128i pack_rounded_s16_avx2(__m256i x) {
+    return _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+}
+
+static inline void store_rounded_s16ne_avx2(uint8_t *d, __m256i x) {
+    _mm_storeu_si128((__m128i *) d, pack_rounded_s16_avx2(x));
+}
+
+static inline void store_rounded_s16re_avx2(uint8_t *d, __m256i x) {
+    _mm_storeu_si128((__m128i *) d, _mm_shuffle_epi8(pack_rounded_s16_avx2(x), _mm256_castsi256_si128(SWAP16_MASK)));
+}
+
+DEFINE_CONVERT_AVX2(s16ne_to_float32ne_avx2, 2, 4, load_s16ne_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(s16re_to_float32ne_avx2, 2, 4, load_s16re_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(s16ne_to_float32re_avx2, 2, 4, load_s16ne_avx2, to_float_avx2, store_float32re_avx2)
+DEFINE_CONVERT_AVX2(s32ne_to_float32ne_avx2, 4, 4, load_s32ne_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(s32re_to_float32ne_avx2, 4, 4, load_s32re_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(s24_32le_to_float32ne_avx2, 4, 4, load_s24_32le_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(s24_32be_to_float32ne_avx2, 4, 4, load_s24_32be_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(s24le_to_float32ne_avx2, 3, 4, load_s24le_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(s24be_to_float32ne_avx2, 3, 4, load_s24be_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(alaw_to_float32ne_avx2, 1, 4, load_alaw_avx2, to_float_avx2, store_float32ne_avx2)
+DEFINE_CONVERT_AVX2(ulaw_to_float32ne_avx2, 1, 4, load_ulaw_avx2, to_float_avx2, store_float32ne_avx2)
+
+DEFINE_CONVERT_AVX2(s16ne_from_float32ne_avx2, 4, 2, load_float32ne_avx2, from_float_s16_avx2, store_rounded_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s16re_from_float32ne_avx2, 4, 2, load_float32ne_avx2, from_float_s16_avx2, store_rounded_s16re_avx2)
+DEFINE_CONVERT_AVX2(s16ne_from_float32re_avx2, 4, 2, load_float32re_avx2, from_float_s16_avx2, store_rounded_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s32ne_from_float32ne_avx2, 4, 4, load_float32ne_avx2, from_float_avx2, store_s32ne_avx2)
+DEFINE_CONVERT_AVX2(s32re_from_float32ne_avx2, 4, 4, load_float32ne_avx2, from_float_avx2, store_s32re_avx2)
+DEFINE_CONVERT_AVX2(s24_32le_from_float32ne_avx2, 4, 4, load_float32ne_avx2, from_float_avx2, store_s24_32le_avx2)
+DEFINE_CONVERT_AVX2(s24_32be_from_float32ne_avx2, 4, 4, load_float32ne_avx2, from_float_avx2, store_s24_32be_avx2)
+DEFINE_CONVERT_AVX2(s24le_from_float32ne_avx2, 4, 3, load_float32ne_avx2, from_float_avx2, store_s24le_avx2)
+DEFINE_CONVERT_AVX2(s24be_from_float32ne_avx2, 4, 3, load_float32ne_avx2, from_float_avx2, store_s24be_avx2)
+
+DEFINE_CONVERT_AVX2(s16re_to_s16ne_avx2, 2, 2, load_s16re_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s32ne_to_s16ne_avx2, 4, 2, load_s32ne_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s32re_to_s16ne_avx2, 4, 2, load_s32re_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s24_32le_to_s16ne_avx2, 4, 2, load_s24_32le_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s24_32be_to_s16ne_avx2, 4, 2, load_s24_32be_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s24le_to_s16ne_avx2, 3, 2, load_s24le_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(s24be_to_s16ne_avx2, 3, 2, load_s24be_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(alaw_to_s16ne_avx2, 1, 2, load_alaw_avx2, same_avx2, store_s16ne_avx2)
+DEFINE_CONVERT_AVX2(ulaw_to_s16ne_avx2, 1, 2, load_ulaw_avx2, same_avx2, store_s16ne_avx2)
+
+DEFINE_CONVERT_AVX2(s32ne_from_s16ne_avx2, 2, 4, load_s16ne_avx2, same_avx2, store_s32ne_avx2)
+DEFINE_CONVERT_AVX2(s32re_from_s16ne_avx2, 2, 4, load_s16ne_avx2, same_avx2, store_s32re_avx2)
+DEFINE_CONVERT_AVX2(s24_32le_from_s16ne_avx2, 2, 4, load_s16ne_avx2, same_avx2, store_s24_32le_avx2)
+DEFINE_CONVERT_AVX2(s24_32be_from_s16ne_avx2, 2, 4, load_s16ne_avx2, same_avx2, store_s24_32be_avx2)
+DEFINE_CONVERT_AVX2(s24le_from_s16ne_avx2, 2, 3, load_s16ne_avx2, same_avx2, store_s24le_avx2)
+DEFINE_CONVERT_AVX2(s24be_from_s16ne_avx2, 2, 3, load_s16ne_avx2, same_avx2, store_s24be_avx2)
+
+DEFINE_CONVERT_AVX2(float32re_to_float32ne_avx2, 4, 4, load_s32re_avx2, same_avx2, store_s32ne_avx2)
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_convert_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized conversions.");
+
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16NE, s16ne_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16RE, s16re_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32NE, s32ne_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32RE, s32re_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32LE, s24_32le_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32BE, s24_32be_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, s24le_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, s24be_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_ALAW, alaw_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_ULAW, ulaw_to_float32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32RE, float32re_to_float32ne_avx2);
+
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16NE, s16ne_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16RE, s16re_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32NE, s32ne_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32RE, s32re_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32LE, s24_32le_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32BE, s24_32be_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, s24le_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, s24be_from_float32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32RE, float32re_to_float32ne_avx2);
+
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S16RE, s16re_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32NE, s16ne_from_float32ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32RE, s16ne_from_float32re_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32NE, s32ne_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32RE, s32re_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32LE, s24_32le_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32BE, s24_32be_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24LE, s24le_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24BE, s24be_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_ALAW, alaw_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_ULAW, ulaw_to_s16ne_avx2);
+
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S16RE, s16re_to_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32NE, s16ne_to_float32ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32RE, s16ne_to_float32re_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32NE, s32ne_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32RE, s32re_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32LE, s24_32le_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32BE, s24_32be_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24LE, s24le_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24BE, s24be_from_s16ne_avx2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
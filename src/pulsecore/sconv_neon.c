@@ -24,73 +24,369 @@
 #include "cpu-arm.h"
 #include "sconv.h"
 
-#include <math.h>
+#include <string.h>
 #include <arm_neon.h>
 
-static void pa_sconv_s16le_from_f32ne_neon(unsigned n, const float *src, int16_t *dst) {
-    unsigned i = n & 3;
+/* Samples are loaded into 32-bit lanes, scaled to the full range like
+ * S32NE, and stored from there, so every format pair is a load and a
+ * store. Eight samples are converted at a time, the last ones through a
+ * bounce buffer. */
+#define DEFINE_CONVERT_NEON(name, in_size, out_size, load, conv, store) \
+    static void name(unsigned n, const void *a, void *b) {              \
+        const uint8_t *s = a;                                           \
+        uint8_t *d = b;                                                 \
+                                                                        \
+        for (; n >= 8; n -= 8, s += 8 * (in_size), d += 8 * (out_size)) \
+            store(d, conv(load(s)));                                    \
+                                                                        \
+        if (n > 0) {                                                    \
+            uint8_t ts[8 * 4] = { 0 }, td[8 * 4];                       \
+                                                                        \
+            memcpy(ts, s, n * (in_size));                               \
+            store(td, conv(load(ts)));                                  \
+            memcpy(d, td, n * (out_size));                              \
+        }                                                               \
+    }
 
-    __asm__ __volatile__ (
-        "movs       %[n], %[n], lsr #2      \n\t"
-        "beq        2f                      \n\t"
+static inline int32x4x2_t same_neon(int32x4x2_t x) {
+    return x;
+}
 
-        "1:                                 \n\t"
-        "vld1.32    {q0}, [%[src]]!         \n\t"
-        "vcvt.s32.f32 q0, q0, #31           \n\t" /* s32<-f32 as 16:16 fixed-point, with implicit multiplication by 32768 */
-        "vqrshrn.s32 d0, q0, #16            \n\t" /* shift, round, narrow */
-        "subs       %[n], %[n], #1          \n\t"
-        "vst1.16    {d0}, [%[dst]]!         \n\t"
-        "bgt        1b                      \n\t"
+static inline int32x4x2_t widen_s16_neon(int16x8_t x) {
+    int32x4x2_t r;
 
-        "2:                                 \n\t"
+    r.val[0] = vshll_n_s16(vget_low_s16(x), 16);
+    r.val[1] = vshll_n_s16(vget_high_s16(x), 16);
+    return r;
+}
 
-        : [dst] "+r" (dst), [src] "+r" (src), [n] "+r" (n) /* output operands (or input operands that get modified) */
-        : /* input operands */
-        : "memory", "cc", "q0" /* clobber list */
-    );
+/* s16 */
 
-    /* leftovers */
-    while (i--) {
-        *dst++ = (int16_t) PA_CLAMP_UNLIKELY(lrintf(*src * (1 << 15)), -0x8000, 0x7FFF);
-        src++;
-    }
+static inline int32x4x2_t load_s16ne_neon(const uint8_t *s) {
+    return widen_s16_neon(vld1q_s16((const int16_t *) s));
 }
 
-static void pa_sconv_s16le_to_f32ne_neon(unsigned n, const int16_t *src, float *dst) {
-    unsigned i = n & 3;
-    const float invscale = 1.0f / (1 << 15);
+static inline int32x4x2_t load_s16re_neon(const uint8_t *s) {
+    return widen_s16_neon(vreinterpretq_s16_u8(vrev16q_u8(vld1q_u8(s))));
+}
 
-    __asm__ __volatile__ (
-        "movs       %[n], %[n], lsr #2      \n\t"
-        "beq        2f                      \n\t"
+static inline int16x8_t narrow_s16_neon(int32x4x2_t x) {
+    return vcombine_s16(vshrn_n_s32(x.val[0], 16), vshrn_n_s32(x.val[1], 16));
+}
 
-        "1:                                 \n\t"
-        "vld1.16    {d0}, [%[src]]!         \n\t"
-        "vmovl.s16  q0, d0                  \n\t" /* widen */
-        "vcvt.f32.s32 q0, q0, #15           \n\t" /* f32<-s32 and divide by (1<<15) */
-        "subs       %[n], %[n], #1          \n\t"
-        "vst1.32    {q0}, [%[dst]]!         \n\t"
-        "bgt        1b                      \n\t"
+static inline void store_s16ne_neon(uint8_t *d, int32x4x2_t x) {
+    vst1q_s16((int16_t *) d, narrow_s16_neon(x));
+}
 
-        "2:                                 \n\t"
+static inline void store_s16re_neon(uint8_t *d, int32x4x2_t x) {
+    vst1q_u8(d, vrev16q_u8(vreinterpretq_u8_s16(narrow_s16_neon(x))));
+}
 
-        : [dst] "+r" (dst), [src] "+r" (src), [n] "+r" (n) /* output operands (or input operands that get modified) */
-        : /* input operands */
-        : "memory", "cc", "q0" /* clobber list */
-    );
+/* s32, s24_32 */
 
-    /* leftovers */
-    while (i--) {
-        *dst++ = *src++ * invscale;
-    }
+static inline int32x4x2_t load_s32ne_neon(const uint8_t *s) {
+    int32x4x2_t r;
+
+    r.val[0] = vld1q_s32((const int32_t *) s);
+    r.val[1] = vld1q_s32((const int32_t *) (s + 16));
+    return r;
+}
+
+static inline int32x4x2_t load_s32re_neon(const uint8_t *s) {
+    int32x4x2_t r;
+
+    r.val[0] = vreinterpretq_s32_u8(vrev32q_u8(vld1q_u8(s)));
+    r.val[1] = vreinterpretq_s32_u8(vrev32q_u8(vld1q_u8(s + 16)));
+    return r;
+}
+
+static inline int32x4x2_t load_s24_32ne_neon(const uint8_t *s) {
+    int32x4x2_t r = load_s32ne_neon(s);
+
+    r.val[0] = vshlq_n_s32(r.val[0], 8);
+    r.val[1] = vshlq_n_s32(r.val[1], 8);
+    return r;
+}
+
+static inline int32x4x2_t load_s24_32re_neon(const uint8_t *s) {
+    int32x4x2_t r = load_s32re_neon(s);
+
+    r.val[0] = vshlq_n_s32(r.val[0], 8);
+    r.val[1] = vshlq_n_s32(r.val[1], 8);
+    return r;
+}
+
+static inline void store_s32ne_neon(uint8_t *d, int32x4x2_t x) {
+    vst1q_s32((int32_t *) d, x.val[0]);
+    vst1q_s32((int32_t *) (d + 16), x.val[1]);
+}
+
+static inline void store_s32re_neon(uint8_t *d, int32x4x2_t x) {
+    vst1q_u8(d, vrev32q_u8(vreinterpretq_u8_s32(x.val[0])));
+    vst1q_u8(d + 16, vrev32q_u8(vreinterpretq_u8_s32(x.val[1])));
+}
+
+static inline int32x4x2_t shift_s24_32_neon(int32x4x2_t x) {
+    x.val[0] = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(x.val[0]), 8));
+    x.val[1] = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(x.val[1]), 8));
+    return x;
 }
 
+static inline void store_s24_32ne_neon(uint8_t *d, int32x4x2_t x) {
+    store_s32ne_neon(d, shift_s24_32_neon(x));
+}
+
+static inline void store_s24_32re_neon(uint8_t *d, int32x4x2_t x) {
+    store_s32re_neon(d, shift_s24_32_neon(x));
+}
+
+/* s24, de-interleaved into its three bytes and zipped back as 16-bit
+ * halves */
+
+static inline int32x4x2_t load_s24_neon(uint8x8_t low, uint8x8_t mid, uint8x8_t high) {
+    uint16x8x2_t z = vzipq_u16(vshll_n_u8(low, 8), vorrq_u16(vshll_n_u8(high, 8), vmovl_u8(mid)));
+    int32x4x2_t r;
+
+    r.val[0] = vreinterpretq_s32_u16(z.val[0]);
+    r.val[1] = vreinterpretq_s32_u16(z.val[1]);
+    return r;
+}
+
+static inline int32x4x2_t load_s24le_neon(const uint8_t *s) {
+    uint8x8x3_t b = vld3_u8(s);
+
+    return load_s24_neon(b.val[0], b.val[1], b.val[2]);
+}
+
+static inline int32x4x2_t load_s24be_neon(const uint8_t *s) {
+    uint8x8x3_t b = vld3_u8(s);
+
+    return load_s24_neon(b.val[2], b.val[1], b.val[0]);
+}
+
+static inline uint8x8x3_t split_s24_neon(int32x4x2_t x) {
+    uint16x8x2_t z = vuzpq_u16(vreinterpretq_u16_s32(x.val[0]), vreinterpretq_u16_s32(x.val[1]));
+    uint8x8x3_t b;
+
+    b.val[0] = vshrn_n_u16(z.val[0], 8);
+    b.val[1] = vmovn_u16(z.val[1]);
+    b.val[2] = vshrn_n_u16(z.val[1], 8);
+    return b;
+}
+
+static inline void store_s24le_neon(uint8_t *d, int32x4x2_t x) {
+    vst3_u8(d, split_s24_neon(x));
+}
+
+static inline void store_s24be_neon(uint8_t *d, int32x4x2_t x) {
+    uint8x8x3_t b = split_s24_neon(x);
+    uint8x8_t t = b.val[0];
+
+    b.val[0] = b.val[2];
+    b.val[2] = t;
+    vst3_u8(d, b);
+}
+
+/* alaw, ulaw: the decoders of g711.c on 16-bit lanes, with a variable
+ * shift for the segment. Encoding is left to the C code. */
+
+static inline int32x4x2_t load_alaw_neon(const uint8_t *s) {
+    int16x8_t a = vreinterpretq_s16_u16(vmovl_u8(veor_u8(vld1_u8(s), vdup_n_u8(0x55))));
+    int16x8_t seg = vshrq_n_s16(vandq_s16(a, vdupq_n_s16(0x70)), 4);
+    int16x8_t t = vshlq_n_s16(vandq_s16(a, vdupq_n_s16(0x0f)), 4);
+    int16x8_t neg = vreinterpretq_s16_u16(vceqq_s16(vandq_s16(a, vdupq_n_s16(0x80)), vdupq_n_s16(0)));
+
+    /* 8 for the first segment, 0x108 for the others */
+    t = vaddq_s16(t, vsubq_s16(vdupq_n_s16(0x108),
+            vandq_s16(vreinterpretq_s16_u16(vceqq_s16(seg, vdupq_n_s16(0))), vdupq_n_s16(0x100))));
+    t = vshlq_s16(t, vmaxq_s16(vsubq_s16(seg, vdupq_n_s16(1)), vdupq_n_s16(0)));
+    t = vsubq_s16(veorq_s16(t, neg), neg);
+
+    return widen_s16_neon(t);
+}
+
+static inline int32x4x2_t load_ulaw_neon(const uint8_t *s) {
+    int16x8_t u = vreinterpretq_s16_u16(vmovl_u8(vmvn_u8(vld1_u8(s))));
+    int16x8_t t = vshlq_n_s16(vandq_s16(u, vdupq_n_s16(0x0f)), 3);
+    int16x8_t neg = vshrq_n_s16(vshlq_n_s16(u, 8), 15);
+
+    t = vaddq_s16(t, vdupq_n_s16(0x84));
+    t = vshlq_s16(t, vshrq_n_s16(vandq_s16(u, vdupq_n_s16(0x70)), 4));
+    t = vsubq_s16(t, vdupq_n_s16(0x84));
+    t = vsubq_s16(veorq_s16(t, neg), neg);
+
+    return widen_s16_neon(t);
+}
+
+/* float32 */
+
+static inline float32x4x2_t load_float32ne_neon(const uint8_t *s) {
+    float32x4x2_t r;
+
+    r.val[0] = vld1q_f32((const float *) s);
+    r.val[1] = vld1q_f32((const float *) (s + 16));
+    return r;
+}
+
+static inline float32x4x2_t load_float32re_neon(const uint8_t *s) {
+    int32x4x2_t x = load_s32re_neon(s);
+    float32x4x2_t r;
+
+    r.val[0] = vreinterpretq_f32_s32(x.val[0]);
+    r.val[1] = vreinterpretq_f32_s32(x.val[1]);
+    return r;
+}
+
+static inline void store_float32ne_neon(uint8_t *d, float32x4x2_t f) {
+    vst1q_f32((float *) d, f.val[0]);
+    vst1q_f32((float *) (d + 16), f.val[1]);
+}
+
+static inline void store_float32re_neon(uint8_t *d, float32x4x2_t f) {
+    int32x4x2_t x;
+
+    x.val[0] = vreinterpretq_s32_f32(f.val[0]);
+    x.val[1] = vreinterpretq_s32_f32(f.val[1]);
+    store_s32re_neon(d, x);
+}
+
+static inline float32x4x2_t to_float_neon(int32x4x2_t x) {
+    float32x4x2_t r;
+
+    r.val[0] = vmulq_n_f32(vcvtq_f32_s32(x.val[0]), 1.0f / (1U << 31));
+    r.val[1] = vmulq_n_f32(vcvtq_f32_s32(x.val[1]), 1.0f / (1U << 31));
+    return r;
+}
+
+/* Rounds to nearest like lrintf(), saturating. ARMv7 only converts
+ * towards zero, so values without an integer part of their own are
+ * rounded by adding and subtracting 2^23 first. */
+static inline int32x4_t round_neon(float32x4_t v) {
+#ifdef __aarch64__
+    return vcvtnq_s32_f32(v);
+#else
+    const float32x4_t big = vdupq_n_f32(1 << 23);
+    float32x4_t m = vbslq_f32(vdupq_n_u32(0x80000000), v, big);
+
+    v = vbslq_f32(vcaltq_f32(v, big), vsubq_f32(vaddq_f32(v, m), m), v);
+    return vcvtq_s32_f32(v);
+#endif
+}
+
+static inline int32x4x2_t from_float_neon(float32x4x2_t f) {
+    int32x4x2_t r;
+
+    r.val[0] = round_neon(vmulq_n_f32(f.val[0], 1U << 31));
+    r.val[1] = round_neon(vmulq_n_f32(f.val[1], 1U << 31));
+    return r;
+}
+
+/* S16 rounds at its own precision and is saturated by the stores below */
+static inline int32x4x2_t from_float_s16_neon(float32x4x2_t f) {
+    int32x4x2_t r;
+
+    r.val[0] = round_neon(vmulq_n_f32(f.val[0], 1 << 15));
+    r.val[1] = round_neon(vmulq_n_f32(f.val[1], 1 << 15));
+    return r;
+}
+
+static inline int16x8_t narrow_rounded_s16_neon(int32x4x2_t x) {
+    return vcombine_s16(vqmovn_s32(x.val[0]), vqmovn_s32(x.val[1]));
+}
+
+static inline void store_rounded_s16ne_neon(uint8_t *d, int32x4x2_t x) {
+    vst1q_s16((int16_t *) d, narrow_rounded_s16_neon(x));
+}
+
+static inline void store_rounded_s16re_neon(uint8_t *d, int32x4x2_t x) {
+    vst1q_u8(d, vrev16q_u8(vreinterpretq_u8_s16(narrow_rounded_s16_neon(x))));
+}
+
+DEFINE_CONVERT_NEON(s16ne_to_float32ne_neon, 2, 4, load_s16ne_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(s16re_to_float32ne_neon, 2, 4, load_s16re_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(s16ne_to_float32re_neon, 2, 4, load_s16ne_neon, to_float_neon, store_float32re_neon)
+DEFINE_CONVERT_NEON(s32ne_to_float32ne_neon, 4, 4, load_s32ne_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(s32re_to_float32ne_neon, 4, 4, load_s32re_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(s24_32ne_to_float32ne_neon, 4, 4, load_s24_32ne_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(s24_32re_to_float32ne_neon, 4, 4, load_s24_32re_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(s24le_to_float32ne_neon, 3, 4, load_s24le_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(s24be_to_float32ne_neon, 3, 4, load_s24be_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(alaw_to_float32ne_neon, 1, 4, load_alaw_neon, to_float_neon, store_float32ne_neon)
+DEFINE_CONVERT_NEON(ulaw_to_float32ne_neon, 1, 4, load_ulaw_neon, to_float_neon, store_float32ne_neon)
+
+DEFINE_CONVERT_NEON(s16ne_from_float32ne_neon, 4, 2, load_float32ne_neon, from_float_s16_neon, store_rounded_s16ne_neon)
+DEFINE_CONVERT_NEON(s16re_from_float32ne_neon, 4, 2, load_float32ne_neon, from_float_s16_neon, store_rounded_s16re_neon)
+DEFINE_CONVERT_NEON(s16ne_from_float32re_neon, 4, 2, load_float32re_neon, from_float_s16_neon, store_rounded_s16ne_neon)
+DEFINE_CONVERT_NEON(s32ne_from_float32ne_neon, 4, 4, load_float32ne_neon, from_float_neon, store_s32ne_neon)
+DEFINE_CONVERT_NEON(s32re_from_float32ne_neon, 4, 4, load_float32ne_neon, from_float_neon, store_s32re_neon)
+DEFINE_CONVERT_NEON(s24_32ne_from_float32ne_neon, 4, 4, load_float32ne_neon, from_float_neon, store_s24_32ne_neon)
+DEFINE_CONVERT_NEON(s24_32re_from_float32ne_neon, 4, 4, load_float32ne_neon, from_float_neon, store_s24_32re_neon)
+DEFINE_CONVERT_NEON(s24le_from_float32ne_neon, 4, 3, load_float32ne_neon, from_float_neon, store_s24le_neon)
+DEFINE_CONVERT_NEON(s24be_from_float32ne_neon, 4, 3, load_float32ne_neon, from_float_neon, store_s24be_neon)
+
+DEFINE_CONVERT_NEON(s16re_to_s16ne_neon, 2, 2, load_s16re_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(s32ne_to_s16ne_neon, 4, 2, load_s32ne_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(s32re_to_s16ne_neon, 4, 2, load_s32re_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(s24_32ne_to_s16ne_neon, 4, 2, load_s24_32ne_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(s24_32re_to_s16ne_neon, 4, 2, load_s24_32re_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(s24le_to_s16ne_neon, 3, 2, load_s24le_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(s24be_to_s16ne_neon, 3, 2, load_s24be_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(alaw_to_s16ne_neon, 1, 2, load_alaw_neon, same_neon, store_s16ne_neon)
+DEFINE_CONVERT_NEON(ulaw_to_s16ne_neon, 1, 2, load_ulaw_neon, same_neon, store_s16ne_neon)
+
+DEFINE_CONVERT_NEON(s32ne_from_s16ne_neon, 2, 4, load_s16ne_neon, same_neon, store_s32ne_neon)
+DEFINE_CONVERT_NEON(s32re_from_s16ne_neon, 2, 4, load_s16ne_neon, same_neon, store_s32re_neon)
+DEFINE_CONVERT_NEON(s24_32ne_from_s16ne_neon, 2, 4, load_s16ne_neon, same_neon, store_s24_32ne_neon)
+DEFINE_CONVERT_NEON(s24_32re_from_s16ne_neon, 2, 4, load_s16ne_neon, same_neon, store_s24_32re_neon)
+DEFINE_CONVERT_NEON(s24le_from_s16ne_neon, 2, 3, load_s16ne_neon, same_neon, store_s24le_neon)
+DEFINE_CONVERT_NEON(s24be_from_s16ne_neon, 2, 3, load_s16ne_neon, same_neon, store_s24be_neon)
+
+DEFINE_CONVERT_NEON(float32re_to_float32ne_neon, 4, 4, load_s32re_neon, same_neon, store_s32ne_neon)
+
 void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags) {
     pa_log_info("Initialising ARM NEON optimized conversions.");
-    pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_neon);
-    pa_set_convert_to_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_to_f32ne_neon);
-#ifndef WORDS_BIGENDIAN
-    pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_to_f32ne_neon);
-    pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_neon);
-#endif
+
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S16NE, s16ne_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S16RE, s16re_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S32NE, s32ne_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S32RE, s32re_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32NE, s24_32ne_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32RE, s24_32re_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, s24le_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, s24be_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_ALAW, alaw_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_ULAW, ulaw_to_float32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32RE, float32re_to_float32ne_neon);
+
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S16NE, s16ne_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S16RE, s16re_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S32NE, s32ne_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S32RE, s32re_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32NE, s24_32ne_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32RE, s24_32re_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, s24le_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, s24be_from_float32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32RE, float32re_to_float32ne_neon);
+
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S16RE, s16re_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32NE, s16ne_from_float32ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32RE, s16ne_from_float32re_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S32NE, s32ne_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S32RE, s32re_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32NE, s24_32ne_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32RE, s24_32re_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S24LE, s24le_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S24BE, s24be_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_ALAW, alaw_to_s16ne_neon);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_ULAW, ulaw_to_s16ne_neon);
+
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S16RE, s16re_to_s16ne_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32NE, s16ne_to_float32ne_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32RE, s16ne_to_float32re_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S32NE, s32ne_from_s16ne_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S32RE, s32re_from_s16ne_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32NE, s24_32ne_from_s16ne_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32RE, s24_32re_from_s16ne_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S24LE, s24le_from_s16ne_neon);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S24BE, s24be_from_s16ne_neon);
 }
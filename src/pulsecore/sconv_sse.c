@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
@@ -158,6 +159,170 @@ static void pa_sconv_s16le_from_f32ne_sse2(unsigned n, const float *a, int16_t *
     );
 }
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* The scheme of the AVX2 conversions, four samples at a time. Without
+ * byte shuffles, packed S24 and the G.711 formats are left to the C code
+ * and byte swaps take a few shifts. */
+#define DEFINE_CONVERT_SSE2(name, in_size, out_size, load, conv, store) \
+    static void name(unsigned n, const void *a, void *b) {              \
+        const uint8_t *s = a;                                           \
+        uint8_t *d = b;                                                 \
+                                                                        \
+        for (; n >= 4; n -= 4, s += 4 * (in_size), d += 4 * (out_size)) \
+            store(d, conv(load(s)));                                    \
+                                                                        \
+        if (n > 0) {                                                    \
+            uint8_t ts[4 * 4] = { 0 }, td[4 * 4];                       \
+                                                                        \
+            memcpy(ts, s, n * (in_size));                               \
+            store(td, conv(load(ts)));                                  \
+            memcpy(d, td, n * (out_size));                              \
+        }                                                               \
+    }
+
+static inline __m128i same_sse2(__m128i x) {
+    return x;
+}
+
+static inline __m128i swap16_sse2(__m128i x) {
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline __m128i swap32_sse2(__m128i x) {
+    return swap16_sse2(_mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1));
+}
+
+/* Samples are scaled to the full 32-bit range in between */
+static inline __m128i load_s16ne_sse2(const uint8_t *s) {
+    return _mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64((const __m128i *) s));
+}
+
+static inline __m128i load_s16re_sse2(const uint8_t *s) {
+    return _mm_unpacklo_epi16(_mm_setzero_si128(), swap16_sse2(_mm_loadl_epi64((const __m128i *) s)));
+}
+
+static inline __m128i pack_s16_sse2(__m128i x) {
+    x = _mm_srai_epi32(x, 16);
+
+    return _mm_packs_epi32(x, x);
+}
+
+static inline void store_s16ne_sse2(uint8_t *d, __m128i x) {
+    _mm_storel_epi64((__m128i *) d, pack_s16_sse2(x));
+}
+
+static inline void store_s16re_sse2(uint8_t *d, __m128i x) {
+    _mm_storel_epi64((__m128i *) d, swap16_sse2(pack_s16_sse2(x)));
+}
+
+static inline __m128i load_s32ne_sse2(const uint8_t *s) {
+    return _mm_loadu_si128((const __m128i *) s);
+}
+
+static inline __m128i load_s32re_sse2(const uint8_t *s) {
+    return swap32_sse2(_mm_loadu_si128((const __m128i *) s));
+}
+
+static inline __m128i load_s24_32ne_sse2(const uint8_t *s) {
+    return _mm_slli_epi32(load_s32ne_sse2(s), 8);
+}
+
+static inline __m128i load_s24_32re_sse2(const uint8_t *s) {
+    return _mm_slli_epi32(load_s32re_sse2(s), 8);
+}
+
+static inline void store_s32ne_sse2(uint8_t *d, __m128i x) {
+    _mm_storeu_si128((__m128i *) d, x);
+}
+
+static inline void store_s32re_sse2(uint8_t *d, __m128i x) {
+    _mm_storeu_si128((__m128i *) d, swap32_sse2(x));
+}
+
+static inline void store_s24_32ne_sse2(uint8_t *d, __m128i x) {
+    store_s32ne_sse2(d, _mm_srli_epi32(x, 8));
+}
+
+static inline void store_s24_32re_sse2(uint8_t *d, __m128i x) {
+    store_s32re_sse2(d, _mm_srli_epi32(x, 8));
+}
+
+static inline __m128 load_float32ne_sse2(const uint8_t *s) {
+    return _mm_loadu_ps((const float *) s);
+}
+
+static inline __m128 load_float32re_sse2(const uint8_t *s) {
+    return _mm_castsi128_ps(load_s32re_sse2(s));
+}
+
+static inline void store_float32ne_sse2(uint8_t *d, __m128 f) {
+    _mm_storeu_ps((float *) d, f);
+}
+
+static inline void store_float32re_sse2(uint8_t *d, __m128 f) {
+    store_s32re_sse2(d, _mm_castps_si128(f));
+}
+
+static inline __m128 to_float_sse2(__m128i x) {
+    return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / (1U << 31)));
+}
+
+/* Rounds to nearest, positive overflow is flipped from INT32_MIN to
+ * INT32_MAX */
+static inline __m128i round_sse2(__m128 v) {
+    __m128i over = _mm_castps_si128(_mm_cmpge_ps(v, _mm_set1_ps(2147483648.0f)));
+
+    return _mm_xor_si128(_mm_cvtps_epi32(v), over);
+}
+
+static inline __m128i from_float_sse2(__m128 f) {
+    return round_sse2(_mm_mul_ps(f, _mm_set1_ps(1U << 31)));
+}
+
+/* S16 is rounded at its own precision and saturated by the packing */
+static inline __m128i from_float_s16_sse2(__m128 f) {
+    return round_sse2(_mm_mul_ps(f, _mm_set1_ps(1 << 15)));
+}
+
+static inline void store_rounded_s16ne_sse2(uint8_t *d, __m128i x) {
+    _mm_storel_epi64((__m128i *) d, _mm_packs_epi32(x, x));
+}
+
+static inline void store_rounded_s16re_sse2(uint8_t *d, __m128i x) {
+    _mm_storel_epi64((__m128i *) d, swap16_sse2(_mm_packs_epi32(x, x)));
+}
+
+DEFINE_CONVERT_SSE2(s16ne_to_float32ne_sse2, 2, 4, load_s16ne_sse2, to_float_sse2, store_float32ne_sse2)
+DEFINE_CONVERT_SSE2(s16re_to_float32ne_sse2, 2, 4, load_s16re_sse2, to_float_sse2, store_float32ne_sse2)
+DEFINE_CONVERT_SSE2(s16ne_to_float32re_sse2, 2, 4, load_s16ne_sse2, to_float_sse2, store_float32re_sse2)
+DEFINE_CONVERT_SSE2(s32ne_to_float32ne_sse2, 4, 4, load_s32ne_sse2, to_float_sse2, store_float32ne_sse2)
+DEFINE_CONVERT_SSE2(s32re_to_float32ne_sse2, 4, 4, load_s32re_sse2, to_float_sse2, store_float32ne_sse2)
+DEFINE_CONVERT_SSE2(s24_32ne_to_float32ne_sse2, 4, 4, load_s24_32ne_sse2, to_float_sse2, store_float32ne_sse2)
+DEFINE_CONVERT_SSE2(s24_32re_to_float32ne_sse2, 4, 4, load_s24_32re_sse2, to_float_sse2, store_float32ne_sse2)
+
+DEFINE_CONVERT_SSE2(s16re_from_float32ne_sse2, 4, 2, load_float32ne_sse2, from_float_s16_sse2, store_rounded_s16re_sse2)
+DEFINE_CONVERT_SSE2(s16ne_from_float32re_sse2, 4, 2, load_float32re_sse2, from_float_s16_sse2, store_rounded_s16ne_sse2)
+DEFINE_CONVERT_SSE2(s32ne_from_float32ne_sse2, 4, 4, load_float32ne_sse2, from_float_sse2, store_s32ne_sse2)
+DEFINE_CONVERT_SSE2(s32re_from_float32ne_sse2, 4, 4, load_float32ne_sse2, from_float_sse2, store_s32re_sse2)
+DEFINE_CONVERT_SSE2(s24_32ne_from_float32ne_sse2, 4, 4, load_float32ne_sse2, from_float_sse2, store_s24_32ne_sse2)
+DEFINE_CONVERT_SSE2(s24_32re_from_float32ne_sse2, 4, 4, load_float32ne_sse2, from_float_sse2, store_s24_32re_sse2)
+
+DEFINE_CONVERT_SSE2(s16re_to_s16ne_sse2, 2, 2, load_s16re_sse2, same_sse2, store_s16ne_sse2)
+DEFINE_CONVERT_SSE2(s32ne_to_s16ne_sse2, 4, 2, load_s32ne_sse2, same_sse2, store_s16ne_sse2)
+DEFINE_CONVERT_SSE2(s32re_to_s16ne_sse2, 4, 2, load_s32re_sse2, same_sse2, store_s16ne_sse2)
+DEFINE_CONVERT_SSE2(s24_32ne_to_s16ne_sse2, 4, 2, load_s24_32ne_sse2, same_sse2, store_s16ne_sse2)
+DEFINE_CONVERT_SSE2(s24_32re_to_s16ne_sse2, 4, 2, load_s24_32re_sse2, same_sse2, store_s16ne_sse2)
+
+DEFINE_CONVERT_SSE2(s32ne_from_s16ne_sse2, 2, 4, load_s16ne_sse2, same_sse2, store_s32ne_sse2)
+DEFINE_CONVERT_SSE2(s32re_from_s16ne_sse2, 2, 4, load_s16ne_sse2, same_sse2, store_s32re_sse2)
+DEFINE_CONVERT_SSE2(s24_32ne_from_s16ne_sse2, 2, 4, load_s16ne_sse2, same_sse2, store_s24_32ne_sse2)
+DEFINE_CONVERT_SSE2(s24_32re_from_s16ne_sse2, 2, 4, load_s16ne_sse2, same_sse2, store_s24_32re_sse2)
+
+DEFINE_CONVERT_SSE2(float32re_to_float32ne_sse2, 4, 4, load_s32re_sse2, same_sse2, store_s32ne_sse2)
+#endif /* __SSE2__ */
+
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
@@ -167,6 +332,37 @@ void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
         pa_log_info("Initialising SSE2 optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
         pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
+#ifdef __SSE2__
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16NE, s16ne_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16RE, s16re_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32NE, s32ne_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32RE, s32re_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32NE, s24_32ne_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32RE, s24_32re_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32RE, float32re_to_float32ne_sse2);
+
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16RE, s16re_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32NE, s32ne_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32RE, s32re_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32NE, s24_32ne_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32RE, s24_32re_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32RE, float32re_to_float32ne_sse2);
+
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S16RE, s16re_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32RE, s16ne_from_float32re_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32NE, s32ne_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32RE, s32re_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32NE, s24_32ne_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32RE, s24_32re_to_s16ne_sse2);
+
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S16RE, s16re_to_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32NE, s16ne_to_float32ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32RE, s16ne_to_float32re_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32NE, s32ne_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32RE, s32re_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32NE, s24_32ne_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32RE, s24_32re_from_s16ne_sse2);
+#endif
     } else if (flags & PA_CPU_X86_SSE) {
         pa_log_info("Initialising SSE optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
@@ -60,6 +60,29 @@
 #define MADV_REMOVE 9
 #endif
 
+#if defined(__linux__) && !defined(MADV_HUGEPAGE)
+#define MADV_HUGEPAGE 14
+#endif
+
+#if defined(__linux__) && !defined(MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#if defined(HAVE_MEMFD) && !defined(MFD_HUGETLB)
+#define MFD_HUGETLB 0x0004U
+#endif
+
+#ifdef HAVE_MBIND
+#include <sys/syscall.h>
+
+/* From <numaif.h>, we don't want to depend on libnuma for this */
+#define PA_MPOL_PREFERRED 1
+#define PA_NUMA_NODES_MAX 1024
+#endif
+
+/* Used if the kernel doesn't tell us the huge page size */
+#define DEFAULT_HUGE_PAGE_SIZE (2*1024*1024)
+
 /* 1 GiB at max */
 #define MAX_SHM_SIZE (PA_ALIGN(1024*1024*1024))
 
@@ -107,7 +130,40 @@ static char *segment_name(char *fn, size_t l, unsigned id) {
 }
 #endif
 
-static int privatemem_create(pa_shm *m, size_t size) {
+static size_t huge_page_size(void) {
+    static size_t size = 0;
+    char *line;
+    uint32_t u;
+
+    if (size > 0)
+        return size;
+
+    size = DEFAULT_HUGE_PAGE_SIZE;
+
+    if ((line = pa_read_line_from_file("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size"))) {
+        if (pa_atou(line, &u) >= 0 && u > 0 && (u % pa_page_size()) == 0)
+            size = (size_t) u;
+
+        pa_xfree(line);
+    }
+
+    return size;
+}
+
+static void advise_huge_pages(pa_shm *m) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(m->ptr, PA_PAGE_ALIGN(m->size), MADV_HUGEPAGE) < 0) {
+        pa_log_info("madvise(MADV_HUGEPAGE) failed: %s", pa_cstrerror(errno));
+        return;
+    }
+
+    m->huge_pages = true;
+#else
+    pa_log_info("Huge pages are not supported on this system.");
+#endif
+}
+
+static int privatemem_create(pa_shm *m, size_t size, pa_shm_flags_t flags) {
     pa_assert(m);
     pa_assert(size > 0);
 
@@ -115,13 +171,31 @@ static int privatemem_create(pa_shm *m, size_t size) {
     m->id = 0;
     m->size = size;
     m->do_unlink = false;
+    m->huge_pages = false;
     m->fd = -1;
 
 #ifdef MAP_ANONYMOUS
+#ifdef MAP_HUGETLB
+    if (flags & PA_SHM_HUGE_PAGES) {
+        size_t hsize = PA_ROUND_UP(size, huge_page_size());
+
+        if ((m->ptr = mmap(NULL, hsize, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB, -1, (off_t) 0)) != MAP_FAILED) {
+            m->size = hsize;
+            m->huge_pages = true;
+            return 0;
+        }
+
+        pa_log_info("No explicit huge pages available, trying transparent huge pages: %s", pa_cstrerror(errno));
+    }
+#endif
+
     if ((m->ptr = mmap(NULL, m->size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, (off_t) 0)) == MAP_FAILED) {
         pa_log("mmap() failed: %s", pa_cstrerror(errno));
         return -1;
     }
+
+    if (flags & PA_SHM_HUGE_PAGES)
+        advise_huge_pages(m);
 #elif defined(HAVE_POSIX_MEMALIGN)
     {
         int r;
@@ -138,18 +212,54 @@ static int privatemem_create(pa_shm *m, size_t size) {
     return 0;
 }
 
-static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
+#ifdef HAVE_MEMFD
+/* Create and map a memfd on hugetlbfs. Unlike for normal memfds the
+ * mapping must not be done with MAP_NORESERVE, so that we fail here
+ * instead of getting SIGBUS later if there are not enough huge pages
+ * in the system pool. */
+static int memfd_hugetlb_create(pa_shm *m, size_t size) {
+    size_t hsize;
+    int fd;
+
+    if ((fd = memfd_create("pulseaudio", MFD_ALLOW_SEALING|MFD_HUGETLB)) < 0) {
+        pa_log_info("memfd_create(MFD_HUGETLB) failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    hsize = PA_ROUND_UP(size, huge_page_size());
+
+    if (ftruncate(fd, (off_t) hsize) < 0) {
+        pa_log_info("ftruncate() on hugetlb memfd failed: %s", pa_cstrerror(errno));
+        pa_close(fd);
+        return -1;
+    }
+
+    if ((m->ptr = mmap(NULL, hsize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log_info("No explicit huge pages available, trying transparent huge pages: %s", pa_cstrerror(errno));
+        pa_close(fd);
+        return -1;
+    }
+
+    m->size = hsize;
+    m->huge_pages = true;
+
+    return fd;
+}
+#endif
+
+static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode, pa_shm_flags_t flags) {
 #if defined(HAVE_SHM_OPEN) || defined(HAVE_MEMFD)
     char fn[32];
     int fd = -1;
     struct shm_marker *marker;
-    bool do_unlink = false;
+    bool do_unlink = false, mapped = false;
 
     /* Each time we create a new SHM area, let's first drop all stale
      * ones */
     pa_shm_cleanup();
 
     pa_random(&m->id, sizeof(m->id));
+    m->huge_pages = false;
 
     switch (type) {
 #ifdef HAVE_SHM_OPEN
@@ -161,6 +271,11 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
 #endif
 #ifdef HAVE_MEMFD
     case PA_MEM_TYPE_SHARED_MEMFD:
+        if ((flags & PA_SHM_HUGE_PAGES) && (fd = memfd_hugetlb_create(m, size)) >= 0) {
+            mapped = true;
+            break;
+        }
+
         fd = memfd_create("pulseaudio", MFD_ALLOW_SEALING);
         break;
 #endif
@@ -174,21 +289,27 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
     }
 
     m->type = type;
-    m->size = size + shm_marker_size(type);
     m->do_unlink = do_unlink;
 
-    if (ftruncate(fd, (off_t) m->size) < 0) {
-        pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
-        goto fail;
-    }
+    if (!mapped) {
+        m->size = size + shm_marker_size(type);
+
+        if (ftruncate(fd, (off_t) m->size) < 0) {
+            pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
+            goto fail;
+        }
 
 #ifndef MAP_NORESERVE
 #define MAP_NORESERVE 0
 #endif
 
-    if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_NORESERVE, fd, (off_t) 0)) == MAP_FAILED) {
-        pa_log("mmap() failed: %s", pa_cstrerror(errno));
-        goto fail;
+        if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_NORESERVE, fd, (off_t) 0)) == MAP_FAILED) {
+            pa_log("mmap() failed: %s", pa_cstrerror(errno));
+            goto fail;
+        }
+
+        if (flags & PA_SHM_HUGE_PAGES)
+            advise_huge_pages(m);
     }
 
     if (type == PA_MEM_TYPE_SHARED_POSIX) {
@@ -213,6 +334,9 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
     return 0;
 
 fail:
+    if (mapped)
+        munmap(m->ptr, m->size);
+
     if (fd >= 0) {
 #ifdef HAVE_SHM_OPEN
         if (type == PA_MEM_TYPE_SHARED_POSIX)
@@ -225,20 +349,95 @@ fail:
     return -1;
 }
 
+static void bind_numa_node(pa_shm *m, int node) {
+#ifdef HAVE_MBIND
+    unsigned long mask[PA_NUMA_NODES_MAX / (8 * sizeof(unsigned long))];
+
+    if (node == PA_SHM_NUMA_NODE_LOCAL) {
+        unsigned cpu, n;
+
+        if (syscall(SYS_getcpu, &cpu, &n, NULL) < 0) {
+            pa_log_warn("getcpu() failed: %s", pa_cstrerror(errno));
+            return;
+        }
+
+        node = (int) n;
+    }
+
+    if (node < 0 || node >= PA_NUMA_NODES_MAX) {
+        pa_log_warn("Invalid NUMA node %i.", node);
+        return;
+    }
+
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+    /* We only prefer the node, running out of memory there should
+     * not take the audio down */
+    if (syscall(SYS_mbind, m->ptr, PA_PAGE_ALIGN(m->size), PA_MPOL_PREFERRED, mask, (unsigned long) PA_NUMA_NODES_MAX, 0) < 0) {
+        pa_log_warn("mbind() to NUMA node %i failed: %s", node, pa_cstrerror(errno));
+        return;
+    }
+
+    pa_log_debug("Placing %s memory on NUMA node %i.", pa_mem_type_to_string(m->type), node);
+#else
+    pa_log_warn("NUMA placement is not supported on this system.");
+#endif
+}
+
+static void prefault(pa_shm *m) {
+    volatile uint8_t *p;
+    size_t o, step;
+
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(m->ptr, PA_PAGE_ALIGN(m->size), MADV_POPULATE_WRITE) >= 0)
+        return;
+#endif
+
+    /* Older kernels, touch every page ourselves. The SHM marker might
+     * already be in place, so write back what we read. */
+    p = m->ptr;
+    step = m->huge_pages ? huge_page_size() : pa_page_size();
+
+    for (o = 0; o < m->size; o += step)
+        p[o] = p[o];
+}
+
 int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
+    return pa_shm_create_rw_full(m, type, size, mode, 0, PA_SHM_NUMA_NODE_ANY);
+}
+
+int pa_shm_create_rw_full(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode,
+                          pa_shm_flags_t flags, int numa_node) {
+    int r;
+
     pa_assert(m);
     pa_assert(size > 0);
     pa_assert(size <= MAX_SHM_SIZE);
     pa_assert(!(mode & ~0777));
     pa_assert(mode >= 0600);
+    pa_assert(numa_node >= PA_SHM_NUMA_NODE_LOCAL);
 
     /* Round up to make it page aligned */
     size = PA_PAGE_ALIGN(size);
 
     if (type == PA_MEM_TYPE_PRIVATE)
-        return privatemem_create(m, size);
+        r = privatemem_create(m, size, flags);
+    else
+        r = sharedmem_create(m, type, size, mode, flags);
+
+    if (r < 0)
+        return r;
+
+    /* The placement policy only applies to pages faulted in later, so
+     * this has to come before prefaulting */
+    if (numa_node != PA_SHM_NUMA_NODE_ANY)
+        bind_numa_node(m, numa_node);
 
-    return sharedmem_create(m, type, size, mode);
+    if (flags & PA_SHM_PREFAULT)
+        prefault(m);
+
+    return 0;
 }
 
 static void privatemem_free(pa_shm *m) {
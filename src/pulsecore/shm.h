@@ -34,6 +34,10 @@ typedef struct pa_shm {
     /* Only for type = PA_MEM_TYPE_SHARED_POSIX */
     bool do_unlink:1;
 
+    /* The memory is backed by huge pages, either explicitly or
+     * transparently */
+    bool huge_pages:1;
+
     /* Only for type = PA_MEM_TYPE_SHARED_MEMFD
      *
      * To avoid fd leaks, we keep this fd open only until we pass it
@@ -49,7 +53,29 @@ typedef struct pa_shm {
     int fd;
 } pa_shm;
 
+/* Flags for pa_shm_create_rw_full() */
+typedef enum pa_shm_flags {
+    /* Back the memory with huge pages. Explicit huge pages are tried
+     * first for private and memfd memory, if none are available the
+     * memory is advised for transparent huge pages instead. */
+    PA_SHM_HUGE_PAGES = 1 << 0,
+
+    /* Fault in all of the memory right away instead of on first use */
+    PA_SHM_PREFAULT = 1 << 1,
+} pa_shm_flags_t;
+
+/* Special values for the numa_node argument of pa_shm_create_rw_full() */
+#define PA_SHM_NUMA_NODE_ANY (-1)
+#define PA_SHM_NUMA_NODE_LOCAL (-2) /* The node the calling thread runs on */
+
 int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode);
+
+/* Like pa_shm_create_rw(), but lets the caller choose how the memory
+ * is backed. If numa_node is not PA_SHM_NUMA_NODE_ANY, the memory is
+ * preferably placed on that NUMA node. Backing options the system
+ * does not support are ignored. */
+int pa_shm_create_rw_full(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode,
+                          pa_shm_flags_t flags, int numa_node);
 int pa_shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd, bool writable);
 
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
@@ -258,6 +258,10 @@ struct pa_sink_input {
         pa_usec_t requested_sink_latency;
 
         pa_hashmap *direct_outputs;
+
+        /* Smoothed time pa_sink_input_peek() takes when the sink renders
+         * its inputs on a render pool */
+        pa_usec_t render_usec;
     } thread_info;
 
     void *userdata;
@@ -274,6 +278,7 @@ enum {
     PA_SINK_INPUT_MESSAGE_SET_STATE,
     PA_SINK_INPUT_MESSAGE_SET_REQUESTED_LATENCY,
     PA_SINK_INPUT_MESSAGE_GET_REQUESTED_LATENCY,
+    PA_SINK_INPUT_MESSAGE_GET_RENDER_TIME,
     PA_SINK_INPUT_MESSAGE_MAX
 };
 
@@ -374,6 +379,10 @@ void pa_sink_input_kill(pa_sink_input*i);
 
 pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency);
 
+/* How long rendering this input took recently, only measured if its sink
+ * uses a render pool */
+pa_usec_t pa_sink_input_get_render_time(pa_sink_input *i);
+
 bool pa_sink_input_is_passthrough(pa_sink_input *i);
 bool pa_sink_input_is_volume_readable(pa_sink_input *i);
 void pa_sink_input_set_volume(pa_sink_input *i, const pa_cvolume *volume, bool save, bool absolute);
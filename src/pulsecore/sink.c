@@ -49,7 +49,7 @@
 
 #include "sink.h"
 
-#define MAX_MIX_CHANNELS 32
+#define MIX_INFO_PREALLOC 32
 #define MIX_BUFFER_LENGTH (pa_page_size())
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
@@ -334,6 +334,21 @@ pa_sink* pa_sink_new(
     s->thread_info.rtpoll = NULL;
     s->thread_info.inputs = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL,
                                                 (pa_free_cb_t) pa_sink_input_unref);
+    s->thread_info.mix_info = pa_xnew(pa_mix_info, MIX_INFO_PREALLOC);
+    s->thread_info.n_mix_info = MIX_INFO_PREALLOC;
+    s->thread_info.render_pool = NULL;
+    pa_atomic_store(&s->thread_info.deferred_rewind, 0);
+
+    /* Renders never exceed the maximum block size, and s16 is the
+     * smallest sample size pa_mix_float() handles */
+    s->thread_info.mix_accum = NULL;
+    s->thread_info.dither_state = 0;
+    if (core->float_mixing) {
+        s->thread_info.mix_accum = pa_xnew(float, pa_mempool_block_size_max(core->mempool) / sizeof(int16_t));
+
+        if (core->float_mixing_dither)
+            s->thread_info.dither_state = 0x12345678U;
+    }
     s->thread_info.soft_volume =  s->soft_volume;
     s->thread_info.soft_muted = s->muted;
     s->thread_info.state = s->state;
@@ -724,6 +739,16 @@ void pa_sink_put(pa_sink* s) {
     pa_assert(s->monitor_source->thread_info.min_latency == s->thread_info.min_latency);
     pa_assert(s->monitor_source->thread_info.max_latency == s->thread_info.max_latency);
 
+    /* Filter sinks are rendered by their master, from within a peek
+     * that may already run on the master's render pool */
+    if (s->core->render_workers > 0 && !pa_sink_is_filter(s)) {
+        int rtprio = s->core->realtime_scheduling ? s->core->realtime_priority : -1;
+
+        if ((s->thread_info.render_pool = pa_render_pool_new(s->core->render_workers, rtprio)))
+            pa_log_debug("Rendering inputs of sink %s on %u worker threads.",
+                         s->name, pa_render_pool_get_n_workers(s->thread_info.render_pool));
+    }
+
     if (s->suspend_cause)
         pa_assert_se(sink_set_state(s, PA_SINK_SUSPENDED, s->suspend_cause) == 0);
     else
@@ -824,6 +849,11 @@ static void sink_free(pa_object *o) {
 
     pa_idxset_free(s->inputs, NULL);
     pa_hashmap_free(s->thread_info.inputs);
+    pa_xfree(s->thread_info.mix_info);
+    pa_xfree(s->thread_info.mix_accum);
+
+    if (s->thread_info.render_pool)
+        pa_render_pool_free(s->thread_info.render_pool);
 
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
@@ -1084,7 +1114,97 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
 }
 
 /* Called from IO thread context */
-static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
+static pa_mix_info *get_mix_info(pa_sink *s) {
+    unsigned n;
+
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+
+    n = pa_hashmap_size(s->thread_info.inputs);
+
+    /* Nothing is kept in here between two renders */
+    if (n > s->thread_info.n_mix_info) {
+        s->thread_info.n_mix_info = PA_MAX(n, 2 * s->thread_info.n_mix_info);
+        pa_xfree(s->thread_info.mix_info);
+        s->thread_info.mix_info = pa_xnew(pa_mix_info, s->thread_info.n_mix_info);
+    }
+
+    return s->thread_info.mix_info;
+}
+
+struct peek_job {
+    pa_mix_info *info;
+    size_t length;
+};
+
+/* Called from a render pool thread, in the IO context of the sink */
+static void peek_job_cb(pa_render_pool *p, unsigned job, void *userdata) {
+    struct peek_job *j = userdata;
+    pa_mix_info *info = &j->info[job];
+    pa_sink_input *i = info->userdata;
+    pa_usec_t t;
+
+    t = pa_rtclock_now();
+    pa_sink_input_peek(i, j->length, &info->chunk, &info->volume);
+    t = pa_rtclock_now() - t;
+
+    /* Every input is peeked by exactly one thread per render, so this is
+     * not shared with the other jobs */
+    i->thread_info.render_usec = (7 * i->thread_info.render_usec + t) / 8;
+}
+
+/* Called from IO thread context */
+static unsigned fill_mix_info_parallel(pa_sink *s, size_t *length, pa_mix_info *info) {
+    struct peek_job job;
+    pa_sink_input *i;
+    unsigned k, n = 0, n_inputs = 0;
+    void *state = NULL;
+    size_t mixlength = *length;
+    int rewind;
+
+    while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL))) {
+        pa_sink_input_assert_ref(i);
+        info[n_inputs++].userdata = i;
+    }
+
+    job.info = info;
+    job.length = *length;
+    pa_render_pool_run(s->thread_info.render_pool, n_inputs, peek_job_cb, &job);
+
+    /* Now that all peeks are done we may touch the sink again */
+    if ((rewind = pa_atomic_load(&s->thread_info.deferred_rewind)) > 0) {
+        pa_atomic_store(&s->thread_info.deferred_rewind, 0);
+        pa_sink_request_rewind(s, (size_t) rewind - 1);
+    }
+
+    /* Same as in fill_mix_info(), but the entries are compacted in place */
+    for (k = 0; k < n_inputs; k++) {
+        i = info[k].userdata;
+
+        if (mixlength == 0 || info[k].chunk.length < mixlength)
+            mixlength = info[k].chunk.length;
+
+        if (pa_memblock_is_silence(info[k].chunk.memblock)) {
+            pa_memblock_unref(info[k].chunk.memblock);
+            continue;
+        }
+
+        pa_assert(info[k].chunk.memblock);
+        pa_assert(info[k].chunk.length > 0);
+
+        info[n] = info[k];
+        info[n].userdata = pa_sink_input_ref(i);
+        n++;
+    }
+
+    if (mixlength > 0)
+        *length = mixlength;
+
+    return n;
+}
+
+/* Called from IO thread context */
+static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info) {
     pa_sink_input *i;
     unsigned n = 0;
     void *state = NULL;
@@ -1094,7 +1214,10 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
-    while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
+    if (s->thread_info.render_pool && pa_hashmap_size(s->thread_info.inputs) > 1)
+        return fill_mix_info_parallel(s, length, info);
+
+    while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL))) {
         pa_sink_input_assert_ref(i);
 
         pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
@@ -1114,7 +1237,6 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
 
         info++;
         n++;
-        maxinfo--;
     }
 
     if (mixlength > 0)
@@ -1123,6 +1245,25 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     return n;
 }
 
+/* Called from IO thread context */
+static size_t mix_inputs(pa_sink *s, pa_mix_info *info, unsigned n, void *data, size_t length) {
+
+    if (s->thread_info.mix_accum && pa_mix_float_supported(s->sample_spec.format))
+        return pa_mix_float(info, n,
+                            data, length,
+                            &s->sample_spec,
+                            &s->thread_info.soft_volume,
+                            s->thread_info.soft_muted,
+                            s->thread_info.mix_accum,
+                            s->thread_info.dither_state ? &s->thread_info.dither_state : NULL);
+
+    return pa_mix(info, n,
+                  data, length,
+                  &s->sample_spec,
+                  &s->thread_info.soft_volume,
+                  s->thread_info.soft_muted);
+}
+
 /* Called from IO thread context */
 static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *result) {
     pa_sink_input *i;
@@ -1223,7 +1364,7 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
 
 /* Called from IO thread context */
 void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t block_size_max;
 
@@ -1254,7 +1395,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = get_mix_info(s);
+    n = fill_mix_info(s, &length, info);
 
     if (n == 0) {
 
@@ -1283,19 +1425,25 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
                                     &s->sample_spec,
                                     result->length);
         } else if (!pa_cvolume_is_norm(&volume)) {
-            pa_memchunk_make_writable(result, 0);
-            pa_volume_memchunk(result, &s->sample_spec, &volume);
+            void *ptr;
+
+            /* Apply the volume while copying out of the input's block,
+             * instead of copying it first and then adjusting it */
+            pa_memblock_unref(result->memblock);
+            result->memblock = pa_memblock_new(s->core->mempool, result->length);
+
+            ptr = pa_memblock_acquire(result->memblock);
+            result->length = mix_inputs(s, info, 1, ptr, result->length);
+            pa_memblock_release(result->memblock);
+
+            result->index = 0;
         }
     } else {
         void *ptr;
         result->memblock = pa_memblock_new(s->core->mempool, length);
 
         ptr = pa_memblock_acquire(result->memblock);
-        result->length = pa_mix(info, n,
-                                ptr, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        result->length = mix_inputs(s, info, n, ptr, length);
         pa_memblock_release(result->memblock);
 
         result->index = 0;
@@ -1308,7 +1456,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
 /* Called from IO thread context */
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t length, block_size_max;
 
@@ -1337,7 +1485,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = get_mix_info(s);
+    n = fill_mix_info(s, &length, info);
 
     if (n == 0) {
         if (target->length > length)
@@ -1354,7 +1503,15 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume))
             pa_silence_memchunk(target, &s->sample_spec);
-        else {
+        else if (!pa_cvolume_is_norm(&volume)) {
+            void *ptr;
+
+            /* Write the input with its volume applied straight into the
+             * target */
+            ptr = pa_memblock_acquire(target->memblock);
+            target->length = mix_inputs(s, info, 1, (uint8_t*) ptr + target->index, target->length);
+            pa_memblock_release(target->memblock);
+        } else {
             pa_memchunk vchunk;
 
             vchunk = info[0].chunk;
@@ -1363,11 +1520,6 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
             if (vchunk.length > length)
                 vchunk.length = length;
 
-            if (!pa_cvolume_is_norm(&volume)) {
-                pa_memchunk_make_writable(&vchunk, 0);
-                pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
-            }
-
             pa_memchunk_memcpy(target, &vchunk);
             pa_memblock_unref(vchunk.memblock);
         }
@@ -1377,11 +1529,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         ptr = pa_memblock_acquire(target->memblock);
 
-        target->length = pa_mix(info, n,
-                                (uint8_t*) ptr + target->index, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        target->length = mix_inputs(s, info, n, (uint8_t*) ptr + target->index, length);
 
         pa_memblock_release(target->memblock);
     }
@@ -3043,6 +3191,21 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
 
     nbytes = PA_MIN(nbytes, s->thread_info.max_rewind);
 
+    /* The inputs are being peeked in parallel, remember the largest
+     * request and leave it to fill_mix_info_parallel() to issue it */
+    if (s->thread_info.render_pool && pa_render_pool_in_job(s->thread_info.render_pool)) {
+        int old;
+
+        do {
+            old = pa_atomic_load(&s->thread_info.deferred_rewind);
+
+            if (old > 0 && nbytes <= (size_t) old - 1)
+                return;
+        } while (!pa_atomic_cmpxchg(&s->thread_info.deferred_rewind, old, (int) nbytes + 1));
+
+        return;
+    }
+
     if (s->thread_info.rewind_requested &&
         nbytes <= s->thread_info.rewind_nbytes)
         return;
@@ -41,6 +41,7 @@
 #include <pulsecore/device-port.h>
 #include <pulsecore/card.h>
 #include <pulsecore/queue.h>
+#include <pulsecore/render-pool.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/sink-input.h>
 
@@ -277,6 +278,23 @@ struct pa_sink {
 
         pa_rtpoll *rtpoll;
 
+        /* Reused by the render functions for the inputs to mix, grown
+         * when there are more inputs */
+        struct pa_mix_info *mix_info;
+        unsigned n_mix_info;
+
+        /* If set, the inputs are peeked in parallel on these workers.
+         * Rewinds requested from there are collected in deferred_rewind
+         * (bytes + 1, 0 if none) and issued once the peeks are done. */
+        pa_render_pool *render_pool;
+        pa_atomic_t deferred_rewind;
+
+        /* If set, multiple inputs are summed in this float buffer and
+         * converted to the sink format once, see pa_mix_float(). The
+         * dither state is 0 if no dither is to be added. */
+        float *mix_accum;
+        uint32_t dither_state;
+
         pa_cvolume soft_volume;
         bool soft_muted:1;
 
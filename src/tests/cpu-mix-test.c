@@ -19,10 +19,18 @@
 #include <config.h>
 #endif
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <check.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/cpu.h>
 #include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/mix.h>
@@ -32,6 +40,7 @@
 #define SAMPLES 1028
 #define TIMES 1000
 #define TIMES2 100
+#define MAX_STREAMS 100
 
 static void acquire_mix_streams(pa_mix_info streams[], unsigned nstreams) {
     unsigned i;
@@ -145,6 +154,133 @@ static void run_mix_test(
     pa_mempool_unref(pool);
 }
 
+/* Mix nstreams streams of random samples with random volumes */
+static void run_mix_format_test(
+        pa_do_mix_func_t func,
+        pa_do_mix_func_t orig_func,
+        pa_sample_format_t format,
+        unsigned nstreams,
+        int align,
+        unsigned channels,
+        bool correct,
+        bool perf) {
+
+    size_t ss = pa_sample_size_of_format(format);
+    uint8_t *in[MAX_STREAMS], *out, *out_ref;
+    uint8_t *samples[MAX_STREAMS], *samples_out, *samples_ref;
+    unsigned nsamples, length, i, j;
+    pa_mix_info m[MAX_STREAMS];
+
+    pa_assert(nstreams <= MAX_STREAMS);
+    pa_assert(channels <= PA_CHANNELS_MAX);
+
+    /* Force sample alignment as requested */
+    nsamples = channels * (SAMPLES - (8 - align));
+    length = nsamples * ss;
+
+    for (i = 0; i < nstreams; i++) {
+        in[i] = pa_xmalloc(length + 8 * ss);
+        samples[i] = in[i] + (8 - align) * ss;
+
+        if (format == PA_SAMPLE_FLOAT32NE) {
+            float *f = (float *) samples[i];
+
+            for (j = 0; j < nsamples; j++)
+                f[j] = 2.0f * rand() / (float) RAND_MAX - 1.0f;
+        } else
+            pa_random(samples[i], length);
+
+        for (j = 0; j < channels; j++) {
+            if (format == PA_SAMPLE_FLOAT32NE)
+                m[i].linear[j].f = 2.0f * rand() / (float) RAND_MAX;
+            else
+                m[i].linear[j].i = rand() % 0x20000;
+        }
+    }
+
+    out = pa_xmalloc0(length + 8 * ss);
+    out_ref = pa_xmalloc0(length + 8 * ss);
+    samples_out = out + (8 - align) * ss;
+    samples_ref = out_ref + (8 - align) * ss;
+
+    if (correct) {
+        for (i = 0; i < nstreams; i++)
+            m[i].ptr = samples[i];
+        orig_func(m, nstreams, channels, samples_ref, length);
+
+        for (i = 0; i < nstreams; i++)
+            m[i].ptr = samples[i];
+        func(m, nstreams, channels, samples_out, length);
+
+        for (j = 0; j < nsamples; j++) {
+            bool ok;
+
+            if (format == PA_SAMPLE_FLOAT32NE)
+                ok = fabsf(((float *) samples_out)[j] - ((float *) samples_ref)[j]) <= 1e-5f;
+            else if (format == PA_SAMPLE_S16NE)
+                ok = ((int16_t *) samples_out)[j] == ((int16_t *) samples_ref)[j];
+            else
+                ok = ((int32_t *) samples_out)[j] == ((int32_t *) samples_ref)[j];
+
+            if (!ok) {
+                pa_log_debug("Correctness test failed: format=%s, streams=%u, align=%d, channels=%u, sample %u",
+                        pa_sample_format_to_string(format), nstreams, align, channels, j);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %u-stream %u-channel %s mixing performance with %d sample alignment",
+                nstreams, channels, pa_sample_format_to_string(format), align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            for (i = 0; i < nstreams; i++)
+                m[i].ptr = samples[i];
+            func(m, nstreams, channels, samples_out, length);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            for (i = 0; i < nstreams; i++)
+                m[i].ptr = samples[i];
+            orig_func(m, nstreams, channels, samples_ref, length);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    for (i = 0; i < nstreams; i++)
+        pa_xfree(in[i]);
+    pa_xfree(out);
+    pa_xfree(out_ref);
+}
+
+#if defined (__i386__) || defined (__amd64__)
+static const pa_sample_format_t x86_formats[] = {
+    PA_SAMPLE_S16NE,
+    PA_SAMPLE_S32NE,
+    PA_SAMPLE_S24_32NE,
+    PA_SAMPLE_FLOAT32NE
+};
+
+/* Check the optimized mixers of all formats against the previous ones, for
+ * channel counts they vectorize and one they leave to the fallback */
+static void run_x86_mix_tests(const pa_do_mix_func_t orig_funcs[]) {
+    static const unsigned channels[] = { 1, 2, 4, 6 };
+    unsigned f, c;
+
+    for (f = 0; f < PA_ELEMENTSOF(x86_formats); f++) {
+        pa_do_mix_func_t func = pa_get_mix_func(x86_formats[f]);
+
+        for (c = 0; c < PA_ELEMENTSOF(channels); c++) {
+            run_mix_format_test(func, orig_funcs[f], x86_formats[f], 2, 7, channels[c], true, false);
+            run_mix_format_test(func, orig_funcs[f], x86_formats[f], 16, 3, channels[c], true, false);
+            run_mix_format_test(func, orig_funcs[f], x86_formats[f], MAX_STREAMS, 5, channels[c], true, false);
+        }
+
+        run_mix_format_test(func, orig_funcs[f], x86_formats[f], 16, 8, 2, false, true);
+    }
+}
+#endif /* defined (__i386__) || defined (__amd64__) */
+
 START_TEST (mix_special_test) {
     pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
     pa_do_mix_func_t orig_func, special_func;
@@ -168,6 +304,52 @@ START_TEST (mix_special_test) {
 }
 END_TEST
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE2)
+START_TEST (mix_sse2_test) {
+    pa_do_mix_func_t orig_funcs[PA_ELEMENTSOF(x86_formats)];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned f;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    for (f = 0; f < PA_ELEMENTSOF(x86_formats); f++)
+        orig_funcs[f] = pa_get_mix_func(x86_formats[f]);
+    pa_mix_func_init_sse(flags);
+
+    pa_log_debug("Checking SSE2 mix");
+    run_x86_mix_tests(orig_funcs);
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE2) */
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+START_TEST (mix_avx2_test) {
+    pa_do_mix_func_t orig_funcs[PA_ELEMENTSOF(x86_formats)];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned f;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (f = 0; f < PA_ELEMENTSOF(x86_formats); f++)
+        orig_funcs[f] = pa_get_mix_func(x86_formats[f]);
+    pa_mix_func_init_avx(flags);
+
+    pa_log_debug("Checking AVX2 mix");
+    run_x86_mix_tests(orig_funcs);
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 START_TEST (mix_neon_test) {
     pa_do_mix_func_t orig_func, neon_func;
@@ -196,6 +378,197 @@ START_TEST (mix_neon_test) {
 END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+#define MANY_STREAMS 256
+#define MANY_SAMPLES 1024
+
+static void many_streams_new(pa_mempool *pool, pa_mix_info m[], unsigned nstreams, const pa_sample_spec *ss) {
+    size_t length = MANY_SAMPLES * pa_sample_size(ss);
+    unsigned i, j, c;
+
+    for (i = 0; i < nstreams; i++) {
+        void *d = pa_xmalloc(length);
+
+        if (ss->format == PA_SAMPLE_FLOAT32NE)
+            for (j = 0; j < MANY_SAMPLES; j++)
+                ((float *) d)[j] = 2.0f * rand() / (float) RAND_MAX - 1.0f;
+        else
+            pa_random(d, length);
+
+        m[i].chunk.memblock = pa_memblock_new_malloced(pool, d, length);
+        m[i].chunk.index = 0;
+        m[i].chunk.length = length;
+
+        m[i].volume.channels = ss->channels;
+        for (c = 0; c < ss->channels; c++)
+            m[i].volume.values[c] = rand() % (PA_VOLUME_NORM * 3 / 2);
+    }
+}
+
+static void many_streams_free(pa_mix_info m[], unsigned nstreams) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++)
+        pa_memblock_unref(m[i].chunk.memblock);
+}
+
+/* With the optimized mixers, the cost of pa_mix() per stream should not grow
+ * with the number of streams */
+START_TEST (mix_many_benchmark) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_S16NE,
+        PA_SAMPLE_FLOAT32NE
+    };
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false, PA_CPU_X86_TIER_MAX };
+    pa_mix_info *m = pa_xnew(pa_mix_info, MANY_STREAMS);
+    void *out = pa_xmalloc(MANY_SAMPLES * 4);
+    pa_mempool *pool;
+    unsigned f, n;
+
+    pa_cpu_init(&cpu_info);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+        pa_sample_spec ss = { formats[f], 48000, 2 };
+        size_t length = MANY_SAMPLES * pa_sample_size(&ss);
+
+        many_streams_new(pool, m, MANY_STREAMS, &ss);
+
+        for (n = 2; n <= MANY_STREAMS; n *= 2) {
+            pa_usec_t start, t;
+            int k;
+
+            start = pa_rtclock_now();
+            for (k = 0; k < TIMES; k++)
+                pa_mix(m, n, out, length, &ss, NULL, false);
+            t = pa_rtclock_now() - start;
+
+            pa_log_debug("%s, %3u streams: %7.2f usec per mix, %.3f usec per stream",
+                    pa_sample_format_to_string(formats[f]), n,
+                    (double) t / TIMES, (double) t / TIMES / n);
+        }
+
+        many_streams_free(m, MANY_STREAMS);
+    }
+
+    pa_mempool_unref(pool);
+    pa_xfree(out);
+    pa_xfree(m);
+}
+END_TEST
+
+#define FUSED_SAMPLES 2048
+
+/* Compare applying a per-stream volume factor in a separate pass (copy,
+ * then adjust in place), followed by pa_mix() or, for a single stream,
+ * another copy and volume pass, with passing the combined volume to
+ * pa_mix() directly, which touches every sample once. Both are run times
+ * times, the timings are logged if perf is set. */
+static void run_fused(int times, bool perf) {
+    static const unsigned counts[] = { 1, 2, 8, 32 };
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false, PA_CPU_X86_TIER_MAX };
+    pa_sample_spec ss = { PA_SAMPLE_S16NE, 48000, 2 };
+    size_t length = FUSED_SAMPLES * sizeof(int16_t);
+    pa_mix_info m[32], tmp[32];
+    pa_cvolume factor, soft;
+    int16_t *fused, *multi;
+    pa_mempool *pool;
+    unsigned c, i, k;
+
+    pa_cpu_init(&cpu_info);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    fused = pa_xmalloc(length);
+    multi = pa_xmalloc(length);
+
+    pa_cvolume_set(&factor, ss.channels, pa_sw_volume_from_linear(0.5));
+    pa_cvolume_set(&soft, ss.channels, pa_sw_volume_from_linear(0.7));
+
+    for (k = 0; k < 32; k++) {
+        int16_t *d = pa_xmalloc(length);
+
+        for (i = 0; i < FUSED_SAMPLES; i++)
+            d[i] = (int16_t) (rand() % 0x10000 - 0x8000) / 8;
+
+        m[k].chunk.memblock = pa_memblock_new_malloced(pool, d, length);
+        m[k].chunk.index = 0;
+        m[k].chunk.length = length;
+
+        tmp[k].chunk.memblock = pa_memblock_new(pool, length);
+        tmp[k].chunk.index = 0;
+        tmp[k].chunk.length = length;
+        tmp[k].volume = soft;
+    }
+
+    for (c = 0; c < PA_ELEMENTSOF(counts); c++) {
+        unsigned n = counts[c];
+        pa_usec_t start, t_multi, t_fused;
+        int j;
+
+        start = pa_rtclock_now();
+        for (j = 0; j < times; j++) {
+            for (k = 0; k < n; k++) {
+                pa_memchunk_memcpy(&tmp[k].chunk, &m[k].chunk);
+                pa_volume_memchunk(&tmp[k].chunk, &ss, &factor);
+            }
+
+            if (n == 1) {
+                pa_memchunk out = tmp[0].chunk;
+
+                pa_memblock_ref(out.memblock);
+                pa_memchunk_make_writable(&out, 0);
+                pa_volume_memchunk(&out, &ss, &soft);
+
+                /* pa_sink_render() hands out the block itself */
+                if (j == times - 1) {
+                    memcpy(multi, pa_memblock_acquire_chunk(&out), length);
+                    pa_memblock_release(out.memblock);
+                }
+
+                pa_memblock_unref(out.memblock);
+            } else
+                pa_mix(tmp, n, multi, length, &ss, NULL, false);
+        }
+        t_multi = pa_rtclock_now() - start;
+
+        for (k = 0; k < n; k++)
+            pa_sw_cvolume_multiply(&m[k].volume, &factor, &soft);
+
+        start = pa_rtclock_now();
+        for (j = 0; j < times; j++)
+            pa_mix(m, n, fused, length, &ss, NULL, false);
+        t_fused = pa_rtclock_now() - start;
+
+        /* Each pass truncates separately */
+        for (i = 0; i < FUSED_SAMPLES; i++)
+            fail_unless(abs(fused[i] - multi[i]) <= (int) (2 * n + 1));
+
+        if (perf)
+            pa_log_debug("%2u streams: multi-pass %7.2f usec, fused %7.2f usec per render",
+                    n, (double) t_multi / times, (double) t_fused / times);
+    }
+
+    for (k = 0; k < 32; k++) {
+        pa_memblock_unref(m[k].chunk.memblock);
+        pa_memblock_unref(tmp[k].chunk.memblock);
+    }
+
+    pa_mempool_unref(pool);
+    pa_xfree(fused);
+    pa_xfree(multi);
+}
+
+START_TEST (mix_fused_test) {
+    run_fused(1, false);
+}
+END_TEST
+
+START_TEST (mix_fused_benchmark) {
+    run_fused(TIMES, true);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -209,12 +582,28 @@ int main(int argc, char *argv[]) {
 
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_special_test);
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE2)
+    tcase_add_test(tc, mix_sse2_test);
+#endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, mix_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, mix_neon_test);
 #endif
+    tcase_add_test(tc, mix_fused_test);
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
+    /* Timings only, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("mix benchmark");
+        tcase_add_test(tc, mix_many_benchmark);
+        tcase_add_test(tc, mix_fused_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);
@@ -226,8 +226,32 @@ static void setup_remap_channels(
     }
 }
 
+/* A sparse matrix with a mix of full, high and low coefficients, like
+ * the up- and downmixing matrices */
+static void setup_remap_matrix(
+    pa_remap_t *m,
+    pa_sample_format_t f,
+    unsigned in_channels,
+    unsigned out_channels) {
+
+    static const float vol[] = { 0.0f, 1.0f, 0.0f, 0.7071f, 0.5f, 0.0f, 0.25f, 0.9f, 0.0f };
+    unsigned i, o;
+
+    m->format = f;
+    m->i_ss.channels = in_channels;
+    m->o_ss.channels = out_channels;
+
+    for (o = 0; o < out_channels; o++) {
+        for (i = 0; i < in_channels; i++) {
+            m->map_table_f[o][i] = vol[(o * 5 + i * 3) % PA_ELEMENTSOF(vol)];
+            m->map_table_i[o][i] = (int32_t) (m->map_table_f[o][i] * 0x10000);
+        }
+    }
+}
+
+/* With perf, the last alignment is timed as well */
 static void remap_test_channels(
-    pa_remap_t *remap_func, pa_remap_t *remap_orig) {
+    pa_remap_t *remap_func, pa_remap_t *remap_orig, bool perf) {
 
     if (!remap_orig->do_remap) {
         pa_log_warn("No reference remapping function, abort test");
@@ -246,19 +270,19 @@ static void remap_test_channels(
         run_remap_test_float(remap_func, remap_orig, 0, true, false);
         run_remap_test_float(remap_func, remap_orig, 1, true, false);
         run_remap_test_float(remap_func, remap_orig, 2, true, false);
-        run_remap_test_float(remap_func, remap_orig, 3, true, true);
+        run_remap_test_float(remap_func, remap_orig, 3, true, perf);
         break;
     case PA_SAMPLE_S32NE:
         run_remap_test_s32(remap_func, remap_orig, 0, true, false);
         run_remap_test_s32(remap_func, remap_orig, 1, true, false);
         run_remap_test_s32(remap_func, remap_orig, 2, true, false);
-        run_remap_test_s32(remap_func, remap_orig, 3, true, true);
+        run_remap_test_s32(remap_func, remap_orig, 3, true, perf);
         break;
     case PA_SAMPLE_S16NE:
         run_remap_test_s16(remap_func, remap_orig, 0, true, false);
         run_remap_test_s16(remap_func, remap_orig, 1, true, false);
         run_remap_test_s16(remap_func, remap_orig, 2, true, false);
-        run_remap_test_s16(remap_func, remap_orig, 3, true, true);
+        run_remap_test_s16(remap_func, remap_orig, 3, true, perf);
         break;
     default:
         pa_assert_not_reached();
@@ -281,7 +305,28 @@ static void remap_init_test_channels(
     setup_remap_channels(&remap_func, f, in_channels, out_channels, rearrange);
     init_func(&remap_func);
 
-    remap_test_channels(&remap_func, &remap_orig);
+    remap_test_channels(&remap_func, &remap_orig, true);
+}
+
+static void remap_init_test_matrix(
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func,
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels) {
+
+    pa_remap_t remap_orig = {0}, remap_func = {0};
+
+    setup_remap_matrix(&remap_orig, f, in_channels, out_channels);
+    orig_init_func(&remap_orig);
+
+    setup_remap_matrix(&remap_func, f, in_channels, out_channels);
+    init_func(&remap_func);
+
+    remap_test_channels(&remap_func, &remap_orig, false);
+
+    pa_xfree(remap_func.state);
+    pa_xfree(remap_orig.state);
 }
 
 static void remap_init2_test_channels(
@@ -303,11 +348,55 @@ static void remap_init2_test_channels(
     setup_remap_channels(&remap_func, f, in_channels, out_channels, rearrange);
     pa_init_remap_func(&remap_func);
 
-    remap_test_channels(&remap_func, &remap_orig);
+    remap_test_channels(&remap_func, &remap_orig, true);
+
+    pa_xfree(remap_func.state);
+}
+
+/* Sparse remapping against the generic matrix code */
+static void remap_init2_test_matrix(
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels,
+        bool perf) {
+
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+    pa_remap_t remap_orig = {0}, remap_func = {0};
+
+    cpu_info.force_generic_code = true;
+    pa_remap_func_init(&cpu_info);
+    setup_remap_matrix(&remap_orig, f, in_channels, out_channels);
+    pa_init_remap_func(&remap_orig);
+
+    cpu_info.force_generic_code = false;
+    pa_remap_func_init(&cpu_info);
+    setup_remap_matrix(&remap_func, f, in_channels, out_channels);
+    pa_init_remap_func(&remap_func);
+
+    remap_test_channels(&remap_func, &remap_orig, perf);
 
     pa_xfree(remap_func.state);
 }
 
+/* Matrix remapping of some odd layouts, the common ones are left to the
+ * sparse remappers */
+static void remap_test_matrix_layouts(
+        const char *name,
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func) {
+
+    static const unsigned layouts[][2] = { { 2, 8 }, { 3, 5 }, { 6, 1 }, { 5, 3 }, { 4, 6 } };
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_FLOAT32NE, PA_SAMPLE_S32NE, PA_SAMPLE_S16NE };
+    unsigned i, j;
+
+    for (i = 0; i < PA_ELEMENTSOF(layouts); i++)
+        for (j = 0; j < PA_ELEMENTSOF(formats); j++) {
+            pa_log_debug("Checking %s matrix remap (%s, %u-channel->%u-channel)", name,
+                         pa_sample_format_to_string(formats[j]), layouts[i][0], layouts[i][1]);
+            remap_init_test_matrix(init_func, orig_init_func, formats[j], layouts[i][0], layouts[i][1]);
+        }
+}
+
 START_TEST (remap_special_test) {
     pa_log_debug("Checking special remap (float, mono->stereo)");
     remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 1, 2, false);
@@ -341,6 +430,45 @@ START_TEST (remap_special_test) {
 }
 END_TEST
 
+START_TEST (remap_sparse_test) {
+    pa_log_debug("Checking sparse remap (float, stereo->6-channel)");
+    remap_init2_test_matrix(PA_SAMPLE_FLOAT32NE, 2, 6, false);
+    pa_log_debug("Checking sparse remap (float, 6-channel->stereo)");
+    remap_init2_test_matrix(PA_SAMPLE_FLOAT32NE, 6, 2, false);
+    pa_log_debug("Checking sparse remap (float, 8-channel->stereo)");
+    remap_init2_test_matrix(PA_SAMPLE_FLOAT32NE, 8, 2, false);
+
+    pa_log_debug("Checking sparse remap (s32, stereo->6-channel)");
+    remap_init2_test_matrix(PA_SAMPLE_S32NE, 2, 6, false);
+    pa_log_debug("Checking sparse remap (s32, 6-channel->stereo)");
+    remap_init2_test_matrix(PA_SAMPLE_S32NE, 6, 2, false);
+    pa_log_debug("Checking sparse remap (s32, 8-channel->stereo)");
+    remap_init2_test_matrix(PA_SAMPLE_S32NE, 8, 2, false);
+
+    pa_log_debug("Checking sparse remap (s16, stereo->6-channel)");
+    remap_init2_test_matrix(PA_SAMPLE_S16NE, 2, 6, false);
+    pa_log_debug("Checking sparse remap (s16, 6-channel->stereo)");
+    remap_init2_test_matrix(PA_SAMPLE_S16NE, 6, 2, false);
+    pa_log_debug("Checking sparse remap (s16, 8-channel->stereo)");
+    remap_init2_test_matrix(PA_SAMPLE_S16NE, 8, 2, false);
+}
+END_TEST
+
+/* Timings of the sparse kernels of the common layouts */
+START_TEST (remap_sparse_benchmark) {
+    static const unsigned layouts[][2] = { { 2, 6 }, { 6, 2 }, { 8, 2 } };
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_FLOAT32NE, PA_SAMPLE_S32NE, PA_SAMPLE_S16NE };
+    unsigned i, j;
+
+    for (i = 0; i < PA_ELEMENTSOF(layouts); i++)
+        for (j = 0; j < PA_ELEMENTSOF(formats); j++) {
+            pa_log_debug("Timing sparse remap (%s, %u-channel->%u-channel)",
+                         pa_sample_format_to_string(formats[j]), layouts[i][0], layouts[i][1]);
+            remap_init2_test_matrix(formats[j], layouts[i][0], layouts[i][1], true);
+        }
+}
+END_TEST
+
 START_TEST (rearrange_special_test) {
     pa_log_debug("Checking special remap (s16, stereo rearrange)");
     remap_init2_test_channels(PA_SAMPLE_S16NE, 2, 2, true);
@@ -404,10 +532,32 @@ START_TEST (remap_sse2_test) {
 
     pa_log_debug("Checking SSE2 remap (s16, mono->stereo)");
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
+
+    remap_test_matrix_layouts("SSE2", init_func, orig_init_func);
 }
 END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+START_TEST (remap_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_avx(flags);
+    init_func = pa_get_init_remap_func();
+
+    remap_test_matrix_layouts("AVX2", init_func, orig_init_func);
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 START_TEST (remap_neon_test) {
     pa_cpu_arm_flag_t flags = 0;
@@ -459,6 +609,8 @@ START_TEST (remap_neon_test) {
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S32NE, 4, 4, false);
     pa_log_debug("Checking NEON remap (s16, 4-channel->4-channel)");
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 4, 4, false);
+
+    remap_test_matrix_layouts("NEON", init_func, orig_init_func);
 }
 END_TEST
 
@@ -513,10 +665,14 @@ int main(int argc, char *argv[]) {
 
     tc = tcase_create("remap");
     tcase_add_test(tc, remap_special_test);
+    tcase_add_test(tc, remap_sparse_test);
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, remap_mmx_test);
     tcase_add_test(tc, remap_sse2_test);
 #endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, remap_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, remap_neon_test);
 #endif
@@ -531,6 +687,14 @@ int main(int argc, char *argv[]) {
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
+    /* Timings only, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("remap benchmark");
+        tcase_add_test(tc, remap_sparse_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);
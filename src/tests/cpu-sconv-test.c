@@ -19,10 +19,16 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <check.h>
 
+#include <pulse/rtclock.h>
+
+#include <pulsecore/cpu.h>
 #include <pulsecore/cpu-arm.h>
 #include <pulsecore/cpu-x86.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/sconv.h>
@@ -83,6 +89,169 @@ static void run_conv_test_float_to_s16(
     }
 }
 
+/* The four conversion tables of sconv.c */
+enum {
+    CONV_TO_FLOAT32NE,
+    CONV_FROM_FLOAT32NE,
+    CONV_TO_S16NE,
+    CONV_FROM_S16NE,
+    CONV_MAX
+};
+
+typedef pa_convert_func_t conv_funcs[CONV_MAX][PA_SAMPLE_MAX];
+
+static void get_conv_funcs(conv_funcs funcs) {
+    pa_sample_format_t f;
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        funcs[CONV_TO_FLOAT32NE][f] = pa_get_convert_to_float32ne_function(f);
+        funcs[CONV_FROM_FLOAT32NE][f] = pa_get_convert_from_float32ne_function(f);
+        funcs[CONV_TO_S16NE][f] = pa_get_convert_to_s16ne_function(f);
+        funcs[CONV_FROM_S16NE][f] = pa_get_convert_from_s16ne_function(f);
+    }
+}
+
+static void get_conv_formats(unsigned t, pa_sample_format_t f, pa_sample_format_t *in, pa_sample_format_t *out) {
+    switch (t) {
+        case CONV_TO_FLOAT32NE:
+            *in = f;
+            *out = PA_SAMPLE_FLOAT32NE;
+            break;
+        case CONV_FROM_FLOAT32NE:
+            *in = PA_SAMPLE_FLOAT32NE;
+            *out = f;
+            break;
+        case CONV_TO_S16NE:
+            *in = f;
+            *out = PA_SAMPLE_S16NE;
+            break;
+        default:
+            *in = PA_SAMPLE_S16NE;
+            *out = f;
+            break;
+    }
+}
+
+/* Formats of up to 16 bits take all their values in turn, starting at
+ * base. Floats are random, with rounding ties and the full scale mixed
+ * in, and slightly out of range. */
+static void fill_samples(pa_sample_format_t f, uint8_t *d, unsigned n, unsigned base) {
+    static const float special[] = {
+        0.0f, 1.0f, -1.0f, 0.5f / 0x8000, -1.5f / 0x8000, 2.5f / 0x8000,
+        0.5f / (1U << 31), -1.5f / (1U << 31), 1.0f - 1.0f / (1 << 24), -1.05f
+    };
+    size_t size = pa_sample_size_of_format(f);
+    unsigned i;
+
+    if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE) {
+        for (i = 0; i < n; i++) {
+            float v = 2.1f * (rand()/(float) RAND_MAX - 0.5f);
+
+            if (i % 16 == 0)
+                v = special[(i / 16) % PA_ELEMENTSOF(special)];
+
+            if (f == PA_SAMPLE_FLOAT32RE)
+                PA_WRITE_FLOAT32RE((float *) (d + i * sizeof(float)), v);
+            else
+                memcpy(d + i * sizeof(float), &v, sizeof(float));
+        }
+    } else if (size == 2) {
+        for (i = 0; i < n; i++) {
+            uint16_t v = (uint16_t) (base + i);
+            memcpy(d + i * 2, &v, 2);
+        }
+    } else if (size == 1) {
+        for (i = 0; i < n; i++)
+            d[i] = (uint8_t) (base + i);
+    } else
+        pa_random(d, n * size);
+}
+
+/* Optimized conversions must match the C code exactly, and not write
+ * past the end of the output */
+static void run_conv_test_format(
+        pa_convert_func_t func,
+        pa_convert_func_t orig_func,
+        pa_sample_format_t in_format,
+        pa_sample_format_t out_format,
+        int align,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, in_buf[SAMPLES * 4]);
+    PA_DECLARE_ALIGNED(8, uint8_t, out_buf[SAMPLES * 4]);
+    PA_DECLARE_ALIGNED(8, uint8_t, out_ref_buf[SAMPLES * 4]);
+    size_t in_size = pa_sample_size_of_format(in_format), out_size = pa_sample_size_of_format(out_format);
+    uint8_t *in, *out, *out_ref;
+    unsigned base, i, nsamples;
+
+    /* Force sample alignment as requested */
+    in = in_buf + (8 - align) * in_size;
+    out = out_buf + (8 - align) * out_size;
+    out_ref = out_ref_buf + (8 - align) * out_size;
+    nsamples = SAMPLES - (8 - align) - 8;
+
+    if (correct) {
+        /* All 16-bit values, or a few rounds of random ones */
+        for (base = 0; base < (in_size <= 2 ? 0x10000 : 16 * nsamples); base += nsamples) {
+            fill_samples(in_format, in, nsamples, base);
+            memset(out_buf, 0x55, sizeof(out_buf));
+            memset(out_ref_buf, 0x55, sizeof(out_ref_buf));
+
+            orig_func(nsamples, in, out_ref);
+            func(nsamples, in, out);
+
+            if (memcmp(out_buf, out_ref_buf, sizeof(out_buf)) != 0) {
+                for (i = 0; out_buf[i] == out_ref_buf[i]; i++)
+                    ;
+
+                pa_log_debug("Correctness test failed: %s -> %s, align=%d",
+                             pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format), align);
+                pa_log_debug("byte %d: %02x != %02x", (int) (i - (out - out_buf)), out_buf[i], out_ref_buf[i]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing sconv performance with %d sample alignment", align);
+
+        fill_samples(in_format, in, nsamples, 0);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(nsamples, in, out);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(nsamples, in, out_ref);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+/* Checks every conversion that was replaced since orig_funcs were taken */
+static void run_conv_test_formats(const char *name, conv_funcs orig_funcs) {
+    conv_funcs funcs;
+    pa_sample_format_t f, in, out;
+    unsigned t;
+    int align;
+
+    get_conv_funcs(funcs);
+
+    for (t = 0; t < CONV_MAX; t++) {
+        for (f = 0; f < PA_SAMPLE_MAX; f++) {
+            if (funcs[t][f] == orig_funcs[t][f])
+                continue;
+
+            get_conv_formats(t, f, &in, &out);
+            pa_log_debug("Checking %s sconv (%s -> %s)", name,
+                         pa_sample_format_to_string(in), pa_sample_format_to_string(out));
+
+            for (align = 0; align < 8; align++)
+                run_conv_test_format(funcs[t][f], orig_funcs[t][f], in, out, align, true, false);
+        }
+    }
+}
+
 /* This test is currently only run under NEON */
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 static void run_conv_test_s16_to_float(
@@ -138,6 +307,7 @@ static void run_conv_test_s16_to_float(
 START_TEST (sconv_sse2_test) {
     pa_cpu_x86_flag_t flags = 0;
     pa_convert_func_t orig_func, sse2_func;
+    conv_funcs orig_funcs;
 
     pa_cpu_get_x86_flags(&flags);
 
@@ -146,6 +316,7 @@ START_TEST (sconv_sse2_test) {
         return;
     }
 
+    get_conv_funcs(orig_funcs);
     orig_func = pa_get_convert_from_float32ne_function(PA_SAMPLE_S16LE);
     pa_convert_func_init_sse(PA_CPU_X86_SSE2);
     sse2_func = pa_get_convert_from_float32ne_function(PA_SAMPLE_S16LE);
@@ -159,6 +330,8 @@ START_TEST (sconv_sse2_test) {
     run_conv_test_float_to_s16(sse2_func, orig_func, 5, true, false);
     run_conv_test_float_to_s16(sse2_func, orig_func, 6, true, false);
     run_conv_test_float_to_s16(sse2_func, orig_func, 7, true, true);
+
+    run_conv_test_formats("SSE2", orig_funcs);
 }
 END_TEST
 
@@ -190,11 +363,32 @@ START_TEST (sconv_sse_test) {
 END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+START_TEST (sconv_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    conv_funcs orig_funcs;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    get_conv_funcs(orig_funcs);
+    pa_convert_func_init_avx(flags);
+
+    run_conv_test_formats("AVX2", orig_funcs);
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 START_TEST (sconv_neon_test) {
     pa_cpu_arm_flag_t flags = 0;
     pa_convert_func_t orig_from_func, neon_from_func;
     pa_convert_func_t orig_to_func, neon_to_func;
+    conv_funcs orig_funcs;
 
     pa_cpu_get_arm_flags(&flags);
 
@@ -203,6 +397,7 @@ START_TEST (sconv_neon_test) {
         return;
     }
 
+    get_conv_funcs(orig_funcs);
     orig_from_func = pa_get_convert_from_float32ne_function(PA_SAMPLE_S16LE);
     orig_to_func = pa_get_convert_to_float32ne_function(PA_SAMPLE_S16LE);
     pa_convert_func_init_neon(flags);
@@ -228,10 +423,55 @@ START_TEST (sconv_neon_test) {
     run_conv_test_s16_to_float(neon_to_func, orig_to_func, 5, true, false);
     run_conv_test_s16_to_float(neon_to_func, orig_to_func, 6, true, false);
     run_conv_test_s16_to_float(neon_to_func, orig_to_func, 7, true, true);
+
+    run_conv_test_formats("NEON", orig_funcs);
 }
 END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+/* Throughput of the conversions set up by pa_cpu_init() against the C
+ * code, for every format */
+START_TEST (sconv_formats_benchmark) {
+    PA_DECLARE_ALIGNED(8, uint8_t, in[SAMPLES * 4]);
+    PA_DECLARE_ALIGNED(8, uint8_t, out[SAMPLES * 4]);
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false, PA_CPU_X86_TIER_MAX };
+    conv_funcs orig_funcs, funcs;
+    pa_sample_format_t f, in_format, out_format;
+    unsigned t;
+
+    get_conv_funcs(orig_funcs);
+    pa_cpu_init(&cpu_info);
+    get_conv_funcs(funcs);
+
+    for (t = 0; t < CONV_MAX; t++) {
+        for (f = 0; f < PA_SAMPLE_MAX; f++) {
+            pa_usec_t start, t_func, t_orig;
+            int k;
+
+            if (funcs[t][f] == orig_funcs[t][f])
+                continue;
+
+            get_conv_formats(t, f, &in_format, &out_format);
+            fill_samples(in_format, in, SAMPLES, 0);
+
+            start = pa_rtclock_now();
+            for (k = 0; k < TIMES; k++)
+                funcs[t][f](SAMPLES, in, out);
+            t_func = pa_rtclock_now() - start;
+
+            start = pa_rtclock_now();
+            for (k = 0; k < TIMES; k++)
+                orig_funcs[t][f](SAMPLES, in, out);
+            t_orig = pa_rtclock_now() - start;
+
+            pa_log_debug("%-9s -> %-9s: %6.3f nsec per sample, C %6.3f",
+                    pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format),
+                    1000.0 * t_func / TIMES / SAMPLES, 1000.0 * t_orig / TIMES / SAMPLES);
+        }
+    }
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -248,12 +488,23 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, sconv_sse2_test);
     tcase_add_test(tc, sconv_sse_test);
 #endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, sconv_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, sconv_neon_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
+    /* Timings only, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("sconv benchmark");
+        tcase_add_test(tc, sconv_formats_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);
@@ -0,0 +1,277 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "runtime-test-util.h"
+#include "../modules/iwab/codec-util.h"
+
+#define MTU 1400 /* MAX_FRAME_SIZE of module-iwab-sink */
+#define RATE 44100
+#define SECONDS 2
+#define TIMES 20
+#define TIMES2 10
+
+/* A few partials and some noise, something not too kind to ADPCM */
+static int16_t *make_signal(unsigned channels, size_t frames) {
+    int16_t *d = pa_xnew(int16_t, frames * channels);
+    size_t f;
+    unsigned c;
+
+    srand(1);
+    for (f = 0; f < frames; f++)
+        for (c = 0; c < channels; c++) {
+            double t = (double) f / RATE;
+            double v = 6000 * sin(2 * M_PI * (220 + 110 * c) * t)
+                + 3000 * sin(2 * M_PI * 1375 * t + c)
+                + 1000 * sin(2 * M_PI * 5100 * t)
+                + (rand() % 600 - 300);
+
+            d[f * channels + c] = (int16_t) lrint(v);
+        }
+
+    return d;
+}
+
+struct stream {
+    uint8_t *blocks; /* MTU bytes per block */
+    size_t *sizes;
+    size_t n;
+    size_t block_size; /* PCM bytes per block */
+};
+
+static void encode(const iwab_codec *codec, void *info, const int16_t *pcm, size_t bytes, struct stream *s) {
+    size_t pos = 0;
+
+    s->block_size = codec->get_write_block_size(info, MTU);
+    s->n = (bytes + s->block_size - 1) / s->block_size;
+    s->blocks = pa_xnew(uint8_t, s->n * MTU);
+    s->sizes = pa_xnew(size_t, s->n);
+
+    for (s->n = 0; pos < bytes; s->n++) {
+        size_t processed, l = PA_MIN(s->block_size, bytes - pos);
+
+        s->sizes[s->n] = codec->encode_buffer(info, 0, (const uint8_t *) pcm + pos, l,
+                s->blocks + s->n * MTU, MTU, &processed);
+        fail_unless(processed == l);
+        fail_unless(s->sizes[s->n] > 0 && s->sizes[s->n] <= MTU);
+        pos += processed;
+    }
+}
+
+static void free_stream(struct stream *s) {
+    pa_xfree(s->blocks);
+    pa_xfree(s->sizes);
+}
+
+static double snr_db(const int16_t *a, const int16_t *b, size_t samples) {
+    double signal = 0, noise = 0;
+    size_t i;
+
+    for (i = 0; i < samples; i++) {
+        signal += (double) a[i] * a[i];
+        noise += (double) (a[i] - b[i]) * (a[i] - b[i]);
+    }
+
+    return noise > 0 ? 10 * log10(signal / noise) : INFINITY;
+}
+
+/* Decode the blocks in reverse order, each must stand on its own */
+static void decode_reversed(const iwab_codec *codec, void *info, const struct stream *s, int16_t *out, size_t bytes) {
+    size_t i;
+
+    for (i = s->n; i > 0; i--) {
+        size_t processed, l, pos = (i - 1) * s->block_size;
+
+        l = codec->decode_buffer(info, s->blocks + (i - 1) * MTU, s->sizes[i - 1],
+                (uint8_t *) out + pos, bytes - pos, &processed);
+        fail_unless(processed == s->sizes[i - 1]);
+        fail_unless(l == PA_MIN(s->block_size, bytes - pos));
+    }
+}
+
+static void roundtrip(const char *name, unsigned channels, double min_snr) {
+    const iwab_codec *codec = iwab_get_codec(name);
+    pa_sample_spec ss = { PA_SAMPLE_S16NE, RATE, channels };
+    size_t frames = RATE / 2 + 17, bytes = frames * channels * sizeof(int16_t);
+    int16_t *pcm = make_signal(channels, frames), *out = pa_xnew0(int16_t, frames * channels);
+    void *enc, *dec;
+    struct stream s;
+    double snr;
+
+    fail_unless(codec != NULL);
+    fail_unless(iwab_get_codec_by_id(codec->id) == codec);
+    fail_unless((enc = codec->init(true, &ss)) != NULL);
+    fail_unless((dec = codec->init(false, &ss)) != NULL);
+
+    encode(codec, enc, pcm, bytes, &s);
+    fail_unless(codec->get_read_block_size(dec, MTU) >= s.block_size);
+    decode_reversed(codec, dec, &s, out, bytes);
+
+    snr = snr_db(pcm, out, frames * channels);
+    pa_log_debug("%s, %u channels: %.1f dB SNR", name, channels, snr);
+    fail_unless(snr >= min_snr);
+
+    free_stream(&s);
+    codec->deinit(enc);
+    codec->deinit(dec);
+    pa_xfree(pcm);
+    pa_xfree(out);
+}
+
+START_TEST (pcm_roundtrip_test) {
+    roundtrip("pcm", 2, INFINITY);
+    roundtrip("pcm", 6, INFINITY);
+}
+END_TEST
+
+START_TEST (adpcm_roundtrip_test) {
+    roundtrip("adpcm", 1, 25);
+    roundtrip("adpcm", 2, 25);
+    roundtrip("adpcm", 3, 25); /* padded blocks */
+    roundtrip("adpcm", 6, 25);
+}
+END_TEST
+
+START_TEST (adpcm_format_test) {
+    const iwab_codec *codec = iwab_get_codec("adpcm");
+    pa_sample_spec ss = { PA_SAMPLE_FLOAT32NE, RATE, 2 };
+
+    fail_unless(codec->init(true, &ss) == NULL);
+    fail_unless(iwab_get_codec("opus") == NULL);
+    fail_unless(iwab_get_codec_by_id(0xff) == NULL);
+}
+END_TEST
+
+/* A payload shorter than an audio frame decodes into nothing, receivers
+ * must not allocate a buffer for it */
+START_TEST (short_payload_test) {
+    static const unsigned channels[] = { 1, 2, 6 };
+    unsigned i, c;
+
+    for (i = 0; i < iwab_codec_count(); i++) {
+        const iwab_codec *codec = iwab_codec_iter(i);
+
+        for (c = 0; c < PA_ELEMENTSOF(channels); c++) {
+            pa_sample_spec ss = { PA_SAMPLE_S16NE, RATE, channels[c] };
+            void *dec = codec->init(false, &ss);
+            size_t size;
+
+            fail_unless(dec != NULL);
+            fail_unless(iwab_codec_get_decoded_size(codec, dec, &ss, 1) == 0);
+            fail_unless(iwab_codec_get_decoded_size(codec, dec, &ss, 0) == 0);
+
+            size = iwab_codec_get_decoded_size(codec, dec, &ss, MTU);
+            fail_unless(size > 0 && pa_frame_aligned(size, &ss));
+
+            codec->deinit(dec);
+        }
+    }
+}
+END_TEST
+
+/* Frame duration and rate for a MTU, and encoding and decoding cost. Run by
+ * hand only. */
+START_TEST (codec_benchmark) {
+    static const unsigned channels[] = { 2, 6 };
+    unsigned i, c;
+
+    for (i = 0; i < iwab_codec_count(); i++) {
+        const iwab_codec *codec = iwab_codec_iter(i);
+
+        for (c = 0; c < PA_ELEMENTSOF(channels); c++) {
+            pa_sample_spec ss = { PA_SAMPLE_S16NE, RATE, channels[c] };
+            size_t frames = RATE * SECONDS, bytes = frames * pa_frame_size(&ss);
+            int16_t *pcm = make_signal(channels[c], frames), *out = pa_xnew(int16_t, frames * channels[c]);
+            void *enc = codec->init(true, &ss), *dec = codec->init(false, &ss);
+            char label[64];
+            struct stream s;
+            pa_usec_t block_usec;
+
+            encode(codec, enc, pcm, bytes, &s);
+            block_usec = pa_bytes_to_usec(s.block_size, &ss);
+            pa_log_info("%s, %u channels: %0.1f ms per %u bytes frame, %0.0f frames/s",
+                    codec->name, channels[c], (double) block_usec / PA_USEC_PER_MSEC, MTU,
+                    (double) PA_USEC_PER_SEC / block_usec);
+
+            pa_snprintf(label, sizeof(label), "%s %uch encode %ds", codec->name, channels[c], SECONDS);
+            PA_RUNTIME_TEST_RUN_START(label, TIMES, TIMES2) {
+                free_stream(&s);
+                encode(codec, enc, pcm, bytes, &s);
+            } PA_RUNTIME_TEST_RUN_STOP
+
+            pa_snprintf(label, sizeof(label), "%s %uch decode %ds", codec->name, channels[c], SECONDS);
+            PA_RUNTIME_TEST_RUN_START(label, TIMES, TIMES2) {
+                decode_reversed(codec, dec, &s, out, bytes);
+            } PA_RUNTIME_TEST_RUN_STOP
+
+            free_stream(&s);
+            codec->deinit(enc);
+            codec->deinit(dec);
+            pa_xfree(pcm);
+            pa_xfree(out);
+        }
+    }
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("iwab codec");
+    tc = tcase_create("iwab codec");
+    tcase_add_test(tc, pcm_roundtrip_test);
+    tcase_add_test(tc, adpcm_roundtrip_test);
+    tcase_add_test(tc, adpcm_format_test);
+    tcase_add_test(tc, short_payload_test);
+    suite_add_tcase(s, tc);
+
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("iwab codec benchmark");
+        tcase_add_test(tc, codec_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,359 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "../modules/iwab/fec.h"
+
+#define N_DATA 480
+#define MAX_WIRE (N_DATA * 2)
+
+struct wire_frame {
+    struct iwab_head h;
+    uint8_t data[IWAB_FEC_MAX_PAYLOAD];
+    size_t length;
+};
+
+struct stream {
+    unsigned k, m;
+    struct wire_frame *data; /* the N_DATA data frames */
+    struct wire_frame *wire; /* data and parity frames in sending order */
+    unsigned n_wire;
+};
+
+static uint32_t lcg_state;
+
+static uint32_t lcg(void) {
+    lcg_state = lcg_state * 1103515245 + 12345;
+    return lcg_state >> 8;
+}
+
+/* Encode N_DATA frames the way net.c does */
+static void encode_stream(struct stream *s, unsigned k, unsigned m) {
+    struct iwab_fec_encoder e;
+    unsigned i, j;
+
+    s->k = k;
+    s->m = m;
+    s->data = pa_xnew0(struct wire_frame, N_DATA);
+    s->wire = pa_xnew0(struct wire_frame, MAX_WIRE);
+    s->n_wire = 0;
+    iwab_fec_encoder_init(&e, k, m);
+    lcg_state = 42;
+
+    for (i = 0; i < N_DATA; i++) {
+        struct wire_frame *f = &s->data[i];
+        unsigned index, n;
+
+        f->length = 1000 + 4 * (lcg() % 100);
+        for (n = 0; n < f->length; n++)
+            f->data[n] = lcg();
+
+        f->h.seq = i + 1;
+        f->h.timestamp = 1000000 + i * 8000;
+        f->h.length = f->length;
+        f->h.fec_k = k;
+        f->h.fec_m = m;
+
+        index = iwab_fec_encoder_add(&e, f->data, f->length, f->h.timestamp);
+        f->h.fec_index = index;
+        s->wire[s->n_wire++] = *f;
+
+        if (index < k - 1)
+            continue;
+
+        for (j = 0; j < m; j++) {
+            struct wire_frame *p = &s->wire[s->n_wire++];
+
+            p->h = f->h;
+            p->h.seq = f->h.seq - (k - 1);
+            p->h.fec_index = k + j;
+            p->h.length = e.parity[j].length_xor;
+            p->h.timestamp = e.parity[j].timestamp;
+            memcpy(p->data, e.parity[j].data, e.parity[j].length);
+            p->length = e.parity[j].length;
+        }
+    }
+}
+
+static void free_stream(struct stream *s) {
+    pa_xfree(s->data);
+    pa_xfree(s->wire);
+}
+
+static unsigned drain(struct iwab_fec_decoder *d, const struct stream *s, uint32_t *last_seq) {
+    const struct iwab_fec_frame *f;
+    unsigned n = 0;
+
+    while ((f = iwab_fec_decoder_pop(d))) {
+        const struct wire_frame *orig;
+
+        /* frames are handed out in order and match what was sent */
+        fail_unless(f->seq > *last_seq);
+        fail_unless(f->seq >= 1 && f->seq <= N_DATA);
+        orig = &s->data[f->seq - 1];
+        fail_unless(f->length == orig->length);
+        fail_unless(f->timestamp == orig->h.timestamp);
+        fail_unless(memcmp(f->data, orig->data, f->length) == 0);
+
+        *last_seq = f->seq;
+        n++;
+    }
+
+    return n;
+}
+
+/* Feed the wire frames that are not dropped to a decoder, returns the number
+ * of data frames handed out */
+static unsigned decode_stream(const struct stream *s, const bool *dropped, uint64_t *recovered) {
+    struct iwab_fec_decoder *d = pa_xnew(struct iwab_fec_decoder, 1);
+    uint32_t last_seq = 0;
+    unsigned i, n = 0;
+
+    iwab_fec_decoder_init(d);
+    for (i = 0; i < s->n_wire; i++) {
+        if (dropped[i])
+            continue;
+
+        while (iwab_fec_decoder_put(d, &s->wire[i].h, s->wire[i].data, s->wire[i].length) > 0)
+            n += drain(d, s, &last_seq);
+
+        n += drain(d, s, &last_seq);
+    }
+
+    iwab_fec_decoder_flush(d);
+    n += drain(d, s, &last_seq);
+
+    /* frames of groups that were lost entirely are not accounted */
+    fail_unless(n + d->lost <= N_DATA);
+    *recovered = d->recovered;
+    pa_xfree(d);
+    return n;
+}
+
+/* Index on the wire of the data frame i of group g */
+static unsigned wire_index(const struct stream *s, unsigned g, unsigned i) {
+    return g * (s->k + s->m) + i;
+}
+
+START_TEST (fec_no_loss_test) {
+    struct stream s;
+    bool dropped[MAX_WIRE] = { false };
+    uint64_t recovered;
+
+    encode_stream(&s, 8, 2);
+    fail_unless(s.n_wire == N_DATA / 8 * 10);
+    fail_unless(decode_stream(&s, dropped, &recovered) == N_DATA);
+    fail_unless(recovered == 0);
+    free_stream(&s);
+}
+END_TEST
+
+START_TEST (fec_single_loss_test) {
+    struct stream s;
+    unsigned pos;
+
+    /* one loss per group, at every position, is always repaired */
+    encode_stream(&s, 8, 1);
+    for (pos = 0; pos < 8; pos++) {
+        bool dropped[MAX_WIRE] = { false };
+        uint64_t recovered;
+        unsigned g;
+
+        for (g = 0; g < N_DATA / 8; g++)
+            dropped[wire_index(&s, g, pos)] = true;
+
+        fail_unless(decode_stream(&s, dropped, &recovered) == N_DATA);
+        fail_unless(recovered == N_DATA / 8);
+    }
+
+    free_stream(&s);
+}
+END_TEST
+
+START_TEST (fec_burst_test) {
+    struct stream s;
+    bool dropped[MAX_WIRE] = { false };
+    uint64_t recovered;
+    unsigned g;
+
+    /* bursts of m consecutive data frames are repaired */
+    encode_stream(&s, 12, 3);
+    for (g = 0; g < N_DATA / 12; g++) {
+        unsigned start = g % (12 - 4 + 1);
+
+        dropped[wire_index(&s, g, start)] = true;
+        dropped[wire_index(&s, g, start + 1)] = true;
+        dropped[wire_index(&s, g, start + 2)] = true;
+    }
+
+    fail_unless(decode_stream(&s, dropped, &recovered) == N_DATA);
+    fail_unless(recovered == N_DATA / 12 * 3);
+
+    /* one more and one frame per group can't be repaired */
+    for (g = 0; g < N_DATA / 12; g++)
+        dropped[wire_index(&s, g, g % (12 - 4 + 1) + 3)] = true;
+
+    fail_unless(decode_stream(&s, dropped, &recovered) == N_DATA - 2 * N_DATA / 12);
+    fail_unless(recovered == N_DATA / 12 * 2);
+    free_stream(&s);
+}
+END_TEST
+
+START_TEST (fec_parity_loss_test) {
+    struct stream s;
+    bool dropped[MAX_WIRE] = { false };
+    uint64_t recovered;
+    unsigned g;
+
+    encode_stream(&s, 4, 2);
+
+    /* losing parity frames only costs nothing */
+    for (g = 0; g < N_DATA / 4; g++)
+        dropped[wire_index(&s, g, 4 + g % 2)] = true;
+
+    fail_unless(decode_stream(&s, dropped, &recovered) == N_DATA);
+    fail_unless(recovered == 0);
+
+    /* a data frame lost with the parity of its class is gone, the other
+     * frames of the group are still handed out in order */
+    for (g = 0; g < N_DATA / 4; g++)
+        dropped[wire_index(&s, g, g % 2)] = true;
+
+    fail_unless(decode_stream(&s, dropped, &recovered) == N_DATA - N_DATA / 4);
+    fail_unless(recovered == 0);
+
+    /* whole groups lost */
+    memset(dropped, 0, sizeof(dropped));
+    for (g = 3; g < s.n_wire; g += 4 * (4 + 2))
+        memset(dropped + g, true, 4 + 2);
+
+    fail_unless(decode_stream(&s, dropped, &recovered) < N_DATA);
+    free_stream(&s);
+}
+END_TEST
+
+/* Drop each wire frame with probability loss, in bursts of burst frames */
+static void random_loss(bool *dropped, unsigned n, double loss, unsigned burst) {
+    unsigned i, b;
+
+    memset(dropped, 0, n * sizeof(bool));
+    for (i = 0; i < n; i += burst) {
+        if ((lcg() % 100000) < loss * 100000 / burst) {
+            for (b = 0; b < burst && i + b < n; b++)
+                dropped[i + b] = true;
+        }
+    }
+}
+
+/* Airtime and residual loss of the fec settings against resends, run by
+ * hand only */
+START_TEST (fec_bandwidth_benchmark) {
+    static const struct { unsigned k, m; } configs[] = {
+        { 4, 1 }, { 8, 1 }, { 8, 2 }, { 16, 4 }, { 12, 3 },
+    };
+    static const double losses[] = { 0.01, 0.05, 0.10, 0.20 };
+    static const unsigned bursts[] = { 1, 2 };
+    unsigned c, l, b, run;
+
+    for (b = 0; b < PA_ELEMENTSOF(bursts); b++) {
+        for (l = 0; l < PA_ELEMENTSOF(losses); l++) {
+            bool dropped[2 * N_DATA];
+            unsigned delivered = 0, total = 0;
+
+            /* baseline: every frame sent twice, back to back */
+            lcg_state = 1234;
+            for (run = 0; run < 20; run++) {
+                unsigned i;
+
+                random_loss(dropped, 2 * N_DATA, losses[l], bursts[b]);
+                for (i = 0; i < N_DATA; i++)
+                    delivered += !(dropped[2 * i] && dropped[2 * i + 1]);
+                total += N_DATA;
+            }
+
+            pa_log_info("loss %4.1f%% burst %u, resend:     airtime x%.2f, residual loss %6.3f%%",
+                    losses[l] * 100, bursts[b], 2.0, 100.0 * (total - delivered) / total);
+
+            for (c = 0; c < PA_ELEMENTSOF(configs); c++) {
+                struct stream s;
+
+                encode_stream(&s, configs[c].k, configs[c].m);
+                delivered = total = 0;
+                lcg_state = 1234;
+                for (run = 0; run < 20; run++) {
+                    uint64_t recovered;
+
+                    random_loss(dropped, s.n_wire, losses[l], bursts[b]);
+                    delivered += decode_stream(&s, dropped, &recovered);
+                    total += N_DATA;
+                }
+
+                pa_log_info("loss %4.1f%% burst %u, fec %2u+%u:   airtime x%.2f, residual loss %6.3f%%",
+                        losses[l] * 100, bursts[b], configs[c].k, configs[c].m,
+                        (double) (configs[c].k + configs[c].m) / configs[c].k,
+                        100.0 * (total - delivered) / total);
+                free_stream(&s);
+            }
+        }
+    }
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("iwab fec");
+    tc = tcase_create("iwab fec");
+    tcase_add_test(tc, fec_no_loss_test);
+    tcase_add_test(tc, fec_single_loss_test);
+    tcase_add_test(tc, fec_burst_test);
+    tcase_add_test(tc, fec_parity_loss_test);
+    suite_add_tcase(s, tc);
+
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("iwab fec benchmark");
+        tcase_add_test(tc, fec_bandwidth_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,428 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* The iwab socket filter is checked against iwab_read() over an AF_UNIX
+ * datagram socketpair, which stands in for the monitor interface: socket
+ * filters apply to those too and no privileges are needed.
+ *
+ * The replay benchmark feeds either synthetic monitor traffic or the
+ * radiotap frames of a pcap capture (IWAB_PCAP=<file>) through the
+ * socketpair at their original pace, and compares the receiver wakeups
+ * with and without the filter. It is left out of make check. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
+
+#include "../modules/iwab/net.h"
+
+#define MAX_FRAME 2048
+#define REPLAY_USEC (PA_USEC_PER_SEC / 2)
+#define SYNTHETIC_RATE 4000 /* frames per second */
+#define SYNTHETIC_IWAB_RATIO 8 /* one iwab frame out of ... */
+
+enum frame_kind {
+    FRAME_IWAB,
+    FRAME_WRONG_TYPE,
+    FRAME_WRONG_ADDR1,
+    FRAME_WRONG_ADDR2,
+    FRAME_WRONG_ADDR3,
+    FRAME_WRONG_ETHERTYPE,
+    FRAME_TRUNCATED,
+    FRAME_KIND_MAX
+};
+
+struct frame {
+    size_t length;
+    pa_usec_t offset; /* replay time relative to the first frame */
+    uint8_t data[MAX_FRAME];
+};
+
+struct replay {
+    int fd;
+    int done_fd;
+    struct frame *frames;
+    unsigned n_frames;
+};
+
+/* Build a frame as iwab_send() would, with a radiotap header of rt_len
+ * bytes, then break it according to kind. */
+static size_t build_frame(uint8_t *buf, enum frame_kind kind, uint16_t rt_len, uint32_t seq) {
+    struct radiotap_head rt;
+    struct headers h;
+    size_t payload = 256, n;
+
+    pa_assert(rt_len >= sizeof(rt));
+
+    memset(&rt, 0, sizeof(rt));
+    rt.length = rt_len;
+    memset(buf, 0, rt_len);
+    memcpy(buf, &rt, sizeof(rt));
+
+    memset(&h, 0, sizeof(h));
+    h.dot11.type = 2;
+    h.dot11.subtype = 8;
+    h.l2.ethertype = IWAB_ETHERTYPE;
+    h.iw_h.seq = seq;
+    h.iw_h.length = payload;
+
+    switch (kind) {
+        case FRAME_WRONG_TYPE:
+            h.dot11.type = 0;
+            h.dot11.subtype = 8; /* beacon */
+            break;
+        case FRAME_WRONG_ADDR1:
+            h.dot11.addr1[5] = 0x42;
+            break;
+        case FRAME_WRONG_ADDR2:
+            h.dot11.addr2[0] = 0x42;
+            break;
+        case FRAME_WRONG_ADDR3:
+            h.dot11.addr3[3] = 0x42;
+            break;
+        case FRAME_WRONG_ETHERTYPE:
+            h.l2.ethertype = 0x0800;
+            break;
+        default:
+            break;
+    }
+
+    memcpy(buf + rt_len, &h, sizeof(h));
+    n = rt_len + sizeof(h);
+
+    if (kind == FRAME_TRUNCATED)
+        return n + 4; /* FCS only, no payload */
+
+    memset(buf + n, 0x55, payload + 4);
+    return n + payload + 4;
+}
+
+static void make_socketpair(int sv[2]) {
+    int size = 1 << 20;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    pa_make_fd_nonblock(sv[1]);
+}
+
+START_TEST (filter_equivalence_test) {
+    const uint16_t rt_lens[] = { 8, 13, 18, 36, 56 };
+    uint8_t buf[MAX_FRAME], in[MAX_FRAME];
+    struct iwab filtered, plain;
+    unsigned i, k;
+
+    for (i = 0; i < PA_ELEMENTSOF(rt_lens); i++) {
+        for (k = 0; k < FRAME_KIND_MAX; k++) {
+            int sv_f[2], sv_p[2];
+            size_t len, off;
+            ssize_t r_f, r_p;
+
+            make_socketpair(sv_f);
+            make_socketpair(sv_p);
+            fail_unless(iwab_open_fd(&filtered, sv_f[1]) == 0);
+            fail_unless(iwab_open_fd(&plain, sv_p[1]) == 0);
+            fail_unless(iwab_attach_filter(&filtered) == 0);
+
+            len = build_frame(buf, k, rt_lens[i], k + 1);
+            fail_unless(send(sv_f[0], buf, len, 0) == (ssize_t) len);
+            fail_unless(send(sv_p[0], buf, len, 0) == (ssize_t) len);
+
+            r_p = iwab_read(&plain, (char *) in, sizeof(in), &off);
+            r_f = recv(filtered.fd, in, sizeof(in), 0);
+
+            pa_log_debug("radiotap %u, kind %u: iwab_read %zd, filter %s",
+                    rt_lens[i], k, r_p, r_f > 0 ? "accepted" : "dropped");
+
+            fail_unless((r_p >= 0) == (k == FRAME_IWAB));
+            fail_unless((r_f > 0) == (r_p >= 0));
+
+            pa_close(sv_f[0]);
+            pa_close(sv_p[0]);
+            iwab_close(&filtered);
+            iwab_close(&plain);
+        }
+    }
+}
+END_TEST
+
+/* Format frames pass the filter, carry the stream id and don't disturb the
+ * sequence and fec numbering of the audio frames */
+START_TEST (format_frame_test) {
+    uint8_t audio[256], in[MAX_FRAME];
+    struct iwab_format format;
+    struct iwab tx, rx;
+    int sv[2];
+    size_t off;
+    ssize_t r;
+
+    make_socketpair(sv);
+    fail_unless(iwab_open_fd(&tx, sv[0]) == 0);
+    fail_unless(iwab_open_fd(&rx, sv[1]) == 0);
+    fail_unless(iwab_attach_filter(&rx) == 0);
+    fail_unless(iwab_set_fec(&tx, 4, 1) == 0);
+    iwab_set_channel(&tx, 7);
+
+    memset(audio, 0x55, sizeof(audio));
+    memset(&format, 0, sizeof(format));
+    format.format = 3;
+    format.channels = 2;
+    format.rate = 48000;
+    format.map[0] = 1;
+    format.map[1] = 2;
+
+    fail_unless(iwab_send(&tx, (char *) audio, sizeof(audio), 1000, 0) > 0);
+    fail_unless(iwab_send_format(&tx, &format) > 0);
+    fail_unless(iwab_send(&tx, (char *) audio, sizeof(audio), 2000, 0) > 0);
+
+    fail_unless(iwab_read(&rx, (char *) in, sizeof(in), &off) >= 0);
+    fail_unless(rx.iw_in->type == IWAB_FRAME_AUDIO);
+    fail_unless(rx.iw_in->channel == 7);
+    fail_unless(rx.iw_in->seq == 1 && rx.iw_in->fec_k == 4 && rx.iw_in->fec_index == 0);
+
+    /* the socketpair has no FCS, the last 4 payload bytes are eaten */
+    r = iwab_read(&rx, (char *) in, sizeof(in), &off);
+    fail_unless(r == sizeof(format) - 4);
+    fail_unless(rx.iw_in->type == IWAB_FRAME_FORMAT);
+    fail_unless(rx.iw_in->channel == 7);
+    fail_unless(rx.iw_in->fec_k == 0);
+    fail_unless(rx.iw_in->length == sizeof(format));
+    fail_unless(memcmp(in + off, &format, r) == 0);
+
+    fail_unless(iwab_read(&rx, (char *) in, sizeof(in), &off) >= 0);
+    fail_unless(rx.iw_in->type == IWAB_FRAME_AUDIO);
+    fail_unless(rx.iw_in->seq == 2 && rx.iw_in->fec_k == 4 && rx.iw_in->fec_index == 1);
+
+    iwab_close(&tx);
+    iwab_close(&rx);
+}
+END_TEST
+
+/* Load the radiotap frames of a pcap capture, only the classic format
+ * with linktype 127 is supported. */
+static unsigned load_pcap(const char *path, struct frame **frames) {
+    struct {
+        uint32_t magic;
+        uint16_t major, minor;
+        int32_t zone;
+        uint32_t sigfigs, snaplen, linktype;
+    } gh;
+    struct {
+        uint32_t sec, usec, incl_len, orig_len;
+    } rh;
+    FILE *f;
+    unsigned n = 0, allocated = 0;
+    pa_usec_t first = 0;
+    bool nsec;
+
+    fail_unless((f = fopen(path, "rb")) != NULL);
+    fail_unless(fread(&gh, sizeof(gh), 1, f) == 1);
+    fail_unless(gh.magic == 0xa1b2c3d4 || gh.magic == 0xa1b23c4d);
+    fail_unless(gh.linktype == 127);
+    nsec = gh.magic == 0xa1b23c4d;
+
+    *frames = NULL;
+    while (fread(&rh, sizeof(rh), 1, f) == 1) {
+        struct frame *fr;
+        pa_usec_t ts = (pa_usec_t) rh.sec * PA_USEC_PER_SEC + (nsec ? rh.usec / 1000 : rh.usec);
+
+        if (n == allocated) {
+            allocated = allocated ? allocated * 2 : 1024;
+            *frames = pa_xrealloc(*frames, allocated * sizeof(struct frame));
+        }
+
+        fr = &(*frames)[n];
+        if (rh.incl_len > MAX_FRAME) {
+            fail_unless(fseek(f, rh.incl_len, SEEK_CUR) == 0);
+            continue;
+        }
+
+        fail_unless(fread(fr->data, rh.incl_len, 1, f) == 1);
+        if (n == 0)
+            first = ts;
+        fr->length = rh.incl_len;
+        fr->offset = ts - first;
+        n++;
+    }
+
+    fclose(f);
+    return n;
+}
+
+static unsigned make_synthetic(struct frame **frames) {
+    unsigned n, count = SYNTHETIC_RATE * REPLAY_USEC / PA_USEC_PER_SEC;
+
+    *frames = pa_xnew(struct frame, count);
+    for (n = 0; n < count; n++) {
+        enum frame_kind kind = n % SYNTHETIC_IWAB_RATIO == 0 ? FRAME_IWAB : 1 + n % (FRAME_KIND_MAX - 1);
+
+        (*frames)[n].length = build_frame((*frames)[n].data, kind, 13 + 5 * (n % 3), n + 1);
+        (*frames)[n].offset = n * PA_USEC_PER_SEC / SYNTHETIC_RATE;
+    }
+
+    return count;
+}
+
+static void replay_thread(void *userdata) {
+    struct replay *r = userdata;
+    pa_usec_t start = pa_rtclock_now();
+    unsigned n;
+
+    for (n = 0; n < r->n_frames; n++) {
+        pa_usec_t now = pa_rtclock_now();
+
+        if (start + r->frames[n].offset > now)
+            pa_msleep((start + r->frames[n].offset - now) / PA_USEC_PER_MSEC);
+
+        pa_assert_se(send(r->fd, r->frames[n].data, r->frames[n].length, 0) == (ssize_t) r->frames[n].length);
+    }
+
+    pa_assert_se(write(r->done_fd, "x", 1) == 1);
+}
+
+/* Replay the frames and count the receiver wakeups, the way
+ * module-iwab-input reads the socket. */
+static unsigned run_replay(struct frame *frames, unsigned n_frames, bool filter, unsigned *accepted, pa_usec_t *duration) {
+    uint8_t buf[MAX_FRAME];
+    struct replay r;
+    struct iwab iw;
+    pa_thread *t;
+    pa_usec_t start;
+    unsigned wakeups = 0;
+    int sv[2], done[2];
+
+    make_socketpair(sv);
+    fail_unless(pipe(done) == 0);
+    fail_unless(iwab_open_fd(&iw, sv[1]) == 0);
+    if (filter)
+        fail_unless(iwab_attach_filter(&iw) == 0);
+
+    r.fd = sv[0];
+    r.done_fd = done[1];
+    r.frames = frames;
+    r.n_frames = n_frames;
+    *accepted = 0;
+
+    start = pa_rtclock_now();
+    fail_unless((t = pa_thread_new("replay", replay_thread, &r)) != NULL);
+
+    for (;;) {
+        struct pollfd p[2] = {
+            { .fd = iw.fd, .events = POLLIN },
+            { .fd = done[0], .events = POLLIN },
+        };
+        size_t off;
+
+        fail_unless(poll(p, 2, -1) > 0);
+
+        if (p[0].revents & POLLIN) {
+            wakeups++;
+
+            /* module-iwab-input handles one frame per wakeup */
+            if (iwab_read(&iw, (char *) buf, sizeof(buf), &off) >= 0)
+                (*accepted)++;
+        } else if (p[1].revents & POLLIN)
+            break;
+    }
+
+    *duration = pa_rtclock_now() - start;
+    pa_thread_free(t);
+    pa_close(done[0]);
+    pa_close(done[1]);
+    pa_close(sv[0]);
+    iwab_close(&iw);
+
+    return wakeups;
+}
+
+START_TEST (replay_benchmark_test) {
+    struct frame *frames;
+    const char *pcap;
+    unsigned n_frames, wakeups_plain, wakeups_filtered, accepted_plain, accepted_filtered;
+    pa_usec_t duration_plain, duration_filtered;
+
+    if ((pcap = getenv("IWAB_PCAP")))
+        n_frames = load_pcap(pcap, &frames);
+    else
+        n_frames = make_synthetic(&frames);
+
+    pa_log_debug("Replaying %u frames from %s", n_frames, pcap ? pcap : "synthetic traffic");
+
+    wakeups_plain = run_replay(frames, n_frames, false, &accepted_plain, &duration_plain);
+    wakeups_filtered = run_replay(frames, n_frames, true, &accepted_filtered, &duration_filtered);
+
+    pa_log_info("Without filter: %u wakeups, %.0f wakeups/s, %u iwab frames",
+            wakeups_plain, wakeups_plain * (double) PA_USEC_PER_SEC / duration_plain, accepted_plain);
+    pa_log_info("With filter: %u wakeups, %.0f wakeups/s, %u iwab frames",
+            wakeups_filtered, wakeups_filtered * (double) PA_USEC_PER_SEC / duration_filtered, accepted_filtered);
+
+    /* the filter must not lose any iwab frame */
+    fail_unless(accepted_plain == accepted_filtered);
+    fail_unless(wakeups_filtered <= wakeups_plain);
+
+    pa_xfree(frames);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("iwab filter");
+    tc = tcase_create("iwab filter");
+    tcase_add_test(tc, filter_equivalence_test);
+    tcase_add_test(tc, format_frame_test);
+    suite_add_tcase(s, tc);
+
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("iwab filter benchmark");
+        tcase_add_test(tc, replay_benchmark_test);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
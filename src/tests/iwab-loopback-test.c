@@ -0,0 +1,613 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Offline loopback of the iwab transmit and receive paths.
+ *
+ * A sender thread paces, encodes and sends frames with net.c the way
+ * module-iwab-sink does, fec groups or resends included. A link thread
+ * stands in for the air between two AF_UNIX datagram socketpairs: it drops,
+ * reorders and duplicates frames and appends the FCS a monitor interface
+ * would deliver. The receiver reads the frames with the socket filter
+ * attached and runs them through the fec decoder, the sequencing code
+ * (iwab/rx.c) and the codec of module-iwab-input.
+ *
+ * Each run reports frames/s, CPU time per frame on both ends, end-to-end
+ * latency percentiles and glitches, that is gaps module-iwab-input would
+ * have to conceal. make check only runs the links unpaced. Run by hand, the
+ * paced links, a custom one and a throughput benchmark run too. The custom
+ * link can be set with IWAB_LOSS, IWAB_REORDER and IWAB_DUP (in percent),
+ * IWAB_FEC (k+m, 0 for resends) and IWAB_CODEC. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
+
+#include "../modules/iwab/codec-util.h"
+#include "../modules/iwab/fec.h"
+#include "../modules/iwab/net.h"
+#include "../modules/iwab/rx.h"
+
+#define MAX_FRAME 2048
+#define MTU 1400 /* MAX_FRAME_SIZE of module-iwab-sink */
+#define RATE 48000
+#define CHANNELS 2
+#define CHUNK_FRAMES 240 /* 5ms */
+#define CHUNK_USEC (CHUNK_FRAMES * PA_USEC_PER_SEC / RATE)
+#define CHUNKS 400 /* 2s */
+#define BENCHMARK_CHUNKS 20000
+#define END_MARKER "end"
+
+struct link_config {
+    const char *name;
+    const char *codec;
+    unsigned fec_k, fec_m;
+    double loss, reorder, dup; /* probabilities per wire frame */
+    bool paced;
+    bool restart; /* the sender starts over halfway through */
+};
+
+struct sender {
+    const struct link_config *cfg;
+    int fd;
+    unsigned chunks;
+    pa_usec_t start;
+    uint64_t wire_frames;
+    pa_usec_t cpu_usec;
+};
+
+struct link {
+    const struct link_config *cfg;
+    int in_fd, out_fd, done_fd;
+    uint32_t lcg_state;
+    uint64_t dropped, reordered, duplicated;
+};
+
+struct receiver {
+    struct iwab iw;
+    struct iwab_fec_decoder fec;
+    const iwab_codec *codec;
+    void *codec_info;
+    struct iwab_rx rx;
+    pa_usec_t start; /* timestamp of the first chunk */
+    uint8_t *pcm;
+
+    uint64_t wire_frames;
+    uint64_t chunks;
+    uint64_t glitches; /* gaps in the stream */
+    uint64_t lost; /* chunks missing from the stream */
+    uint64_t corrupted; /* pcm chunks whose content doesn't match */
+    uint64_t restarts;
+    pa_usec_t *latencies;
+    pa_usec_t cpu_usec;
+};
+
+static pa_usec_t thread_cpu_usec(void) {
+    struct timespec ts;
+
+    pa_assert_se(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0);
+    return (pa_usec_t) ts.tv_sec * PA_USEC_PER_SEC + (pa_usec_t) ts.tv_nsec / PA_NSEC_PER_USEC;
+}
+
+static uint32_t lcg(uint32_t *state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static bool chance(uint32_t *state, double p) {
+    return p > 0 && (lcg(state) % 1000000) < p * 1000000;
+}
+
+/* Sample c of the stream frame n, every chunk can be checked on its own */
+static int16_t sample(uint64_t n, unsigned c) {
+    return (int16_t) ((n * 31 + c * 1000) & 0x7fff) - 0x4000;
+}
+
+static void make_socketpair(int sv[2]) {
+    int size = 1 << 20;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+static void sleep_until(pa_usec_t t) {
+    pa_usec_t now = pa_rtclock_now();
+
+    if (t > now)
+        pa_msleep((t - now + PA_USEC_PER_MSEC - 1) / PA_USEC_PER_MSEC);
+}
+
+static void sender_open(struct sender *s, struct iwab *iw, const iwab_codec *codec) {
+    pa_assert_se(iwab_open_fd(iw, s->fd) == 0);
+    pa_assert_se(iwab_set_fec(iw, s->cfg->fec_k, s->cfg->fec_m) == 0);
+    iwab_set_codec(iw, codec->id);
+}
+
+/* Render, encode and send the chunks like module-iwab-sink in direct tx
+ * mode: without fec every frame is resent half a chunk later. The frame
+ * timestamp is its stream time, when paced it is sent right then. */
+
+static void sender_thread(void *userdata) {
+    struct sender *s = userdata;
+    pa_sample_spec ss = { .format = PA_SAMPLE_S16NE, .rate = RATE, .channels = CHANNELS };
+    int16_t pcm[CHUNK_FRAMES * CHANNELS];
+    uint8_t encoded[MTU];
+    const iwab_codec *codec;
+    struct iwab iw;
+    void *info;
+    pa_usec_t cpu_start = thread_cpu_usec();
+    unsigned n, f, c;
+
+    pa_assert_se(codec = iwab_get_codec(s->cfg->codec));
+    pa_assert_se(info = codec->init(true, &ss));
+    sender_open(s, &iw, codec);
+
+    for (n = 0; n < s->chunks; n++) {
+        uint64_t timestamp = s->start + n * CHUNK_USEC;
+        size_t length, processed;
+
+        /* module-iwab-sink loaded again: the sequence starts over, the
+         * stream time goes on */
+        if (s->cfg->restart && n == s->chunks / 2) {
+            s->wire_frames += iw.tx_stats.frames;
+            pa_assert_se(iwab_set_fec(&iw, 0, 0) == 0);
+            sender_open(s, &iw, codec);
+        }
+
+        if (s->cfg->paced)
+            sleep_until(timestamp);
+
+        for (f = 0; f < CHUNK_FRAMES; f++)
+            for (c = 0; c < CHANNELS; c++)
+                pcm[f * CHANNELS + c] = sample((uint64_t) n * CHUNK_FRAMES + f, c);
+
+        length = codec->encode_buffer(info, (uint32_t) timestamp, (const uint8_t *) pcm, sizeof(pcm),
+                encoded, sizeof(encoded), &processed);
+        pa_assert_se(processed == sizeof(pcm));
+        pa_assert_se(iwab_send(&iw, (char *) encoded, length, timestamp, 0) > 0);
+
+        if (s->cfg->fec_k)
+            continue;
+
+        if (s->cfg->paced)
+            sleep_until(timestamp + CHUNK_USEC / 2);
+
+        pa_assert_se(iwab_send(&iw, (char *) encoded, length, timestamp, 1) > 0);
+    }
+
+    s->wire_frames += iw.tx_stats.frames;
+    s->cpu_usec = thread_cpu_usec() - cpu_start;
+    pa_assert_se(send(s->fd, END_MARKER, sizeof(END_MARKER), 0) == sizeof(END_MARKER));
+
+    codec->deinit(info);
+    iwab_close(&iw);
+}
+
+static void forward(struct link *l, const uint8_t *frame, size_t length) {
+    pa_assert_se(send(l->out_fd, frame, length, 0) == (ssize_t) length);
+}
+
+/* Carry the frames from the sender to the receiver, impairing the link.
+ * A reordered frame is held back and forwarded after the next one. */
+static void link_thread(void *userdata) {
+    struct link *l = userdata;
+    uint8_t frame[MAX_FRAME], held[MAX_FRAME];
+    size_t held_length = 0;
+
+    for (;;) {
+        ssize_t r = recv(l->in_fd, frame, sizeof(frame) - 4, 0);
+
+        pa_assert_se(r > 0);
+        if (r == sizeof(END_MARKER) && memcmp(frame, END_MARKER, r) == 0)
+            break;
+
+        // the FCS the card leaves at the end of monitored frames
+        memset(frame + r, 0, 4);
+        r += 4;
+
+        if (chance(&l->lcg_state, l->cfg->loss)) {
+            l->dropped++;
+            continue;
+        }
+
+        if (!held_length && chance(&l->lcg_state, l->cfg->reorder)) {
+            memcpy(held, frame, r);
+            held_length = r;
+            l->reordered++;
+            continue;
+        }
+
+        forward(l, frame, r);
+
+        if (chance(&l->lcg_state, l->cfg->dup)) {
+            forward(l, frame, r);
+            l->duplicated++;
+        }
+
+        if (held_length) {
+            forward(l, held, held_length);
+            held_length = 0;
+        }
+    }
+
+    if (held_length)
+        forward(l, held, held_length);
+
+    pa_assert_se(write(l->done_fd, "x", 1) == 1);
+}
+
+/* As push_frame() of module-iwab-input, the chunk is checked instead of
+ * played */
+static void push_payload(struct receiver *r, uint32_t seq, uint64_t timestamp, const uint8_t *payload, size_t length) {
+    const int16_t *pcm = (const int16_t *) r->pcm;
+    size_t processed, decoded;
+    uint64_t n;
+    pa_usec_t now;
+    unsigned f, c;
+
+    decoded = r->codec->decode_buffer(r->codec_info, payload, length, r->pcm,
+            r->codec->get_read_block_size(r->codec_info, MTU), &processed);
+    fail_unless(decoded == CHUNK_FRAMES * CHANNELS * sizeof(int16_t));
+
+    if (iwab_rx_push(&r->rx, seq, timestamp, CHUNK_USEC) > 0)
+        r->glitches++;
+
+    now = pa_rtclock_now();
+    iwab_rx_update_timing(&r->rx, timestamp, now);
+
+    // the sequence starts over with the sender, the stream time doesn't
+    n = (timestamp - r->start) / CHUNK_USEC;
+    if (timestamp < r->start || (timestamp - r->start) % CHUNK_USEC)
+        r->corrupted++;
+    else if (r->codec->id == IWAB_CODEC_PCM) {
+        for (f = 0; f < CHUNK_FRAMES; f++)
+            for (c = 0; c < CHANNELS; c++)
+                if (pcm[f * CHANNELS + c] != sample(n * CHUNK_FRAMES + f, c)) {
+                    r->corrupted++;
+                    f = CHUNK_FRAMES;
+                    break;
+                }
+    }
+
+    r->latencies[r->chunks++] = now > timestamp ? now - timestamp : 0;
+}
+
+static void fec_drain(struct receiver *r) {
+    const struct iwab_fec_frame *f;
+
+    while ((f = iwab_fec_decoder_pop(&r->fec)))
+        if (iwab_rx_frame_is_new(&r->rx, f->seq, f->timestamp))
+            push_payload(r, f->seq, f->timestamp, f->data, f->length);
+}
+
+/* Same steps as receive() of module-iwab-input */
+static void receive(struct receiver *r, const uint8_t *payload, size_t length) {
+    const struct iwab_head *h = r->iw.iw_in;
+
+    r->wire_frames++;
+
+    // parity frames carry no timestamp of their own
+    if ((!h->fec_k || h->fec_index < h->fec_k) && iwab_rx_check_restart(&r->rx, h->seq, h->timestamp)) {
+        iwab_fec_decoder_reset(&r->fec);
+        r->restarts++;
+    }
+
+    if (h->fec_k) {
+        while (iwab_fec_decoder_put(&r->fec, h, payload, length) > 0)
+            fec_drain(r);
+
+        fec_drain(r);
+    } else if (iwab_rx_frame_is_new(&r->rx, h->seq, h->timestamp))
+        push_payload(r, h->seq, h->timestamp, payload, length);
+}
+
+static int cmp_usec(const void *a, const void *b) {
+    pa_usec_t x = *(const pa_usec_t *) a, y = *(const pa_usec_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static pa_usec_t percentile(const pa_usec_t *sorted, uint64_t n, unsigned p) {
+    return n ? sorted[PA_MIN(n - 1, n * p / 100)] : 0;
+}
+
+/* Run chunks through the loopback and check what was received */
+static void run_loopback(const struct link_config *cfg, unsigned chunks, struct receiver *r, struct link *l) {
+    pa_sample_spec ss = { .format = PA_SAMPLE_S16NE, .rate = RATE, .channels = CHANNELS };
+    uint8_t buf[MAX_FRAME];
+    struct sender s;
+    pa_thread *st, *lt;
+    pa_usec_t start, end, duration, cpu_start;
+    int tx[2], rx[2], done[2];
+
+    make_socketpair(tx);
+    make_socketpair(rx);
+    pa_make_fd_nonblock(rx[1]);
+    fail_unless(pipe(done) == 0);
+
+    memset(r, 0, sizeof(*r));
+    fail_unless(iwab_open_fd(&r->iw, rx[1]) == 0);
+    fail_unless(iwab_attach_filter(&r->iw) == 0);
+    iwab_fec_decoder_init(&r->fec);
+    iwab_rx_init(&r->rx, pa_rtclock_now());
+    fail_unless((r->codec = iwab_get_codec(cfg->codec)) != NULL);
+    fail_unless((r->codec_info = r->codec->init(false, &ss)) != NULL);
+    r->pcm = pa_xmalloc(r->codec->get_read_block_size(r->codec_info, MTU));
+    r->latencies = pa_xnew(pa_usec_t, chunks);
+
+    memset(l, 0, sizeof(*l));
+    l->cfg = cfg;
+    l->in_fd = tx[1];
+    l->out_fd = rx[0];
+    l->done_fd = done[1];
+    l->lcg_state = 42;
+
+    memset(&s, 0, sizeof(s));
+    s.cfg = cfg;
+    s.fd = tx[0];
+    s.chunks = chunks;
+
+    cpu_start = thread_cpu_usec();
+    start = s.start = r->start = pa_rtclock_now();
+    fail_unless((lt = pa_thread_new("iwab-link", link_thread, l)) != NULL);
+    fail_unless((st = pa_thread_new("iwab-sender", sender_thread, &s)) != NULL);
+
+    for (;;) {
+        struct pollfd p[2] = {
+            { .fd = r->iw.fd, .events = POLLIN },
+            { .fd = done[0], .events = POLLIN },
+        };
+        size_t off;
+        ssize_t n;
+
+        fail_unless(poll(p, 2, -1) > 0);
+
+        if (p[0].revents & POLLIN) {
+            /* recv() fails with -1 once the socket is drained, frames
+             * rejected by iwab_read() come out as other negative values */
+            while ((n = iwab_read(&r->iw, (char *) buf, sizeof(buf), &off)) != -1)
+                if (n >= 0)
+                    receive(r, buf + off, n);
+
+            fail_unless(errno == EAGAIN);
+        } else if (p[1].revents & POLLIN)
+            break;
+    }
+
+    iwab_fec_decoder_flush(&r->fec);
+    fec_drain(r);
+
+    duration = pa_rtclock_now() - start;
+    r->cpu_usec = thread_cpu_usec() - cpu_start;
+    pa_thread_free(st);
+    pa_thread_free(lt);
+
+    // chunks lost at the end of the stream are gaps too
+    end = r->start + chunks * CHUNK_USEC;
+    r->lost = r->rx.lost / CHUNK_USEC;
+    if (r->rx.last_pb_ts < end) {
+        r->glitches++;
+        r->lost += (end - PA_MAX(r->rx.last_pb_ts, r->start)) / CHUNK_USEC;
+    }
+
+    qsort(r->latencies, r->chunks, sizeof(pa_usec_t), cmp_usec);
+
+    pa_log_info("%s: %llu wire frames, %.0f frames/s, tx %.2fus/frame, rx %.2fus/frame",
+            cfg->name, (unsigned long long) s.wire_frames, s.wire_frames * (double) PA_USEC_PER_SEC / duration,
+            (double) s.cpu_usec / PA_MAX(s.wire_frames, 1),
+            (double) r->cpu_usec / PA_MAX(r->wire_frames, 1));
+    pa_log_info("%s: link dropped %llu, reordered %llu, duplicated %llu, fec recovered %llu",
+            cfg->name, (unsigned long long) l->dropped, (unsigned long long) l->reordered,
+            (unsigned long long) l->duplicated, (unsigned long long) r->fec.recovered);
+    pa_log_info("%s: %llu glitches, %llu chunks lost, %llu restarts", cfg->name,
+            (unsigned long long) r->glitches, (unsigned long long) r->lost,
+            (unsigned long long) r->restarts);
+
+    // unpaced, frames are sent ahead of their timestamp
+    if (cfg->paced) {
+        pa_log_info("%s: latency p50 %lluus p90 %lluus p99 %lluus max %lluus, jitter %lluus", cfg->name,
+            (unsigned long long) percentile(r->latencies, r->chunks, 50),
+            (unsigned long long) percentile(r->latencies, r->chunks, 90),
+            (unsigned long long) percentile(r->latencies, r->chunks, 99),
+            (unsigned long long) percentile(r->latencies, r->chunks, 100),
+            (unsigned long long) r->rx.jitter);
+        // scheduling noise only, far from a wrapped around estimate
+        fail_unless(r->rx.jitter < 100 * PA_USEC_PER_MSEC);
+    }
+
+    // every chunk is either handed out once, in order, or accounted lost
+    fail_unless(r->chunks + r->lost == chunks);
+    fail_unless(r->corrupted == 0);
+    fail_unless(r->restarts == (cfg->restart ? 1 : 0));
+
+    iwab_rx_done(&r->rx);
+    r->codec->deinit(r->codec_info);
+    pa_xfree(r->pcm);
+    pa_xfree(r->latencies);
+    iwab_close(&r->iw); /* the sender closed tx[0] */
+    pa_close(tx[1]);
+    pa_close(rx[0]);
+    pa_close(done[0]);
+    pa_close(done[1]);
+}
+
+static const struct link_config clean_links[] = {
+    { "pcm resend", "pcm", 0, 0, 0, 0, 0, false, false },
+    { "pcm fec 4+1", "pcm", 4, 1, 0, 0, 0, false, false },
+    { "adpcm fec 8+2", "adpcm", 8, 2, 0, 0, 0, false, false },
+    { "pcm resend, sender restart", "pcm", 0, 0, 0, 0, 0, false, true },
+    { "pcm fec 4+1, sender restart", "pcm", 4, 1, 0, 0, 0, false, true },
+};
+
+static const struct link_config impaired_links[] = {
+    { "pcm resend, 2% loss", "pcm", 0, 0, 0.02, 0, 0, false, false },
+    { "pcm fec 4+1, 2% loss", "pcm", 4, 1, 0.02, 0, 0, false, false },
+    { "pcm fec 8+2, reorder and dup", "pcm", 8, 2, 0, 0.05, 0.05, false, false },
+    { "pcm resend, reorder and dup", "pcm", 0, 0, 0, 0.05, 0.05, false, false },
+};
+
+static void run_clean(const struct link_config *cfg) {
+    struct receiver r;
+    struct link l;
+
+    run_loopback(cfg, CHUNKS, &r, &l);
+    fail_unless(r.glitches == 0);
+    fail_unless(r.chunks == CHUNKS);
+}
+
+static void run_impaired(const struct link_config *cfg) {
+    struct receiver r;
+    struct link l;
+
+    run_loopback(cfg, CHUNKS, &r, &l);
+
+    /* both the resends and the parity frames repair most of the loss,
+     * duplicates and reordering within a fec group are harmless */
+    fail_unless(r.lost * 4 <= l.dropped);
+    if (cfg->fec_k && cfg->loss == 0)
+        fail_unless(r.glitches == 0);
+}
+
+START_TEST (loopback_clean_test) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(clean_links); i++)
+        run_clean(&clean_links[i]);
+}
+END_TEST
+
+START_TEST (loopback_impaired_test) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(impaired_links); i++)
+        run_impaired(&impaired_links[i]);
+}
+END_TEST
+
+/* The same links in real time, for the latency figures */
+START_TEST (loopback_paced_test) {
+    struct link_config cfg;
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(clean_links); i++) {
+        cfg = clean_links[i];
+        cfg.paced = true;
+        run_clean(&cfg);
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(impaired_links); i++) {
+        cfg = impaired_links[i];
+        cfg.paced = true;
+        run_impaired(&cfg);
+    }
+}
+END_TEST
+
+/* Link set from the environment */
+START_TEST (loopback_custom_test) {
+    struct link_config cfg = { "custom", "pcm", 0, 0, 0, 0, 0, true, false };
+    struct receiver r;
+    struct link l;
+    const char *e;
+
+    if ((e = getenv("IWAB_LOSS")))
+        cfg.loss = atof(e) / 100;
+    if ((e = getenv("IWAB_REORDER")))
+        cfg.reorder = atof(e) / 100;
+    if ((e = getenv("IWAB_DUP")))
+        cfg.dup = atof(e) / 100;
+    if ((e = getenv("IWAB_FEC")))
+        fail_unless(sscanf(e, "%u+%u", &cfg.fec_k, &cfg.fec_m) >= 1);
+    if ((e = getenv("IWAB_CODEC")))
+        cfg.codec = e;
+
+    fail_unless(cfg.fec_k == 0 || iwab_fec_params_valid(cfg.fec_k, cfg.fec_m));
+    run_loopback(&cfg, CHUNKS, &r, &l);
+}
+END_TEST
+
+/* The hot path as fast as it goes, without pacing */
+START_TEST (loopback_throughput_benchmark) {
+    static const struct link_config configs[] = {
+        { "unpaced pcm resend", "pcm", 0, 0, 0, 0, 0, false, false },
+        { "unpaced pcm fec 8+2", "pcm", 8, 2, 0, 0, 0, false, false },
+        { "unpaced adpcm fec 8+2", "adpcm", 8, 2, 0, 0, 0, false, false },
+    };
+    struct receiver r;
+    struct link l;
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(configs); i++) {
+        run_loopback(&configs[i], BENCHMARK_CHUNKS, &r, &l);
+        fail_unless(r.glitches == 0);
+    }
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("iwab loopback");
+    tc = tcase_create("iwab loopback");
+    tcase_add_test(tc, loopback_clean_test);
+    tcase_add_test(tc, loopback_impaired_test);
+    suite_add_tcase(s, tc);
+
+    /* Real time runs and the benchmark, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("iwab loopback benchmark");
+        tcase_add_test(tc, loopback_paced_test);
+        tcase_add_test(tc, loopback_custom_test);
+        tcase_add_test(tc, loopback_throughput_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,189 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "../modules/iwab/plc.h"
+
+#define RATE 44100
+#define CHANNELS 2
+#define FREQ 441.0 /* a period of exactly 100 frames */
+#define CHUNK 441
+#define MAX_MSEC 60
+
+static void sine(int16_t *d, size_t start, size_t frames) {
+    size_t f;
+    unsigned c;
+
+    for (f = 0; f < frames; f++)
+        for (c = 0; c < CHANNELS; c++)
+            d[f * CHANNELS + c] = (int16_t) lrint(10000 * sin(2 * M_PI * FREQ * (start + f) / RATE));
+}
+
+/* Largest step between two consecutive frames of the first channel */
+static int max_step(const int16_t *d, size_t frames) {
+    int m = 0;
+    size_t f;
+
+    for (f = 1; f < frames; f++)
+        m = PA_MAX(m, abs(d[f * CHANNELS] - d[(f - 1) * CHANNELS]));
+
+    return m;
+}
+
+/* Feed 100ms of sine */
+static size_t prime(struct iwab_plc *plc, int16_t *buf) {
+    size_t pos;
+
+    for (pos = 0; pos < 10 * CHUNK; pos += CHUNK) {
+        sine(buf, pos, CHUNK);
+        iwab_plc_feed(plc, buf, CHUNK);
+    }
+
+    return pos;
+}
+
+START_TEST (plc_wsola_test) {
+    struct iwab_plc plc;
+    int16_t *buf = pa_xnew(int16_t, 4 * CHUNK * CHANNELS);
+    int16_t last;
+    size_t pos, n, f;
+    int sine_step;
+
+    fail_unless(iwab_plc_init(&plc, IWAB_PLC_WSOLA, RATE, CHANNELS, MAX_MSEC) == 0);
+    pos = prime(&plc, buf);
+    last = buf[(CHUNK - 1) * CHANNELS];
+    sine_step = max_step(buf, CHUNK);
+
+    /* the concealed audio goes on smoothly and follows the sine closely
+     * while it is at full level */
+    n = iwab_plc_conceal(&plc, buf + CHANNELS, CHUNK / 2);
+    fail_unless(n == CHUNK / 2);
+    buf[0] = last;
+    fail_unless(max_step(buf, n + 1) <= sine_step + 50);
+
+    for (f = 0; f < n; f++) {
+        int16_t expected = (int16_t) lrint(10000 * sin(2 * M_PI * FREQ * (pos + f) / RATE));
+
+        fail_unless(abs(buf[(f + 1) * CHANNELS] - expected) < 100);
+    }
+
+    /* the next received chunk is crossfaded without a click */
+    pos += n;
+    last = buf[n * CHANNELS];
+    sine(buf + CHANNELS, pos, CHUNK);
+    iwab_plc_feed(&plc, buf + CHANNELS, CHUNK);
+    buf[0] = last;
+    fail_unless(max_step(buf, CHUNK + 1) <= sine_step + 50);
+
+    iwab_plc_done(&plc);
+    pa_xfree(buf);
+}
+END_TEST
+
+START_TEST (plc_cap_test) {
+    struct iwab_plc plc;
+    int16_t *buf = pa_xnew(int16_t, RATE * CHANNELS);
+    size_t n, f;
+
+    fail_unless(iwab_plc_init(&plc, IWAB_PLC_WSOLA, RATE, CHANNELS, MAX_MSEC) == 0);
+    prime(&plc, buf);
+
+    /* a long gap is only concealed up to the cap, in several calls too */
+    n = iwab_plc_conceal(&plc, buf, CHUNK);
+    n += iwab_plc_conceal(&plc, buf, RATE);
+    fail_unless(n == RATE * MAX_MSEC / 1000);
+    fail_unless(iwab_plc_conceal(&plc, buf, CHUNK) == 0);
+    fail_unless(plc.total == n);
+
+    /* and it has faded out by then */
+    for (f = n - CHUNK - 10; f < n - CHUNK; f++)
+        fail_unless(abs(buf[f * CHANNELS]) < 200);
+
+    /* received audio resets the cap */
+    sine(buf, 0, CHUNK);
+    iwab_plc_feed(&plc, buf, CHUNK);
+    fail_unless(iwab_plc_conceal(&plc, buf, CHUNK) == CHUNK);
+
+    iwab_plc_done(&plc);
+    pa_xfree(buf);
+}
+END_TEST
+
+START_TEST (plc_fade_test) {
+    struct iwab_plc plc;
+    int16_t *buf = pa_xnew(int16_t, 4 * CHUNK * CHANNELS);
+    size_t n, f;
+
+    fail_unless(iwab_plc_init(&plc, IWAB_PLC_FADE, RATE, CHANNELS, MAX_MSEC) == 0);
+
+    /* nothing received yet, silence */
+    fail_unless(iwab_plc_conceal(&plc, buf, CHUNK) == CHUNK);
+    for (f = 0; f < CHUNK * CHANNELS; f++)
+        fail_unless(buf[f] == 0);
+
+    sine(buf, 0, CHUNK);
+    iwab_plc_feed(&plc, buf, CHUNK);
+    prime(&plc, buf);
+
+    /* fades to silence within 20ms */
+    n = iwab_plc_conceal(&plc, buf, 2 * CHUNK);
+    fail_unless(n == 2 * CHUNK);
+    fail_unless(abs(buf[0]) > 0 || abs(buf[CHANNELS]) > 0);
+    for (f = RATE / 50; f < n; f++)
+        fail_unless(buf[f * CHANNELS] == 0);
+
+    iwab_plc_done(&plc);
+    pa_xfree(buf);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("iwab plc");
+    tc = tcase_create("iwab plc");
+    tcase_add_test(tc, plc_wsola_test);
+    tcase_add_test(tc, plc_cap_test);
+    tcase_add_test(tc, plc_fade_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,250 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "../modules/iwab/rx.h"
+
+#define FRAME_USEC (5 * PA_USEC_PER_MSEC)
+#define START (1000 * PA_USEC_PER_SEC)
+#define TRANSIT (10 * PA_USEC_PER_MSEC)
+
+/* Frame n of the sender arrives transit late */
+static void arrive(struct iwab_rx *rx, unsigned n, pa_usec_t transit) {
+    uint64_t timestamp = START + (uint64_t) n * FRAME_USEC;
+
+    iwab_rx_update_timing(rx, timestamp, timestamp + transit);
+}
+
+/* Run frame seq with sender timestamp ts through the rx thread checks,
+ * returns the sender time to conceal before it or -1 if it is dropped */
+static int64_t receive(struct iwab_rx *rx, uint32_t seq, uint64_t timestamp) {
+    iwab_rx_check_restart(rx, seq, timestamp);
+
+    if (!iwab_rx_frame_is_new(rx, seq, timestamp))
+        return -1;
+
+    return (int64_t) iwab_rx_push(rx, seq, timestamp, FRAME_USEC);
+}
+
+static uint64_t ts(uint32_t seq) {
+    return START + (uint64_t) seq * FRAME_USEC;
+}
+
+START_TEST (rx_sequence_test) {
+    struct iwab_rx rx;
+    uint32_t seq;
+
+    iwab_rx_init(&rx, START);
+
+    for (seq = 1; seq <= 10; seq++)
+        fail_unless(receive(&rx, seq, ts(seq)) == 0);
+
+    /* repeats and late frames are dropped */
+    fail_unless(receive(&rx, 10, ts(10)) == -1);
+    fail_unless(receive(&rx, 8, ts(8)) == -1);
+
+    /* a gap is reported for concealment */
+    fail_unless(receive(&rx, 13, ts(13)) == 2 * FRAME_USEC);
+    fail_unless(rx.lost == 2 * FRAME_USEC);
+    fail_unless(receive(&rx, 11, ts(11)) == -1);
+
+    /* frames skipped in sequence but not in time resync without a gap,
+     * those going back in time are dropped */
+    fail_unless(receive(&rx, 16, ts(14)) == 0);
+    fail_unless(receive(&rx, 18, ts(14)) == -1);
+    fail_unless(receive(&rx, 17, ts(15)) == 0);
+    fail_unless(rx.lost == 2 * FRAME_USEC);
+    fail_unless(rx.seqnb == 17);
+
+    iwab_rx_done(&rx);
+}
+END_TEST
+
+START_TEST (rx_restart_test) {
+    struct iwab_rx rx;
+    uint32_t seq;
+
+    iwab_rx_init(&rx, START);
+
+    for (seq = 1; seq <= 500; seq++)
+        fail_unless(receive(&rx, seq, ts(seq)) == 0);
+
+    /* retries of the last frames are no restart */
+    fail_unless(!iwab_rx_check_restart(&rx, 500, ts(500)));
+    fail_unless(!iwab_rx_check_restart(&rx, 499, ts(499)));
+
+    /* the sender starts over at seq 1, later in time */
+    fail_unless(iwab_rx_check_restart(&rx, 1, ts(600)));
+    fail_unless(iwab_rx_frame_is_new(&rx, 1, ts(600)));
+    fail_unless(iwab_rx_push(&rx, 1, ts(600), FRAME_USEC) == 0);
+
+    for (seq = 2; seq <= 10; seq++)
+        fail_unless(receive(&rx, seq, ts(599 + seq)) == 0);
+
+    /* late frames of the previous stream are still dropped */
+    fail_unless(!iwab_rx_check_restart(&rx, 499, ts(499)));
+    fail_unless(receive(&rx, 499, ts(499)) == -1);
+    fail_unless(rx.seqnb == 10);
+
+    /* so is a restart with a timestamp a lot earlier */
+    fail_unless(iwab_rx_check_restart(&rx, 11, ts(0)));
+    fail_unless(receive(&rx, 11, ts(0)) == 0);
+    fail_unless(receive(&rx, 12, ts(1)) == 0);
+    fail_unless(rx.lost == 0);
+
+    iwab_rx_done(&rx);
+}
+END_TEST
+
+START_TEST (rx_jitter_test) {
+    struct iwab_rx rx;
+    pa_usec_t transit = TRANSIT, last;
+    unsigned n = 0, i;
+
+    iwab_rx_init(&rx, START);
+
+    /* transit times 4ms apart: the jitter converges to 4ms */
+    for (i = 0; i < 200; i++, n++) {
+        transit = TRANSIT + (i & 1) * 4 * PA_USEC_PER_MSEC;
+        arrive(&rx, n, transit);
+    }
+
+    pa_log_debug("Jitter with 4ms deltas: %llu usec", (unsigned long long) rx.jitter);
+    fail_unless(rx.jitter > 3900 && rx.jitter <= 4000);
+
+    /* a smaller delta than the jitter brings it down by one sixteenth of
+     * the difference */
+    last = rx.jitter;
+    transit += PA_USEC_PER_MSEC;
+    arrive(&rx, n++, transit);
+    fail_unless(rx.jitter == last - (last - PA_USEC_PER_MSEC) / 16);
+
+    for (i = 0; i < 200; i++, n++) {
+        last = rx.jitter;
+        if (i & 1)
+            transit += PA_USEC_PER_MSEC;
+        else
+            transit -= PA_USEC_PER_MSEC;
+        arrive(&rx, n, transit);
+        fail_unless(rx.jitter <= last);
+    }
+
+    pa_log_debug("Jitter with 1ms deltas: %llu usec", (unsigned long long) rx.jitter);
+    fail_unless(rx.jitter >= PA_USEC_PER_MSEC && rx.jitter < PA_USEC_PER_MSEC + 20);
+
+    /* and a steady transit time to almost nothing */
+    for (i = 0; i < 200; i++, n++) {
+        last = rx.jitter;
+        arrive(&rx, n, transit);
+        fail_unless(rx.jitter <= last);
+    }
+
+    fail_unless(rx.jitter < 16);
+    fail_unless(rx.timeline == 1);
+
+    iwab_rx_done(&rx);
+}
+END_TEST
+
+START_TEST (rx_timeline_test) {
+    struct iwab_rx rx;
+    pa_usec_t jitter;
+    unsigned n;
+
+    iwab_rx_init(&rx, START);
+
+    for (n = 0; n < 100; n++)
+        arrive(&rx, n, TRANSIT + (n & 1) * PA_USEC_PER_MSEC);
+
+    fail_unless(rx.timeline == 1);
+    jitter = rx.jitter;
+
+    /* a transit time jump is a new sender timeline, it doesn't count as
+     * jitter */
+    arrive(&rx, n++, TRANSIT + 2 * PA_USEC_PER_SEC);
+    fail_unless(rx.timeline == 2);
+    fail_unless(rx.jitter == jitter - jitter / 16);
+
+    arrive(&rx, n++, TRANSIT + 2 * PA_USEC_PER_SEC);
+    fail_unless(rx.timeline == 2);
+
+    iwab_rx_done(&rx);
+}
+END_TEST
+
+START_TEST (rx_drift_test) {
+    struct iwab_rx rx;
+    pa_usec_t local = START, remote1, remote2;
+    uint64_t timestamp = START;
+    double ratio;
+    unsigned n;
+
+    iwab_rx_init(&rx, local);
+
+    /* the sender clock runs 200ppm fast, arrivals are up to 2ms late */
+    for (n = 0; n < 4000; n++) {
+        local = START + (pa_usec_t) n * FRAME_USEC;
+        timestamp = START + (uint64_t) (n * FRAME_USEC * 1.0002);
+        iwab_rx_update_timing(&rx, timestamp, local + TRANSIT + (n * 7919 % 2000));
+    }
+
+    remote1 = iwab_rx_get_remote(&rx, local);
+    remote2 = iwab_rx_get_remote(&rx, local + PA_USEC_PER_SEC);
+    ratio = (double) (remote2 - remote1) / PA_USEC_PER_SEC;
+
+    pa_log_debug("Estimated clock ratio %f", ratio);
+    fail_unless(ratio > 1.0001 && ratio < 1.0003);
+
+    iwab_rx_done(&rx);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("iwab rx");
+    tc = tcase_create("iwab rx");
+    tcase_add_test(tc, rx_sequence_test);
+    tcase_add_test(tc, rx_restart_test);
+    tcase_add_test(tc, rx_jitter_test);
+    tcase_add_test(tc, rx_timeline_test);
+    tcase_add_test(tc, rx_drift_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
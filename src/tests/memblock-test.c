@@ -24,6 +24,7 @@
 
 #include <check.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/log.h>
@@ -176,6 +177,146 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+START_TEST (memblock_slot_class_test) {
+    static const size_t sizes[] = { 8192, 2048, 65536, 2048 };
+    pa_mempool *pool;
+    const pa_mempool_stat *stat;
+    pa_memblock *small, *medium, *large, *blocks[1024];
+    unsigned n, i;
+
+    pool = pa_mempool_new_full(PA_MEM_TYPE_PRIVATE, 2*1024*1024, true, sizes, PA_ELEMENTSOF(sizes), 0, PA_SHM_NUMA_NODE_ANY);
+    fail_unless(pool != NULL);
+
+    stat = pa_mempool_get_stat(pool);
+
+    /* Sorted, without the duplicate */
+    fail_unless(stat->n_slot_classes == 3);
+    fail_unless(stat->slot_class_size[0] == 2048);
+    fail_unless(stat->slot_class_size[1] == 8192);
+    fail_unless(stat->slot_class_size[2] == 65536);
+    fail_unless(stat->slot_class_n_slots[2] == 16);
+
+    fail_unless(pa_mempool_block_size_max(pool) < 65536);
+    fail_unless(pa_mempool_block_size_max(pool) > 65536 - 256);
+
+    small = pa_memblock_new_pool(pool, 100);
+    medium = pa_memblock_new_pool(pool, 5000);
+    large = pa_memblock_new_pool(pool, (size_t) -1);
+    fail_unless(small && medium && large);
+
+    fail_unless(pa_memblock_get_length(large) == pa_mempool_block_size_max(pool));
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_class[0]) == 1);
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_class[1]) == 1);
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_class[2]) == 1);
+
+    /* Too large for any slot */
+    fail_unless(pa_memblock_new_pool(pool, 65537) == NULL);
+
+    /* Exhaust the smallest class, further small blocks spill over into
+     * the next larger one */
+    n = stat->slot_class_n_slots[0] - 1;
+    fail_unless(n + 1 <= PA_ELEMENTSOF(blocks));
+
+    for (i = 0; i < n; i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool, 100)) != NULL);
+
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_class[0]) == (int) stat->slot_class_n_slots[0]);
+    fail_unless(pa_atomic_load(&stat->n_full_by_class[0]) == 0);
+
+    fail_unless((blocks[n] = pa_memblock_new_pool(pool, 100)) != NULL);
+    fail_unless(pa_atomic_load(&stat->n_full_by_class[0]) == 1);
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_class[1]) == 2);
+
+    for (i = 0; i <= n; i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_memblock_unref(small);
+    pa_memblock_unref(medium);
+    pa_memblock_unref(large);
+
+    for (i = 0; i < stat->n_slot_classes; i++)
+        fail_unless(pa_atomic_load(&stat->n_allocated_by_class[i]) == 0);
+    fail_unless(pa_atomic_load(&stat->n_accumulated_by_class[0]) == (int) stat->slot_class_n_slots[0]);
+
+    /* Freed slots are reused */
+    small = pa_memblock_new_pool(pool, 100);
+    fail_unless(small != NULL);
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_class[0]) == 1);
+    pa_memblock_unref(small);
+
+    pa_mempool_vacuum(pool);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+#define N_BENCH_BLOCKS 512
+#define N_BENCH_ROUNDS 16
+
+/* Allocate, render into and free blocks like a sink render loop does,
+ * with enough blocks in flight to spread over a large part of the
+ * pool. The first round pays for faulting in lazily backed memory. */
+static void render_benchmark(const char *label, pa_shm_flags_t flags, int numa_node) {
+    pa_mempool *pool;
+    pa_memblock *blocks[N_BENCH_BLOCKS];
+    pa_usec_t start, first = 0, rest = 0;
+    size_t length, k;
+    unsigned round, n;
+    int64_t sum = 0;
+
+    pool = pa_mempool_new_full(PA_MEM_TYPE_PRIVATE, 0, true, NULL, 0, flags, numa_node);
+    fail_unless(pool != NULL);
+
+    length = pa_mempool_block_size_max(pool);
+
+    for (round = 0; round < N_BENCH_ROUNDS; round++) {
+        start = pa_rtclock_now();
+
+        for (n = 0; n < N_BENCH_BLOCKS; n++) {
+            int16_t *d;
+
+            fail_unless((blocks[n] = pa_memblock_new_pool(pool, length)) != NULL);
+
+            d = pa_memblock_acquire(blocks[n]);
+            for (k = 0; k < length / sizeof(int16_t); k++)
+                d[k] = (int16_t) (k * 7 + n);
+            pa_memblock_release(blocks[n]);
+        }
+
+        for (n = 0; n < N_BENCH_BLOCKS; n++) {
+            const int16_t *d;
+
+            d = pa_memblock_acquire(blocks[n]);
+            for (k = 0; k < length / sizeof(int16_t); k += 64)
+                sum += d[k];
+            pa_memblock_release(blocks[n]);
+
+            pa_memblock_unref(blocks[n]);
+        }
+
+        if (round == 0)
+            first = pa_rtclock_now() - start;
+        else
+            rest += pa_rtclock_now() - start;
+    }
+
+    pa_log_info("%s: first round %.1f ns/block, later rounds %.1f ns/block (%lli)",
+                label,
+                (double) first * 1000.0 / N_BENCH_BLOCKS,
+                (double) rest * 1000.0 / (N_BENCH_BLOCKS * (N_BENCH_ROUNDS - 1)),
+                (long long) sum);
+
+    pa_mempool_unref(pool);
+}
+
+START_TEST (memblock_backing_benchmark) {
+    render_benchmark("default", 0, PA_SHM_NUMA_NODE_ANY);
+    render_benchmark("prefault", PA_SHM_PREFAULT, PA_SHM_NUMA_NODE_ANY);
+    render_benchmark("huge pages", PA_SHM_HUGE_PAGES, PA_SHM_NUMA_NODE_ANY);
+    render_benchmark("huge pages, prefault", PA_SHM_HUGE_PAGES|PA_SHM_PREFAULT, PA_SHM_NUMA_NODE_ANY);
+    render_benchmark("huge pages, prefault, local node", PA_SHM_HUGE_PAGES|PA_SHM_PREFAULT, PA_SHM_NUMA_NODE_LOCAL);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -188,8 +329,17 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, memblock_slot_class_test);
     suite_add_tcase(s, tc);
 
+    /* Timings only, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("memblock benchmark");
+        tcase_add_test(tc, memblock_backing_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);
@@ -20,12 +20,14 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include <check.h>
 
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
@@ -342,6 +344,136 @@ START_TEST (mix_test) {
 }
 END_TEST
 
+#define FLOAT_MIX_STREAMS 3
+#define FLOAT_MIX_SAMPLES 1024
+
+static int32_t read_int_sample(pa_sample_format_t f, const void *p, unsigned i) {
+    switch (f) {
+        case PA_SAMPLE_S16NE:
+            return ((const int16_t *) p)[i];
+        case PA_SAMPLE_S24NE:
+            return (int32_t) (PA_READ24NE((const uint8_t *) p + 3 * i) << 8) >> 8;
+        case PA_SAMPLE_S24_32NE:
+            return (int32_t) (((const uint32_t *) p)[i] << 8) >> 8;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void write_int_sample(pa_sample_format_t f, void *p, unsigned i, int32_t v) {
+    switch (f) {
+        case PA_SAMPLE_S16NE:
+            ((int16_t *) p)[i] = (int16_t) v;
+            break;
+        case PA_SAMPLE_S24NE:
+            PA_WRITE24NE((uint8_t *) p + 3 * i, (uint32_t) v);
+            break;
+        case PA_SAMPLE_S24_32NE:
+            ((uint32_t *) p)[i] = ((uint32_t) v) & 0xFFFFFFU;
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+/* pa_mix_float() must agree with pa_mix() up to the rounding of the
+ * integer mixer, which truncates once per stream and has 16 bit volume
+ * factors. Dither may only move samples by one LSB and must not shift
+ * the signal. */
+START_TEST (mix_float_test) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_S24NE, PA_SAMPLE_S24_32NE };
+    pa_mempool *pool;
+    pa_sample_spec a;
+    unsigned f;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    a.channels = 2;
+    a.rate = 44100;
+
+    fail_unless(!pa_mix_float_supported(PA_SAMPLE_S32NE));
+    fail_unless(!pa_mix_float_supported(PA_SAMPLE_FLOAT32NE));
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+        pa_mix_info m[FLOAT_MIX_STREAMS];
+        void *src[FLOAT_MIX_STREAMS];
+        size_t length;
+        void *ref, *out, *dithered;
+        float *accum;
+        int32_t max;
+        uint32_t dither = 1;
+        double drift = 0;
+        unsigned i, k;
+
+        a.format = formats[f];
+        fail_unless(pa_mix_float_supported(a.format));
+
+        pa_log_debug("=== float mixing: %s", pa_sample_format_to_string(a.format));
+
+        max = a.format == PA_SAMPLE_S16NE ? 0x7FFF : 0x7FFFFF;
+        length = FLOAT_MIX_SAMPLES * pa_sample_size(&a);
+
+        for (k = 0; k < FLOAT_MIX_STREAMS; k++) {
+            void *d;
+
+            m[k].chunk.memblock = pa_memblock_new(pool, length);
+            m[k].chunk.index = 0;
+            m[k].chunk.length = length;
+            pa_cvolume_set(&m[k].volume, a.channels, pa_sw_volume_from_linear(0.3 + 0.2 * k));
+
+            d = pa_memblock_acquire(m[k].chunk.memblock);
+            for (i = 0; i < FLOAT_MIX_SAMPLES; i++)
+                write_int_sample(a.format, d, i, (int32_t) (rand() % (max + 1)) - max / 2);
+            pa_memblock_release(m[k].chunk.memblock);
+        }
+
+        ref = pa_xmalloc(length);
+        out = pa_xmalloc(length);
+        dithered = pa_xmalloc(length);
+        accum = pa_xnew(float, FLOAT_MIX_SAMPLES);
+
+        pa_mix(m, FLOAT_MIX_STREAMS, ref, length, &a, NULL, false);
+        pa_mix_float(m, FLOAT_MIX_STREAMS, out, length, &a, NULL, false, accum, NULL);
+        pa_mix_float(m, FLOAT_MIX_STREAMS, dithered, length, &a, NULL, false, accum, &dither);
+
+        for (k = 0; k < FLOAT_MIX_STREAMS; k++)
+            src[k] = pa_memblock_acquire(m[k].chunk.memblock);
+
+        for (i = 0; i < FLOAT_MIX_SAMPLES; i++) {
+            int32_t r = read_int_sample(a.format, ref, i);
+            int32_t o = read_int_sample(a.format, out, i);
+            int32_t d = read_int_sample(a.format, dithered, i);
+            int32_t tolerance = 0;
+
+            for (k = 0; k < FLOAT_MIX_STREAMS; k++)
+                tolerance += 1 + abs(read_int_sample(a.format, src[k], i)) / 0x10000;
+
+            fail_unless(abs(o - r) <= tolerance, "sample %u: %d vs %d", i, o, r);
+            fail_unless(abs(d - o) <= 1, "sample %u: dithered %d vs %d", i, d, o);
+
+            drift += d - o;
+        }
+
+        fail_unless(fabs(drift / FLOAT_MIX_SAMPLES) < 0.1);
+
+        for (k = 0; k < FLOAT_MIX_STREAMS; k++) {
+            pa_memblock_release(m[k].chunk.memblock);
+            pa_memblock_unref(m[k].chunk.memblock);
+        }
+
+        pa_xfree(ref);
+        pa_xfree(out);
+        pa_xfree(dithered);
+        pa_xfree(accum);
+    }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -351,6 +483,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("Mix");
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_test);
+    tcase_add_test(tc, mix_float_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
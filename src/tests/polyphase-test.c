@@ -0,0 +1,494 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
+
+#define BLOCK_FRAMES 480
+#define N_STREAMS 500
+#define TONE_HZ 1000.0
+#define AMPLITUDE 0.5
+
+static pa_mempool *pool;
+
+static float *sine_new(uint32_t rate, unsigned channels, size_t n_frames) {
+    float *s = pa_xnew(float, n_frames * channels);
+    size_t i;
+    unsigned c;
+
+    for (i = 0; i < n_frames; i++)
+        for (c = 0; c < channels; c++)
+            s[i * channels + c] = (float) (AMPLITUDE * sin(2 * M_PI * TONE_HZ * i / rate + c));
+
+    return s;
+}
+
+static pa_resampler *polyphase_new(uint32_t in_rate, uint32_t out_rate, unsigned channels, pa_resample_flags_t flags) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = channels;
+    a.rate = in_rate;
+    b.rate = out_rate;
+
+    fail_unless((r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, PA_RESAMPLER_POLYPHASE, flags)) != NULL);
+    fail_unless(pa_resampler_get_method(r) == PA_RESAMPLER_POLYPHASE);
+
+    return r;
+}
+
+/* Resamples n_frames of in, appends the result to out at *n_out */
+static void feed(pa_resampler *r, const float *in, size_t n_frames, unsigned channels, float *out, size_t *n_out, size_t max_out) {
+    pa_memchunk i, o;
+
+    i.memblock = pa_memblock_new_fixed(pool, (void *) in, n_frames * channels * sizeof(float), true);
+    i.index = 0;
+    i.length = pa_memblock_get_length(i.memblock);
+
+    pa_resampler_run(r, &i, &o);
+    pa_memblock_unref(i.memblock);
+
+    if (!o.memblock)
+        return;
+
+    fail_unless(*n_out + o.length / sizeof(float) / channels <= max_out);
+    memcpy(out + *n_out * channels, pa_memblock_acquire_chunk(&o), o.length);
+    pa_memblock_release(o.memblock);
+    pa_memblock_unref(o.memblock);
+
+    *n_out += o.length / sizeof(float) / channels;
+}
+
+/* Signal to noise ratio of channel 0 in dB, anything but the tone is
+ * noise */
+static double tone_snr(const float *s, size_t n_frames, unsigned channels, uint32_t rate) {
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, a, b, det, signal = 0, noise = 0;
+    size_t i;
+
+    for (i = 0; i < n_frames; i++) {
+        double sn = sin(2 * M_PI * TONE_HZ * i / rate), cs = cos(2 * M_PI * TONE_HZ * i / rate);
+
+        ss += sn * sn;
+        cc += cs * cs;
+        sc += sn * cs;
+        ys += s[i * channels] * sn;
+        yc += s[i * channels] * cs;
+    }
+
+    det = ss * cc - sc * sc;
+    a = (ys * cc - yc * sc) / det;
+    b = (yc * ss - ys * sc) / det;
+
+    for (i = 0; i < n_frames; i++) {
+        double fit = a * sin(2 * M_PI * TONE_HZ * i / rate) + b * cos(2 * M_PI * TONE_HZ * i / rate);
+
+        signal += fit * fit;
+        noise += (s[i * channels] - fit) * (s[i * channels] - fit);
+    }
+
+    return 10 * log10(signal / noise);
+}
+
+static void run_quality_test(uint32_t in_rate, uint32_t out_rate, unsigned channels) {
+    const size_t n_in = in_rate / 2, max_out = (size_t) out_rate + BLOCK_FRAMES;
+    pa_resampler *r;
+    float *in, *out;
+    size_t i, n_out = 0, expected;
+    double snr;
+
+    in = sine_new(in_rate, channels, n_in);
+    out = pa_xnew(float, max_out * channels);
+    r = polyphase_new(in_rate, out_rate, channels, 0);
+
+    for (i = 0; i < n_in; i += BLOCK_FRAMES)
+        feed(r, in + i * channels, PA_MIN(BLOCK_FRAMES, n_in - i), channels, out, &n_out, max_out);
+
+    /* All but the filter delay of about 32 frames of the lower rate
+     * comes out */
+    expected = (uint64_t) n_in * out_rate / in_rate;
+    fail_unless(n_out <= expected + 1);
+    fail_unless(n_out + 40 * out_rate / PA_MIN(in_rate, out_rate) >= expected);
+
+    /* Skip the fade in */
+    snr = tone_snr(out + 256 * channels, n_out - 256, channels, out_rate);
+    pa_log_debug("%u -> %u Hz: %zu frames, SNR %0.1f dB", in_rate, out_rate, n_out, snr);
+    fail_unless(snr > 80);
+
+    pa_resampler_free(r);
+    pa_xfree(in);
+    pa_xfree(out);
+}
+
+START_TEST (polyphase_quality_test) {
+    run_quality_test(44100, 48000, 2);
+    run_quality_test(48000, 44100, 2);
+    run_quality_test(48000, 96000, 1);
+    run_quality_test(96000, 48000, 1);
+    run_quality_test(44100, 96000, 2);
+    run_quality_test(96000, 44100, 2);
+    /* Interpolated bank */
+    run_quality_test(44100, 47993, 2);
+    run_quality_test(48000, 44101, 6);
+}
+END_TEST
+
+/* Rewinding and feeding the same input again must give exactly the
+ * output of not rewinding at all */
+static void run_rewind_test(uint32_t in_rate, uint32_t out_rate, pa_resample_flags_t flags) {
+    const unsigned channels = 2;
+    const size_t fs = channels * sizeof(float);
+    const size_t n_in = in_rate / 4, max_out = (size_t) out_rate / 2;
+    pa_resampler *r;
+    float *in, *ref, *out;
+    size_t i, n_ref = 0, n_out = 0, in_bytes, out_bytes;
+
+    in = sine_new(in_rate, channels, n_in);
+    ref = pa_xnew(float, max_out * channels);
+    out = pa_xnew(float, max_out * channels);
+
+    r = polyphase_new(in_rate, out_rate, channels, flags);
+    for (i = 0; i < n_in; i += BLOCK_FRAMES)
+        feed(r, in + i * channels, PA_MIN(BLOCK_FRAMES, n_in - i), channels, ref, &n_ref, max_out);
+    pa_resampler_free(r);
+
+    r = polyphase_new(in_rate, out_rate, channels, flags);
+    pa_resampler_set_max_rewind(r, out_rate / 10 * fs);
+
+    for (i = 0; i < n_in / 2; i += BLOCK_FRAMES)
+        feed(r, in + i * channels, BLOCK_FRAMES, channels, out, &n_out, max_out);
+
+    /* As pa_sink_input_process_rewind(): the implementor rewinds its
+     * input, the output goes back by pa_resampler_result() of that, which
+     * rounds up */
+    in_bytes = PA_MIN((in_rate / 20 + 7) * fs, pa_resampler_request(r, out_rate / 10 * fs));
+    out_bytes = pa_resampler_result(r, in_bytes);
+    pa_resampler_rewind(r, out_bytes, in_bytes);
+    n_out -= out_bytes / fs;
+    i -= in_bytes / fs;
+
+    /* Differently sized blocks this time */
+    for (; i < n_in; i += BLOCK_FRAMES / 3)
+        feed(r, in + i * channels, PA_MIN(BLOCK_FRAMES / 3, n_in - i), channels, out, &n_out, max_out);
+
+    pa_log_debug("%u -> %u Hz: rewound %zu input and %zu output frames, %zu and %zu frames", in_rate, out_rate,
+            in_bytes / fs, out_bytes / fs, n_ref, n_out);
+    fail_unless(n_out == n_ref);
+    fail_unless(memcmp(out, ref, n_out * channels * sizeof(float)) == 0);
+
+    /* Going back further than the history falls back to a reset */
+    pa_resampler_rewind(r, out_rate * fs, in_rate * fs);
+    feed(r, in, BLOCK_FRAMES, channels, out, &n_out, max_out);
+
+    pa_resampler_free(r);
+    pa_xfree(in);
+    pa_xfree(ref);
+    pa_xfree(out);
+}
+
+START_TEST (polyphase_rewind_test) {
+    run_rewind_test(44100, 48000, 0);
+    run_rewind_test(48000, 44100, 0);
+    run_rewind_test(48000, 96000, 0);
+    run_rewind_test(96000, 48000, 0);
+    run_rewind_test(44100, 48000, PA_RESAMPLER_VARIABLE_RATE);
+}
+END_TEST
+
+/* The tone must stay continuous while the input rate changes, also when
+ * the change goes past the headroom of the filter bank. Rates change in
+ * IO threads, no bank may be built then. */
+static void run_rate_change_test(uint32_t in_rate, uint32_t out_rate, double change) {
+    const unsigned channels = 2;
+    const size_t n_in = in_rate / 2, max_out = (size_t) out_rate;
+    /* Largest step between samples of the tone, with some slack for the
+     * rate change */
+    const double max_step = AMPLITUDE * 2 * M_PI * TONE_HZ / out_rate * (1 + change) * 1.05;
+    pa_resampler *r;
+    float *in, *out;
+    size_t i, n_out = 0;
+    unsigned k = 0, n_banks;
+
+    in = sine_new(in_rate, channels, n_in);
+    out = pa_xnew(float, max_out * channels);
+    r = polyphase_new(in_rate, out_rate, channels, PA_RESAMPLER_VARIABLE_RATE);
+    n_banks = pa_resampler_polyphase_n_banks();
+
+    for (i = 0; i < n_in; i += BLOCK_FRAMES, k++) {
+        /* Input rate jumps back and forth every 50 ms */
+        pa_resampler_set_input_rate(r, (uint32_t) (in_rate * ((k / 5) % 2 ? 1 + change : 1)));
+        feed(r, in + i * channels, PA_MIN(BLOCK_FRAMES, n_in - i), channels, out, &n_out, max_out);
+    }
+
+    for (i = 256; i < n_out; i++)
+        fail_unless(fabs(out[i * channels] - out[(i - 1) * channels]) < max_step);
+
+    fail_unless(pa_resampler_polyphase_n_banks() == n_banks);
+
+    pa_resampler_free(r);
+    pa_xfree(in);
+    pa_xfree(out);
+}
+
+START_TEST (polyphase_rate_change_test) {
+    run_rate_change_test(44100, 48000, 0.003);
+    run_rate_change_test(48000, 44100, 0.003);
+    run_rate_change_test(48000, 44100, 0.05);
+}
+END_TEST
+
+/* Resamplers with the same rates share their filter bank, which is kept
+ * for the next one once unused */
+START_TEST (polyphase_cache_test) {
+    pa_resampler *r[8];
+    unsigned i;
+
+    pa_resampler_flush_cache();
+    fail_unless(pa_resampler_polyphase_n_banks() == 0);
+
+    for (i = 0; i < 4; i++)
+        r[i] = polyphase_new(44100, 48000, 2, 0);
+    fail_unless(pa_resampler_polyphase_n_banks() == 1);
+
+    for (; i < 6; i++)
+        r[i] = polyphase_new(48000, 44100, 2, 0);
+    fail_unless(pa_resampler_polyphase_n_banks() == 2);
+
+    for (; i < 8; i++)
+        r[i] = polyphase_new(44100, 48000, 2, PA_RESAMPLER_VARIABLE_RATE);
+    fail_unless(pa_resampler_polyphase_n_banks() == 3);
+
+    for (i = 0; i < PA_ELEMENTSOF(r); i++)
+        pa_resampler_free(r[i]);
+    fail_unless(pa_resampler_polyphase_n_banks() == 3);
+
+    r[0] = polyphase_new(44100, 48000, 2, 0);
+    fail_unless(pa_resampler_polyphase_n_banks() == 3);
+    pa_resampler_free(r[0]);
+
+    pa_resampler_flush_cache();
+    fail_unless(pa_resampler_polyphase_n_banks() == 0);
+}
+END_TEST
+
+/* Resident set size in bytes, 0 if unknown */
+static size_t rss(void) {
+    unsigned long size, resident = 0;
+    FILE *f;
+
+    if (!(f = fopen("/proc/self/statm", "r")))
+        return 0;
+
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    fclose(f);
+
+    return resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+static pa_resampler *stream_new(pa_resample_method_t method) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = 2;
+    a.rate = 44100;
+    b.rate = 48000;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, 0));
+
+    return r;
+}
+
+/* Creates N_STREAMS resamplers 44.1 -> 48 kHz, logs the time taken by
+ * the first one and by the rest, and the RSS growth */
+static void create_streams(pa_resample_method_t method) {
+    pa_resampler *r[N_STREAMS];
+    pa_usec_t ts, first, rest;
+    size_t before, after;
+    unsigned i;
+
+    before = rss();
+
+    ts = pa_rtclock_now();
+    r[0] = stream_new(method);
+    first = pa_rtclock_now() - ts;
+
+    ts = pa_rtclock_now();
+    for (i = 1; i < N_STREAMS; i++)
+        r[i] = stream_new(method);
+    rest = pa_rtclock_now() - ts;
+
+    after = rss();
+
+    pa_log_info("%s: first stream %llu us, %u more %llu us, RSS +%zu kB",
+                pa_resample_method_to_string(method), (unsigned long long) first,
+                N_STREAMS - 1, (unsigned long long) rest, (PA_MAX(after, before) - before) / 1024);
+
+    for (i = 0; i < N_STREAMS; i++)
+        pa_resampler_free(r[i]);
+}
+
+/* Cost of creating many streams against the other resamplers. Run by
+ * hand only. */
+START_TEST (polyphase_streams_benchmark) {
+    pa_resampler_flush_cache();
+
+    create_streams(PA_RESAMPLER_POLYPHASE);
+    if (pa_resample_method_supported(PA_RESAMPLER_SPEEX_FLOAT_BASE + 1))
+        create_streams(PA_RESAMPLER_SPEEX_FLOAT_BASE + 1);
+    if (pa_resample_method_supported(PA_RESAMPLER_SOXR_MQ))
+        create_streams(PA_RESAMPLER_SOXR_MQ);
+
+    /* The unused bank is kept for the next stream */
+    create_streams(PA_RESAMPLER_POLYPHASE);
+
+    pa_resampler_flush_cache();
+}
+END_TEST
+
+#if ((defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)) || \
+    (defined (__arm__) && defined (__linux__) && defined (HAVE_NEON))
+static void run_dot_test(pa_polyphase_dot_func_t func, pa_polyphase_dot_func_t orig_func) {
+    int16_t ia[1031], ib[1031];
+    float a[1031], b[1031];
+    unsigned i, n;
+
+    pa_random(ia, sizeof(ia));
+    pa_random(ib, sizeof(ib));
+    for (i = 0; i < PA_ELEMENTSOF(a); i++) {
+        a[i] = (float) ia[i] / 0x8000;
+        b[i] = (float) ib[i] / 0x8000;
+    }
+
+    for (n = 0; n <= 1024; n = n < 32 ? n + 1 : n * 2)
+        for (i = 0; i < 8; i += 3) {
+            float s = func(a + i, b + 7 - i, n), s_ref = orig_func(a + i, b + 7 - i, n);
+
+            if (fabsf(s - s_ref) > 1e-4f * (1 + n / 64)) {
+                pa_log_debug("Inner product of %u differs: %f != %f", n, s, s_ref);
+                ck_abort();
+            }
+        }
+}
+#endif
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+START_TEST (polyphase_avx2_test) {
+    pa_polyphase_dot_func_t orig_func;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_polyphase_dot_func();
+    pa_polyphase_func_init_avx(flags);
+
+    pa_log_debug("Checking AVX2 polyphase inner product");
+    run_dot_test(pa_get_polyphase_dot_func(), orig_func);
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+START_TEST (polyphase_neon_test) {
+    pa_polyphase_dot_func_t orig_func;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_polyphase_dot_func();
+    pa_polyphase_func_init_neon(flags);
+
+    pa_log_debug("Checking NEON polyphase inner product");
+    run_dot_test(pa_get_polyphase_dot_func(), orig_func);
+}
+END_TEST
+#endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    s = suite_create("Polyphase Resampler");
+    tc = tcase_create("polyphase");
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, polyphase_avx2_test);
+#endif
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    tcase_add_test(tc, polyphase_neon_test);
+#endif
+    tcase_add_test(tc, polyphase_quality_test);
+    tcase_add_test(tc, polyphase_rewind_test);
+    tcase_add_test(tc, polyphase_rate_change_test);
+    tcase_add_test(tc, polyphase_cache_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    /* Timings only, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("polyphase benchmark");
+        tcase_add_test(tc, polyphase_streams_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    pa_mempool_unref(pool);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
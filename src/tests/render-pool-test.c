@@ -0,0 +1,102 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/render-pool.h>
+
+#define MAX_JOBS 64
+#define N_WORKERS 3
+#define N_RUNS 200
+
+struct jobs {
+    pa_atomic_t count[MAX_JOBS];
+    pa_atomic_t not_in_job;
+};
+
+static void job_cb(pa_render_pool *p, unsigned job, void *userdata) {
+    struct jobs *j = userdata;
+
+    fail_unless(job < MAX_JOBS);
+
+    if (!pa_render_pool_in_job(p))
+        pa_atomic_inc(&j->not_in_job);
+
+    pa_atomic_inc(&j->count[job]);
+}
+
+START_TEST (render_pool_test) {
+    pa_render_pool *p;
+    struct jobs j;
+    unsigned n, k, run;
+
+    p = pa_render_pool_new(N_WORKERS, -1);
+    fail_unless(p != NULL);
+    fail_unless(pa_render_pool_get_n_workers(p) == N_WORKERS);
+
+    /* Both fewer and more jobs than threads, every job must run once
+     * per run, and the pool must be idle again when run() returns */
+    for (run = 0; run < N_RUNS; run++) {
+        n = run % (MAX_JOBS + 1);
+
+        for (k = 0; k < MAX_JOBS; k++)
+            pa_atomic_store(&j.count[k], 0);
+        pa_atomic_store(&j.not_in_job, 0);
+
+        pa_render_pool_run(p, n, job_cb, &j);
+
+        for (k = 0; k < MAX_JOBS; k++)
+            fail_unless(pa_atomic_load(&j.count[k]) == (k < n ? 1 : 0));
+        fail_unless(pa_atomic_load(&j.not_in_job) == 0);
+    }
+
+    fail_unless(!pa_render_pool_in_job(p));
+
+    pa_render_pool_free(p);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Render Pool");
+    tc = tcase_create("renderpool");
+    tcase_add_test(tc, render_pool_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,207 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
+
+/* Odd sizes, so that the tiles of the fused stages don't line up with
+ * the blocks */
+static const unsigned block_frames[] = { 1000, 37, 256, 700, 1 };
+
+static pa_mempool *pool;
+
+/* Runs the block through the resampler, returns a new memblock with
+ * the output appended to the previous output */
+static void run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *acc) {
+    pa_memchunk out;
+    pa_memblock *b;
+    uint8_t *d;
+
+    pa_resampler_run(r, in, &out);
+    if (!out.memblock)
+        return;
+
+    b = pa_memblock_new(pool, acc->length + out.length);
+    d = pa_memblock_acquire(b);
+
+    if (acc->memblock) {
+        memcpy(d, pa_memblock_acquire_chunk(acc), acc->length);
+        pa_memblock_release(acc->memblock);
+        pa_memblock_unref(acc->memblock);
+    }
+
+    memcpy(d + acc->length, pa_memblock_acquire_chunk(&out), out.length);
+    pa_memblock_release(out.memblock);
+    pa_memblock_unref(out.memblock);
+
+    pa_memblock_release(b);
+    acc->memblock = b;
+    acc->index = 0;
+    acc->length += out.length;
+}
+
+/* Compares the output of a resampler with fused stages with a chain of
+ * three resamplers doing one stage each: conversion into the work
+ * format, remapping and resampling, conversion into the output format */
+static void pipeline_test(const pa_sample_spec *a, const pa_sample_spec *b, pa_resample_method_t method,
+                          bool fuse_to_work, bool fuse_from_work) {
+    pa_resampler *fused, *chain[3];
+    pa_sample_spec w1, w2;
+    pa_memchunk fused_out, chain_out;
+    unsigned i;
+
+    pa_log_debug("%s %uch %u Hz -> %s %uch %u Hz", pa_sample_format_to_string(a->format), a->channels, a->rate,
+                 pa_sample_format_to_string(b->format), b->channels, b->rate);
+
+    pa_assert_se(fused = pa_resampler_new(pool, a, NULL, b, NULL, 0, method, 0));
+    fail_unless(fused->fuse_to_work == fuse_to_work);
+    fail_unless(fused->fuse_from_work == fuse_from_work);
+
+    w1 = *a;
+    w1.format = fused->work_format;
+    w2 = *b;
+    w2.format = fused->work_format;
+
+    pa_assert_se(chain[0] = pa_resampler_new(pool, a, NULL, &w1, NULL, 0, PA_RESAMPLER_COPY, 0));
+    pa_assert_se(chain[1] = pa_resampler_new(pool, &w1, NULL, &w2, NULL, 0, method, 0));
+    pa_assert_se(chain[2] = pa_resampler_new(pool, &w2, NULL, b, NULL, 0, PA_RESAMPLER_COPY, 0));
+
+    for (i = 0; i < 3; i++)
+        fail_unless(!chain[i]->tile_buf);
+
+    pa_memchunk_reset(&fused_out);
+    pa_memchunk_reset(&chain_out);
+
+    for (i = 0; i < PA_ELEMENTSOF(block_frames); i++) {
+        pa_memchunk in, c1, c2;
+
+        in.memblock = pa_memblock_new(pool, block_frames[i] * pa_frame_size(a));
+        in.index = 0;
+        in.length = pa_memblock_get_length(in.memblock);
+        pa_random(pa_memblock_acquire(in.memblock), in.length);
+        pa_memblock_release(in.memblock);
+
+        /* Random bits aren't necessarily valid floats */
+        if (a->format == PA_SAMPLE_FLOAT32NE) {
+            float *f = pa_memblock_acquire(in.memblock);
+            unsigned j;
+
+            for (j = 0; j < in.length / sizeof(float); j++)
+                f[j] = (float) ((int16_t) ((uint32_t *) f)[j]) / 0x8000;
+            pa_memblock_release(in.memblock);
+        }
+
+        run(fused, &in, &fused_out);
+
+        pa_resampler_run(chain[0], &in, &c1);
+        pa_resampler_run(chain[1], &c1, &c2);
+        if (c2.memblock)
+            run(chain[2], &c2, &chain_out);
+
+        pa_memblock_unref(c1.memblock);
+        if (c2.memblock)
+            pa_memblock_unref(c2.memblock);
+        pa_memblock_unref(in.memblock);
+    }
+
+    fail_unless(fused_out.length == chain_out.length);
+    fail_unless(fused_out.length > 0);
+    fail_unless(memcmp(pa_memblock_acquire_chunk(&fused_out), pa_memblock_acquire_chunk(&chain_out), fused_out.length) == 0);
+    pa_memblock_release(fused_out.memblock);
+    pa_memblock_release(chain_out.memblock);
+
+    pa_memblock_unref(fused_out.memblock);
+    pa_memblock_unref(chain_out.memblock);
+
+    for (i = 0; i < 3; i++)
+        pa_resampler_free(chain[i]);
+    pa_resampler_free(fused);
+}
+
+START_TEST (pipeline_fused_test) {
+    pa_sample_spec a, b;
+
+    /* Conversion, remapping and conversion in one pass */
+    a.format = PA_SAMPLE_S32NE;
+    a.channels = 2;
+    a.rate = 44100;
+    b.format = PA_SAMPLE_S24LE;
+    b.channels = 6;
+    b.rate = 44100;
+    pipeline_test(&a, &b, PA_RESAMPLER_COPY, true, true);
+
+    /* Conversion and remapping before resampling */
+    a.format = PA_SAMPLE_S16NE;
+    a.channels = 6;
+    b.format = PA_SAMPLE_FLOAT32NE;
+    b.channels = 2;
+    b.rate = 48000;
+    pipeline_test(&a, &b, PA_RESAMPLER_POLYPHASE, true, false);
+
+    /* Remapping and conversion after resampling */
+    a.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = 2;
+    b.format = PA_SAMPLE_S16NE;
+    b.channels = 6;
+    pipeline_test(&a, &b, PA_RESAMPLER_POLYPHASE, false, true);
+
+    /* Conversion before resampling and remapping, nothing to fuse */
+    a.format = PA_SAMPLE_S16NE;
+    a.channels = 2;
+    b.format = PA_SAMPLE_FLOAT32NE;
+    b.channels = 6;
+    pipeline_test(&a, &b, PA_RESAMPLER_POLYPHASE, false, false);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    s = suite_create("Resampler Pipeline");
+    tc = tcase_create("resampler-pipeline");
+    tcase_add_test(tc, pipeline_fused_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    pa_mempool_unref(pool);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
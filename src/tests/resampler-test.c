@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <locale.h>
+#include <math.h>
 
 #include <pulse/pulseaudio.h>
 
@@ -251,6 +252,119 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+/* Least squares fit of a sine of the given frequency to the first
+ * channel, returns the ratio of its power to the residual in dB */
+static double tone_snr(const float *x, unsigned n, unsigned channels, double freq, uint32_t rate) {
+    double ss = 0, cc = 0, sc = 0, xs = 0, xc = 0, xx = 0, det, p, q, signal, noise;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        double si = sin(2 * M_PI * freq * i / rate), ci = cos(2 * M_PI * freq * i / rate);
+        double v = x[i * channels];
+
+        ss += si * si;
+        cc += ci * ci;
+        sc += si * ci;
+        xs += v * si;
+        xc += v * ci;
+        xx += v * v;
+    }
+
+    det = ss * cc - sc * sc;
+    p = (xs * cc - xc * sc) / det;
+    q = (xc * ss - xs * sc) / det;
+
+    signal = p * xs + q * xc;
+    noise = PA_MAX(xx - signal, 1e-30);
+
+    return 10 * log10(signal / noise);
+}
+
+/* Resamples a tone in 10 ms chunks with each of the methods, reporting
+ * the time taken per second of audio and the SNR of the output */
+static void benchmark(pa_mempool *pool, int seconds) {
+    static const uint32_t rates[][2] = {
+        { 44100, 48000 }, { 48000, 44100 },
+        { 48000, 96000 }, { 96000, 48000 },
+        { 44100, 96000 }, { 96000, 44100 },
+    };
+    static const pa_resample_method_t methods[] = {
+        PA_RESAMPLER_POLYPHASE,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 1,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 5,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 10,
+        PA_RESAMPLER_SOXR_MQ,
+    };
+    const double freq = 997;
+    unsigned r, m;
+
+    for (r = 0; r < PA_ELEMENTSOF(rates); r++) {
+        pa_sample_spec a, b;
+        pa_memchunk i;
+        unsigned n_in, chunk, k;
+        float *d;
+
+        a.format = b.format = PA_SAMPLE_FLOAT32NE;
+        a.channels = b.channels = 2;
+        a.rate = rates[r][0];
+        b.rate = rates[r][1];
+
+        n_in = a.rate * seconds;
+        chunk = a.rate / 100;
+
+        i.memblock = pa_memblock_new(pool, n_in * pa_frame_size(&a));
+        d = pa_memblock_acquire(i.memblock);
+        for (k = 0; k < n_in; k++)
+            d[2 * k] = d[2 * k + 1] = (float) (0.5 * sin(2 * M_PI * freq * k / a.rate));
+        pa_memblock_release(i.memblock);
+
+        for (m = 0; m < PA_ELEMENTSOF(methods); m++) {
+            pa_resampler *resampler;
+            float *out = NULL;
+            size_t n_out = 0, size = 0;
+            pa_usec_t ts;
+
+            if (!pa_resample_method_supported(methods[m]))
+                continue;
+
+            pa_assert_se(resampler = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, methods[m], 0));
+
+            ts = pa_rtclock_now();
+            for (k = 0; k + chunk <= n_in; k += chunk) {
+                pa_memchunk in = i, o;
+
+                in.index = k * pa_frame_size(&a);
+                in.length = chunk * pa_frame_size(&a);
+                pa_resampler_run(resampler, &in, &o);
+
+                if (!o.memblock)
+                    continue;
+
+                if (n_out + o.length / sizeof(float) > size) {
+                    size = PA_MAX(size * 2, n_out + o.length / sizeof(float));
+                    out = pa_xrealloc(out, size * sizeof(float));
+                }
+                memcpy(out + n_out, (uint8_t *) pa_memblock_acquire(o.memblock) + o.index, o.length);
+                pa_memblock_release(o.memblock);
+                pa_memblock_unref(o.memblock);
+                n_out += o.length / sizeof(float);
+            }
+            ts = pa_rtclock_now() - ts;
+
+            /* Skip the first half to be clear of the filter start */
+            pa_log_info("%6u -> %6u Hz %-16s %8.1f us/s, SNR %6.1f dB",
+                        a.rate, b.rate, pa_resample_method_to_string(methods[m]),
+                        (double) ts / seconds,
+                        tone_snr(out + n_out / 4 * 2, n_out / 4, 2, freq, b.rate));
+
+            pa_xfree(out);
+            pa_resampler_free(resampler);
+        }
+
+        pa_memblock_unref(i.memblock);
+    }
+}
+
 static void help(const char *argv0) {
     printf("%s [options]\n\n"
            "-h, --help                            Show this help\n"
@@ -263,6 +377,9 @@ static void help(const char *argv0) {
            "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
            "      --resample-method=METHOD        Resample method (defaults to auto)\n"
            "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+           "      --benchmark                     Compare the speed and quality of the\n"
+           "                                      polyphase, speex-float and soxr-mq\n"
+           "                                      methods on stereo float32\n"
            "\n"
            "If the formats are not specified, the test performs all formats combinations,\n"
            "back and forth.\n"
@@ -284,7 +401,8 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_BENCHMARK
 };
 
 static void dump_resample_methods(void) {
@@ -300,7 +418,7 @@ int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    bool all_formats = true;
+    bool all_formats = true, bench = false;
     pa_resample_method_t method;
     int seconds;
     unsigned crossover_freq = 120;
@@ -318,6 +436,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"benchmark",             0, NULL, ARG_BENCHMARK},
         {NULL,                    0, NULL, 0}
     };
 
@@ -389,6 +508,10 @@ int main(int argc, char *argv[]) {
                 seconds = atoi(optarg);
                 break;
 
+            case ARG_BENCHMARK:
+                bench = true;
+                break;
+
             case ARG_RESAMPLE_METHOD:
                 if (*optarg == '\0' || pa_streq(optarg, "help")) {
                     dump_resample_methods();
@@ -406,6 +529,11 @@ int main(int argc, char *argv[]) {
     ret = 0;
     pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
 
+    if (bench) {
+        benchmark(pool, seconds);
+        goto quit;
+    }
+
     if (!all_formats) {
 
         pa_resampler *resampler;
@@ -0,0 +1,396 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulsecore/memblockq.h>
+#include <pulsecore/ringq.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include <pulse/rtclock.h>
+
+#define N_OPS 20000
+#define N_BENCH 200000
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = 48000,
+    .channels = 2
+};
+
+static pa_memchunk make_chunk(pa_mempool *p, size_t length, uint8_t *counter) {
+    pa_memchunk c;
+    uint8_t *d;
+    size_t i;
+
+    c.memblock = pa_memblock_new(p, length);
+    c.index = 0;
+    c.length = length;
+
+    d = pa_memblock_acquire(c.memblock);
+    for (i = 0; i < length; i++)
+        d[i] = ++*counter | 1;
+    pa_memblock_release(c.memblock);
+
+    return c;
+}
+
+static pa_memchunk make_silence(pa_mempool *p) {
+    pa_memchunk c;
+
+    c.memblock = pa_memblock_new(p, 256);
+    c.index = 0;
+    c.length = 256;
+
+    memset(pa_memblock_acquire(c.memblock), 0, c.length);
+    pa_memblock_release(c.memblock);
+
+    return c;
+}
+
+static void check_same(pa_memblockq *bq, pa_ringq *rq) {
+    ck_assert_int_eq(pa_memblockq_get_read_index(bq), pa_ringq_get_read_index(rq));
+    ck_assert_int_eq(pa_memblockq_get_write_index(bq), pa_ringq_get_write_index(rq));
+    ck_assert_int_eq(pa_memblockq_get_length(bq), pa_ringq_get_length(rq));
+    ck_assert_int_eq(pa_memblockq_is_readable(bq), pa_ringq_is_readable(rq));
+    ck_assert_int_eq(pa_memblockq_prebuf_active(bq), pa_ringq_prebuf_active(rq));
+}
+
+static void check_peek(pa_memblockq *bq, pa_ringq *rq, size_t length) {
+    pa_memchunk a, b;
+    int ra, rb;
+
+    ra = pa_memblockq_peek_fixed_size(bq, length, &a);
+    rb = pa_ringq_peek_fixed_size(rq, length, &b);
+    ck_assert_int_eq(ra, rb);
+
+    if (ra < 0)
+        return;
+
+    ck_assert_int_eq(a.length, length);
+    ck_assert_int_eq(b.length, length);
+    fail_unless(memcmp(pa_memblock_acquire_chunk(&a), pa_memblock_acquire_chunk(&b), length) == 0);
+    pa_memblock_release(a.memblock);
+    pa_memblock_release(b.memblock);
+
+    pa_memblock_unref(a.memblock);
+    pa_memblock_unref(b.memblock);
+}
+
+/* Random pushes, seeks, drops and rewinds must leave a ringq in the
+ * same state as a memblockq, as long as the test stays within the
+ * rewind history both keep */
+START_TEST (ringq_memblockq_equivalence_test) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_ringq *rq;
+    pa_memchunk silence;
+    uint8_t counter = 0;
+    int64_t max_read;
+    size_t base, maxrewind = 1024;
+    unsigned n;
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(p != NULL);
+
+    silence = make_silence(p);
+
+    bq = pa_memblockq_new("test memblockq", 0, 4096, 2048, &ss, 512, 256, maxrewind, &silence);
+    rq = pa_ringq_new("test ringq", p, 0, 4096, 2048, &ss, 512, 256, maxrewind, &silence);
+    fail_unless(bq != NULL);
+    fail_unless(rq != NULL);
+
+    base = pa_ringq_get_base(rq);
+    ck_assert_int_eq(base, pa_memblockq_get_base(bq));
+    fail_unless(pa_ringq_get_capacity(rq) >= 4096 + maxrewind);
+
+    ck_assert_int_eq(pa_memblockq_pop_missing(bq), pa_ringq_pop_missing(rq));
+    check_same(bq, rq);
+
+    srand(42);
+    max_read = 0;
+
+    for (n = 0; n < N_OPS; n++) {
+        int64_t ri, wi, o;
+        size_t l;
+
+        ri = pa_ringq_get_read_index(rq);
+        wi = pa_ringq_get_write_index(rq);
+
+        switch (rand() % 8) {
+            case 0:
+            case 1: {
+                pa_memchunk c;
+
+                c = make_chunk(p, base * (1 + rand() % 128), &counter);
+                ck_assert_int_eq(pa_memblockq_push(bq, &c), pa_ringq_push(rq, &c));
+                pa_memblock_unref(c.memblock);
+                break;
+            }
+
+            case 2:
+                /* Never seek behind the read index, a memblockq
+                 * would keep data there that a ringq throws away */
+                o = (int64_t) base * (rand() % 64 - 32);
+                if (wi + o < ri)
+                    o = ri - wi;
+                pa_memblockq_seek(bq, o, PA_SEEK_RELATIVE, true);
+                pa_ringq_seek(rq, o, PA_SEEK_RELATIVE, true);
+                break;
+
+            case 3:
+                o = (int64_t) base * (rand() % 16);
+                if (rand() % 2) {
+                    pa_memblockq_seek(bq, o, PA_SEEK_RELATIVE_END, false);
+                    pa_ringq_seek(rq, o, PA_SEEK_RELATIVE_END, false);
+                } else {
+                    pa_memblockq_seek(bq, o, PA_SEEK_RELATIVE_ON_READ, true);
+                    pa_ringq_seek(rq, o, PA_SEEK_RELATIVE_ON_READ, true);
+                }
+                break;
+
+            case 4:
+            case 5:
+                /* A memblockq stops dropping at the first block boundary
+                 * past the write index when prebuf kicks in, a ringq
+                 * right at the write index. Don't go there. */
+                l = PA_MIN(base * (rand() % 128), pa_memblockq_get_length(bq));
+                check_peek(bq, rq, l > 0 ? l : base);
+                pa_memblockq_drop(bq, l);
+                pa_ringq_drop(rq, l);
+                break;
+
+            case 6:
+                /* Only rewind into history both queues still have */
+                l = base * (rand() % 128);
+                if (ri - (int64_t) l < max_read - (int64_t) maxrewind)
+                    l = (size_t) (ri - (max_read - (int64_t) maxrewind));
+                pa_memblockq_rewind(bq, l);
+                pa_ringq_rewind(rq, l);
+                break;
+
+            case 7:
+                switch (rand() % 8) {
+                    case 0:
+                        pa_memblockq_flush_write(bq, true);
+                        pa_ringq_flush_write(rq, true);
+                        break;
+                    case 1:
+                        pa_memblockq_prebuf_force(bq);
+                        pa_ringq_prebuf_force(rq);
+                        break;
+                    case 2:
+                        pa_memblockq_prebuf_disable(bq);
+                        pa_ringq_prebuf_disable(rq);
+                        break;
+                    default:
+                        ck_assert_int_eq(pa_memblockq_pop_missing(bq), pa_ringq_pop_missing(rq));
+                        break;
+                }
+                break;
+        }
+
+        if (pa_ringq_get_read_index(rq) > max_read)
+            max_read = pa_ringq_get_read_index(rq);
+
+        check_same(bq, rq);
+        check_peek(bq, rq, base * 64);
+    }
+
+    pa_memblockq_free(bq);
+    pa_ringq_free(rq);
+    pa_memblock_unref(silence.memblock);
+    pa_mempool_unref(p);
+}
+END_TEST
+
+/* Data written across the end of the ring and moved to a larger ring
+ * must come back unchanged, and chunks peeked before must stay valid */
+START_TEST (ringq_wrap_resize_test) {
+    pa_mempool *p;
+    pa_ringq *rq;
+    pa_memchunk c, peeked, copy;
+    uint8_t counter = 0;
+    size_t capacity, base;
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(p != NULL);
+
+    rq = pa_ringq_new("test ringq", p, 0, 1024, 1024, &ss, 0, 0, 0, NULL);
+    fail_unless(rq != NULL);
+
+    capacity = pa_ringq_get_capacity(rq);
+    base = pa_ringq_get_base(rq);
+
+    /* Walk the write index to 512 bytes before the end of the ring */
+    while (pa_ringq_get_write_index(rq) + 512 < (int64_t) capacity) {
+        size_t l;
+
+        l = PA_MIN((size_t) 1024, capacity - 512 - (size_t) pa_ringq_get_write_index(rq));
+        c = make_chunk(p, l, &counter);
+        ck_assert_int_eq(pa_ringq_push(rq, &c), 0);
+        pa_memblock_unref(c.memblock);
+        pa_ringq_drop(rq, l);
+    }
+
+    c = make_chunk(p, 1024, &counter);
+    ck_assert_int_eq(pa_ringq_push(rq, &c), 0);
+
+    /* The queued data wraps, a plain peek only returns the first part */
+    ck_assert_int_eq(pa_ringq_peek(rq, &peeked), 0);
+    fail_unless(peeked.memblock != NULL);
+    ck_assert_int_eq(peeked.length, 512);
+    fail_unless(memcmp(pa_memblock_acquire_chunk(&peeked), pa_memblock_acquire_chunk(&c), peeked.length) == 0);
+    pa_memblock_release(peeked.memblock);
+    pa_memblock_release(c.memblock);
+
+    /* Growing the history moves the data to a new ring */
+    pa_ringq_set_maxrewind(rq, capacity * 4);
+    fail_unless(pa_ringq_get_capacity(rq) >= 1024 + capacity * 4);
+
+    ck_assert_int_eq(pa_ringq_peek_fixed_size(rq, 1024, &copy), 0);
+    ck_assert_int_eq(copy.length, 1024);
+    fail_unless(memcmp(pa_memblock_acquire_chunk(&copy), pa_memblock_acquire_chunk(&c), 1024) == 0);
+    pa_memblock_release(copy.memblock);
+    pa_memblock_release(c.memblock);
+    fail_unless(memcmp(pa_memblock_acquire_chunk(&peeked), pa_memblock_acquire_chunk(&c), peeked.length) == 0);
+    pa_memblock_release(peeked.memblock);
+    pa_memblock_release(c.memblock);
+
+    pa_memblock_unref(copy.memblock);
+    pa_memblock_unref(peeked.memblock);
+
+    /* With the larger history we can rewind over the whole chunk */
+    pa_ringq_drop(rq, 1024);
+    pa_ringq_rewind(rq, 1024);
+    ck_assert_int_eq(pa_ringq_peek_fixed_size(rq, 1024, &copy), 0);
+    fail_unless(memcmp(pa_memblock_acquire_chunk(&copy), pa_memblock_acquire_chunk(&c), 1024) == 0);
+    pa_memblock_release(copy.memblock);
+    pa_memblock_release(c.memblock);
+    pa_memblock_unref(copy.memblock);
+
+    /* Without silence memchunk an empty queue can't be peeked */
+    pa_ringq_drop(rq, 1024);
+    ck_assert_int_eq(pa_ringq_peek(rq, &copy), -1);
+    ck_assert_int_eq(pa_ringq_get_length(rq), 0);
+    fail_unless(pa_ringq_get_read_index(rq) % base == 0);
+
+    pa_memblock_unref(c.memblock);
+    pa_ringq_free(rq);
+    pa_mempool_unref(p);
+}
+END_TEST
+
+/* The jitter buffer pattern of the network modules: many small packets
+ * in, sink sized blocks out. Run under perf stat -e cache-misses to see
+ * the difference in memory traffic as well. */
+START_TEST (ringq_benchmark) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_ringq *rq;
+    pa_memchunk packets[16], chunk, silence;
+    uint8_t counter = 0;
+    pa_usec_t start, stop;
+    unsigned n;
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(p != NULL);
+
+    /* 1ms packets */
+    for (n = 0; n < PA_ELEMENTSOF(packets); n++)
+        packets[n] = make_chunk(p, 192, &counter);
+
+    silence = make_silence(p);
+
+    bq = pa_memblockq_new("bench memblockq", 0, 65536, 19200, &ss, 0, 0, 0, &silence);
+    rq = pa_ringq_new("bench ringq", p, 0, 65536, 19200, &ss, 0, 0, 0, &silence);
+
+    start = pa_rtclock_now();
+    for (n = 0; n < N_BENCH; n++) {
+        pa_memblockq_push(bq, &packets[n % PA_ELEMENTSOF(packets)]);
+
+        while (pa_memblockq_get_length(bq) >= 19200 && pa_memblockq_peek_fixed_size(bq, 1024, &chunk) >= 0) {
+            pa_memblockq_drop(bq, chunk.length);
+            pa_memblock_unref(chunk.memblock);
+        }
+    }
+    stop = pa_rtclock_now();
+    pa_log_info("memblockq: %.1f ns/op", (double) (stop - start) * 1000.0 / N_BENCH);
+
+    start = pa_rtclock_now();
+    for (n = 0; n < N_BENCH; n++) {
+        pa_ringq_push(rq, &packets[n % PA_ELEMENTSOF(packets)]);
+
+        while (pa_ringq_get_length(rq) >= 19200 && pa_ringq_peek_fixed_size(rq, 1024, &chunk) >= 0) {
+            pa_ringq_drop(rq, chunk.length);
+            pa_memblock_unref(chunk.memblock);
+        }
+    }
+    stop = pa_rtclock_now();
+    pa_log_info("ringq: %.1f ns/op", (double) (stop - start) * 1000.0 / N_BENCH);
+
+    ck_assert_int_eq(pa_memblockq_get_length(bq), pa_ringq_get_length(rq));
+
+    pa_memblockq_free(bq);
+    pa_ringq_free(rq);
+
+    for (n = 0; n < PA_ELEMENTSOF(packets); n++)
+        pa_memblock_unref(packets[n].memblock);
+
+    pa_memblock_unref(silence.memblock);
+    pa_mempool_unref(p);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Ring Queue");
+    tc = tcase_create("ringq");
+    tcase_add_test(tc, ringq_memblockq_equivalence_test);
+    tcase_add_test(tc, ringq_wrap_resize_test);
+    suite_add_tcase(s, tc);
+
+    /* Timings only, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("ringq benchmark");
+        tcase_add_test(tc, ringq_benchmark);
+        tcase_set_timeout(tc, 120);
+        suite_add_tcase(s, tc);
+    }
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
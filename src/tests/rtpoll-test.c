@@ -21,10 +21,20 @@
 
 #include <check.h>
 #include <signal.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/thread.h>
+
+#define N_IDLE_FDS 64
+#define N_WAKEUPS 200
+#define WAKEUP_INTERVAL_USEC 300
 
 static int before(pa_rtpoll_item *i) {
     pa_log("before");
@@ -82,21 +92,239 @@ START_TEST (rtpoll_test) {
 }
 END_TEST
 
+static pa_rtpoll_item *fd_item_new(pa_rtpoll *p, int fd) {
+    pa_rtpoll_item *i;
+    struct pollfd *pollfd;
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NEVER, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd->fd = fd;
+    pollfd->events = POLLIN;
+
+    return i;
+}
+
+static short fd_item_revents(pa_rtpoll_item *i) {
+    return pa_rtpoll_item_get_pollfd(i, NULL)->revents;
+}
+
+static pa_rtpoll_item *victim;
+
+static void free_victim(pa_rtpoll_item *i) {
+    if (victim) {
+        pa_rtpoll_item_free(victim);
+        victim = NULL;
+    }
+}
+
+static void backend_test(pa_rtpoll_backend_t backend) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *a, *b, *c, *freer;
+    pa_rtpoll_backend_t actual;
+    int pa[2], pb[2];
+    char x = 'x';
+
+    pa_log_debug("Testing %s backend", pa_rtpoll_backend_to_string(backend));
+
+    fail_unless(pipe(pa) == 0);
+    fail_unless(pipe(pb) == 0);
+
+    p = pa_rtpoll_new_with_backend(backend);
+    actual = pa_rtpoll_get_backend(p);
+    a = fd_item_new(p, pa[0]);
+    b = fd_item_new(p, pb[0]);
+
+    /* Only the ready fd has revents set, and the timer did not elapse */
+    fail_unless(pa_write(pa[1], &x, 1, NULL) == 1);
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(fd_item_revents(a) & POLLIN);
+    fail_unless(fd_item_revents(b) == 0);
+
+    /* Nothing ready, the timer elapses and all revents are cleared */
+    fail_unless(pa_read(pa[0], &x, 1, NULL) == 1);
+    pa_rtpoll_set_timer_relative(p, 1000);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(fd_item_revents(a) == 0);
+    fail_unless(fd_item_revents(b) == 0);
+
+    /* Move b over to the write end of a */
+    pa_rtpoll_item_get_pollfd(b, NULL)->fd = pa[1];
+    pa_rtpoll_item_get_pollfd(b, NULL)->events = POLLOUT;
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(fd_item_revents(a) == 0);
+    fail_unless(fd_item_revents(b) & POLLOUT);
+
+    /* An item freed from a callback of another one must not be polled */
+    freer = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 0);
+    pa_rtpoll_item_set_after_callback(freer, free_victim, NULL);
+    victim = a;
+    fail_unless(pa_write(pa[1], &x, 1, NULL) == 1);
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(victim == NULL);
+    pa_rtpoll_item_get_pollfd(b, NULL)->events = 0;
+    pa_rtpoll_set_timer_relative(p, 1000);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(pa_rtpoll_get_backend(p) == actual);
+
+    /* The same fd in two items works too, the loop falls back to ppoll
+     * for that */
+    c = fd_item_new(p, pa[0]);
+    a = fd_item_new(p, pa[0]);
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(fd_item_revents(a) & POLLIN);
+    fail_unless(fd_item_revents(c) & POLLIN);
+    fail_unless(pa_rtpoll_get_backend(p) == PA_RTPOLL_BACKEND_PPOLL);
+
+    pa_rtpoll_item_free(a);
+    pa_rtpoll_item_free(b);
+    pa_rtpoll_item_free(c);
+    pa_rtpoll_item_free(freer);
+    pa_rtpoll_free(p);
+
+    pa_close_pipe(pa);
+    pa_close_pipe(pb);
+}
+
+START_TEST (rtpoll_backend_test) {
+    backend_test(PA_RTPOLL_BACKEND_PPOLL);
+    backend_test(PA_RTPOLL_BACKEND_EPOLL);
+}
+END_TEST
+
+static int nop_before(pa_rtpoll_item *i) {
+    return 0;
+}
+
+static void nop_after(pa_rtpoll_item *i) {
+}
+
+static void writer(void *userdata) {
+    int fd = PA_PTR_TO_INT(userdata);
+    unsigned n;
+
+    for (n = 0; n < N_WAKEUPS; n++) {
+        pa_usec_t now;
+
+        usleep(WAKEUP_INTERVAL_USEC);
+
+        now = pa_rtclock_now();
+        pa_assert_se(pa_write(fd, &now, sizeof(now), NULL) == sizeof(now));
+    }
+}
+
+static void wakeup_benchmark(pa_rtpoll_backend_t backend) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *idle[N_IDLE_FDS], *cb[4], *wakeup;
+    int idle_pipes[N_IDLE_FDS][2], wakeup_pipe[2];
+    pa_usec_t late;
+    pa_thread *thread;
+    unsigned n;
+
+    p = pa_rtpoll_new_with_backend(backend);
+
+    /* Like the IO thread of a sink with many streams: lots of fds that
+     * are hardly ever ready, and a few items with callbacks */
+    for (n = 0; n < N_IDLE_FDS; n++) {
+        fail_unless(pipe(idle_pipes[n]) == 0);
+        idle[n] = fd_item_new(p, idle_pipes[n][0]);
+    }
+
+    for (n = 0; n < PA_ELEMENTSOF(cb); n++) {
+        cb[n] = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 0);
+        pa_rtpoll_item_set_before_callback(cb[n], nop_before, NULL);
+        pa_rtpoll_item_set_after_callback(cb[n], nop_after, NULL);
+    }
+
+    /* Timer wakeups */
+    late = 0;
+    for (n = 0; n < N_WAKEUPS; n++) {
+        pa_usec_t deadline = pa_rtclock_now() + WAKEUP_INTERVAL_USEC;
+
+        pa_rtpoll_set_timer_absolute(p, deadline);
+        fail_unless(pa_rtpoll_run(p) > 0);
+        fail_unless(pa_rtpoll_timer_elapsed(p));
+        late += pa_rtclock_now() - deadline;
+    }
+
+    pa_log_info("%s: timer wakeup %0.1f usec late on average",
+                pa_rtpoll_backend_to_string(backend), (double) late / N_WAKEUPS);
+
+    /* fd wakeups, the writer sends the time it wrote at */
+    fail_unless(pipe(wakeup_pipe) == 0);
+    wakeup = fd_item_new(p, wakeup_pipe[0]);
+    thread = pa_thread_new("rtpoll-writer", writer, PA_INT_TO_PTR(wakeup_pipe[1]));
+
+    late = 0;
+    for (n = 0; n < N_WAKEUPS; n++) {
+        pa_usec_t sent;
+
+        do {
+            pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+            fail_unless(pa_rtpoll_run(p) > 0);
+        } while (!(fd_item_revents(wakeup) & POLLIN));
+
+        fail_unless(pa_read(wakeup_pipe[0], &sent, sizeof(sent), NULL) == sizeof(sent));
+        late += pa_rtclock_now() - sent;
+    }
+
+    pa_log_info("%s: fd wakeup after %0.1f usec on average",
+                pa_rtpoll_backend_to_string(backend), (double) late / N_WAKEUPS);
+
+    pa_thread_free(thread);
+
+    pa_rtpoll_item_free(wakeup);
+    for (n = 0; n < PA_ELEMENTSOF(cb); n++)
+        pa_rtpoll_item_free(cb[n]);
+    for (n = 0; n < N_IDLE_FDS; n++) {
+        pa_rtpoll_item_free(idle[n]);
+        pa_close_pipe(idle_pipes[n]);
+    }
+    pa_rtpoll_free(p);
+
+    pa_close_pipe(wakeup_pipe);
+}
+
+START_TEST (rtpoll_wakeup_benchmark) {
+    wakeup_benchmark(PA_RTPOLL_BACKEND_PPOLL);
+    wakeup_benchmark(PA_RTPOLL_BACKEND_EPOLL);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
     TCase *tc;
     SRunner *sr;
 
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_backend_test);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
     tcase_set_timeout(tc, 60 * 60);
     suite_add_tcase(s, tc);
 
+    /* Timings only, not for make check */
+    if (!getenv("MAKE_CHECK")) {
+        tc = tcase_create("rtpoll benchmark");
+        tcase_add_test(tc, rtpoll_wakeup_benchmark);
+        tcase_set_timeout(tc, 60 * 60);
+        suite_add_tcase(s, tc);
+    }
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);